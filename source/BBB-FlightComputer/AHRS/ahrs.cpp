@@ -1,13 +1,37 @@
 #include "ahrs.h"
+#include "fixedAhrs.h"
+#include "../realtime/latency.h"
+#include "../realtime/console.h"
 
 imu::Quaternion q;
 imu::Quaternion offset;
-imu::Quaternion body;
+AttitudeSnapshot attitude;
 
 volatile float beta = 0.1;
 unsigned long last_micros = 0;
 
+volatile UIMU_AHRS_FILTER filter = AHRS_FILTER_MADGWICK;
+volatile float twoKp = 2.0f * 0.5f;	// 2 * proportional gain
+volatile float twoKi = 2.0f * 0.0f;	// 2 * integral gain
+float integralFBx = 0.0f, integralFBy = 0.0f, integralFBz = 0.0f;	// Mahony integral error terms
+
+volatile unsigned long correction_period = 10000;	// Microseconds between batch corrections
+unsigned long last_correction_micros = 0;
+bool pending_acc = false;	// Fresh samples seen since the last batch correction
+bool pending_mag = false;
+float acc_pending_dt = 0.0f;	// Time since each sensor last corrected the estimate
+float mag_pending_dt = 0.0f;
+
+volatile float airspeed = 0.0f;	// m/s along the IMU's x, 0 takes the accel as it is
+
 void MadgwickAHRSupdate(imu::Vector<3> g, imu::Vector<3> a, imu::Vector<3> m, float dt);
+void MadgwickAHRSupdateIMU(imu::Vector<3> g, imu::Vector<3> a, float dt);
+void MahonyAHRSupdate(imu::Vector<3> g, imu::Vector<3> a, imu::Vector<3> m, float dt);
+void GyroOnlyUpdate(imu::Vector<3> g, float dt);
+
+#ifdef AHRS_FIXED_POINT
+static FixedAhrs fixedFilter;	// Holds the estimate, q is its float copy for the readers
+#endif
 
 
 void uimu_ahrs_init(imu::Vector<3> acc, imu::Vector<3> mag) {
@@ -24,31 +48,208 @@ void uimu_ahrs_init(imu::Vector<3> acc, imu::Vector<3> mag) {
     m.vector_to_row(east, 1);
     m.vector_to_row(down, 2);
 
-    q.fromMatrix(m);
-    last_micros = micros();
+    imu::Quaternion initial;
+    initial.fromMatrix(m);
+    uimu_ahrs_reset(initial);	// Also clears filter state left from a previous run
+}
+
+void uimu_ahrs_reset(imu::Quaternion initial) {
+	q = initial;
+	q.normalize();
+#ifdef AHRS_FIXED_POINT
+	fixedFilter.reset(q);
+#endif
+	attitude.update(q, offset);
+	integralFBx = integralFBy = integralFBz = 0.0f;
+	pending_acc = pending_mag = false;
+	acc_pending_dt = mag_pending_dt = 0.0f;
+	last_micros = micros();
+	last_correction_micros = last_micros;
 }
 
 
 void  uimu_ahrs_set_offset(imu::Quaternion o) {
 	offset = o;
+	attitude.update(q, offset);
 }
 
 void uimu_ahrs_set_beta(float b) {
     beta = b;
 }
 
-void uimu_ahrs_iterate(imu::Vector<3> ang_vel, imu::Vector<3> acc, imu::Vector<3> mag) {
+void uimu_ahrs_set_filter(UIMU_AHRS_FILTER f) {
+	if(f != filter)
+		integralFBx = integralFBy = integralFBz = 0.0f;	// Don't carry a stale bias estimate across
+	filter = f;
+}
+
+UIMU_AHRS_FILTER uimu_ahrs_get_filter() {
+#ifdef AHRS_FIXED_POINT
+	return AHRS_FILTER_MAHONY;	// The only one there is in fixed point
+#else
+	return filter;
+#endif
+}
+
+void uimu_ahrs_set_correction_rate(float hz) {
+	if(hz <= 0)
+		return;
+	correction_period = (unsigned long)(1000000.0f / hz);
+}
+
+void uimu_ahrs_set_airspeed(float metresPerSecond) {
+	airspeed = metresPerSecond > 0 ? metresPerSecond : 0;
+}
+
+// Flying at V along x while rotating at rate, the accel also senses rate x V. Taking that
+// out leaves gravity, which is all the correction should line the estimate up with; left
+// in, a coordinated turn reads as level and the estimate follows the bank
+static imu::Vector<3> gravityOnly(imu::Vector<3> acc, imu::Vector<3> rate) {
+	if(airspeed <= 0)
+		return acc;
+	double toG = airspeed / 9.80665;
+	acc.y() -= rate.z() * toG;
+	acc.z() += rate.y() * toG;
+	return acc;
+}
+
+void uimu_ahrs_set_mahony_gains(float kp, float ki) {
+	twoKp = 2.0f * kp;
+	twoKi = 2.0f * ki;
+#ifdef AHRS_FIXED_POINT
+	fixedFilter.setGains(kp, ki);
+#endif
+}
+
+#ifdef AHRS_FIXED_POINT
+
+// Rates, accel and mag that come in as floats are put on a Q15 scale first
+static void toFixed(imu::Vector<3> v, float fullScale, int16_t out[3]) {
+	for(int k = 0; k < 3; k++)
+		out[k] = fixedpoint::toQ15(v(k), fullScale);
+}
+
+static uint32_t toMicros(float dt) {
+	return (uint32_t)(dt * 1000000.0f + 0.5f);
+}
+
+static void applyFilter(imu::Vector<3> g, imu::Vector<3> a, imu::Vector<3> m, float dt, bool accFresh, bool magFresh) {
+	if(!accFresh && !magFresh) {
+		GyroOnlyUpdate(g, dt);
+		return;
+	}
+
+	int16_t gq[3], aq[3], mq[3];
+	g.toDegrees();
+	toFixed(g, FIXED_AHRS_GYRO_FULL_SCALE, gq);
+	toFixed(a, FIXED_AHRS_ACC_FULL_SCALE, aq);
+	toFixed(m, FIXED_AHRS_MAG_FULL_SCALE, mq);
+	fixedFilter.setGyroScale(FIXED_AHRS_GYRO_FULL_SCALE / 32768.0f);
+	fixedFilter.update(gq, aq, magFresh ? mq : NULL, toMicros(dt));
+}
+
+void GyroOnlyUpdate(imu::Vector<3> g, float dt) {
+	int16_t gq[1][3];
+	uint32_t micros = toMicros(dt);
+	g.toDegrees();
+	toFixed(g, FIXED_AHRS_GYRO_FULL_SCALE, gq[0]);
+	fixedFilter.setGyroScale(FIXED_AHRS_GYRO_FULL_SCALE / 32768.0f);
+	fixedFilter.propagate(gq, &micros, 1);
+}
+
+// The batch correction. The learned bias went in with each gyro sample, so unlike the
+// float filters it isn't applied again here
+static void applyCorrection(imu::Vector<3> a, imu::Vector<3> m, float dt, bool accFresh, bool magFresh) {
+	int16_t aq[3], mq[3];
+	toFixed(a, FIXED_AHRS_ACC_FULL_SCALE, aq);
+	toFixed(m, FIXED_AHRS_MAG_FULL_SCALE, mq);
+	fixedFilter.correct(aq, magFresh ? mq : NULL, toMicros(dt));
+}
+
+static void normalizeEstimate() {
+	fixedFilter.normalize();
+	q = fixedFilter.quaternion();
+}
+
+#else
+
+// Picks the cheapest step the fresh data allows. A new mag sample gets the full
+// update (with the latest accel), a new accel sample alone gets the gravity only
+// update, and with neither the gyro is integrated on its own.
+static void applyFilter(imu::Vector<3> g, imu::Vector<3> a, imu::Vector<3> m, float dt, bool accFresh, bool magFresh) {
+	if(!accFresh && !magFresh) {
+		GyroOnlyUpdate(g, dt);
+		return;
+	}
+
+	switch(filter) {
+	case AHRS_FILTER_MAHONY:
+		if(!magFresh)
+			m = imu::Vector<3>();	// A zero field skips the mag terms
+		MahonyAHRSupdate(g, a, m, dt);
+		break;
+	case AHRS_FILTER_MADGWICK:
+	default:
+		if(magFresh)
+			MadgwickAHRSupdate(g, a, m, dt);
+		else
+			MadgwickAHRSupdateIMU(g, a, dt);
+		break;
+	}
+}
+
+// The batch correction is the normal filter update with no rotation
+static void applyCorrection(imu::Vector<3> a, imu::Vector<3> m, float dt, bool accFresh, bool magFresh) {
+	applyFilter(imu::Vector<3>(), a, m, dt, accFresh, magFresh);
+}
+
+static void normalizeEstimate() {
+	q.normalize();
+}
+
+#endif
+
+// When stale samples were skipped, the correction is applied over all the time since
+// that sensor was last used, so skipping doesn't weaken it.
+static void filterStep(imu::Vector<3> g, imu::Vector<3> a, imu::Vector<3> m, float dt, bool accFresh, bool magFresh) {
+	acc_pending_dt += dt;
+	mag_pending_dt += dt;
+	if(!accFresh && !magFresh) {
+		GyroOnlyUpdate(g, dt);
+		return;
+	}
+
+	float correctionDt = magFresh ? mag_pending_dt : acc_pending_dt;
+	if(correctionDt > 0.1f)
+		correctionDt = 0.1f;
+	acc_pending_dt = 0.0f;
+	if(magFresh)
+		mag_pending_dt = 0.0f;
+
+	if(correctionDt > dt) {	// Rotate first, then correct with no rotation
+		GyroOnlyUpdate(g, dt);
+		g = imu::Vector<3>();
+		dt = correctionDt;
+	}
+	applyFilter(g, a, m, dt, accFresh, magFresh);
+}
+
+void uimu_ahrs_iterate(imu::Vector<3> ang_vel, imu::Vector<3> acc, imu::Vector<3> mag, bool accFresh, bool magFresh) {
 	double dt = micros() - last_micros;
     last_micros = micros();
     dt /= 1000000.0;
-    std::cout << "dt: " << dt << std::endl;
+    console_print("dt: %g", dt);
 
 	if(dt == 0)
 		return;
 
+	uimu_ahrs_update(ang_vel, acc, mag, dt, accFresh, magFresh);
+}
+
+void uimu_ahrs_update(imu::Vector<3> ang_vel, imu::Vector<3> acc, imu::Vector<3> mag, float dt, bool accFresh, bool magFresh) {
 	ang_vel.toRadians();
 
-    MadgwickAHRSupdate(ang_vel, acc, mag, dt);
+	filterStep(ang_vel, gravityOnly(acc, ang_vel), mag, dt, accFresh, magFresh);
 
 /*
 	imu::Vector<3> correction;
@@ -74,33 +275,184 @@ void uimu_ahrs_iterate(imu::Vector<3> ang_vel, imu::Vector<3> acc, imu::Vector<3
 
     q = q*n;
 */
-    q.normalize();
+	normalizeEstimate();
 
-	body = q * offset.conjugate();
+	attitude.update(q, offset);
 }
 
 
-imu::Vector<3> uimu_ahrs_get_euler() {
-    imu::Vector<3> euler = body.toEuler();
-    euler.toDegrees();
-    return euler;
+#ifdef AHRS_FIXED_POINT
+
+// The raw samples go straight in, with the chip's scale
+static void propagateGyroBatch(const gyroFIFOBatch& gyro, const uint32_t* dtMicros, int n) {
+	LATENCY_SCOPE("gyro batch propagation");
+	fixedFilter.setGyroScale(gyro.scale);
+	fixedFilter.propagate(gyro.raw, dtMicros, n);
+}
+
+#else
+
+// Rotates q through every sample in the batch. The small rotation for each sample
+// doesn't depend on q, so those are all worked out first in a flat loop the
+// compiler can vectorise. Only the chain of quaternion products is sequential.
+static void propagateGyroBatch(const gyroFIFOBatch& gyro, const uint32_t* dtMicros, int n) {
+	LATENCY_SCOPE("gyro batch propagation");
+	const float* gx = gyro.x;
+	const float* gy = gyro.y;
+	const float* gz = gyro.z;
+	float dw[GYRO_FIFO_SLOTS], dx[GYRO_FIFO_SLOTS], dy[GYRO_FIFO_SLOTS], dz[GYRO_FIFO_SLOTS];
+	const float halfDegToRad = 0.5f * (float)M_PI / 180.0f;
+
+	for(int i = 0; i < n; i++) {
+		// Half angle rotation vector for this sample
+		float dt = dtMicros[i] * 1e-6f;
+		float ax = gx[i] * halfDegToRad * dt;
+		float ay = gy[i] * halfDegToRad * dt;
+		float az = gz[i] * halfDegToRad * dt;
+		float a2 = ax * ax + ay * ay + az * az;
+
+		// exp() of the rotation, cos/sin replaced by their series. At 2000 dps and
+		// 800 Hz the truncation error is below 1e-8, under float resolution
+		float s = 1.0f - a2 * (1.0f / 6.0f);
+		dw[i] = 1.0f - 0.5f * a2;
+		dx[i] = ax * s;
+		dy[i] = ay * s;
+		dz[i] = az * s;
+	}
+
+	float q0 = q.w(), q1 = q.x(), q2 = q.y(), q3 = q.z();
+	for(int i = 0; i < n; i++) {
+		float w = dw[i], x = dx[i], y = dy[i], z = dz[i];
+		float t0 = q0 * w - q1 * x - q2 * y - q3 * z;
+		float t1 = q0 * x + q1 * w + q2 * z - q3 * y;
+		float t2 = q0 * y - q1 * z + q2 * w + q3 * x;
+		float t3 = q0 * z + q1 * y - q2 * x + q3 * w;
+		q0 = t0; q1 = t1; q2 = t2; q3 = t3;
+	}
+	q.w() = q0;
+	q.x() = q1;
+	q.y() = q2;
+	q.z() = q3;
+}
+
+#endif
+
+void uimu_ahrs_iterate_batch(const gyroFIFOBatch& gyro, imu::Vector<3> acc, imu::Vector<3> mag, bool accFresh, bool magFresh) {
+	int n = gyro.count;
+	if(n <= 0)
+		return;
+	if(n > GYRO_FIFO_SLOTS)
+		n = GYRO_FIFO_SLOTS;
+
+	uint32_t dt[GYRO_FIFO_SLOTS];
+	unsigned long prev = last_micros;
+	imu::Vector<3> rate;	// Batch mean, rad/s
+	for(int i = 0; i < n; i++) {
+		rate.x() += gyro.x[i];
+		rate.y() += gyro.y[i];
+		rate.z() += gyro.z[i];
+		long step = (long)(gyro.timestamp[i] - prev);
+		if(step < 0 || step > 100000)	// First call, or samples from before a stall
+			step = 0;
+		dt[i] = (uint32_t)step;
+		prev = gyro.timestamp[i];
+	}
+	last_micros = prev;
+
+	propagateGyroBatch(gyro, dt, n);
+
+	// The correction step is the normal filter update with no rotation, integrated
+	// over the time since the last correction. Freshness is latched so a sample that
+	// arrives between corrections isn't missed
+	pending_acc = pending_acc || accFresh;
+	pending_mag = pending_mag || magFresh;
+	unsigned long sinceCorrection = last_micros - last_correction_micros;
+	if(sinceCorrection >= correction_period && (pending_acc || pending_mag)) {
+		float correctionDt = sinceCorrection * 1e-6f;
+		if(correctionDt > 0.1f)
+			correctionDt = 0.1f;
+		last_correction_micros = last_micros;
+
+		rate = rate * (M_PI / 180.0 / n);
+		applyCorrection(gravityOnly(acc, rate), mag, correctionDt, pending_acc, pending_mag);
+		pending_acc = false;
+		pending_mag = false;
+	}
+
+	normalizeEstimate();
+
+	attitude.update(q, offset);
+}
+
+
+AttitudeSnapshot::AttitudeSnapshot() {
+	sequence = 0;
+	bodyValid = true;	// Identity everywhere to start with
+	eulerValid = true;
+	matrixValid = false;
+}
+
+void AttitudeSnapshot::update(const imu::Quaternion& imuFrame, const imu::Quaternion& offset) {
+	q = imuFrame;
+	offsetConjugate = imu::Quaternion(offset.w(), -offset.x(), -offset.y(), -offset.z());
+	sequence++;
+	bodyValid = false;
+	eulerValid = false;
+	matrixValid = false;
 }
 
-imu::Matrix<3> uimu_ahrs_get_matrix() {
-    return body.toMatrix();
+const imu::Quaternion& AttitudeSnapshot::quaternion() {
+	if(!bodyValid) {
+		body = q * offsetConjugate;
+		bodyValid = true;
+	}
+	return body;
 }
 
-imu::Quaternion uimu_ahrs_get_quaternion() {
-    return body;
+const imu::Vector<3>& AttitudeSnapshot::euler() {
+	if(!eulerValid) {
+		quaternion();
+		eulerDegrees = body.toEuler();
+		eulerDegrees.toDegrees();
+		eulerValid = true;
+	}
+	return eulerDegrees;
 }
 
-imu::Quaternion uimu_ahrs_get_imu_quaternion() {
-	return q;
+const imu::Matrix<3>& AttitudeSnapshot::matrix() {
+	if(!matrixValid) {
+		quaternion();
+		dcm = body.toMatrix();
+		matrixValid = true;
+	}
+	return dcm;
+}
+
+
+const imu::Vector<3>& uimu_ahrs_get_euler() {
+    return attitude.euler();
+}
+
+const imu::Matrix<3>& uimu_ahrs_get_matrix() {
+    return attitude.matrix();
+}
+
+const imu::Quaternion& uimu_ahrs_get_quaternion() {
+    return attitude.quaternion();
+}
+
+const imu::Quaternion& uimu_ahrs_get_imu_quaternion() {
+	return attitude.imuQuaternion();
+}
+
+AttitudeSnapshot& uimu_ahrs_get_attitude() {
+	return attitude;
 }
 
 
 
 void MadgwickAHRSupdate(imu::Vector<3> g, imu::Vector<3> a, imu::Vector<3> m, float dt) {
+	LATENCY_SCOPE("madgwick update");
     imu::Vector<4> s;
     imu::Vector<4> qDot;
     float hx, hy;
@@ -109,7 +461,7 @@ void MadgwickAHRSupdate(imu::Vector<3> g, imu::Vector<3> a, imu::Vector<3> m, fl
     if(isnan(m.magnitude()) || isinf(m.magnitude()))
         return;
 
-    qDot[0] = 0.5f * (-q.y() * g.x() - q.y() * g.y() - q.z() * g.z());
+    qDot[0] = 0.5f * (-q.x() * g.x() - q.y() * g.y() - q.z() * g.z());
     qDot[1] = 0.5f * (q.w() * g.x() + q.y() * g.z() - q.z() * g.y());
     qDot[2] = 0.5f * (q.w() * g.y() - q.x() * g.z() + q.z() * g.x());
     qDot[3] = 0.5f * (q.w() * g.z() + q.x() * g.y() - q.y() * g.x());
@@ -172,3 +524,178 @@ void MadgwickAHRSupdate(imu::Vector<3> g, imu::Vector<3> a, imu::Vector<3> m, fl
     q.y() += qDot[2] * dt;
     q.z() += qDot[3] * dt;
 }
+
+
+void MahonyAHRSupdate(imu::Vector<3> g, imu::Vector<3> a, imu::Vector<3> m, float dt) {
+	LATENCY_SCOPE("mahony update");
+    float q0 = q.w(), q1 = q.x(), q2 = q.y(), q3 = q.z();
+    float gx = g.x(), gy = g.y(), gz = g.z();
+    float ax = a.x(), ay = a.y(), az = a.z();
+    float mx = m.x(), my = m.y(), mz = m.z();
+    float recipNorm;
+    float halfex = 0.0f, halfey = 0.0f, halfez = 0.0f;
+
+    // Only correct when the accelerometer has a usable reading
+    if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f)) && !isnan(ax + ay + az)) {
+        recipNorm = 1.0f / sqrtf(ax * ax + ay * ay + az * az);
+        ax *= recipNorm;
+        ay *= recipNorm;
+        az *= recipNorm;
+
+        // Auxiliary variables to avoid repeated arithmetic
+        float q0q0 = q0 * q0;
+        float q0q1 = q0 * q1;
+        float q0q2 = q0 * q2;
+        float q0q3 = q0 * q3;
+        float q1q1 = q1 * q1;
+        float q1q2 = q1 * q2;
+        float q1q3 = q1 * q3;
+        float q2q2 = q2 * q2;
+        float q2q3 = q2 * q3;
+        float q3q3 = q3 * q3;
+
+        // Estimated direction of gravity
+        float halfvx = q1q3 - q0q2;
+        float halfvy = q0q1 + q2q3;
+        float halfvz = q0q0 - 0.5f + q3q3;
+
+        // Error is the cross product between estimated and measured gravity
+        halfex = (ay * halfvz - az * halfvy);
+        halfey = (az * halfvx - ax * halfvz);
+        halfez = (ax * halfvy - ay * halfvx);
+
+        float magNorm = mx * mx + my * my + mz * mz;
+        if(magNorm > 0.0f && !isnan(magNorm) && !isinf(magNorm)) {
+            recipNorm = 1.0f / sqrtf(magNorm);
+            mx *= recipNorm;
+            my *= recipNorm;
+            mz *= recipNorm;
+
+            // Reference direction of Earth's magnetic field
+            float hx = 2.0f * (mx * (0.5f - q2q2 - q3q3) + my * (q1q2 - q0q3) + mz * (q1q3 + q0q2));
+            float hy = 2.0f * (mx * (q1q2 + q0q3) + my * (0.5f - q1q1 - q3q3) + mz * (q2q3 - q0q1));
+            float bx = sqrtf(hx * hx + hy * hy);
+            float bz = 2.0f * (mx * (q1q3 - q0q2) + my * (q2q3 + q0q1) + mz * (0.5f - q1q1 - q2q2));
+
+            // Estimated direction of magnetic field
+            float halfwx = bx * (0.5f - q2q2 - q3q3) + bz * (q1q3 - q0q2);
+            float halfwy = bx * (q1q2 - q0q3) + bz * (q0q1 + q2q3);
+            float halfwz = bx * (q0q2 + q1q3) + bz * (0.5f - q1q1 - q2q2);
+
+            halfex += (my * halfwz - mz * halfwy);
+            halfey += (mz * halfwx - mx * halfwz);
+            halfez += (mx * halfwy - my * halfwx);
+        }
+
+        // Integral feedback trims out gyro bias
+        if(twoKi > 0.0f) {
+            integralFBx += twoKi * halfex * dt;
+            integralFBy += twoKi * halfey * dt;
+            integralFBz += twoKi * halfez * dt;
+            gx += integralFBx;
+            gy += integralFBy;
+            gz += integralFBz;
+        }
+        else {
+            integralFBx = integralFBy = integralFBz = 0.0f;
+        }
+
+        // Proportional feedback
+        gx += twoKp * halfex;
+        gy += twoKp * halfey;
+        gz += twoKp * halfez;
+    }
+
+    // Integrate rate of change of quaternion
+    gx *= (0.5f * dt);
+    gy *= (0.5f * dt);
+    gz *= (0.5f * dt);
+    q.w() = q0 + (-q1 * gx - q2 * gy - q3 * gz);
+    q.x() = q1 + (q0 * gx + q2 * gz - q3 * gy);
+    q.y() = q2 + (q0 * gy - q1 * gz + q3 * gx);
+    q.z() = q3 + (q0 * gz + q1 * gy - q2 * gx);
+}
+
+
+void MadgwickAHRSupdateIMU(imu::Vector<3> g, imu::Vector<3> a, float dt) {
+	LATENCY_SCOPE("madgwick imu update");
+    float q0 = q.w(), q1 = q.x(), q2 = q.y(), q3 = q.z();
+    float ax = a.x(), ay = a.y(), az = a.z();
+    float recipNorm;
+    float s0, s1, s2, s3;
+    float _2q0, _2q1, _2q2, _2q3, _4q0, _4q1, _4q2, _8q1, _8q2, q0q0, q1q1, q2q2, q3q3;
+
+    // Rate of change of quaternion from gyroscope
+    float qDot1 = 0.5f * (-q1 * g.x() - q2 * g.y() - q3 * g.z());
+    float qDot2 = 0.5f * (q0 * g.x() + q2 * g.z() - q3 * g.y());
+    float qDot3 = 0.5f * (q0 * g.y() - q1 * g.z() + q3 * g.x());
+    float qDot4 = 0.5f * (q0 * g.z() + q1 * g.y() - q2 * g.x());
+
+    if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f)) && !isnan(ax + ay + az)) {
+        recipNorm = 1.0f / sqrtf(ax * ax + ay * ay + az * az);
+        ax *= recipNorm;
+        ay *= recipNorm;
+        az *= recipNorm;
+
+        // Auxiliary variables to avoid repeated arithmetic
+        _2q0 = 2.0f * q0;
+        _2q1 = 2.0f * q1;
+        _2q2 = 2.0f * q2;
+        _2q3 = 2.0f * q3;
+        _4q0 = 4.0f * q0;
+        _4q1 = 4.0f * q1;
+        _4q2 = 4.0f * q2;
+        _8q1 = 8.0f * q1;
+        _8q2 = 8.0f * q2;
+        q0q0 = q0 * q0;
+        q1q1 = q1 * q1;
+        q2q2 = q2 * q2;
+        q3q3 = q3 * q3;
+
+        // Gradient decent algorithm corrective step, gravity only
+        s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+        s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+        s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+        s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+        float sNorm = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+        if(sNorm > 0.0f) {
+            recipNorm = 1.0f / sqrtf(sNorm);
+
+            // Apply feedback step
+            qDot1 -= beta * s0 * recipNorm;
+            qDot2 -= beta * s1 * recipNorm;
+            qDot3 -= beta * s2 * recipNorm;
+            qDot4 -= beta * s3 * recipNorm;
+        }
+    }
+
+    // Integrate rate of change of quaternion to yield quaternion
+    q.w() = q0 + qDot1 * dt;
+    q.x() = q1 + qDot2 * dt;
+    q.y() = q2 + qDot3 * dt;
+    q.z() = q3 + qDot4 * dt;
+}
+
+
+#ifndef AHRS_FIXED_POINT	// fixed point version above
+void GyroOnlyUpdate(imu::Vector<3> g, float dt) {
+    float q0 = q.w(), q1 = q.x(), q2 = q.y(), q3 = q.z();
+    float gx = g.x(), gy = g.y(), gz = g.z();
+
+    // Keep the bias the Mahony filter has learned applied between corrections
+    if(filter == AHRS_FILTER_MAHONY) {
+        gx += integralFBx;
+        gy += integralFBy;
+        gz += integralFBz;
+    }
+
+    gx *= (0.5f * dt);
+    gy *= (0.5f * dt);
+    gz *= (0.5f * dt);
+    q.w() = q0 + (-q1 * gx - q2 * gy - q3 * gz);
+    q.x() = q1 + (q0 * gx + q2 * gz - q3 * gy);
+    q.y() = q2 + (q0 * gy - q1 * gz + q3 * gx);
+    q.z() = q3 + (q0 * gz + q1 * gy - q2 * gx);
+}
+
+#endif
@@ -6,25 +6,93 @@
 #include <time.h>
 #include <iostream>
 
+enum UIMU_AHRS_FILTER {
+	AHRS_FILTER_MADGWICK	= 0,	// gradient descent filter, tuned with beta
+	AHRS_FILTER_MAHONY		= 1		// PI complementary filter, tuned with kp/ki. Cheaper per update
+};
+
+//one AHRS output. the body frame quaternion, euler angles and rotation matrix are
+//only worked out the first time they are asked for, then kept until the next update,
+//so any number of readers per cycle cost one conversion each
+class AttitudeSnapshot {
+public:
+	AttitudeSnapshot();
+	void update(const imu::Quaternion& imuFrame, const imu::Quaternion& offset);	// Drops the cached forms
+
+	const imu::Quaternion& imuQuaternion() const { return q; }
+	const imu::Quaternion& quaternion();	// Body frame
+	const imu::Vector<3>& euler();	// Heading, pitch, roll in degrees
+	const imu::Matrix<3>& matrix();	// North-east-down rotation matrix
+	unsigned long getSequence() const { return sequence; }	// Counts updates
+
+private:
+	imu::Quaternion q;
+	imu::Quaternion offsetConjugate;
+	imu::Quaternion body;
+	imu::Vector<3> eulerDegrees;
+	imu::Matrix<3> dcm;
+	unsigned long sequence;
+	bool bodyValid;
+	bool eulerValid;
+	bool matrixValid;
+};
+
 //initialises the AHRS
 void uimu_ahrs_init(imu::Vector<3> acc, imu::Vector<3> mag);
 
+//restarts the filter from a known orientation. clears the mahony integral term
+void uimu_ahrs_reset(imu::Quaternion initial);
+
 void uimu_ahrs_set_offset(imu::Quaternion o);
 
 //sets the beta. this controls how strong the drift correction will be. 
 //a higher beta means more correction
 void uimu_ahrs_set_beta(float beta);
 
+//selects the filter used by uimu_ahrs_iterate. safe to switch at any time.
+//built with AHRS_FIXED_POINT it is always the integer mahony filter of fixedAhrs.h
+void uimu_ahrs_set_filter(UIMU_AHRS_FILTER filter);
+UIMU_AHRS_FILTER uimu_ahrs_get_filter();
+
+//sets the airspeed the aircraft flies at along the imu's x axis, in m/s. the correction
+//takes the centripetal acceleration of turning at that speed out of the accel first, so a
+//coordinated turn doesn't read as level. 0, the default, uses the accel as it is
+void uimu_ahrs_set_airspeed(float metresPerSecond);
+
+//sets the mahony gains. kp sets how hard accel/mag pull the estimate in,
+//ki slowly trims out gyro bias (0 disables the integral term)
+void uimu_ahrs_set_mahony_gains(float kp, float ki);
+
+
+//does an iteration. call this every 20ms at least.
+//accFresh/magFresh say whether acc and mag are new samples (see LMS303::isAccelNew()).
+//a stale mag drops the update to gravity only, and with neither fresh the gyro is
+//just integrated, which is much cheaper when running faster than the mag data rate
+void uimu_ahrs_iterate(imu::Vector<3> acc, imu::Vector<3> ang_vel, imu::Vector<3> mag,
+		bool accFresh = true, bool magFresh = true);
+
+//does an iteration with a caller supplied time step in seconds. ang_vel in degrees per second
+void uimu_ahrs_update(imu::Vector<3> ang_vel, imu::Vector<3> acc, imu::Vector<3> mag, float dt,
+		bool accFresh = true, bool magFresh = true);
+
+//integrates every gyro sample in the batch, oldest first, instead of one averaged rate.
+//the accel/mag correction is only applied at the correction rate, and only once a fresh
+//sample has arrived since the last correction
+void uimu_ahrs_iterate_batch(const gyroFIFOBatch& gyro, imu::Vector<3> acc, imu::Vector<3> mag,
+		bool accFresh = true, bool magFresh = true);
+
+//sets how often uimu_ahrs_iterate_batch runs the accel/mag correction, in Hz
+void uimu_ahrs_set_correction_rate(float hz);
 
-//does an iteration. call this every 20ms at least
-void uimu_ahrs_iterate(imu::Vector<3> acc, imu::Vector<3> ang_vel, imu::Vector<3> mag);
+//returns the orientation in various forms. each is computed at most once per update
+const imu::Vector<3>& uimu_ahrs_get_euler(); //heading, pitch, roll in degrees
+const imu::Matrix<3>& uimu_ahrs_get_matrix(); //north-east-down rotation matrix
+const imu::Quaternion& uimu_ahrs_get_quaternion(); //good ol' quaternion
 
-//returns the orientation in various forms
-imu::Vector<3> uimu_ahrs_get_euler(); //heading, pitch, roll in degrees
-imu::Matrix<3> uimu_ahrs_get_matrix(); //north-east-down rotation matrix
-imu::Quaternion uimu_ahrs_get_quaternion(); //good ol' quaternion
+const imu::Quaternion& uimu_ahrs_get_imu_quaternion();
 
-imu::Quaternion uimu_ahrs_get_imu_quaternion();
+//the current output as a whole, for readers that want several forms
+AttitudeSnapshot& uimu_ahrs_get_attitude();
 
 
 #endif
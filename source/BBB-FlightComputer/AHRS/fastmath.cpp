@@ -0,0 +1,35 @@
+/*
+ * fastmath.cpp
+ *	Pressure to altitude table for fastmath::baroAltitude().
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "fastmath.h"
+
+#define BARO_STEP	((FASTMATH_BARO_MAX_MBAR - FASTMATH_BARO_MIN_MBAR) / FASTMATH_BARO_TABLE_SIZE)
+
+static float preciseAltitude(float pressure_mbar) {
+	return (1 - pow(pressure_mbar/1013.25, 0.190263)) * 44330.8;
+}
+
+static float altitudeTable[FASTMATH_BARO_TABLE_SIZE + 1];
+
+static bool buildAltitudeTable() {	// Run once during static initialisation
+	for(int i = 0; i <= FASTMATH_BARO_TABLE_SIZE; i++)
+		altitudeTable[i] = preciseAltitude(FASTMATH_BARO_MIN_MBAR + i * BARO_STEP);
+	return true;
+}
+
+static bool altitudeTableBuilt = buildAltitudeTable();
+
+float fastmath::baroAltitudeTable(float pressure_mbar) {
+	float pos = (pressure_mbar - FASTMATH_BARO_MIN_MBAR) * (1.0f / BARO_STEP);
+	if(!(pos >= 0.0f && pos < FASTMATH_BARO_TABLE_SIZE) || !altitudeTableBuilt)	// Also catches NaN
+		return preciseAltitude(pressure_mbar);
+
+	int i = (int)pos;
+	float frac = pos - i;
+	return altitudeTable[i] + frac * (altitudeTable[i + 1] - altitudeTable[i]);
+}
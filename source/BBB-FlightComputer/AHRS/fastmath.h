@@ -0,0 +1,126 @@
+/*
+ * fastmath.h
+ *	Bounded error float approximations of the transcendental functions used every
+ *	cycle (tilt from accel, quaternion to euler, pressure to altitude). The error
+ *	bounds below are the worst cases measured by main-fastmathBenchmark over the
+ *	whole input range, which fails if any of them are exceeded.
+ *
+ *	Define FASTMATH_PRECISE at build time to route every function to libm instead.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ *
+ *  Reference:
+ *  	Abramowitz & Stegun, Handbook of Mathematical Functions, 4.4.46 and 4.4.49
+ */
+
+#ifndef FASTMATH_H_
+#define FASTMATH_H_
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+#define FASTMATH_ATAN_MAX_ERROR		2.0e-5f		// radians, fastmath::atan and atan2
+#define FASTMATH_ASIN_MAX_ERROR		1.0e-6f		// radians
+#define FASTMATH_RSQRT_MAX_ERROR	2.0e-3f		// relative, one Newton step
+#define FASTMATH_BARO_MAX_ERROR		0.15f		// meters, 260-1260 mBar (worst at 260 mBar)
+
+#define FASTMATH_BARO_MIN_MBAR		260.0f		// LPS331 measurement range
+#define FASTMATH_BARO_MAX_MBAR		1260.0f
+#define FASTMATH_BARO_TABLE_SIZE	256			// Intervals in the altitude table
+
+namespace fastmath
+{
+
+float baroAltitudeTable(float pressure_mbar);	// fastmath.cpp
+
+#ifndef FASTMATH_PRECISE
+
+// atan on [-1, 1] is a 9th order odd polynomial (A&S 4.4.49). Outside that range
+// atan(x) = +-pi/2 - atan(1/x).
+inline float atan(float x)
+{
+	bool invert = fabsf(x) > 1.0f;
+	if(invert)
+		x = 1.0f / x;
+	float x2 = x * x;
+	float r = x * (0.9998660f + x2 * (-0.3302995f + x2 * (0.1801410f + x2 * (-0.0851330f + x2 * 0.0208351f))));
+	if(invert)
+		r = (x > 0.0f ? 1.5707963f : -1.5707963f) - r;
+	return r;
+}
+
+inline float atan2(float y, float x)
+{
+	float ay = fabsf(y), ax = fabsf(x);
+	if(ax == 0.0f && ay == 0.0f)
+		return 0.0f;
+
+	// Keep the polynomial argument in [0, 1]
+	float r;
+	if(ay <= ax) {
+		float t = ay / ax;
+		float t2 = t * t;
+		r = t * (0.9998660f + t2 * (-0.3302995f + t2 * (0.1801410f + t2 * (-0.0851330f + t2 * 0.0208351f))));
+	}
+	else {
+		float t = ax / ay;
+		float t2 = t * t;
+		r = 1.5707963f - t * (0.9998660f + t2 * (-0.3302995f + t2 * (0.1801410f + t2 * (-0.0851330f + t2 * 0.0208351f))));
+	}
+	if(x < 0.0f)
+		r = 3.1415927f - r;
+	return y < 0.0f ? -r : r;
+}
+
+// asin(x) = pi/2 - sqrt(1 - x) * P(x) on [0, 1] (A&S 4.4.46), odd symmetry below 0.
+// The sqrt is a single VFP instruction on the Cortex-A8.
+inline float asin(float x)
+{
+	float ax = fabsf(x);
+	if(ax >= 1.0f)
+		return x > 0.0f ? 1.5707963f : -1.5707963f;
+	float p = -0.0012624911f;
+	p = p * ax + 0.0066700901f;
+	p = p * ax - 0.0170881256f;
+	p = p * ax + 0.0308918810f;
+	p = p * ax - 0.0501743046f;
+	p = p * ax + 0.0889789874f;
+	p = p * ax - 0.2145988016f;
+	p = p * ax + 1.5707963050f;
+	float r = 1.5707963f - sqrtf(1.0f - ax) * p;
+	return x < 0.0f ? -r : r;
+}
+
+// 1/sqrt(x) from the exponent trick and one Newton-Raphson step. x must be > 0.
+inline float rsqrt(float x)
+{
+	uint32_t i;
+	float y = x;
+	memcpy(&i, &y, sizeof(i));
+	i = 0x5f3759df - (i >> 1);
+	memcpy(&y, &i, sizeof(y));
+	return y * (1.5f - 0.5f * x * y * y);
+}
+
+// Standard atmosphere altitude in meters. Linear interpolation in a table built at
+// startup, falling back to pow() outside the sensor range.
+inline float baroAltitude(float pressure_mbar)
+{
+	return baroAltitudeTable(pressure_mbar);
+}
+
+#else	// FASTMATH_PRECISE
+
+inline float atan(float x) { return ::atanf(x); }
+inline float atan2(float y, float x) { return ::atan2f(y, x); }
+inline float asin(float x) { return ::asinf(x > 1.0f ? 1.0f : (x < -1.0f ? -1.0f : x)); }
+inline float rsqrt(float x) { return 1.0f / sqrtf(x); }
+inline float baroAltitude(float pressure_mbar) { return (1 - powf(pressure_mbar/1013.25f, 0.190263f)) * 44330.8f; }
+
+#endif	// FASTMATH_PRECISE
+
+};
+
+#endif /* FASTMATH_H_ */
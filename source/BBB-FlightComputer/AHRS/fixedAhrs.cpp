@@ -0,0 +1,174 @@
+/*
+ * fixedAhrs.cpp
+ *	Integer Mahony filter, see fixedAhrs.h.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "fixedAhrs.h"
+
+using fixedpoint::mul;
+using fixedpoint::shiftRound;
+
+#define MICROS_TO_Q32		281474977ULL	// 2^32 / 10^6, << 16
+#define GYRO_ANGLE_SHIFT	36				// Of gyroHalfAngle
+#define RATE_TO_HALF_ANGLE	(32 + 1 - (FIXEDPOINT_Q - FIXED_AHRS_RATE_Q))	// rate * Q32 dt / 2 to Q30
+#define ERROR_TO_RATE		(FIXEDPOINT_Q + FIXED_AHRS_GAIN_Q - FIXED_AHRS_RATE_Q)	// Q30 error * gain to a rate
+
+static uint32_t toQ32Seconds(uint32_t micros) {
+	if(micros > FIXED_AHRS_MAX_DT_MICROS)
+		micros = FIXED_AHRS_MAX_DT_MICROS;
+	return (uint32_t)(((uint64_t)micros * MICROS_TO_Q32) >> 16);
+}
+
+FixedAhrs::FixedAhrs() {
+	gyroScale = 0;
+	gyroHalfAngle = 0;
+	setGains(0.5f, 0.0f);	// The float Mahony defaults
+	setGyroScale(FIXED_AHRS_GYRO_FULL_SCALE / 32768.0f);
+	reset(imu::Quaternion());
+}
+
+void FixedAhrs::reset(const imu::Quaternion& initial) {
+	double c[4] = { initial.w(), initial.x(), initial.y(), initial.z() };
+	for(int i = 0; i < 4; i++)
+		q[i] = (int32_t)(c[i] * FIXEDPOINT_ONE + (c[i] < 0 ? -0.5 : 0.5));
+	normalize();
+	bias[0] = bias[1] = bias[2] = 0;
+}
+
+void FixedAhrs::setGains(float kp, float ki) {
+	twoKp = (int32_t)(2.0f * kp * (1 << FIXED_AHRS_GAIN_Q) + 0.5f);
+	twoKi = (int32_t)(2.0f * ki * (1 << FIXED_AHRS_GAIN_Q) + 0.5f);
+	if(twoKi <= 0)
+		bias[0] = bias[1] = bias[2] = 0;
+}
+
+// The half angle of one sample is raw * dt * scale / 2 with scale in rad/s per LSB. With dt
+// as Q32 seconds that is raw * dtQ32 * scale / 8 in Q30
+void FixedAhrs::setGyroScale(float dpsPerLsb) {
+	if(dpsPerLsb == gyroScale)
+		return;
+	gyroScale = dpsPerLsb;
+	double radPerLsb = dpsPerLsb * M_PI / 180.0;
+	gyroHalfAngle = (int64_t)(radPerLsb / 8.0 * (double)(1ULL << GYRO_ANGLE_SHIFT) + 0.5);
+}
+
+void FixedAhrs::gyroAngle(const int16_t gyro[3], uint32_t dtQ32, int32_t angle[3]) {
+	int64_t perLsb = ((int64_t)dtQ32 * gyroHalfAngle) >> 16;
+	for(int k = 0; k < 3; k++)
+		angle[k] = (int32_t)shiftRound(gyro[k] * perLsb, GYRO_ANGLE_SHIFT - 16);
+}
+
+// exp() of the half angle vector, cos and sin replaced by their series as in the float
+// batch propagation, then q = q * that
+void FixedAhrs::rotate(int32_t ax, int32_t ay, int32_t az) {
+	int64_t a2 = ((int64_t)ax * ax + (int64_t)ay * ay + (int64_t)az * az) >> FIXEDPOINT_Q;
+	int64_t w = FIXEDPOINT_ONE - (a2 >> 1);
+	int64_t s = FIXEDPOINT_ONE - a2 / 6;
+	int64_t x = (ax * s) >> FIXEDPOINT_Q;
+	int64_t y = (ay * s) >> FIXEDPOINT_Q;
+	int64_t z = (az * s) >> FIXEDPOINT_Q;
+
+	int64_t q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+	q[0] = (int32_t)shiftRound(q0 * w - q1 * x - q2 * y - q3 * z, FIXEDPOINT_Q);
+	q[1] = (int32_t)shiftRound(q0 * x + q1 * w + q2 * z - q3 * y, FIXEDPOINT_Q);
+	q[2] = (int32_t)shiftRound(q0 * y - q1 * z + q2 * w + q3 * x, FIXEDPOINT_Q);
+	q[3] = (int32_t)shiftRound(q0 * z + q1 * y - q2 * x + q3 * w, FIXEDPOINT_Q);
+}
+
+// The proportional feedback rate from the accel/mag error, as MahonyAHRSupdate(), and the
+// integral term brought up to date. False, with rate zero, when the accel sample is unusable
+bool FixedAhrs::feedback(const int16_t acc[3], const int16_t mag[3], uint32_t dtQ32, int32_t rate[3]) {
+	rate[0] = rate[1] = rate[2] = 0;
+	int32_t a[3];
+	if(!fixedpoint::normalize3(acc, a))
+		return false;
+
+	int32_t q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+	int32_t q0q0 = mul(q0, q0), q0q1 = mul(q0, q1), q0q2 = mul(q0, q2), q0q3 = mul(q0, q3);
+	int32_t q1q1 = mul(q1, q1), q1q2 = mul(q1, q2), q1q3 = mul(q1, q3);
+	int32_t q2q2 = mul(q2, q2), q2q3 = mul(q2, q3), q3q3 = mul(q3, q3);
+
+	// Estimated direction of gravity, and the error to the measured one
+	int32_t halfvx = q1q3 - q0q2;
+	int32_t halfvy = q0q1 + q2q3;
+	int32_t halfvz = q0q0 - FIXEDPOINT_HALF + q3q3;
+	int64_t e[3];
+	e[0] = (int64_t)mul(a[1], halfvz) - mul(a[2], halfvy);
+	e[1] = (int64_t)mul(a[2], halfvx) - mul(a[0], halfvz);
+	e[2] = (int64_t)mul(a[0], halfvy) - mul(a[1], halfvx);
+
+	int32_t m[3];
+	if(mag && fixedpoint::normalize3(mag, m)) {
+		// Reference direction of Earth's magnetic field. Each is a row of the rotation
+		// matrix times a unit vector, so within +-1
+		int32_t hx = 2 * (mul(m[0], FIXEDPOINT_HALF - q2q2 - q3q3) + mul(m[1], q1q2 - q0q3) + mul(m[2], q1q3 + q0q2));
+		int32_t hy = 2 * (mul(m[0], q1q2 + q0q3) + mul(m[1], FIXEDPOINT_HALF - q1q1 - q3q3) + mul(m[2], q2q3 - q0q1));
+		int32_t bx = fixedpoint::sqrt60((uint64_t)((int64_t)hx * hx + (int64_t)hy * hy));
+		int32_t bz = 2 * (mul(m[0], q1q3 - q0q2) + mul(m[1], q2q3 + q0q1) + mul(m[2], FIXEDPOINT_HALF - q1q1 - q2q2));
+
+		// Estimated direction of the field
+		int32_t halfwx = mul(bx, FIXEDPOINT_HALF - q2q2 - q3q3) + mul(bz, q1q3 - q0q2);
+		int32_t halfwy = mul(bx, q1q2 - q0q3) + mul(bz, q0q1 + q2q3);
+		int32_t halfwz = mul(bx, q0q2 + q1q3) + mul(bz, FIXEDPOINT_HALF - q1q1 - q2q2);
+
+		e[0] += (int64_t)mul(m[1], halfwz) - mul(m[2], halfwy);
+		e[1] += (int64_t)mul(m[2], halfwx) - mul(m[0], halfwz);
+		e[2] += (int64_t)mul(m[0], halfwy) - mul(m[1], halfwx);
+	}
+
+	for(int k = 0; k < 3; k++) {
+		if(twoKi > 0)	// Integral feedback trims out gyro bias
+			bias[k] += (int32_t)shiftRound(shiftRound(e[k] * twoKi, ERROR_TO_RATE) * dtQ32, 32);
+		rate[k] = (int32_t)shiftRound(e[k] * twoKp, ERROR_TO_RATE);
+	}
+	return true;
+}
+
+void FixedAhrs::propagate(const int16_t gyro[][3], const uint32_t dtMicros[], int n) {
+	for(int i = 0; i < n; i++) {
+		uint32_t dt = toQ32Seconds(dtMicros[i]);
+		int32_t angle[3];
+		gyroAngle(gyro[i], dt, angle);
+		for(int k = 0; k < 3; k++)	// Keep the learned bias applied between corrections
+			angle[k] += (int32_t)shiftRound((int64_t)bias[k] * dt, RATE_TO_HALF_ANGLE);
+		rotate(angle[0], angle[1], angle[2]);
+	}
+}
+
+void FixedAhrs::correct(const int16_t acc[3], const int16_t mag[3], uint32_t dtMicros) {
+	uint32_t dt = toQ32Seconds(dtMicros);
+	int32_t rate[3];
+	feedback(acc, mag, dt, rate);
+	rotate((int32_t)shiftRound((int64_t)rate[0] * dt, RATE_TO_HALF_ANGLE),
+			(int32_t)shiftRound((int64_t)rate[1] * dt, RATE_TO_HALF_ANGLE),
+			(int32_t)shiftRound((int64_t)rate[2] * dt, RATE_TO_HALF_ANGLE));
+}
+
+void FixedAhrs::update(const int16_t gyro[3], const int16_t acc[3], const int16_t mag[3], uint32_t dtMicros) {
+	uint32_t dt = toQ32Seconds(dtMicros);
+	int32_t rate[3], angle[3];
+	bool corrected = feedback(acc, mag, dt, rate);
+	gyroAngle(gyro, dt, angle);
+
+	// As MahonyAHRSupdate(), the integral term only rides along with a usable accel sample
+	for(int k = 0; k < 3; k++) {
+		int32_t r = rate[k] + (corrected ? bias[k] : 0);
+		angle[k] += (int32_t)shiftRound((int64_t)r * dt, RATE_TO_HALF_ANGLE);
+	}
+	rotate(angle[0], angle[1], angle[2]);
+}
+
+void FixedAhrs::normalize() {
+	if(!fixedpoint::normalize(q, q, 4)) {	// Only a zero quaternion, which can't come from rotate()
+		q[0] = FIXEDPOINT_ONE;
+		q[1] = q[2] = q[3] = 0;
+	}
+}
+
+imu::Quaternion FixedAhrs::quaternion() const {
+	const double scale = 1.0 / FIXEDPOINT_ONE;
+	return imu::Quaternion(q[0] * scale, q[1] * scale, q[2] * scale, q[3] * scale);
+}
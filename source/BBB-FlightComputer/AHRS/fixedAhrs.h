@@ -0,0 +1,77 @@
+/*
+ * fixedAhrs.h
+ *	Integer Mahony filter: the PI complementary filter of MahonyAHRSupdate() in ahrs.cpp
+ *	with every step in Q-format fixed point (fixedpoint.h). Gyro samples go in as the chip
+ *	outputs them, Q15 of its full scale, and the scale is folded into one integer constant.
+ *	Accel and mag only give a direction, so any scale common to their three axes will do.
+ *	The quaternion is kept in Q30, rotated by the series expansion of each sample's
+ *	rotation and normalised with the integer rsqrt.
+ *
+ *	Apart from skipping a zero accel or mag sample there are no data dependent branches
+ *	and no divides, so an update takes the same time whatever the attitude and rates.
+ *
+ *	Building with AHRS_FIXED_POINT runs the uimu_ahrs_* functions on this filter whichever
+ *	filter is selected. It is always compiled, so main-ahrsBenchmark can compare it with
+ *	the float filters in one program.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ *
+ *  Reference:
+ *  	Mahony, Hamel & Pflimlin, Nonlinear Complementary Filters on the Special Orthogonal
+ *  	Group, IEEE Transactions on Automatic Control 53(5), 2008
+ */
+
+#ifndef FIXEDAHRS_H_
+#define FIXEDAHRS_H_
+
+#include "imumaths.h"
+#include "fixedpoint.h"
+
+#define FIXED_AHRS_GYRO_FULL_SCALE	2000.0f		// dps, Q15 scale of gyro rates handed over as floats
+#define FIXED_AHRS_ACC_FULL_SCALE	16.0f		// g, likewise for accel
+#define FIXED_AHRS_MAG_FULL_SCALE	16.0f		// gauss, likewise for mag
+#define FIXED_AHRS_MAX_DT_MICROS	100000		// Longer steps are clamped, as in the float filters
+#define FIXED_AHRS_RATE_Q			24			// Fractional bits of rates in rad/s (+-128 rad/s)
+#define FIXED_AHRS_GAIN_Q			16			// Fractional bits of the gains
+
+class FixedAhrs {
+
+private:
+
+	int32_t q[4];			// Q30 w, x, y, z
+	int32_t bias[3];		// Integral term, rad/s in FIXED_AHRS_RATE_Q
+	int32_t twoKp;			// FIXED_AHRS_GAIN_Q
+	int32_t twoKi;
+	float gyroScale;		// dps per LSB that gyroHalfAngle was worked out for
+	int64_t gyroHalfAngle;	// Half angle per LSB per Q32 second, Q30 << 36
+
+	void rotate(int32_t ax, int32_t ay, int32_t az);	// By a Q30 half angle vector
+	bool feedback(const int16_t acc[3], const int16_t mag[3], uint32_t dtQ32, int32_t rate[3]);
+	void gyroAngle(const int16_t gyro[3], uint32_t dtQ32, int32_t angle[3]);
+
+public:
+
+	FixedAhrs();
+
+	void reset(const imu::Quaternion& initial);	// Also clears the integral term
+	void setGains(float kp, float ki);			// As uimu_ahrs_set_mahony_gains()
+	void setGyroScale(float dpsPerLsb);			// Cheap when the scale hasn't changed
+
+	// Integrates n gyro samples, oldest first, with the learned bias applied
+	void propagate(const int16_t gyro[][3], const uint32_t dtMicros[], int n);
+
+	// The accel/mag correction with no rotation, over dtMicros. mag may be NULL. The bias
+	// isn't applied here, propagate() already has
+	void correct(const int16_t acc[3], const int16_t mag[3], uint32_t dtMicros);
+
+	// One gyro sample and the correction together, as MahonyAHRSupdate(). mag may be NULL
+	void update(const int16_t gyro[3], const int16_t acc[3], const int16_t mag[3], uint32_t dtMicros);
+
+	void normalize();
+
+	imu::Quaternion quaternion() const;
+	const int32_t* raw() const { return q; }	// Q30 w, x, y, z
+};
+
+#endif /* FIXEDAHRS_H_ */
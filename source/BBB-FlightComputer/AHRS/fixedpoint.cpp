@@ -0,0 +1,22 @@
+/*
+ * fixedpoint.cpp
+ *	Seed table for fixedpoint::rsqrtUnit(): 1/sqrt of the middle of each 1/16 wide
+ *	interval of [1, 4), in Q30. Constant, so it is there before any static constructor
+ *	that normalises a quaternion runs.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "fixedpoint.h"
+
+const uint32_t fixedpoint::rsqrtSeeds[FIXEDPOINT_RSQRT_TABLE] = {
+	1057347856u, 1026693558u, 998559613u, 972618566u, 948599586u, 926276469u,
+	905458609u, 885984104u, 867714429u, 850530263u, 834328203u, 819018128u,
+	804521086u, 790767575u, 777696137u, 765252196u, 753387102u, 742057327u,
+	731223792u, 720851298u, 710908045u, 701365222u, 692196655u, 683378504u,
+	674889000u, 666708225u, 658817909u, 651201261u, 643842818u, 636728315u,
+	629844563u, 623179354u, 616721362u, 610460069u, 604385689u, 598489102u,
+	592761802u, 587195840u, 581783781u, 576518662u, 571393950u, 566403514u,
+	561541591u, 556802759u, 552181909u, 547674226u, 543275165u, 538980433u
+};
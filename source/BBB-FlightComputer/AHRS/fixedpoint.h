@@ -0,0 +1,120 @@
+/*
+ * fixedpoint.h
+ *	Q-format integer arithmetic for the fixed point attitude filter (fixedAhrs.h).
+ *	Q15 is an int16_t with 15 fractional bits, which is what the sensors output: a raw
+ *	sample is a fraction of the full scale. Q30 is an int32_t with 30 fractional bits.
+ *	Q31 can't hold the 1.0 of an identity quaternion, and Q30 leaves room for the
+ *	overshoot of a propagation step before it is normalised. Products are formed in
+ *	64 bits and rounded.
+ *
+ *	Nothing here divides or loops a data dependent number of times. The variable
+ *	shifts and clz are single instructions on the Cortex-A8, so a call costs the same
+ *	whatever its arguments.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef FIXEDPOINT_H_
+#define FIXEDPOINT_H_
+
+#include <stdint.h>
+
+#define FIXEDPOINT_Q				30
+#define FIXEDPOINT_ONE				((int32_t)1 << FIXEDPOINT_Q)
+#define FIXEDPOINT_HALF				((int32_t)1 << (FIXEDPOINT_Q - 1))
+#define FIXEDPOINT_RSQRT_TABLE		48		// Seeds over [1, 4), one per 1/16
+#define FIXEDPOINT_RSQRT_STEPS		3		// Newton steps from a seed good to 1.6%
+
+namespace fixedpoint
+{
+
+extern const uint32_t rsqrtSeeds[FIXEDPOINT_RSQRT_TABLE];	// fixedpoint.cpp
+
+// Q30 product, rounded
+inline int32_t mul(int32_t a, int32_t b)
+{
+	return (int32_t)(((int64_t)a * b + FIXEDPOINT_HALF) >> FIXEDPOINT_Q);
+}
+
+// Rounded arithmetic shift right, shift >= 0
+inline int64_t shiftRound(int64_t x, int shift)
+{
+	return (x + (((int64_t)1 << shift) >> 1)) >> shift;
+}
+
+// 1/sqrt(m) for m in [1, 4) as Q30, so m is in [2^30, 2^32). The result is in (0.5, 1]
+inline uint32_t rsqrtUnit(uint32_t m)
+{
+	uint32_t y = rsqrtSeeds[(m >> 26) - 16];
+	for(int i = 0; i < FIXEDPOINT_RSQRT_STEPS; i++) {
+		uint64_t y2 = ((uint64_t)y * y) >> FIXEDPOINT_Q;
+		uint64_t my2 = ((uint64_t)m * y2) >> FIXEDPOINT_Q;
+		y = (uint32_t)(((uint64_t)y * ((3ULL << FIXEDPOINT_Q) - my2)) >> (FIXEDPOINT_Q + 1));
+	}
+	return y;
+}
+
+// The even shift that brings x > 0 into [2^60, 2^62), negative for a right shift.
+// Even, so the square root of the shifted value scales back exactly
+inline int evenShift(uint64_t x)
+{
+	return (__builtin_clzll(x) - 2) & ~1;
+}
+
+// x scaled by 2^shift into [1, 4) as Q30
+inline uint32_t mantissa(uint64_t x, int shift)
+{
+	return (uint32_t)(((x << (shift + 2)) >> 2) >> FIXEDPOINT_Q);
+}
+
+// v/|v| as Q30, for n components of any common scale. The sum of squares must fit in
+// 64 bits: below 4 for Q30 vectors. Returns false, leaving out alone, for a zero vector
+inline bool normalize(const int32_t* v, int32_t* out, int n)
+{
+	uint64_t sum = 0;
+	for(int i = 0; i < n; i++)
+		sum += (uint64_t)((int64_t)v[i] * v[i]);
+	if(sum == 0)
+		return false;
+
+	// 1/|v| = r * 2^(shift/2 - 60) with r the Q30 rsqrt of the mantissa
+	int shift = evenShift(sum);
+	int64_t r = rsqrtUnit(mantissa(sum, shift));
+	int down = FIXEDPOINT_Q - shift / 2;
+	for(int i = 0; i < n; i++)
+		out[i] = (int32_t)shiftRound(v[i] * r, down);
+	return true;
+}
+
+inline bool normalize3(const int16_t v[3], int32_t out[3])
+{
+	int32_t wide[3] = { v[0], v[1], v[2] };
+	return normalize(wide, out, 3);
+}
+
+// sqrt of a Q60 value below 4.0 as Q30, from sqrt(m) = m * rsqrt(m)
+inline int32_t sqrt60(uint64_t x)
+{
+	if(x == 0)
+		return 0;
+	int shift = evenShift(x);
+	uint32_t m = mantissa(x, shift);
+	uint64_t root = ((uint64_t)m * rsqrtUnit(m)) >> FIXEDPOINT_Q;
+	return (int32_t)(root >> (shift / 2));
+}
+
+// Saturating float to Q15 of fullScale
+inline int16_t toQ15(float value, float fullScale)
+{
+	float scaled = value * (32768.0f / fullScale);
+	if(!(scaled > -32767.0f))	// Also catches NaN
+		return scaled < 0.0f ? -32767 : 0;
+	if(scaled > 32767.0f)
+		return 32767;
+	return (int16_t)(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+}
+
+};
+
+#endif /* FIXEDPOINT_H_ */
@@ -17,6 +17,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+
 #ifndef IMUMATH_MATRIX_HPP
 #define IMUMATH_MATRIX_HPP
 
@@ -29,77 +30,58 @@ namespace imu
 {
 
 
-template <uint8_t N> class Matrix
+//R rows by C columns, stored row major in place. Nothing in here touches the heap,
+//so a matrix can live on the stack of the control loop. Matrix<N> is square.
+template <uint8_t R, uint8_t C = R> class Matrix
 {
 public:
 	Matrix()
 	{
-		int r = sizeof(double)*N;
-        _cell = (double*)malloc(r*r);
-        memset(_cell, 0, r*r);
+        memset(_cell, 0, sizeof(_cell));
 	}
 
-    Matrix(const Matrix &v)
-    {
-        int r = sizeof(double)*N;
-        _cell = (double*)malloc(r*r);
-        memset(_cell, 0, r*r);
-        for (int x = 0; x < N; x++ )
-        {
-            for(int y = 0; y < N; y++)
-            {
-                _cell[x*N+y] = v._cell[x*N+y];
-            }
-        }
-    }
-
-    ~Matrix()
+    static Matrix identity()
     {
-        free(_cell);
+        Matrix ret;
+        for(int i = 0; i < R && i < C; i++)
+            ret._cell[i*C+i] = 1.0;
+        return ret;
     }
 
-    void operator = (Matrix m)
-    {
-        for(int x = 0; x < N; x++)
-        {
-            for(int y = 0; y < N; y++)
-            {
-                cell(x, y) = m.cell(x, y);
-            }
-        }
-    }
+    uint8_t rows() const { return R; }
+    uint8_t cols() const { return C; }
 
-    Vector<N> row_to_vector(int y)
+    Vector<C> row_to_vector(int y) const
     {
-        Vector<N> ret;
-        for(int i = 0; i < N; i++)
+        Vector<C> ret;
+        for(int i = 0; i < C; i++)
         {
-            ret[i] = _cell[y*N+i];
+            ret[i] = _cell[y*C+i];
         }
         return ret;
     }
 
-    Vector<N> col_to_vector(int x)
+    Vector<R> col_to_vector(int x) const
     {
-        Vector<N> ret;
-        for(int i = 0; i < N; i++)
+        Vector<R> ret;
+        for(int i = 0; i < R; i++)
         {
-            ret[i] = _cell[i*N+x];
+            ret[i] = _cell[i*C+x];
         }
         return ret;
     }
 
-    void vector_to_row(Vector<N> v, int row)
+    void vector_to_row(Vector<C> v, int row)
     {
-        for(int i = 0; i < N; i++)
+        for(int i = 0; i < C; i++)
         {
             cell(row, i) = v(i);
         }
     }
 
-    void vector_to_col(Vector<N> v, int col)
+    void vector_to_col(Vector<R> v, int col)
     {
-        for(int i = 0; i < N; i++)
+        for(int i = 0; i < R; i++)
         {
             cell(i, col) = v(i);
         }
@@ -107,75 +89,88 @@ public:
 
     double& operator ()(int x, int y)
     {
-        return _cell[x*N+y];
+        return _cell[x*C+y];
+    }
+
+    double operator ()(int x, int y) const
+    {
+        return _cell[x*C+y];
     }
 
     double& cell(int x, int y)
     {
-        return _cell[x*N+y];
+        return _cell[x*C+y];
     }
 
+    double cell(int x, int y) const
+    {
+        return _cell[x*C+y];
+    }
+
+    double* data() { return _cell; }
+    const double* data() const { return _cell; }
 
-    Matrix operator + (Matrix m)
+
+    Matrix operator + (const Matrix& m) const
     {
         Matrix ret;
-        for(int x = 0; x < N; x++)
-        {
-            for(int y = 0; y < N; y++)
-            {
-                ret._cell[x*N+y] = _cell[x*N+y] + m._cell[x*N+y];
-            }
-        }
+        for(int i = 0; i < R*C; i++)
+            ret._cell[i] = _cell[i] + m._cell[i];
         return ret;
     }
 
-    Matrix operator - (Matrix m)
+    Matrix operator - (const Matrix& m) const
     {
         Matrix ret;
-        for(int x = 0; x < N; x++)
-        {
-            for(int y = 0; y < N; y++)
-            {
-                ret._cell[x*N+y] = _cell[x*N+y] - m._cell[x*N+y];
-            }
-        }
+        for(int i = 0; i < R*C; i++)
+            ret._cell[i] = _cell[i] - m._cell[i];
         return ret;
     }
 
-    Matrix operator * (double scalar)
+    Matrix operator * (double scalar) const
     {
         Matrix ret;
-        for(int x = 0; x < N; x++)
+        for(int i = 0; i < R*C; i++)
+            ret._cell[i] = _cell[i] * scalar;
+        return ret;
+    }
+
+    template <uint8_t K> Matrix<R, K> operator * (const Matrix<C, K>& m) const
+    {
+        Matrix<R, K> ret;
+        for(int x = 0; x < R; x++)
         {
-            for(int y = 0; y < N; y++)
+            for(int k = 0; k < C; k++)
             {
-                ret._cell[x*N+y] = _cell[x*N+y] * scalar;
+                double a = _cell[x*C+k];
+                if(a == 0.0)
+                    continue;
+                for(int y = 0; y < K; y++)
+                    ret(x, y) += a * m(k, y);
             }
         }
         return ret;
     }
 
-    Matrix operator * (Matrix m)
+    Vector<R> operator * (Vector<C> v) const
     {
-        Matrix ret;
-        for(int x = 0; x < N; x++)
+        Vector<R> ret;
+        for(int x = 0; x < R; x++)
         {
-            for(int y = 0; y < N; y++)
-            {
-                Vector<N> row = row_to_vector(x);
-                Vector<N> col = m.col_to_vector(y);
-                ret.cell(x, y) = row.dot(col);
-            }
+            double sum = 0;
+            for(int y = 0; y < C; y++)
+                sum += _cell[x*C+y] * v[y];
+            ret[x] = sum;
         }
         return ret;
     }
 
-    Matrix transpose()
+    Matrix<C, R> transpose() const
     {
-        Matrix ret;
-        for(int x = 0; x < N; x++)
+        Matrix<C, R> ret;
+        for(int x = 0; x < R; x++)
         {
-            for(int y = 0; y < N; y++)
+            for(int y = 0; y < C; y++)
             {
                 ret.cell(y, x) = cell(x, y);
             }
@@ -183,15 +178,16 @@ public:
         return ret;
     }
 
-    Matrix<N-1> minor_matrix(int row, int col)
+    Matrix<R-1, C-1> minor_matrix(int row, int col) const
     {
         int colCount = 0, rowCount = 0;
-        Matrix<N-1> ret;
-        for(int i = 0; i < N; i++ )
+        Matrix<R-1, C-1> ret;
+        for(int i = 0; i < R; i++ )
         {
             if( i != row )
             {
-                for(int j = 0; j < N; j++ )
+                colCount = 0;
+                for(int j = 0; j < C; j++ )
                 {
                     if( j != col )
                     {
@@ -205,44 +201,299 @@ public:
         return ret;
     }
 
-    double determinant()
+    //square matrices only. both go through an LU decomposition, O(N^3)
+    double determinant() const;
+    Matrix invert() const;
+
+    //solves L*X = B, where L is the lower triangle of this matrix
+    template <uint8_t K> Matrix<R, K> solve_lower(const Matrix<R, K>& b, bool unitDiagonal = false) const
     {
-        if(N == 1)
-            return cell(0, 0);
+        Matrix<R, K> x = b;
+        for(int k = 0; k < K; k++)
+        {
+            for(int i = 0; i < R; i++)
+            {
+                double sum = x(i, k);
+                for(int j = 0; j < i; j++)
+                    sum -= _cell[i*C+j] * x(j, k);
+                x(i, k) = unitDiagonal ? sum : sum / _cell[i*C+i];
+            }
+        }
+        return x;
+    }
 
-        float det = 0.0;
-        for(int i = 0; i < N; i++ )
+    //solves U*X = B, where U is the upper triangle of this matrix
+    template <uint8_t K> Matrix<R, K> solve_upper(const Matrix<R, K>& b, bool unitDiagonal = false) const
+    {
+        Matrix<R, K> x = b;
+        for(int k = 0; k < K; k++)
         {
-            Matrix<N-1> minor = minor_matrix(0, i);
-            det += (i%2==1?-1.0:1.0) * cell(0, i) * minor.determinant();
+            for(int i = R-1; i >= 0; i--)
+            {
+                double sum = x(i, k);
+                for(int j = i+1; j < R; j++)
+                    sum -= _cell[i*C+j] * x(j, k);
+                x(i, k) = unitDiagonal ? sum : sum / _cell[i*C+i];
+            }
         }
-        return det;
+        return x;
     }
 
-    Matrix invert()
+    //this += alpha * A * A^T. only the upper triangle is computed and then mirrored,
+    //so a symmetric matrix (eg. a covariance) stays exactly symmetric
+    template <uint8_t K> void symmetric_update(const Matrix<R, K>& a, double alpha = 1.0)
     {
-        Matrix ret;
-        float det = determinant();
+        for(int x = 0; x < R; x++)
+        {
+            for(int y = x; y < R; y++)
+            {
+                double sum = 0;
+                for(int k = 0; k < K; k++)
+                    sum += a(x, k) * a(y, k);
+                _cell[x*C+y] += alpha * sum;
+                _cell[y*C+x] = _cell[x*C+y];
+            }
+        }
+    }
+
+    //this += alpha * v * v^T
+    void rank_one_update(Vector<R> v, double alpha = 1.0)
+    {
+        for(int x = 0; x < R; x++)
+        {
+            for(int y = x; y < R; y++)
+            {
+                _cell[x*C+y] += alpha * v[x] * v[y];
+                _cell[y*C+x] = _cell[x*C+y];
+            }
+        }
+    }
+
+    //returns A * this * A^T for a symmetric this, as in covariance propagation
+    template <uint8_t K> Matrix<K, K> transform_symmetric(const Matrix<K, R>& a) const
+    {
+        Matrix<K, R> ap = a * (*this);
+        Matrix<K, K> ret;
+        for(int x = 0; x < K; x++)
+        {
+            for(int y = x; y < K; y++)
+            {
+                double sum = 0;
+                for(int k = 0; k < R; k++)
+                    sum += ap(x, k) * a(y, k);
+                ret(x, y) = sum;
+                ret(y, x) = sum;
+            }
+        }
+        return ret;
+    }
+
+    //averages out rounding drift between the two triangles
+    void symmetrize()
+    {
+        for(int x = 0; x < R; x++)
+        {
+            for(int y = x+1; y < C; y++)
+            {
+                double avg = 0.5 * (_cell[x*C+y] + _cell[y*C+x]);
+                _cell[x*C+y] = avg;
+                _cell[y*C+x] = avg;
+            }
+        }
+    }
+
+private:
+    double _cell[R*C];
+};
+
+
+//LU decomposition with partial pivoting, PA = LU. L (unit diagonal) and U share one matrix.
+template <uint8_t N> class LU
+{
+public:
+    LU(const Matrix<N>& a)
+    {
+        _lu = a;
+        _sign = 1;
+        _singular = false;
+        for(int i = 0; i < N; i++)
+            _perm[i] = i;
 
-        for(int x = 0; x < N; x++)
+        for(int k = 0; k < N; k++)
         {
-            for(int y = 0; y < N; y++)
+            int p = k;
+            double big = fabs(_lu(k, k));
+            for(int i = k+1; i < N; i++)
+            {
+                if(fabs(_lu(i, k)) > big)
+                {
+                    big = fabs(_lu(i, k));
+                    p = i;
+                }
+            }
+            if(big == 0.0)
+            {
+                _singular = true;
+                continue;
+            }
+            if(p != k)
+            {
+                for(int j = 0; j < N; j++)
+                {
+                    double t = _lu(k, j);
+                    _lu(k, j) = _lu(p, j);
+                    _lu(p, j) = t;
+                }
+                uint8_t t = _perm[k];
+                _perm[k] = _perm[p];
+                _perm[p] = t;
+                _sign = -_sign;
+            }
+
+            double pivot = _lu(k, k);
+            for(int i = k+1; i < N; i++)
             {
-                Matrix<N-1> minor = minor_matrix(y, x);
-                ret(x, y) = det*minor.determinant();
-                if( (x+y)%2 == 1)
-                    ret(x, y) = -ret(x, y);
+                double l = _lu(i, k) / pivot;
+                _lu(i, k) = l;
+                if(l == 0.0)
+                    continue;
+                for(int j = k+1; j < N; j++)
+                    _lu(i, j) -= l * _lu(k, j);
             }
         }
+    }
+
+    bool isSingular() const { return _singular; }
+
+    double determinant() const
+    {
+        if(_singular)
+            return 0.0;
+        double det = _sign;
+        for(int i = 0; i < N; i++)
+            det *= _lu(i, i);
+        return det;
+    }
+
+    template <uint8_t K> Matrix<N, K> solve(const Matrix<N, K>& b) const
+    {
+        Matrix<N, K> pb;
+        for(int i = 0; i < N; i++)
+            for(int k = 0; k < K; k++)
+                pb(i, k) = b(_perm[i], k);
+        return _lu.solve_upper(_lu.solve_lower(pb, true));
+    }
+
+    Vector<N> solve(Vector<N> b) const
+    {
+        Matrix<N, 1> m;
+        for(int i = 0; i < N; i++)
+            m(i, 0) = b[i];
+        m = solve(m);
+        Vector<N> ret;
+        for(int i = 0; i < N; i++)
+            ret[i] = m(i, 0);
         return ret;
     }
 
+    Matrix<N> inverse() const
+    {
+        return solve(Matrix<N>::identity());
+    }
+
+    const Matrix<N>& packed() const { return _lu; }
+
+private:
+    Matrix<N> _lu;
+    uint8_t _perm[N];
+    int _sign;
+    bool _singular;
+};
+
+
+//Cholesky decomposition A = L*L^T of a symmetric positive definite matrix.
+//Cheaper and better conditioned than LU for covariances and normal equations.
+template <uint8_t N> class Cholesky
+{
+public:
+    Cholesky(const Matrix<N>& a)
+    {
+        _ok = true;
+        for(int j = 0; j < N; j++)
+        {
+            double d = a(j, j);
+            for(int k = 0; k < j; k++)
+                d -= _l(j, k) * _l(j, k);
+            if(!(d > 0.0))	//also catches NaN
+            {
+                _ok = false;
+                return;
+            }
+            d = sqrt(d);
+            _l(j, j) = d;
+            for(int i = j+1; i < N; i++)
+            {
+                double s = a(i, j);
+                for(int k = 0; k < j; k++)
+                    s -= _l(i, k) * _l(j, k);
+                _l(i, j) = s / d;
+            }
+        }
+    }
+
+    //false if the matrix was not positive definite, in which case nothing else is valid
+    bool ok() const { return _ok; }
+
+    const Matrix<N>& L() const { return _l; }
+
+    double determinant() const
+    {
+        double det = 1.0;
+        for(int i = 0; i < N; i++)
+            det *= _l(i, i);
+        return det * det;
+    }
+
+    template <uint8_t K> Matrix<N, K> solve(const Matrix<N, K>& b) const
+    {
+        Matrix<N, K> y = _l.solve_lower(b);
+        for(int k = 0; k < K; k++)	//back substitution with L^T
+        {
+            for(int i = N-1; i >= 0; i--)
+            {
+                double sum = y(i, k);
+                for(int j = i+1; j < N; j++)
+                    sum -= _l(j, i) * y(j, k);
+                y(i, k) = sum / _l(i, i);
+            }
+        }
+        return y;
+    }
+
+    Matrix<N> inverse() const
+    {
+        return solve(Matrix<N>::identity());
+    }
+
 private:
-    double* _cell;
+    Matrix<N> _l;
+    bool _ok;
 };
 
 
+template <uint8_t R, uint8_t C> double Matrix<R, C>::determinant() const
+{
+    LU<R> lu(*this);
+    return lu.determinant();
+}
+
+template <uint8_t R, uint8_t C> Matrix<R, C> Matrix<R, C>::invert() const
+{
+    LU<R> lu(*this);
+    return lu.inverse();
+}
+
+
 };
 
 #endif
-
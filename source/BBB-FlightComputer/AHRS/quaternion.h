@@ -27,6 +27,7 @@
 #include <math.h>
 
 #include "vector.h"
+#include "fastmath.h"
 
 
 namespace imu
@@ -75,6 +76,10 @@ public:
     {
         return _z;
     }
+    double w() const { return _w; }
+    double x() const { return _x; }
+    double y() const { return _y; }
+    double z() const { return _z; }
 
     double magnitude()
     {
@@ -122,7 +127,7 @@ public:
             _y = (m(0, 2) - m(2, 0)) / S;
             _z = (m(1, 0) - m(0, 1)) / S;
         }
-        else if ((m(0, 0) < m(1, 1))&(m(0, 0) < m(2, 2)))
+        else if ((m(0, 0) > m(1, 1))&(m(0, 0) > m(2, 2)))	// Largest diagonal keeps S away from 0
         {
             S = sqrt(1.0 + m(0, 0) - m(1, 1) - m(2, 2)) * 2;
             _w = (m(2, 1) - m(1, 2)) / S;
@@ -130,7 +135,7 @@ public:
             _y = (m(0, 1) + m(1, 0)) / S;
             _z = (m(0, 2) + m(2, 0)) / S;
         }
-        else if (m(1, 1) < m(2, 2))
+        else if (m(1, 1) > m(2, 2))
         {
             S = sqrt(1.0 + m(1, 1) - m(0, 0) - m(2, 2)) * 2;
             _w = (m(0, 2) - m(2, 0)) / S;
@@ -186,9 +191,9 @@ public:
         double sqy = _y*_y;
         double sqz = _z*_z;
 
-        ret.x() = atan2(2.0*(_x*_y+_z*_w),(sqx-sqy-sqz+sqw));
-        ret.y() = asin(-2.0*(_x*_z-_y*_w)/(sqx+sqy+sqz+sqw));
-        ret.z() = atan2(2.0*(_y*_z+_x*_w),(-sqx-sqy+sqz+sqw));
+        ret.x() = fastmath::atan2(2.0*(_x*_y+_z*_w),(sqx-sqy-sqz+sqw));
+        ret.y() = fastmath::asin(-2.0*(_x*_z-_y*_w)/(sqx+sqy+sqz+sqw));
+        ret.z() = fastmath::atan2(2.0*(_y*_z+_x*_w),(-sqx-sqy+sqz+sqw));
 
         return ret;
     }
@@ -34,20 +34,17 @@ template <uint8_t N> class Vector
 public:
 	Vector()
 	{
-		p_vec = (double*)malloc(sizeof(double)*N+1);
         memset(p_vec, 0, sizeof(double)*N);
 	}
 
 	Vector(double a)
 	{
-		p_vec = (double*)malloc(sizeof(double)*N+1);
         memset(p_vec, 0, sizeof(double)*N);
 		p_vec[0] = a;
 	}
 
 	Vector(double a, double b)
 	{
-		p_vec = (double*)malloc(sizeof(double)*N+1);
         memset(p_vec, 0, sizeof(double)*N);
 		p_vec[0] = a;
 		p_vec[1] = b;
@@ -55,7 +52,6 @@ public:
 
 	Vector(double a, double b, double c)
 	{
-		p_vec = (double*)malloc(sizeof(double)*N+1);
         memset(p_vec, 0, sizeof(double)*N);
 		p_vec[0] = a;
 		p_vec[1] = b;
@@ -64,7 +60,6 @@ public:
 
     Vector(double a, double b, double c, double d)
     {
-		p_vec = (double*)malloc(sizeof(double)*N+1);
         memset(p_vec, 0, sizeof(double)*N);
         p_vec[0] = a;
 		p_vec[1] = b;
@@ -74,17 +69,10 @@ public:
 
     Vector(const Vector<N> &v)
     {
-        p_vec = (double*)malloc(sizeof(double)*N);
-        memset(p_vec, 0, sizeof(double)*N);
         for (int x = 0; x < N; x++ )
             p_vec[x] = v.p_vec[x];
     }
 
-    ~Vector()
-    {
-        free(p_vec);
-    }
-
     uint8_t n() { return N; }
 
     double magnitude()
@@ -165,6 +153,11 @@ public:
         return p_vec[n];
     }
 
+    double operator [](int n) const
+    {
+        return p_vec[n];
+    }
+
     double& operator ()(int n)
     {
         return p_vec[n];
@@ -214,10 +207,13 @@ public:
     double& x() { return p_vec[0]; }
     double& y() { return p_vec[1]; }
     double& z() { return p_vec[2]; }
+    double x() const { return p_vec[0]; }
+    double y() const { return p_vec[1]; }
+    double z() const { return p_vec[2]; }
 
 
 private:
-    double* p_vec;
+    double p_vec[N];	// In place, so vectors on the flight loop never touch the heap
 };
 
 
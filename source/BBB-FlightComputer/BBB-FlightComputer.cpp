@@ -8,9 +8,39 @@
 //============================================================================
 
 #include "BBB-FlightComputer.h"
+#include <errno.h>
+
+static bool virtualTime = false;
+static unsigned long virtualMicros = 0;
 
 unsigned long micros() {
+	if(virtualTime) return virtualMicros;
+
     timespec tv;
     clock_gettime(CLOCK_MONOTONIC, &tv);
-    return (tv.tv_sec) * 1000000 + (tv.tv_nsec)/1000000;
+    return (tv.tv_sec) * 1000000 + (tv.tv_nsec)/1000;
+}
+
+void delayMicros(unsigned long us) {
+	if(virtualTime) {
+		virtualMicros += us;
+		return;
+	}
+	timespec ts;
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (us % 1000000) * 1000;
+	while(nanosleep(&ts, &ts) != 0 && errno == EINTR) {}	// Resume after signals
+}
+
+void setVirtualMicros(unsigned long us) {
+	virtualTime = true;
+	virtualMicros = us;
+}
+
+void useRealTime() {
+	virtualTime = false;
+}
+
+bool usingVirtualTime() {
+	return virtualTime;
 }
@@ -17,11 +17,13 @@
 #include "sensors/LMS303.h"
 #include "sensors/LPS331Altimeter.h"
 #include "sensors/L3GD20Gyro.h"
+#include "sensors/i2cTransport.h"
 #include "AHRS/ahrs.h"
 #include "flightControl/aircraftControls.h"
+#include "flightControl/attitudeController.h"
 #include <time.h>
+#include "timing.h"
 
-unsigned long micros();
 
 
 #endif /* BBB_FLIGHTCOMPUTER_H_ */
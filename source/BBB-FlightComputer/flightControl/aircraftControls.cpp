@@ -7,6 +7,8 @@
  */
 
 #include "aircraftControls.h"
+#include "../realtime/latency.h"
+#include "../realtime/console.h"
 
 #define MAX_BUF	64
 #define FLAP_DEFLECTION_ANGLE	15	// Max throw of flaps in degrees
@@ -15,9 +17,26 @@
 
 using namespace std;
 
+static PWMOutput* output = NULL;
+static std::string sysfsRoot = "/sys/devices/";
+
+void pwm_set_output(PWMOutput* o) {
+	output = o;
+}
+
+PWMOutput* pwm_get_output() {
+	return output;
+}
+
+void pwm_set_sysfs_root(const std::string& root) {
+	sysfsRoot = root;
+	if(sysfsRoot.empty() || sysfsRoot[sysfsRoot.size() - 1] != '/')
+		sysfsRoot += '/';
+}
+
 int getCapeManagerSlot(char* name) {
 	//cout << " Getting slot!" << endl;
-	std::string slotPath = "/sys/devices/";
+	std::string slotPath = sysfsRoot;
 	slotPath = slotPath + GetFullNameOfFileInDirectory(slotPath, "bone_capemgr.");
 	slotPath = slotPath + "/slots";
 
@@ -65,7 +84,7 @@ int loadDeviceTree(int header, int pin) {
 	int fd, len;
 	char buf[MAX_BUF] = { 0 };
 
-	std::string slotPath = "/sys/devices/";
+	std::string slotPath = sysfsRoot;
 	slotPath = slotPath + GetFullNameOfFileInDirectory(slotPath, "bone_capemgr.");
 	slotPath = slotPath + "/slots";
 
@@ -106,11 +125,26 @@ int loadDeviceTree(int header, int pin) {
 
 PWMChannel::PWMChannel(int header, int pin, std::string chName) {	// Identifies the correct file path to communicate with PWM via sysfs
 	char buf[MAX_BUF] = { 0 };
+	servoMax = SERVO_MAX_DUTY;
+	servoMin = SERVO_MIN_DUTY;
+	channelName = chName;
+	period = 0;
+	duty = 0;
+	polarity = 0;
+	written = 0;
+	memset(basePath, 0, sizeof(basePath));
+	memset(periodPath, 0, sizeof(periodPath));
+	memset(dutyPath, 0, sizeof(dutyPath));
+	memset(polarityPath, 0, sizeof(polarityPath));
+	memset(runPath, 0, sizeof(runPath));
+	if(output)	// No sysfs behind it
+		return;
+
 	// Load PWM device tree overlays
 	loadDeviceTree(header, pin);
 
 	// Get sysfs locations to control PWM channel
-	std::string base = "/sys/devices/";
+	std::string base = sysfsRoot;
 	std::string temp = GetFullNameOfFileInDirectory(base, "ocp.");
 	snprintf(buf, sizeof(buf), "pwm_test_P%d_%d.", header, pin);
 	temp = base + temp + "/";
@@ -139,13 +173,6 @@ PWMChannel::PWMChannel(int header, int pin, std::string chName) {	// Identifies
 	memcpy(runPath, temp1.c_str(), temp1.size());
 	//cout << "runPath: " << runPath << endl;
 
-	servoMax = SERVO_MAX_DUTY;
-	servoMin = SERVO_MIN_DUTY;
-	channelName = chName;
-	period = 0;
-	duty = 0;
-	polarity = 0;
-
 	/*	Do this manually later. PWMs are not ready at the point this point
 	setPeriod(20000000);
 	setDuty(10000000);
@@ -160,9 +187,14 @@ PWMChannel::PWMChannel() {	// Identifies the correct file path to communicate wi
 	period = 0;
 	duty = 0;
 	polarity = 0;
+	written = 0;
 }
 
 int PWMChannel::setPeriod(unsigned long p) {
+	if(output) {
+		period = p;
+		return 0;
+	}
 	int fd, len;
 	char buf[MAX_BUF] = { 0 };	// Data to write
 	fd = open(periodPath, O_WRONLY);
@@ -182,11 +214,18 @@ int PWMChannel::setPeriod(unsigned long p) {
 }
 
 int PWMChannel::setDuty(unsigned long dut) {
+	LATENCY_SCOPE("pwm write");
+	if(output) {
+		output->setDuty(*this, dut);
+		duty = dut;
+		written = latency_now();
+		return 0;
+	}
 	int fd, len;
 	char buf[MAX_BUF] = { 0 };	// Data to write
 	fd = open(dutyPath, O_WRONLY);
 	if (fd < 0) {
-		cout << "Failed to set " << channelName << " PWM duty!" << endl;
+		console_print("Failed to set %s PWM duty!", channelName.c_str());
 		close(fd);
 		return 1;
 	}
@@ -196,11 +235,16 @@ int PWMChannel::setDuty(unsigned long dut) {
 	close(fd);
 
 	duty = dut;
+	written = latency_now();
 
 	return 0;
 }
 
 int PWMChannel::setPolarity(unsigned long p) {
+	if(output) {
+		polarity = p;
+		return 0;
+	}
 	int fd, len;
 	char buf[MAX_BUF] = { 0 };	// Data to write
 	fd = open(polarityPath, O_WRONLY);
@@ -220,6 +264,8 @@ int PWMChannel::setPolarity(unsigned long p) {
 }
 
 int PWMChannel::enable() {
+	if(output)
+		return 0;
 	int fd, len;
 	char buf[MAX_BUF] = { 0 };	// Data to write
 	fd = open(runPath, O_WRONLY);
@@ -237,6 +283,8 @@ int PWMChannel::enable() {
 }
 
 int PWMChannel::disable() {
+	if(output)
+		return 0;
 	int fd, len;
 	char buf[MAX_BUF] = { 0 };	// Data to write
 	fd = open(runPath, O_WRONLY);
@@ -322,9 +370,11 @@ int aircraftControls::init() {
 }
 
 int aircraftControls::PWMInit() {
+	if(output)	// No overlays to load
+		return 0;
 	int fd;
 
-	std::string slotPath = "/sys/devices/";
+	std::string slotPath = sysfsRoot;
 	slotPath = slotPath + GetFullNameOfFileInDirectory(slotPath, "bone_capemgr.");
 	slotPath = slotPath + "/slots";
 
@@ -365,7 +415,7 @@ int aircraftControls::shutdown() {
 	int fd;
 	char buf[MAX_BUF] = { 0 };
 
-	std::string slotPath = "/sys/devices/";
+	std::string slotPath = sysfsRoot;
 	slotPath = slotPath + GetFullNameOfFileInDirectory(slotPath, "bone_capemgr.");
 	slotPath = slotPath + "/slots";
 
@@ -422,125 +472,79 @@ int aircraftControls::setFlapMode(FLAP_MIX_MODE mix) {
 	return 0;
 }
 
-int aircraftControls::setThrottle(int percent) {
-	throttle = percent;
-	unsigned long maxDuty = throttleChannel.getServoMax();
-	unsigned long minDuty = throttleChannel.getServoMin();
-	percent = (percent + 100) / 2;
-	percent += throttleTrim;
+// Duty for a position from 0 to 100 percent of the channel's travel. Clamped as a float,
+// so a command past full travel can't wrap the unsigned duty around to the other end
+static unsigned long dutyFor(PWMChannel& channel, float percent) {
+	unsigned long maxDuty = channel.getServoMax();
+	unsigned long minDuty = channel.getServoMin();
+	if(!(percent > 0)) percent = 0;	// Also NaN
+	if(percent > 100) percent = 100;
+	return minDuty + (unsigned long)((maxDuty - minDuty) * percent / 100);
+}
+
+void aircraftControls::mixElevons() {
+	float mixed = ((pitch + pitchTrim) / 2) + ((roll + rollTrim) / 2);
+	leftElevonChannel.setDuty(dutyFor(leftElevonChannel, (mixed + 100) / 2));
 
-	unsigned long dutyLevel = ((maxDuty - minDuty) * percent ) / 100;
-	dutyLevel += minDuty;
-	if(dutyLevel > maxDuty) dutyLevel = maxDuty;
-	if(dutyLevel < minDuty) dutyLevel = minDuty;
+	mixed = ((pitch + pitchTrim) / 2) - ((roll + rollTrim) / 2);
+	rightElevonChannel.setDuty(dutyFor(rightElevonChannel, (mixed + 100) / 2));
+}
 
-	throttleChannel.setDuty(dutyLevel);
+int aircraftControls::setThrottle(float percent) {
+	LATENCY_SCOPE("mixer");	// Includes the pwm writes
+	throttle = percent;
+	throttleChannel.setDuty(dutyFor(throttleChannel, (percent + 100) / 2 + throttleTrim));
 	return 0;
 }
 
-int aircraftControls::setPitch(int percent) {
+int aircraftControls::setPitch(float percent) {
+	LATENCY_SCOPE("mixer");	// Includes the pwm writes
 	pitch = percent;
-	percent = (percent + 100) / 2;
-	percent += pitchTrim;
-
-	unsigned long maxDuty = rightElevonChannel.getServoMax();
-	unsigned long minDuty = rightElevonChannel.getServoMin();
 
 	switch(mixMode) {
-	case FLAP_MIX_ACRO: {
-		unsigned long dutyLevel = ((maxDuty - minDuty) * percent ) / 100;
-		dutyLevel += minDuty;
-		if(dutyLevel > maxDuty) dutyLevel = maxDuty;
-		if(dutyLevel < minDuty) dutyLevel = minDuty;
-
-		elevatorChannel.setDuty(dutyLevel);
+	case FLAP_MIX_ACRO:
+		elevatorChannel.setDuty(dutyFor(elevatorChannel, (percent + 100) / 2 + pitchTrim));
 		break;
-	}
-	case FLAP_MIX_ELEVON: {
-		int tempPercent = ((pitch + pitchTrim) / 2) + ((roll + rollTrim) / 2);
-		tempPercent = ( tempPercent + 100 ) / 2;
-		unsigned long dutyLevel = ((maxDuty - minDuty) * tempPercent ) / 100;
-		dutyLevel += minDuty;
-		if(dutyLevel > maxDuty) dutyLevel = maxDuty;
-		if(dutyLevel < minDuty) dutyLevel = minDuty;
-
-		leftElevonChannel.setDuty(dutyLevel);
-
-		tempPercent = ((pitch + pitchTrim) / 2) - ((roll + rollTrim) / 2);
-		tempPercent = ( tempPercent + 100 ) / 2;
-		dutyLevel = ((maxDuty - minDuty) * tempPercent ) / 100;
-		dutyLevel += minDuty;
-		if(dutyLevel > maxDuty) dutyLevel = maxDuty;
-		if(dutyLevel < minDuty) dutyLevel = minDuty;
-
-		rightElevonChannel.setDuty(dutyLevel);
+	case FLAP_MIX_ELEVON:
+		mixElevons();
 		break;
 	}
-	}
 
 	return 0;
 }
 
-int aircraftControls::setRoll(int percent) {
+int aircraftControls::setRoll(float percent) {
+	LATENCY_SCOPE("mixer");	// Includes the pwm writes
 	roll = percent;
-	percent = (percent + 100) / 2;
-	percent += rollTrim;
-
-	unsigned long maxDuty = rightElevonChannel.getServoMax();
-	unsigned long minDuty = rightElevonChannel.getServoMin();
 
 	switch(mixMode) {
-	case FLAP_MIX_ACRO: {
-		unsigned long dutyLevel = ((maxDuty - minDuty) * percent ) / 100;
-		dutyLevel += minDuty;
-		if(dutyLevel > maxDuty) dutyLevel = maxDuty;
-		if(dutyLevel < minDuty) dutyLevel = minDuty;
-
-		aileronChannel.setDuty(dutyLevel);
+	case FLAP_MIX_ACRO:
+		aileronChannel.setDuty(dutyFor(aileronChannel, (percent + 100) / 2 + rollTrim));
+		break;
+	case FLAP_MIX_ELEVON:
+		mixElevons();
 		break;
 	}
-	case FLAP_MIX_ELEVON: {
-		int tempPercent = ((pitch + pitchTrim) / 2) + ((roll + rollTrim) / 2);
-		tempPercent = ( tempPercent + 100 ) / 2;
-
-		unsigned long dutyLevel = ((maxDuty - minDuty) * tempPercent ) / 100;
-		dutyLevel += minDuty;
-		if(dutyLevel > maxDuty) dutyLevel = maxDuty;
-		if(dutyLevel < minDuty) dutyLevel = minDuty;
-
-
-		leftElevonChannel.setDuty(dutyLevel);
-
-		tempPercent = ((pitch + pitchTrim) / 2) - ((roll + rollTrim) / 2);
-		tempPercent = ( tempPercent + 100 ) / 2;
-
-		dutyLevel = ((maxDuty - minDuty) * tempPercent ) / 100;
-		dutyLevel += minDuty;
-		if(dutyLevel > maxDuty) dutyLevel = maxDuty;
-		if(dutyLevel < minDuty) dutyLevel = minDuty;
 
+	return 0;
+}
 
-		rightElevonChannel.setDuty(dutyLevel);
-		break;
-	}
+int aircraftControls::setPitchAndRoll(float pitchPercent, float rollPercent) {
+	if(mixMode != FLAP_MIX_ELEVON) {
+		setPitch(pitchPercent);
+		return setRoll(rollPercent);
 	}
-
+	LATENCY_SCOPE("mixer");	// Includes the pwm writes
+	pitch = pitchPercent;
+	roll = rollPercent;
+	mixElevons();	// Once, where setPitch() then setRoll() would write each elevon twice
 	return 0;
 }
 
-int aircraftControls::setYaw(int percent) {
+int aircraftControls::setYaw(float percent) {
+	LATENCY_SCOPE("mixer");	// Includes the pwm writes
 	yaw = percent;
-	unsigned long maxDuty = rudderChannel.getServoMax();
-	unsigned long minDuty = rudderChannel.getServoMin();
-	percent = (percent + 100) / 2;
-	percent += yawTrim;
-
-	unsigned long dutyLevel = ((maxDuty - minDuty) * percent ) / 100;
-	dutyLevel += minDuty;
-	if(dutyLevel > maxDuty) dutyLevel = maxDuty;
-	if(dutyLevel < minDuty) dutyLevel = minDuty;
-
-	rudderChannel.setDuty(dutyLevel);
+	rudderChannel.setDuty(dutyFor(rudderChannel, (percent + 100) / 2 + yawTrim));
 	return 0;
 }
 
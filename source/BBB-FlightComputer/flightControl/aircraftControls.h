@@ -12,6 +12,7 @@
 #define AIRCRAFTCONTROLS_H_
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <dirent.h>
 #include <fstream>
@@ -55,6 +56,18 @@ enum FLAP_MIX_MODE {
 	FLAP_MIX_ELEVON		= 1
 };
 
+class PWMChannel;
+
+class PWMOutput {	// Stands in for the sysfs PWM files once installed with pwm_set_output(), e.g. in simulation
+public:
+	virtual void setDuty(PWMChannel& channel, unsigned long duty) = 0;	// ns
+	virtual ~PWMOutput() {}
+};
+
+void pwm_set_output(PWMOutput* output);	// NULL goes back to sysfs. Install before aircraftControls::init()
+PWMOutput* pwm_get_output();
+void pwm_set_sysfs_root(const std::string& root);	// "/sys/devices/", or a test tree laid out like it
+
 int loadDeviceTree(int header, int pin);
 int getCapeManagerSlot(char* name);
 std::string GetFullNameOfFileInDirectory(const std::string & dirName, const std::string & fileNameToFind);
@@ -74,6 +87,7 @@ private:
 	unsigned long polarity;
 	unsigned long servoMax;
 	unsigned long servoMin;
+	uint64_t written;	// latency_now() when the last duty landed
 
 	friend int loadDeviceTree(int header, int pin);
 	friend int getCapeManagerSlot(char* name);
@@ -92,10 +106,12 @@ public:
 	int setPeriod(unsigned long p);
 	unsigned long getDuty() { return duty; }
 	int setDuty(unsigned long dut);
+	uint64_t getDutyWritten() { return written; }
 	unsigned long getPolarity() { return polarity; }
 	int setPolarity(unsigned long p);
 	unsigned long getServoMax() { return servoMax; }
 	unsigned long getServoMin() { return servoMin; }
+	const std::string& getName() { return channelName; }
 	int enable();
 	int disable();
 
@@ -104,10 +120,10 @@ public:
 
 class aircraftControls {
 public:	// MAKE THIS PRIVATE************************************************************************************
-	int throttle;	// In + percentage
-	int pitch;	// In +/- percentage
-	int roll;	// In +/- percentage
-	int yaw;	// In +/- percentage
+	float throttle;	// In + percentage
+	float pitch;	// In +/- percentage
+	float roll;	// In +/- percentage
+	float yaw;	// In +/- percentage
 	int fullDeflection;		// degrees
 	int throttleTrim;
 	int pitchTrim;
@@ -125,6 +141,8 @@ public:	// MAKE THIS PRIVATE****************************************************
 	friend int getCapeManagerSlot(char* name);
 	friend std::string GetFullNameOfFileInDirectory(const std::string & dirName, const std::string & fileNameToFind);
 
+	void mixElevons();
+
 public:
 	aircraftControls(FLAP_MIX_MODE mix);
 	int init();
@@ -134,14 +152,15 @@ public:
 
 	int setFlapMode(FLAP_MIX_MODE mix);
 
-	int getThrottle() { return throttle; }
-	int getYaw() { return yaw; }
-	int getPitch() { return pitch; }
-	int getRoll() { return roll; }
-	int setThrottle(int percent);
-	int setPitch(int percent);
-	int setRoll(int percent);
-	int setYaw(int percent);
+	float getThrottle() { return throttle; }
+	float getYaw() { return yaw; }
+	float getPitch() { return pitch; }
+	float getRoll() { return roll; }
+	int setThrottle(float percent);
+	int setPitch(float percent);
+	int setRoll(float percent);
+	int setPitchAndRoll(float pitchPercent, float rollPercent);	// One mixer pass for both
+	int setYaw(float percent);
 
 	virtual ~aircraftControls();
 };
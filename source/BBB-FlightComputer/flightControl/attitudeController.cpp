@@ -0,0 +1,120 @@
+/*
+ * attitudeController.cpp
+ *	Cascaded angle and rate loops, see attitudeController.h.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "attitudeController.h"
+
+void attitude_controller_default_gains(attitudeControllerGains& g) {
+	//                  kp     ki    kd     D Hz  I limit  output limit
+	pidGains roll   = { 0.50f, 0.40f, 0.010f, 30, 30,      100 };
+	pidGains pitch  = { 0.60f, 0.50f, 0.010f, 30, 100,     100 };	// The I term carries the trim of an offset CG
+	pidGains yaw    = { 0.40f, 0.10f, 0,      0,  20,      100 };
+	pidGains angle  = { 4.00f, 0,     0,      0,  0,       120 };	// Rate setpoints up to 120 deg/s
+	g.rate[CONTROL_ROLL] = roll;
+	g.rate[CONTROL_PITCH] = pitch;
+	g.rate[CONTROL_YAW] = yaw;
+	g.angle[CONTROL_ROLL] = angle;
+	g.angle[CONTROL_PITCH] = angle;
+}
+
+AttitudeController::AttitudeController() {
+	attitudeControllerGains g;
+	attitude_controller_default_gains(g);
+	setGains(g);
+}
+
+void AttitudeController::setGains(const attitudeControllerGains& g) {
+	for(int i = 0; i < CONTROL_AXES; i++)
+		rateLoop[i].setGains(g.rate[i]);
+	for(int i = 0; i < CONTROL_ANGLE_AXES; i++)
+		angleLoop[i].setGains(g.angle[i]);
+	reset();
+}
+
+void AttitudeController::reset() {
+	for(int i = 0; i < CONTROL_AXES; i++) {
+		rateLoop[i].reset();
+		rateSetpoint[i] = 0;
+	}
+	for(int i = 0; i < CONTROL_ANGLE_AXES; i++)
+		angleLoop[i].reset();
+	for(int i = 0; i < CONTROL_AXES; i++)
+		attitudeError[i] = 0;
+	setAttitude(0, 0);
+	yawRateSetpoint = 0;
+	lastRateMicros = 0;
+	lastAngleMicros = 0;
+	rateStarted = false;
+	angleStarted = false;
+	rateUpdates = 0;
+	angleUpdates = 0;
+}
+
+void AttitudeController::setAttitude(float rollDegrees, float pitchDegrees) {
+	float r = rollDegrees * (float)M_PI / 360.0f;	// Half angles
+	float p = pitchDegrees * (float)M_PI / 360.0f;
+	float cr = cosf(r), sr = sinf(r), cp = cosf(p), sp = sinf(p);
+
+	// Pitch then roll, as the AHRS euler angles are, with the heading part taken back out:
+	// the twist about the vertical is (cp cr, 0, 0, -sp sr) normalised, and its conjugate
+	// times the rotation leaves the tilt, which has no z
+	float w = cp * cr, x = cp * sr, y = sp * cr, z = -sp * sr;
+	float n = 1.0f / sqrtf(w * w + z * z);
+	float tw = w * n, tz = z * n;
+	tiltSetpoint[0] = tw * w + tz * z;
+	tiltSetpoint[1] = tw * x + tz * y;
+	tiltSetpoint[2] = tw * y - tz * x;
+	tiltSetpoint[3] = 0;
+}
+
+void AttitudeController::updateAttitude(const imu::Quaternion& attitude, unsigned long micros) {
+	float dt = angleStarted ? secondsSince(micros, lastAngleMicros) : 0;
+	lastAngleMicros = micros;
+	angleStarted = true;
+
+	float qw = attitude.w(), qx = attitude.x(), qy = attitude.y(), qz = attitude.z();
+
+	// Measured heading: the twist about the vertical. Straight up or down it has no
+	// length, and any heading will do
+	float twistSquared = qw * qw + qz * qz;
+	float hw = 1, hz = 0;
+	if(twistSquared > 1e-6f) {
+		float n = 1.0f / sqrtf(twistSquared);
+		hw = qw * n;
+		hz = qz * n;
+	}
+
+	// Setpoint = heading * tilt
+	float sw = tiltSetpoint[0], sx = tiltSetpoint[1], sy = tiltSetpoint[2];
+	float pw = hw * sw;
+	float px = hw * sx - hz * sy;
+	float py = hw * sy + hz * sx;
+	float pz = hz * sw;
+
+	// Error = conjugate(attitude) * setpoint, the rotation still to go in body axes
+	float ew =  qw * pw + qx * px + qy * py + qz * pz;
+	float ex =  qw * px - qx * pw - qy * pz + qz * py;
+	float ey =  qw * py + qx * pz - qy * pw - qz * px;
+	float ez =  qw * pz - qx * py + qy * px - qz * pw;
+	float scale = (ew < 0 ? -2.0f : 2.0f) * 180.0f / (float)M_PI;	// The short way round, in degrees
+	attitudeError[CONTROL_ROLL] = ex * scale;
+	attitudeError[CONTROL_PITCH] = ey * scale;
+	attitudeError[CONTROL_YAW] = ez * scale;
+
+	if(dt > 0) {	// Otherwise the rate setpoints stay where they were
+		rateSetpoint[CONTROL_ROLL] = angleLoop[CONTROL_ROLL].update(attitudeError[CONTROL_ROLL], 0, dt);
+		rateSetpoint[CONTROL_PITCH] = angleLoop[CONTROL_PITCH].update(attitudeError[CONTROL_PITCH], 0, dt);
+	}
+	rateSetpoint[CONTROL_YAW] = yawRateSetpoint;
+	angleUpdates++;
+}
+
+void AttitudeController::updateRates(const gyroFIFOBatch& batch) {
+	int n = batch.count > GYRO_FIFO_SLOTS ? GYRO_FIFO_SLOTS : batch.count;
+	for(int i = 0; i < n; i++)
+		updateRates(batch.x[i], batch.y[i], batch.z[i], batch.timestamp[i]);
+}
@@ -0,0 +1,111 @@
+/*
+ * attitudeController.h
+ *	Cascaded stabilisation. The outer loop turns the attitude error from the AHRS quaternion
+ *	into body rate setpoints at the attitude rate. The inner loop holds those rates
+ *	with a PID per axis fed straight from the L3GD20: it runs for every sample in the gyro
+ *	FIFO, oldest first, using each sample's own timestamp, so it runs at the gyro data
+ *	rate whatever the flight loop rate is. Yaw has only the rate loop, a damper around the
+ *	yaw rate setpoint.
+ *
+ *	The attitude error is a quaternion, not Euler angle differences, so the loop has no trig
+ *	and no gimbal lock at +/-90 degrees of pitch. The roll/pitch setpoint is held as a tilt:
+ *	the rotation that leaves the heading alone (no component about the vertical). Each
+ *	update takes the measured heading, the twist of the AHRS quaternion about the vertical,
+ *	which is its w and z normalised, and applies the setpoint tilt after it. The error
+ *	quaternion from the measured attitude to that setpoint, in body axes, is turned into a
+ *	rotation vector by doubling its vector part (exact for small errors, and it eases off
+ *	smoothly past that), which the angle loops turn into roll and pitch rate setpoints.
+ *	Heading is never controlled, so the error has no part that fights the yaw damper.
+ *
+ *	Outputs are surface deflections in percent, +/- 100, for aircraftControls. Nothing here
+ *	allocates or blocks; a rate update is three PID updates.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef ATTITUDECONTROLLER_H_
+#define ATTITUDECONTROLLER_H_
+
+#include "pid.h"
+#include "../sensors/L3GD20Gyro.h"
+#include "../AHRS/imumaths.h"
+
+enum CONTROL_AXIS {
+	CONTROL_ROLL		= 0,	// Gyro X, body quaternion x
+	CONTROL_PITCH		= 1,	// Gyro Y, body quaternion y
+	CONTROL_YAW			= 2,	// Gyro Z
+	CONTROL_AXES		= 3,
+	CONTROL_ANGLE_AXES	= 2		// Roll and pitch have an angle loop
+};
+
+#define CONTROL_MAX_DT		0.1f	// s, longer gaps (first sample, stalls) hold the output
+
+struct attitudeControllerGains {
+	pidGains rate[CONTROL_AXES];			// deg/s in, percent deflection out
+	pidGains angle[CONTROL_ANGLE_AXES];		// degrees in, deg/s rate setpoint out
+};
+
+// A conservative starting point for a small fixed wing, to be tuned in flight
+void attitude_controller_default_gains(attitudeControllerGains& g);
+
+class AttitudeController {
+
+private:
+
+	PIDController rateLoop[CONTROL_AXES];
+	PIDController angleLoop[CONTROL_ANGLE_AXES];
+	float tiltSetpoint[4];				// w, x, y, z: roll and pitch as a rotation with no heading part
+	float attitudeError[CONTROL_AXES];	// degrees, body axes
+	float rateSetpoint[CONTROL_AXES];	// deg/s
+	float yawRateSetpoint;
+	unsigned long lastRateMicros;
+	unsigned long lastAngleMicros;
+	bool rateStarted;
+	bool angleStarted;
+	unsigned long rateUpdates;
+	unsigned long angleUpdates;
+
+	static float secondsSince(unsigned long micros, unsigned long last) {
+		float dt = (long)(micros - last) * 1e-6f;
+		return dt > CONTROL_MAX_DT ? 0 : dt;	// Negative too, update() holds on dt <= 0
+	}
+
+public:
+
+	AttitudeController();
+
+	void setGains(const attitudeControllerGains& g);
+	void reset();	// Clears integrals and filters, e.g. when stabilisation is switched on
+
+	void setAttitude(float rollDegrees, float pitchDegrees);	// The only trig, once per setpoint change
+	void setYawRate(float degreesPerSecond) { yawRateSetpoint = degreesPerSecond; }
+
+	// Outer loop, after the AHRS update, with uimu_ahrs_get_quaternion()
+	void updateAttitude(const imu::Quaternion& attitude, unsigned long micros);
+
+	// Inner loop, one gyro sample in deg/s
+	void updateRates(float x, float y, float z, unsigned long micros) {
+		float dt = rateStarted ? secondsSince(micros, lastRateMicros) : 0;
+		lastRateMicros = micros;
+		rateStarted = true;
+		rateLoop[CONTROL_ROLL].update(rateSetpoint[CONTROL_ROLL], x, dt);
+		rateLoop[CONTROL_PITCH].update(rateSetpoint[CONTROL_PITCH], y, dt);
+		rateLoop[CONTROL_YAW].update(rateSetpoint[CONTROL_YAW], z, dt);
+		rateUpdates++;
+	}
+
+	// Inner loop over every sample of a FIFO read
+	void updateRates(const gyroFIFOBatch& batch);
+
+	float getRoll() { return rateLoop[CONTROL_ROLL].getOutput(); }		// percent
+	float getPitch() { return rateLoop[CONTROL_PITCH].getOutput(); }
+	float getYaw() { return rateLoop[CONTROL_YAW].getOutput(); }
+	float getRateSetpoint(CONTROL_AXIS axis) { return rateSetpoint[axis]; }
+	float getAttitudeError(CONTROL_AXIS axis) { return attitudeError[axis]; }	// degrees
+	PIDController& getRateLoop(CONTROL_AXIS axis) { return rateLoop[axis]; }
+	unsigned long getRateUpdates() { return rateUpdates; }
+	unsigned long getAngleUpdates() { return angleUpdates; }
+};
+
+#endif /* ATTITUDECONTROLLER_H_ */
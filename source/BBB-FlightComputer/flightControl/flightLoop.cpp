@@ -0,0 +1,202 @@
+/*
+ * flightLoop.cpp
+ *	The flight computer's rate group tasks, see flightLoop.h.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "flightLoop.h"
+#include "../realtime/latency.h"
+#include "../realtime/console.h"
+
+using namespace std;
+
+void flight_print_status(const void* block, ostream& out) {
+	const flightStatus& s = *(const flightStatus*)block;
+	out << "##################################\n";
+
+	out << "Magnetism X:\t" << s.mag[0] << " gauss\n";
+	out << "Magnetism Y:\t" << s.mag[1] << " gauss\n";
+	out << "Magnetism Z:\t" << s.mag[2] << " gauss\n\n";
+
+	out << "Accel X:\t" << s.accel[0] << " g\n";
+	out << "Accel Y:\t" << s.accel[1] << " g\n";
+	out << "Accel Z:\t" << s.accel[2] << " g\n\n";
+
+	out << "Pitch:\t" << s.pitch << "\u00b0\n";
+	out << "Roll:\t" << s.roll << "\u00b0\n\n";
+
+	out << "Pitch command:\t" << s.pitchCommand << "% at " << s.pitchRateSetpoint << " \u00b0/s\n";
+	out << "Roll command:\t" << s.rollCommand << "% at " << s.rollRateSetpoint << " \u00b0/s\n\n";
+
+	out << "Core temperature:\t" << s.temperature << "\u00b0C\n\n";
+
+	out << "Pressure:\t" << s.pressure << " mBar\n";
+	out << "Altitude:\t" << s.altitude << " m, climbing " << s.climbRate << " m/s\n\n";
+
+	out << "Roll X:\t" << s.gyro[0] << " \u00b0/s\n";
+	out << "Roll Y:\t" << s.gyro[1] << " \u00b0/s\n";
+	out << "Roll Z:\t" << s.gyro[2] << " \u00b0/s\n";
+
+	out << "AHRS:\t" << s.euler[0] << " " << s.euler[1] << " " << s.euler[2] << " \u00b0\n";
+	out << "INS:\t" << s.velocity[0] << " " << s.velocity[1] << " " << s.velocity[2] << " m/s at "
+			<< s.position[0] << " " << s.position[1] << " " << s.position[2] << " m\n";
+
+	if(s.logging)
+		out << "Log:\t" << s.logBytesPerSecond / 1024 << " KiB/s, " << s.logDropped << " dropped\n";
+}
+
+static void taskAccelMag(void* context) {
+	flightTasks& f = *(flightTasks*)context;
+	f.lms303->readFullSensorState();
+	f.accelNew |= f.lms303->isAccelNew();
+	f.magNew |= f.lms303->isMagNew();
+	if(f.lms303->isAccelNew())
+		f.ins.pushAccel(f.lms303->getAccelBatch());
+	if(f.imuStream->isOpen() && f.lms303->isAccelNew())
+		f.imuStream->write(IMU_STREAM_ACCEL, f.logCycle, (uint32_t)micros(), f.rawSamples,
+				f.lms303->getRawFIFO(f.rawSamples));
+}
+
+static void taskGyro(void* context) {
+	flightTasks& f = *(flightTasks*)context;
+	{
+		LATENCY_SCOPE("gyro sensor");
+		f.gyro->readFullSensorState();
+	}
+	{
+		LATENCY_SCOPE("gyro ahrs");
+		uimu_ahrs_iterate_batch(f.gyro->getFIFOBatch(), f.lms303->read_acc(), f.lms303->read_mag(),
+				f.accelNew, f.magNew);
+		f.accelNew = f.magNew = false;
+	}
+	{
+		LATENCY_SCOPE("gyro ins");
+		unsigned long batches = f.ins.solution().batches;
+		f.ins.integrate(f.gyro->getFIFOBatch());
+		const insSolution& nav = f.ins.solution();
+		if(nav.batches != batches)
+			f.vertical.predict((float)(nav.specificForce[2] - INS_GRAVITY), (float)nav.interval);
+	}
+	{
+		LATENCY_SCOPE("gyro rate loop");
+		if(f.gyro->getFIFOBatch().count > 0)	// Empty after a sync loss or with nothing new, hold the last output
+			f.controller->updateRates(f.gyro->getFIFOBatch());
+	}
+	if(f.imuStream->isOpen() && f.gyro->isGyroNew())
+		f.imuStream->write(IMU_STREAM_GYRO, f.logCycle, (uint32_t)micros(), f.rawSamples,
+				f.gyro->getRawFIFO(f.rawSamples));
+}
+
+static void taskAttitude(void* context) {
+	flightTasks& f = *(flightTasks*)context;
+	f.controller->updateAttitude(uimu_ahrs_get_quaternion(), micros());
+}
+
+// The lower rate navigation output. The INS attitude is slaved to the AHRS's, which is
+// corrected by accel and mag, before its drift can leak gravity into the velocity
+static void taskNavigation(void* context) {
+	flightTasks& f = *(flightTasks*)context;
+	f.ins.setAttitude(uimu_ahrs_get_imu_quaternion());
+	f.navigation = f.ins.solution();
+}
+
+static void taskMixer(void* context) {
+	flightTasks& f = *(flightTasks*)context;
+	f.aircraft->setPitchAndRoll(f.controller->getPitch(), f.controller->getRoll());
+	// Yaw isn't driven: the rudder shares its PWM pin with the right elevon
+}
+
+static void taskBaro(void* context) {
+	flightTasks& f = *(flightTasks*)context;
+	f.alt->readFullSensorState();
+	if(f.alt->isPressureNew())
+		f.vertical.correct(f.alt->getAltitude());
+}
+
+static void taskRecorder(void* context) {
+	flightTasks& f = *(flightTasks*)context;
+	if(!f.recorder->isOpen())
+		return;
+	flightRecord record;
+	flight_log_capture(record, f.logCycle++, *f.lms303, *f.gyro, *f.alt, f.aircraft);
+	uint64_t longest = f.executive->takeLongestFrame() / 1000;
+	record.frameMicros = longest > 0xFFFF ? 0xFFFF : (uint16_t)longest;
+	RTLoop& loop = f.executive->getLoop();
+	if(loop.getOverruns() != f.overruns) record.flags |= FLIGHT_RECORD_OVERRUN;
+	f.overruns = loop.getOverruns();
+	f.recorder->record(record);
+}
+
+static void taskTelemetry(void* context) {
+	flightTasks& f = *(flightTasks*)context;
+	const imu::Vector<3>& euler = uimu_ahrs_get_euler();
+	flightStatus status;
+	status.mag[0] = f.lms303->getMagX();
+	status.mag[1] = f.lms303->getMagY();
+	status.mag[2] = f.lms303->getMagZ();
+	status.accel[0] = f.lms303->getAccelX();
+	status.accel[1] = f.lms303->getAccelY();
+	status.accel[2] = f.lms303->getAccelZ();
+	status.gyro[0] = f.gyro->getGyroX();
+	status.gyro[1] = f.gyro->getGyroY();
+	status.gyro[2] = f.gyro->getGyroZ();
+	status.euler[0] = euler.x();
+	status.euler[1] = euler.y();
+	status.euler[2] = euler.z();
+	status.pitch = euler.y();
+	status.roll = euler.z();
+	status.pitchCommand = f.aircraft->getPitch();
+	status.rollCommand = f.aircraft->getRoll();
+	status.pitchRateSetpoint = f.controller->getRateSetpoint(CONTROL_PITCH);
+	status.rollRateSetpoint = f.controller->getRateSetpoint(CONTROL_ROLL);
+	status.temperature = f.lms303->getTemperature();
+	status.pressure = f.alt->getPressure();
+	status.altitude = f.vertical.getAltitude();
+	status.climbRate = f.vertical.getClimbRate();
+	for(int k = 0; k < 3; k++) {
+		status.velocity[k] = f.navigation.velocity[k];
+		status.position[k] = f.navigation.position[k];
+	}
+	status.logging = f.recorder->isOpen();
+	status.logBytesPerSecond = f.recorder->getBytesPerSecond();
+	status.logDropped = f.recorder->getDropped();
+	console_publish_status(&status, sizeof(status));
+}
+
+void flight_tasks_init(flightTasks& f, LMS303& lms303, LPS331Altimeter& alt, L3GD20Gyro& gyro,
+		aircraftControls& aircraft, AttitudeController& controller, FlightRecorder& recorder,
+		ImuStreamWriter& imuStream, RateGroupExecutive& executive) {
+	f.lms303 = &lms303;
+	f.alt = &alt;
+	f.gyro = &gyro;
+	f.aircraft = &aircraft;
+	f.controller = &controller;
+	f.recorder = &recorder;
+	f.imuStream = &imuStream;
+	f.executive = &executive;
+	f.accelNew = f.magNew = false;
+	uimu_ahrs_set_airspeed(FLIGHT_CRUISE_AIRSPEED);
+	f.ins.align(uimu_ahrs_get_imu_quaternion(), micros());	// The AHRS is initialised by now
+	f.navigation = f.ins.solution();
+	f.vertical.reset(alt.getAltitude());
+	f.logCycle = 0;
+	f.overruns = 0;
+}
+
+int flight_tasks_add(flightTasks& f) {
+	RateGroupExecutive& e = *f.executive;
+	float base = e.getBaseRate();
+	int failed = 0;
+	//                  name          rate Hz               task             budget us
+	failed += e.addTask("accel mag",   FLIGHT_LOOP_HZ,       taskAccelMag,    &f, 1500) < 0;
+	failed += e.addTask("gyro",        base,                 taskGyro,        &f, 4000, RATE_TASK_CRITICAL) < 0;
+	failed += e.addTask("attitude",    FLIGHT_LOOP_HZ,       taskAttitude,    &f, 50) < 0;
+	failed += e.addTask("navigation",  FLIGHT_LOOP_HZ,       taskNavigation,  &f, 50) < 0;
+	failed += e.addTask("mixer",       base,                 taskMixer,       &f, 300) < 0;
+	failed += e.addTask("baro",        FLIGHT_BARO_HZ,       taskBaro,        &f, 1000) < 0;
+	failed += e.addTask("recorder",    FLIGHT_LOOP_HZ,       taskRecorder,    &f, 100) < 0;
+	failed += e.addTask("telemetry",   FLIGHT_TELEMETRY_HZ,  taskTelemetry,   &f, 100) < 0;
+	return failed;
+}
@@ -0,0 +1,82 @@
+/*
+ * flightLoop.h
+ *	The flight computer's tasks, as rate group tasks: sensing, estimation, control, logging
+ *	and telemetry. main.cpp runs them against the hardware and main-sitl against the
+ *	simulator, so both fly the same code. Tasks share their state through flightTasks and
+ *	all run on the executive's thread.
+ *
+ *	Rates: the gyro FIFO, AHRS, strapdown INS, vertical channel, rate loop and mixer run at
+ *	the base rate, accel/mag, the attitude loop, the navigation output and the flight log at
+ *	FLIGHT_LOOP_HZ, baro at FLIGHT_BARO_HZ and the status snapshot at FLIGHT_TELEMETRY_HZ, so
+ *	the base rate must be a multiple of FLIGHT_LOOP_HZ. Every gyro sample still reaches the
+ *	rate loop through the FIFO.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef FLIGHTLOOP_H_
+#define FLIGHTLOOP_H_
+
+#include "../BBB-FlightComputer.h"
+#include "../realtime/rateGroups.h"
+#include "../logging/flightRecorder.h"
+#include "../logging/imuStream.h"
+#include "../navigation/strapdown.h"
+#include "../navigation/verticalChannel.h"
+
+#define FLIGHT_GYRO_RATE_HZ		100		// Default base rate
+#define FLIGHT_LOOP_HZ			50		// Accel/mag, attitude loop, navigation output and flight log
+#define FLIGHT_BARO_HZ			25		// The LPS331's output rate
+#define FLIGHT_TELEMETRY_HZ		10
+#define FLIGHT_CRUISE_AIRSPEED	18		// m/s, what the AHRS takes turns to be flown at, there's no pitot
+#define FLIGHT_GYRO_ZERO_READS	50		// FIFO drains averaged for the gyro zero rate before launch, 1 s
+#define FLIGHT_AHRS_BETA		0.03f	// Madgwick. Airspeed changes read as tilt too, so lean on the calibrated gyro
+
+struct flightStatus {	// Snapshot for the console printer thread
+	float mag[3];		// gauss
+	float accel[3];		// g
+	float gyro[3];		// deg/s
+	float euler[3];		// AHRS heading, pitch, roll
+	float pitch, roll;	// AHRS, as stabilised
+	float pitchCommand, rollCommand;	// percent
+	float pitchRateSetpoint, rollRateSetpoint;	// deg/s
+	int temperature;
+	float pressure;
+	float altitude, climbRate;	// Vertical channel, m and m/s
+	float velocity[3];	// INS, m/s north, west, up
+	float position[3];	// INS, m from the start
+	bool logging;
+	float logBytesPerSecond;
+	unsigned long logDropped;
+};
+
+// Formatter for console_start()
+void flight_print_status(const void* status, std::ostream& out);
+
+struct flightTasks {	// State the rate group tasks share, all on the flight loop thread
+	LMS303* lms303;
+	LPS331Altimeter* alt;
+	L3GD20Gyro* gyro;
+	aircraftControls* aircraft;
+	AttitudeController* controller;
+	FlightRecorder* recorder;
+	ImuStreamWriter* imuStream;
+	RateGroupExecutive* executive;
+	bool accelNew, magNew;	// Latched by the accel/mag task until the AHRS has seen them
+	StrapdownINS ins;		// Integrated every gyro batch
+	insSolution navigation;	// Its output, taken at FLIGHT_LOOP_HZ
+	VerticalChannel vertical;	// Its vertical acceleration every batch, and the baro
+	uint16_t logCycle;	// Of the next flight record, the IMU stream's frames carry it too
+	unsigned long overruns;
+	int16_t rawSamples[IMU_STREAM_MAX_SAMPLES][IMU_STREAM_AXES];
+};
+
+void flight_tasks_init(flightTasks& f, LMS303& lms303, LPS331Altimeter& alt, L3GD20Gyro& gyro,
+		aircraftControls& aircraft, AttitudeController& controller, FlightRecorder& recorder,
+		ImuStreamWriter& imuStream, RateGroupExecutive& executive);
+
+// Adds the tasks to f's executive at its base rate. Non-zero if any didn't fit
+int flight_tasks_add(flightTasks& f);
+
+#endif /* FLIGHTLOOP_H_ */
@@ -0,0 +1,94 @@
+/*
+ * pid.h
+ *	PID controller for the stabilisation loops. update() is inline, allocation free and
+ *	branch light so the rate loop can run it for every gyro FIFO sample.
+ *
+ *	The derivative acts on the measurement, not the error, so setpoint steps from the outer
+ *	loop don't kick the output, and is low pass filtered (first order, derivativeHz) since
+ *	differentiating gyro noise at several hundred Hz would otherwise swamp it. Anti-windup
+ *	is conditional integration: the integral only grows while the output isn't saturated,
+ *	or while the error would pull it back out of saturation, and is also clamped to
+ *	integralLimit so a long saturated stretch can't store up an overshoot.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef PID_H_
+#define PID_H_
+
+#include <math.h>
+
+struct pidGains {
+	float kp;
+	float ki;				// Per second
+	float kd;				// Seconds
+	float derivativeHz;		// Derivative low pass cutoff, 0 for unfiltered
+	float integralLimit;	// Largest contribution of the integral term to the output
+	float outputLimit;		// Output is clamped to +/- this
+};
+
+class PIDController {
+
+private:
+
+	pidGains gains;
+	float tau;				// Derivative filter time constant, seconds
+	float integral;			// Already multiplied by ki, in output units
+	float derivative;		// Filtered rate of change of the measurement
+	float lastMeasurement;
+	float output;
+	bool primed;			// lastMeasurement is valid
+
+	static float clamp(float value, float limit) {
+		return value > limit ? limit : (value < -limit ? -limit : value);
+	}
+
+public:
+
+	PIDController() {
+		pidGains none = { 0, 0, 0, 0, 0, 0 };
+		setGains(none);
+	}
+
+	void setGains(const pidGains& g) {
+		gains = g;
+		tau = g.derivativeHz > 0 ? 1.0f / (2.0f * (float)M_PI * g.derivativeHz) : 0;
+		reset();
+	}
+	const pidGains& getGains() { return gains; }
+
+	void reset() {
+		integral = 0;
+		derivative = 0;
+		lastMeasurement = 0;
+		output = 0;
+		primed = false;
+	}
+
+	float update(float setpoint, float measurement, float dt) {
+		if(!(dt > 0))	// Also NaN: hold the last output
+			return output;
+		float error = setpoint - measurement;
+
+		if(primed) {
+			float rate = (measurement - lastMeasurement) / dt;
+			derivative += dt / (dt + tau) * (rate - derivative);	// tau 0 is no filtering
+		}
+		lastMeasurement = measurement;
+		primed = true;
+
+		float unclamped = gains.kp * error + integral - gains.kd * derivative;
+		bool saturated = unclamped > gains.outputLimit || unclamped < -gains.outputLimit;
+		if(!saturated || (unclamped > 0) != (error > 0))
+			integral = clamp(integral + gains.ki * error * dt, gains.integralLimit);
+
+		output = clamp(gains.kp * error + integral - gains.kd * derivative, gains.outputLimit);
+		return output;
+	}
+
+	float getOutput() { return output; }
+	float getIntegral() { return integral; }
+};
+
+#endif /* PID_H_ */
@@ -0,0 +1,72 @@
+/*
+ * flightLog.cpp
+ *	Packing the flight loop's state into flight data recorder records.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "flightLog.h"
+#include "../BBB-FlightComputer.h"
+
+static uint16_t pwmCount(PWMChannel& channel) {
+	unsigned long duty = channel.getDuty() / FLIGHT_LOG_PWM_LSB;
+	return duty > 0xFFFF ? 0xFFFF : (uint16_t)duty;
+}
+
+static int8_t percent(float value) {
+	if(!(value > -128.0f)) return -128;	// Also NaN
+	if(value > 127.0f) return 127;
+	return (int8_t)lrintf(value);
+}
+
+void flight_log_capture(flightRecord& r, uint16_t cycle, LMS303& lms303, L3GD20Gyro& gyro,
+		LPS331Altimeter& alt, aircraftControls* aircraft) {
+	memset(&r, 0, sizeof(r));
+	r.micros = (uint32_t)micros();
+	r.cycle = cycle;
+	r.flags = FLIGHT_RECORD_VALID;
+	if(lms303.isAccelNew()) r.flags |= FLIGHT_RECORD_ACCEL_NEW;
+	if(lms303.isMagNew()) r.flags |= FLIGHT_RECORD_MAG_NEW;
+	if(gyro.isGyroNew()) r.flags |= FLIGHT_RECORD_GYRO_NEW;
+	if(lms303.isSyncLost()) r.lostSync |= FLIGHT_SYNC_LMS303;
+	if(gyro.isSyncLost()) r.lostSync |= FLIGHT_SYNC_GYRO;
+	if(alt.isSyncLost()) r.lostSync |= FLIGHT_SYNC_ALTIMETER;
+	if(r.lostSync) r.flags |= FLIGHT_RECORD_LOST_SYNC;
+
+	int samples = gyro.getFIFOBatch().count;
+	r.gyroSamples = samples > 255 ? 255 : samples;
+
+	r.accel[0] = flight_log_fixed(lms303.getAccelX(), FLIGHT_LOG_ACCEL_LSB);
+	r.accel[1] = flight_log_fixed(lms303.getAccelY(), FLIGHT_LOG_ACCEL_LSB);
+	r.accel[2] = flight_log_fixed(lms303.getAccelZ(), FLIGHT_LOG_ACCEL_LSB);
+	r.mag[0] = flight_log_fixed(lms303.getMagX(), FLIGHT_LOG_MAG_LSB);
+	r.mag[1] = flight_log_fixed(lms303.getMagY(), FLIGHT_LOG_MAG_LSB);
+	r.mag[2] = flight_log_fixed(lms303.getMagZ(), FLIGHT_LOG_MAG_LSB);
+	r.gyro[0] = flight_log_fixed(gyro.getGyroX(), FLIGHT_LOG_GYRO_LSB);
+	r.gyro[1] = flight_log_fixed(gyro.getGyroY(), FLIGHT_LOG_GYRO_LSB);
+	r.gyro[2] = flight_log_fixed(gyro.getGyroZ(), FLIGHT_LOG_GYRO_LSB);
+
+	const imu::Quaternion& q = uimu_ahrs_get_quaternion();
+	r.attitude[0] = flight_log_fixed(q.w(), FLIGHT_LOG_QUAT_LSB);
+	r.attitude[1] = flight_log_fixed(q.x(), FLIGHT_LOG_QUAT_LSB);
+	r.attitude[2] = flight_log_fixed(q.y(), FLIGHT_LOG_QUAT_LSB);
+	r.attitude[3] = flight_log_fixed(q.z(), FLIGHT_LOG_QUAT_LSB);
+
+	r.pressure = (int32_t)lrintf(alt.getPressure() / FLIGHT_LOG_PRESSURE_LSB);
+	r.altitude = flight_log_fixed(alt.getAltitude(), FLIGHT_LOG_ALTITUDE_LSB);
+	r.temperature = lms303.getTemperature();
+
+	if(aircraft) {
+		r.demand[0] = percent(aircraft->getThrottle());
+		r.demand[1] = percent(aircraft->getPitch());
+		r.demand[2] = percent(aircraft->getRoll());
+		r.demand[3] = percent(aircraft->getYaw());
+		r.pwm[0] = pwmCount(aircraft->throttleChannel);
+		r.pwm[1] = pwmCount(aircraft->elevatorChannel);
+		r.pwm[2] = pwmCount(aircraft->aileronChannel);
+		r.pwm[3] = pwmCount(aircraft->leftElevonChannel);
+		r.pwm[4] = pwmCount(aircraft->rightElevonChannel);
+		r.pwm[5] = pwmCount(aircraft->rudderChannel);
+	}
+}
@@ -0,0 +1,100 @@
+/*
+ * flightLog.h
+ *	On-disk format of the flight data recorder. A log is one header block followed by one
+ *	fixed 64 byte flightRecord per flight loop cycle, host byte order. Records are fixed
+ *	point engineering units so they stay compact and compress losslessly as int16.
+ *
+ *	The recorder preallocates the file, so a log cut short by a crash or power loss ends
+ *	in zeroed space. Every written record has FLIGHT_RECORD_VALID set, so the first record
+ *	without it marks the end of the flight.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef FLIGHTLOG_H_
+#define FLIGHTLOG_H_
+
+#include <stdint.h>
+#include <math.h>
+
+#define FLIGHT_LOG_MAGIC		"FLTLOG1"
+#define FLIGHT_LOG_VERSION		1
+#define FLIGHT_LOG_BLOCK		4096	// Header size and write alignment
+
+// Record units
+#define FLIGHT_LOG_ACCEL_LSB	0.001f			// g
+#define FLIGHT_LOG_MAG_LSB		0.001f			// gauss
+#define FLIGHT_LOG_GYRO_LSB		0.0625f			// deg/s
+#define FLIGHT_LOG_QUAT_LSB		(1.0f / 32767)	// Q15
+#define FLIGHT_LOG_PRESSURE_LSB	(1.0f / 4096)	// mbar, the LPS331's own resolution
+#define FLIGHT_LOG_ALTITUDE_LSB	0.1f			// m
+#define FLIGHT_LOG_PWM_LSB		1000			// ns of PWM duty per count (microseconds)
+
+// flightRecord flags
+#define FLIGHT_RECORD_VALID		0x01
+#define FLIGHT_RECORD_ACCEL_NEW	0x02
+#define FLIGHT_RECORD_MAG_NEW	0x04
+#define FLIGHT_RECORD_GYRO_NEW	0x08
+#define FLIGHT_RECORD_OVERRUN	0x10	// The cycle before this one ran past its deadline
+#define FLIGHT_RECORD_LOST_SYNC	0x20	// A sensor read failed its WHO_AM_I check, see lostSync
+
+// flightRecord lostSync
+#define FLIGHT_SYNC_LMS303		0x01
+#define FLIGHT_SYNC_GYRO		0x02
+#define FLIGHT_SYNC_ALTIMETER	0x04
+
+#define FLIGHT_LOG_DEMANDS		4		// throttle, pitch, roll, yaw
+#define FLIGHT_LOG_PWM_CHANNELS	6		// throttle, elevator, aileron, left/right elevon, rudder
+
+struct flightLogHeader {	// Start of the first FLIGHT_LOG_BLOCK, the rest of it is zero
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;		// Records start at this offset
+	uint32_t recordSize;
+	float rateHz;				// Flight loop rate, one record per cycle (0 if unknown, e.g. replays)
+	uint32_t startMicros;		// micros() when the log was opened
+	uint32_t reserved;
+	uint64_t startUnixMicros;	// Wall clock at the same moment
+};
+
+struct flightRecord {
+	uint32_t micros;		// Wraps every ~71 minutes, like micros()
+	int32_t pressure;		// FLIGHT_LOG_PRESSURE_LSB
+	uint16_t cycle;			// Record number, gaps are records the recorder dropped
+	uint8_t flags;
+	uint8_t gyroSamples;	// Gyro FIFO samples behind this cycle's rates
+	int16_t accel[3];		// FLIGHT_LOG_ACCEL_LSB
+	int16_t mag[3];			// FLIGHT_LOG_MAG_LSB
+	int16_t gyro[3];		// FLIGHT_LOG_GYRO_LSB, FIFO average
+	int16_t attitude[4];	// AHRS quaternion w, x, y, z, FLIGHT_LOG_QUAT_LSB
+	int16_t temperature;	// deg C
+	int16_t altitude;		// FLIGHT_LOG_ALTITUDE_LSB
+	int8_t demand[FLIGHT_LOG_DEMANDS];		// percent
+	uint16_t pwm[FLIGHT_LOG_PWM_CHANNELS];	// Servo duty, FLIGHT_LOG_PWM_LSB
+	uint8_t lostSync;		// FLIGHT_SYNC_* of the sensors whose read failed this cycle
+	uint8_t reserved[3];
+	uint16_t frameMicros;	// Longest rate group frame since the last record, wake to its last task
+};
+
+typedef char flightRecordSizeCheck[sizeof(flightRecord) == 64 ? 1 : -1];	// Blocks hold whole records
+typedef char flightLogHeaderSizeCheck[sizeof(flightLogHeader) <= FLIGHT_LOG_BLOCK ? 1 : -1];
+
+inline int16_t flight_log_fixed(float value, float lsb) {	// Rounded and saturated
+	float scaled = value / lsb;
+	if(!(scaled > -32768.0f)) return -32768;	// Also NaN
+	if(scaled > 32767.0f) return 32767;
+	return (int16_t)lrintf(scaled);
+}
+
+class LMS303;
+class L3GD20Gyro;
+class LPS331Altimeter;
+class aircraftControls;
+
+// Fills r from the drivers' last readFullSensorState() and the AHRS. aircraft may be NULL
+// (replay, bench runs), leaving the demands and PWM outputs zero.
+void flight_log_capture(flightRecord& r, uint16_t cycle, LMS303& lms303, L3GD20Gyro& gyro,
+		LPS331Altimeter& alt, aircraftControls* aircraft);
+
+#endif /* FLIGHTLOG_H_ */
@@ -0,0 +1,331 @@
+/*
+ * flightLogReader.cpp
+ *	Memory mapped flight log reader, its sidecar index and CSV export.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "flightLogReader.h"
+#include "../AHRS/imumaths.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+struct channelName {
+	const char* name;
+	unsigned channel;
+};
+
+static const channelName channelNames[] = {
+	{ "time", FLIGHT_CHANNEL_TIME },
+	{ "accel", FLIGHT_CHANNEL_ACCEL },
+	{ "mag", FLIGHT_CHANNEL_MAG },
+	{ "gyro", FLIGHT_CHANNEL_GYRO },
+	{ "attitude", FLIGHT_CHANNEL_ATTITUDE },
+	{ "euler", FLIGHT_CHANNEL_EULER },
+	{ "baro", FLIGHT_CHANNEL_BARO },
+	{ "demand", FLIGHT_CHANNEL_DEMAND },
+	{ "pwm", FLIGHT_CHANNEL_PWM },
+	{ "all", FLIGHT_CHANNEL_ALL }
+};
+
+FlightLog::FlightLog() {
+	fd = -1;
+	map = NULL;
+	mapSize = 0;
+	header = NULL;
+	records = NULL;
+	count = 0;
+	indexLoaded = false;
+}
+
+int FlightLog::open(const char* path, bool useSidecar) {
+	close();
+
+	fd = ::open(path, O_RDONLY);
+	if(fd < 0) {
+		cout << "Failed to open flight log " << path << endl;
+		return 1;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size < FLIGHT_LOG_BLOCK) {
+		cout << path << " is too short to be a flight log" << endl;
+		close();
+		return 2;
+	}
+
+	mapSize = st.st_size;
+	void* m = mmap(NULL, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+	if(m == MAP_FAILED) {
+		cout << "Failed to map flight log " << path << endl;
+		map = NULL;
+		close();
+		return 3;
+	}
+	map = (const char*)m;
+	madvise(m, mapSize, MADV_RANDOM);	// Seeks touch a page here and there, don't read around them
+
+	header = (const flightLogHeader*)map;
+	if(memcmp(header->magic, FLIGHT_LOG_MAGIC, sizeof(header->magic)) != 0 ||
+			header->recordSize != sizeof(flightRecord) || header->headerSize < sizeof(flightLogHeader) ||
+			header->headerSize > mapSize) {
+		cout << path << " is not a version " << FLIGHT_LOG_VERSION << " flight log" << endl;
+		close();
+		return 4;
+	}
+	records = (const flightRecord*)(map + header->headerSize);
+	count = findEnd((mapSize - header->headerSize) / sizeof(flightRecord));
+
+	string indexPath = string(path) + FLIGHT_LOG_INDEX_SUFFIX;
+	indexLoaded = useSidecar && loadIndex(indexPath.c_str()) == 0;
+	if(!indexLoaded) {
+		buildIndex();
+		if(useSidecar) saveIndex(indexPath.c_str());
+	}
+	return 0;
+}
+
+void FlightLog::close() {
+	if(map) munmap((void*)map, mapSize);
+	if(fd >= 0) ::close(fd);
+	fd = -1;
+	map = NULL;
+	mapSize = 0;
+	header = NULL;
+	records = NULL;
+	count = 0;
+	index.clear();
+	indexLoaded = false;
+}
+
+// Written records are valid and the preallocated space after them is zero, so the end of
+// a log that was never closed (power loss) can be found by bisection.
+size_t FlightLog::findEnd(size_t slots) {
+	size_t low = 0, high = slots;
+	while(low < high) {
+		size_t middle = low + (high - low) / 2;
+		if(records[middle].flags & FLIGHT_RECORD_VALID) low = middle + 1;
+		else high = middle;
+	}
+	return low;
+}
+
+int FlightLog::loadIndex(const char* path) {
+	FILE* f = fopen(path, "rb");
+	if(f == NULL)
+		return 1;
+
+	flightLogIndexHeader h;
+	size_t entries = (count + FLIGHT_LOG_INDEX_STRIDE - 1) / FLIGHT_LOG_INDEX_STRIDE;
+	if(fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, FLIGHT_LOG_INDEX_MAGIC, sizeof(h.magic)) != 0 ||
+			h.logSize != mapSize || h.records != count || h.stride != FLIGHT_LOG_INDEX_STRIDE || h.entries != entries) {
+		fclose(f);
+		return 2;	// Stale, the log has grown or been rewritten since
+	}
+	index.resize(entries);
+	size_t got = entries ? fread(&index[0], sizeof(uint64_t), entries, f) : 0;
+	fclose(f);
+	if(got != entries) {
+		index.clear();
+		return 3;
+	}
+	return 0;
+}
+
+void FlightLog::buildIndex() {
+	size_t entries = (count + FLIGHT_LOG_INDEX_STRIDE - 1) / FLIGHT_LOG_INDEX_STRIDE;
+	index.resize(entries);
+	if(entries == 0)
+		return;
+
+	// Consecutive entries are far less than a micros() wrap apart, so the unsigned
+	// difference of their raw micros is the time between them
+	uint64_t t = records[0].micros;
+	uint32_t previous = records[0].micros;
+	for(size_t k = 0; k < entries; k++) {
+		uint32_t m = records[k * FLIGHT_LOG_INDEX_STRIDE].micros;
+		t += (uint32_t)(m - previous);
+		previous = m;
+		index[k] = t;
+	}
+}
+
+void FlightLog::saveIndex(const char* path) {
+	string temporary = string(path) + ".tmp";
+	FILE* f = fopen(temporary.c_str(), "wb");
+	if(f == NULL)
+		return;	// Read only directory etc., it just gets rebuilt next time
+
+	flightLogIndexHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, FLIGHT_LOG_INDEX_MAGIC, sizeof(h.magic));
+	h.logSize = mapSize;
+	h.records = count;
+	h.stride = FLIGHT_LOG_INDEX_STRIDE;
+	h.entries = index.size();
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+	if(ok && !index.empty())
+		ok = fwrite(&index[0], sizeof(uint64_t), index.size(), f) == index.size();
+	ok = fclose(f) == 0 && ok;
+
+	if(!ok || rename(temporary.c_str(), path) != 0)	// Readers never see half an index
+		unlink(temporary.c_str());
+}
+
+uint64_t FlightLog::timeOf(size_t i) {
+	size_t k = i / FLIGHT_LOG_INDEX_STRIDE;
+	return index[k] + (uint32_t)(records[i].micros - records[k * FLIGHT_LOG_INDEX_STRIDE].micros);
+}
+
+size_t FlightLog::seek(uint64_t relativeMicros) {
+	if(count == 0)
+		return FLIGHT_LOG_END;
+	uint64_t target = index[0] + relativeMicros;
+
+	// Last index entry at or before the target
+	size_t low = 0, high = index.size();
+	while(high - low > 1) {
+		size_t middle = low + (high - low) / 2;
+		if(index[middle] <= target) low = middle;
+		else high = middle;
+	}
+
+	// First record of that stride at or after the target
+	size_t first = low * FLIGHT_LOG_INDEX_STRIDE;
+	size_t last = first + FLIGHT_LOG_INDEX_STRIDE;
+	if(last > count) last = count;
+	while(first < last) {
+		size_t middle = first + (last - first) / 2;
+		if(timeOf(middle) < target) first = middle + 1;
+		else last = middle;
+	}
+	return first < count ? first : FLIGHT_LOG_END;
+}
+
+size_t FlightLog::next(size_t from, uint8_t flags) {
+	for(size_t i = from; i < count; i++)
+		if((records[i].flags & flags) == flags)
+			return i;
+	return FLIGHT_LOG_END;
+}
+
+void FlightLog::adviseSequential(size_t from, size_t to) {
+	if(to > count) to = count;
+	if(from >= to)
+		return;
+	long page = sysconf(_SC_PAGESIZE);
+	size_t start = header->headerSize + from * sizeof(flightRecord);
+	size_t end = header->headerSize + to * sizeof(flightRecord);
+	start -= start % page;
+	madvise((void*)(map + start), end - start, MADV_SEQUENTIAL);
+	madvise((void*)(map + start), end - start, MADV_WILLNEED);
+}
+
+FlightLog::~FlightLog() {
+	close();
+}
+
+int flight_log_parse_channels(const char* list, unsigned& channels) {
+	channels = 0;
+	string text = list;
+	size_t pos = 0;
+	while(pos <= text.size()) {
+		size_t comma = text.find(',', pos);
+		if(comma == string::npos) comma = text.size();
+		string name = text.substr(pos, comma - pos);
+		bool found = false;
+		for(size_t i = 0; i < sizeof(channelNames) / sizeof(channelNames[0]); i++) {
+			if(name == channelNames[i].name) {
+				channels |= channelNames[i].channel;
+				found = true;
+			}
+		}
+		if(!found) {
+			cout << "Unknown channel " << name << ", expected ";
+			for(size_t i = 0; i < sizeof(channelNames) / sizeof(channelNames[0]); i++)
+				cout << (i ? "," : "") << channelNames[i].name;
+			cout << endl;
+			return 1;
+		}
+		pos = comma + 1;
+	}
+	return channels == 0;
+}
+
+unsigned long flight_log_export_csv(FlightLog& log, size_t from, size_t to, unsigned channels,
+		uint8_t flags, FILE* out) {
+	if(to > log.size()) to = log.size();
+
+	const char* separator = "";
+	if(channels & FLIGHT_CHANNEL_TIME) { fprintf(out, "%stime,cycle,flags,frame_us", separator); separator = ","; }
+	if(channels & FLIGHT_CHANNEL_ACCEL) { fprintf(out, "%saccel_x,accel_y,accel_z", separator); separator = ","; }
+	if(channels & FLIGHT_CHANNEL_MAG) { fprintf(out, "%smag_x,mag_y,mag_z", separator); separator = ","; }
+	if(channels & FLIGHT_CHANNEL_GYRO) { fprintf(out, "%sgyro_x,gyro_y,gyro_z", separator); separator = ","; }
+	if(channels & FLIGHT_CHANNEL_ATTITUDE) { fprintf(out, "%sqw,qx,qy,qz", separator); separator = ","; }
+	if(channels & FLIGHT_CHANNEL_EULER) { fprintf(out, "%sheading,pitch,roll", separator); separator = ","; }
+	if(channels & FLIGHT_CHANNEL_BARO) { fprintf(out, "%spressure,altitude,temperature", separator); separator = ","; }
+	if(channels & FLIGHT_CHANNEL_DEMAND) { fprintf(out, "%sthrottle,pitch_demand,roll_demand,yaw_demand", separator); separator = ","; }
+	if(channels & FLIGHT_CHANNEL_PWM) { fprintf(out, "%spwm_throttle,pwm_elevator,pwm_aileron,pwm_left_elevon,pwm_right_elevon,pwm_rudder", separator); }
+	fprintf(out, "\n");
+
+	log.adviseSequential(from, to);
+	unsigned long rows = 0;
+	for(size_t i = log.next(from, flags); i < to; i = log.next(i + 1, flags), rows++) {
+		const flightRecord& r = log[i];
+		separator = "";
+		if(channels & FLIGHT_CHANNEL_TIME) {
+			fprintf(out, "%.6f,%u,%u,%u", log.relativeTime(i) / 1e6, r.cycle, r.flags, r.frameMicros);
+			separator = ",";
+		}
+		if(channels & FLIGHT_CHANNEL_ACCEL) {
+			fprintf(out, "%s%.3f,%.3f,%.3f", separator, r.accel[0] * FLIGHT_LOG_ACCEL_LSB,
+					r.accel[1] * FLIGHT_LOG_ACCEL_LSB, r.accel[2] * FLIGHT_LOG_ACCEL_LSB);
+			separator = ",";
+		}
+		if(channels & FLIGHT_CHANNEL_MAG) {
+			fprintf(out, "%s%.3f,%.3f,%.3f", separator, r.mag[0] * FLIGHT_LOG_MAG_LSB,
+					r.mag[1] * FLIGHT_LOG_MAG_LSB, r.mag[2] * FLIGHT_LOG_MAG_LSB);
+			separator = ",";
+		}
+		if(channels & FLIGHT_CHANNEL_GYRO) {
+			fprintf(out, "%s%.4f,%.4f,%.4f", separator, r.gyro[0] * FLIGHT_LOG_GYRO_LSB,
+					r.gyro[1] * FLIGHT_LOG_GYRO_LSB, r.gyro[2] * FLIGHT_LOG_GYRO_LSB);
+			separator = ",";
+		}
+		if(channels & (FLIGHT_CHANNEL_ATTITUDE | FLIGHT_CHANNEL_EULER)) {
+			imu::Quaternion q(r.attitude[0] * FLIGHT_LOG_QUAT_LSB, r.attitude[1] * FLIGHT_LOG_QUAT_LSB,
+					r.attitude[2] * FLIGHT_LOG_QUAT_LSB, r.attitude[3] * FLIGHT_LOG_QUAT_LSB);
+			if(channels & FLIGHT_CHANNEL_ATTITUDE) {
+				fprintf(out, "%s%.5f,%.5f,%.5f,%.5f", separator, q.w(), q.x(), q.y(), q.z());
+				separator = ",";
+			}
+			if(channels & FLIGHT_CHANNEL_EULER) {
+				imu::Vector<3> e = q.toEuler();
+				e.toDegrees();
+				fprintf(out, "%s%.3f,%.3f,%.3f", separator, e.x(), e.y(), e.z());
+				separator = ",";
+			}
+		}
+		if(channels & FLIGHT_CHANNEL_BARO) {
+			fprintf(out, "%s%.3f,%.1f,%d", separator, r.pressure * FLIGHT_LOG_PRESSURE_LSB,
+					r.altitude * FLIGHT_LOG_ALTITUDE_LSB, r.temperature);
+			separator = ",";
+		}
+		if(channels & FLIGHT_CHANNEL_DEMAND) {
+			fprintf(out, "%s%d,%d,%d,%d", separator, r.demand[0], r.demand[1], r.demand[2], r.demand[3]);
+			separator = ",";
+		}
+		if(channels & FLIGHT_CHANNEL_PWM) {
+			fprintf(out, "%s%u,%u,%u,%u,%u,%u", separator, r.pwm[0], r.pwm[1], r.pwm[2], r.pwm[3], r.pwm[4], r.pwm[5]);
+		}
+		fprintf(out, "\n");
+	}
+	return rows;
+}
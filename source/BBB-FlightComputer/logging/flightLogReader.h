@@ -0,0 +1,102 @@
+/*
+ * flightLogReader.h
+ *	Random access to flight data recorder logs. open() maps the log read-only and finds
+ *	its end, then loads the sidecar index (<log>.idx), or builds it and saves it for next
+ *	time. Records are returned as references into the mapping, never copied, so opening
+ *	a log costs the same few page touches whatever its size.
+ *
+ *	Record micros are the flight computer's 32 bit micros() and wrap. The index holds the
+ *	unwrapped time of every FLIGHT_LOG_INDEX_STRIDE'th record, which is enough to unwrap
+ *	any record's time from its index entry and to seek by time with two binary searches:
+ *	one over the index, one over the records of a single stride.
+ *
+ *	Every record is the same type. next() walks the records that carry a given set of
+ *	flags (new accel samples, new mag samples, overruns, ...) for per-sensor iteration.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef FLIGHTLOGREADER_H_
+#define FLIGHTLOGREADER_H_
+
+#include "flightLog.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <vector>
+
+#define FLIGHT_LOG_INDEX_MAGIC	"FLTIDX1"
+#define FLIGHT_LOG_INDEX_SUFFIX	".idx"
+#define FLIGHT_LOG_INDEX_STRIDE	1024	// Records per index entry, 64 KiB of log
+#define FLIGHT_LOG_END			((size_t)-1)
+
+// Channel groups for CSV export
+#define FLIGHT_CHANNEL_TIME			0x0001	// seconds since the start of the log, cycle, flags, frame time
+#define FLIGHT_CHANNEL_ACCEL		0x0002
+#define FLIGHT_CHANNEL_MAG			0x0004
+#define FLIGHT_CHANNEL_GYRO			0x0008
+#define FLIGHT_CHANNEL_ATTITUDE		0x0010	// Quaternion
+#define FLIGHT_CHANNEL_EULER		0x0020	// Heading, pitch, roll from the quaternion
+#define FLIGHT_CHANNEL_BARO			0x0040	// Pressure, altitude, temperature
+#define FLIGHT_CHANNEL_DEMAND		0x0080
+#define FLIGHT_CHANNEL_PWM			0x0100
+#define FLIGHT_CHANNEL_ALL			0x01FF
+
+struct flightLogIndexHeader {
+	char magic[8];
+	uint64_t logSize;		// Bytes of log the index was built from, a mismatch means rebuild
+	uint64_t records;
+	uint32_t stride;
+	uint32_t entries;		// uint64_t unwrapped micros follow, one per stride
+};
+
+class FlightLog {
+
+private:
+
+	int fd;
+	const char* map;
+	size_t mapSize;
+	const flightLogHeader* header;
+	const flightRecord* records;
+	size_t count;
+	std::vector<uint64_t> index;	// Unwrapped micros of records[i * FLIGHT_LOG_INDEX_STRIDE]
+	bool indexLoaded;				// From the sidecar rather than built
+
+	size_t findEnd(size_t slots);
+	int loadIndex(const char* path);
+	void buildIndex();
+	void saveIndex(const char* path);
+
+public:
+
+	FlightLog();
+
+	int open(const char* path, bool useSidecar = true);
+	void close();
+
+	const flightLogHeader& getHeader() { return *header; }
+	size_t size() { return count; }
+	const flightRecord& operator[](size_t i) { return records[i]; }
+	bool isIndexLoaded() { return indexLoaded; }
+
+	uint64_t timeOf(size_t i);				// Unwrapped micros of record i
+	uint64_t relativeTime(size_t i) { return timeOf(i) - timeOf(0); }
+	double getDuration() { return count ? relativeTime(count - 1) / 1e6 : 0; }	// seconds
+
+	size_t seek(uint64_t relativeMicros);	// First record at or after, FLIGHT_LOG_END if none
+	size_t next(size_t from, uint8_t flags);	// First record from 'from' on with all these flags
+
+	void adviseSequential(size_t from, size_t to);	// Read ahead over a range about to be walked
+
+	virtual ~FlightLog();
+};
+
+int flight_log_parse_channels(const char* list, unsigned& channels);	// "accel,gyro,euler" or "all"
+
+// Streams the records in [from, to) that carry all the given flags (0 for every record) to
+// out as CSV. Returns the number of rows written.
+unsigned long flight_log_export_csv(FlightLog& log, size_t from, size_t to, unsigned channels,
+		uint8_t flags, FILE* out);
+
+#endif /* FLIGHTLOGREADER_H_ */
@@ -0,0 +1,289 @@
+/*
+ * flightRecorder.cpp
+ *	Ring to disk pipeline of the flight data recorder.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "flightRecorder.h"
+#include "../realtime/latency.h"
+#include "../realtime/console.h"
+#include "../timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#define FLIGHT_RECORDER_NICE	10	// Below the flight loop, above the console
+
+using namespace std;
+
+FlightRecorder::FlightRecorder() {
+	fd = -1;
+	direct = false;
+	ring = NULL;
+	block = NULL;
+	head = 0;
+	tail = 0;
+	dropped = 0;
+	appends = 0;
+	maxQueued = 0;
+	running = false;
+	stopping = false;
+	offset = 0;
+	allocated = 0;
+	bytesWritten = 0;
+	writes = 0;
+	writeErrors = 0;
+	maxWriteNs = 0;
+	openedNs = 0;
+	closedNs = 0;
+	lastWriteNs = 0;
+}
+
+int FlightRecorder::open(const char* path, float rateHz) {
+	timeval wall;
+	gettimeofday(&wall, NULL);
+	flightLogHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, FLIGHT_LOG_MAGIC, sizeof(header.magic));
+	header.version = FLIGHT_LOG_VERSION;
+	header.headerSize = FLIGHT_LOG_BLOCK;
+	header.recordSize = sizeof(flightRecord);
+	header.rateHz = rateHz;
+	header.startMicros = (uint32_t)micros();
+	header.startUnixMicros = (uint64_t)wall.tv_sec * 1000000 + wall.tv_usec;
+	return open(path, &header, sizeof(header));
+}
+
+int FlightRecorder::open(const char* path, const void* header, size_t size) {
+	if(running)
+		close();
+	if(size > FLIGHT_LOG_BLOCK) {
+		cout << "Recorder header of " << path << " is larger than a block" << endl;
+		return 1;
+	}
+
+	// O_DIRECT needs aligned buffers, offsets and sizes, which every write here has
+	direct = true;
+	fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+	if(fd < 0 && errno == EINVAL) {	// tmpfs and friends
+		direct = false;
+		fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+	if(fd < 0) {
+		cout << "Failed to create " << path << endl;
+		return 1;
+	}
+
+	if(ring == NULL && posix_memalign((void**)&ring, FLIGHT_LOG_BLOCK, FLIGHT_RECORDER_RING) != 0)
+		ring = NULL;
+	if(block == NULL && posix_memalign((void**)&block, FLIGHT_LOG_BLOCK, FLIGHT_LOG_BLOCK) != 0)
+		block = NULL;
+	if(ring == NULL || block == NULL) {
+		cout << "Failed to allocate the recorder buffers" << endl;
+		::close(fd);
+		fd = -1;
+		return 2;
+	}
+	memset(ring, 0, FLIGHT_RECORDER_RING);	// Touch it now, not mid flight
+
+	head = 0;
+	tail = 0;
+	dropped = 0;
+	appends = 0;
+	maxQueued = 0;
+	offset = 0;
+	allocated = 0;
+	bytesWritten = 0;
+	writes = 0;
+	writeErrors = 0;
+	maxWriteNs = 0;
+	if(preallocate(FLIGHT_RECORDER_PREALLOCATE))
+		cout << path << " is not preallocated" << endl;
+
+	memset(block, 0, FLIGHT_LOG_BLOCK);
+	memcpy(block, header, size);
+	if(writeAt(block, FLIGHT_LOG_BLOCK)) {
+		cout << "Failed to write the header of " << path << endl;
+		::close(fd);
+		fd = -1;
+		return 3;
+	}
+
+	// The writer is explicitly SCHED_OTHER so it never inherits the flight loop's SCHED_FIFO
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	sched_param p;
+	p.sched_priority = 0;
+	pthread_attr_setschedparam(&attr, &p);
+
+	openedNs = latency_now();
+	lastWriteNs = openedNs;
+	stopping = false;
+	running = true;
+	int failed = pthread_create(&writer, &attr, writerThread, this);
+	pthread_attr_destroy(&attr);
+	if(failed) {
+		running = false;
+		cout << "Failed to start the recorder for " << path << endl;
+		::close(fd);
+		fd = -1;
+		return 4;
+	}
+	return 0;
+}
+
+void FlightRecorder::close() {
+	if(!running)
+		return;
+	stopping = true;
+	pthread_join(writer, NULL);
+	writeQueued(true);
+	running = false;
+	closedNs = latency_now();
+
+	if(ftruncate(fd, offset) != 0)	// Drop the unused preallocation and the final block's padding
+		cout << "Failed to trim the recorder file" << endl;
+	fsync(fd);
+	::close(fd);
+	fd = -1;
+}
+
+int FlightRecorder::preallocate(uint64_t end) {
+	if(end <= allocated)
+		return 0;
+	uint64_t length = end - allocated;
+	length = (length + FLIGHT_RECORDER_PREALLOCATE - 1) / FLIGHT_RECORDER_PREALLOCATE * FLIGHT_RECORDER_PREALLOCATE;
+	if(posix_fallocate(fd, allocated, length) != 0)
+		return 1;
+	allocated += length;
+	return 0;
+}
+
+int FlightRecorder::writeAt(const void* data, size_t size) {
+	if(offset + size > allocated)	// Normally done ahead of time by the writer loop
+		preallocate(offset + size);
+
+	uint64_t start = latency_now();
+	const char* p = (const char*)data;
+	size_t done = 0;
+	while(done < size) {
+		ssize_t n = pwrite(fd, p + done, size - done, offset + done);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) {
+			writeErrors++;
+			return 1;
+		}
+		done += n;
+	}
+	uint64_t took = latency_now() - start;
+	if(took > maxWriteNs) maxWriteNs = took;
+
+	offset += size;
+	bytesWritten += size;
+	writes++;
+	lastWriteNs = latency_now();
+	return 0;
+}
+
+// Writes whole blocks of queued data straight from the ring. With everything set (at close)
+// the last partial block goes out padded with zeros; offset only counts the data, so
+// close() trims the padding off again.
+void FlightRecorder::writeQueued(bool everything) {
+	unsigned long t = tail;
+	unsigned long available = head - t;
+	__sync_synchronize();	// Data up to head is complete
+
+	while(available > 0) {
+		unsigned long start = t & (FLIGHT_RECORDER_RING - 1);
+		unsigned long count = available;
+		if(count > FLIGHT_RECORDER_RING - start) count = FLIGHT_RECORDER_RING - start;	// Up to the end of the ring
+		if(count > FLIGHT_RECORDER_WRITE_SIZE) count = FLIGHT_RECORDER_WRITE_SIZE;
+		unsigned long whole = count - count % FLIGHT_LOG_BLOCK;
+
+		int failed = 0;
+		if(whole > 0) {
+			count = whole;
+			failed = writeAt(ring + start, count);
+		}
+		else if(everything) {
+			memset(block, 0, FLIGHT_LOG_BLOCK);
+			memcpy(block, ring + start, count);
+			failed = writeAt(block, FLIGHT_LOG_BLOCK);
+			if(!failed) {
+				offset -= FLIGHT_LOG_BLOCK - count;
+				bytesWritten -= FLIGHT_LOG_BLOCK - count;
+			}
+		}
+		else {
+			break;	// Less than a block left, it waits for more
+		}
+
+		if(failed) {	// Lost to the disk rather than the ring, but lost all the same
+			__sync_fetch_and_add(&dropped, 1);
+			console_print("Recorder write failed: %s", strerror(errno));
+		}
+		t += count;
+		available -= count;
+		__sync_synchronize();	// Done with the bytes before append() may reuse them
+		tail = t;
+	}
+}
+
+void FlightRecorder::writerLoop() {
+	setpriority(PRIO_PROCESS, syscall(SYS_gettid), FLIGHT_RECORDER_NICE);	// Per thread on Linux
+
+	timespec poll;
+	poll.tv_sec = 0;
+	poll.tv_nsec = FLIGHT_RECORDER_POLL_MS * 1000000L;
+	while(!stopping) {
+		nanosleep(&poll, NULL);
+
+		unsigned long queued = head - tail;
+		bool due = latency_now() - lastWriteNs > FLIGHT_RECORDER_FLUSH_MS * 1000000ULL;
+		if(queued >= FLIGHT_RECORDER_WRITE_SIZE || (due && queued >= FLIGHT_LOG_BLOCK)) {
+			LATENCY_SCOPE("recorder write");
+			writeQueued(false);
+		}
+
+		// Keep a write's worth of preallocated space ahead of the writer
+		if(offset + FLIGHT_RECORDER_RING > allocated)
+			preallocate(allocated + FLIGHT_RECORDER_PREALLOCATE);
+	}
+}
+
+void* FlightRecorder::writerThread(void* recorder) {
+	((FlightRecorder*)recorder)->writerLoop();
+	return NULL;
+}
+
+double FlightRecorder::getBytesPerSecond() {
+	double seconds = ((running ? latency_now() : closedNs) - openedNs) / 1e9;
+	return seconds > 0 ? bytesWritten / seconds : 0;
+}
+
+void FlightRecorder::report(ostream& out, const char* name) {
+	char line[160];
+	snprintf(line, sizeof(line), "%s: %lu appends, %.1f KiB written in %lu writes (%.0f B/s)%s\n",
+			name, appends, bytesWritten / 1024.0, writes, getBytesPerSecond(), direct ? ", O_DIRECT" : "");
+	out << line;
+	snprintf(line, sizeof(line), "  %lu dropped, %lu write errors, ring peak %.1f of %d KiB, slowest write %.2f ms\n",
+			(unsigned long)dropped, writeErrors, maxQueued / 1024.0, FLIGHT_RECORDER_RING / 1024, maxWriteNs / 1e6);
+	out << line << flush;
+}
+
+FlightRecorder::~FlightRecorder() {
+	close();
+	free(ring);
+	free(block);
+}
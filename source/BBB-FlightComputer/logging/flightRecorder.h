@@ -0,0 +1,113 @@
+/*
+ * flightRecorder.h
+ *	Flight data recorder. The flight loop hands each cycle's flightRecord to record(),
+ *	which copies it into a preallocated in-memory ring and returns; it never touches the
+ *	disk and never blocks. A background writer thread drains the ring to the log file in
+ *	large block aligned writes straight out of the ring memory.
+ *
+ *	The file is preallocated (and extended a chunk at a time, ahead of the writer) so
+ *	writes don't allocate blocks on the SD card as they go, and opened O_DIRECT where the
+ *	filesystem allows so they don't fill the page cache either. Data is written once a
+ *	whole write's worth has built up, or as whole blocks every FLIGHT_RECORDER_FLUSH_MS
+ *	so a crash costs at most about that much flight. When the ring is full, record()
+ *	drops the record and counts it; gaps show in the records' cycle numbers.
+ *
+ *	The ring holds bytes, so other streams (the compressed IMU stream) use the same
+ *	pipeline through append() and open() with a header of their own.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef FLIGHTRECORDER_H_
+#define FLIGHTRECORDER_H_
+
+#include "flightLog.h"
+#include <pthread.h>
+#include <string.h>
+#include <iostream>
+
+#define FLIGHT_RECORDER_RING		(512*1024)			// Bytes, a multiple of FLIGHT_RECORDER_WRITE_SIZE
+#define FLIGHT_RECORDER_WRITE_SIZE	(64*1024)			// Bytes per normal write
+#define FLIGHT_RECORDER_PREALLOCATE	(16*1024*1024)		// Bytes added to the file at a time
+#define FLIGHT_RECORDER_FLUSH_MS	2000
+#define FLIGHT_RECORDER_POLL_MS		50
+
+class FlightRecorder {
+
+private:
+
+	int fd;
+	bool direct;			// Opened O_DIRECT
+	char* ring;				// FLIGHT_LOG_BLOCK aligned
+	char* block;			// Aligned staging for the header and the final partial block
+
+	volatile unsigned long head;	// Bytes added, written by append() only
+	volatile unsigned long tail;	// Bytes written to disk, written by the writer only
+	volatile unsigned long dropped;	// Full ring (control thread) or failed writes (writer)
+	unsigned long appends;
+	unsigned long maxQueued;
+
+	pthread_t writer;
+	volatile bool running;
+	volatile bool stopping;
+
+	uint64_t offset;		// Next write position in the file
+	uint64_t allocated;		// File length preallocated so far
+	uint64_t bytesWritten;
+	unsigned long writes;
+	unsigned long writeErrors;
+	uint64_t maxWriteNs;
+	uint64_t openedNs;
+	uint64_t closedNs;
+	uint64_t lastWriteNs;
+
+	static void* writerThread(void* recorder);
+	void writerLoop();
+	void writeQueued(bool everything);
+	int writeAt(const void* data, size_t size);
+	int preallocate(uint64_t end);
+
+public:
+
+	FlightRecorder();
+
+	int open(const char* path, float rateHz);	// Flight log, see flightLog.h
+	int open(const char* path, const void* header, size_t size);	// Any stream, header padded to a block
+	void close();	// Writes everything still queued and trims the preallocated tail
+	bool isOpen() { return running; }
+
+	bool append(const void* data, size_t size) {	// One producer thread; false (and dropped) if it didn't fit
+		unsigned long h = head;
+		unsigned long queued = h - tail;
+		if(queued + size > FLIGHT_RECORDER_RING) {
+			__sync_fetch_and_add(&dropped, 1);
+			return false;
+		}
+		if(queued > maxQueued) maxQueued = queued;
+
+		unsigned long start = h & (FLIGHT_RECORDER_RING - 1);
+		size_t first = FLIGHT_RECORDER_RING - start < size ? FLIGHT_RECORDER_RING - start : size;
+		memcpy(ring + start, data, first);
+		memcpy(ring, (const char*)data + first, size - first);	// Wrapped around the end
+		appends++;
+		__sync_synchronize();	// Data complete before the writer can see it
+		head = h + size;
+		return true;
+	}
+
+	bool record(const flightRecord& r) { return append(&r, sizeof(r)); }	// Control thread
+
+	bool hasRoom(size_t size) { return head - tail + size <= FLIGHT_RECORDER_RING; }	// For producers that would rather wait
+
+	unsigned long getAppends() { return appends; }
+	unsigned long getDropped() { return dropped; }
+	uint64_t getBytesWritten() { return bytesWritten; }
+	double getBytesPerSecond();
+
+	void report(std::ostream& out, const char* name);
+
+	virtual ~FlightRecorder();
+};
+
+#endif /* FLIGHTRECORDER_H_ */
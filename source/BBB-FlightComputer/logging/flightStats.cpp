@@ -0,0 +1,147 @@
+/*
+ * flightStats.cpp
+ *	Per-flight summaries of flight data recorder logs, see flightStats.h.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "flightStats.h"
+#include <float.h>
+
+static const char* channelNames[FLIGHT_STATS_CHANNELS] = {
+	"accel_x", "accel_y", "accel_z", "gyro_x", "gyro_y", "gyro_z", "mag_x", "mag_y", "mag_z", "altitude"
+};
+
+static const char* sensorNames[FLIGHT_STATS_SENSORS] = { "lms303", "l3gd20", "lps331" };
+
+FlightStats::FlightStats(const char* n) {
+	name = n;
+	flights = 0;
+	failed = 0;
+	duration = 0;
+	bytes = 0;
+	records = 0;
+	dropped = 0;
+	overruns = 0;
+	lostSyncCycles = 0;
+	for(int i = 0; i < FLIGHT_STATS_SENSORS; i++)
+		lostSync[i] = 0;
+	for(int i = 0; i < FLIGHT_STATS_CHANNELS; i++) {
+		channels[i].minimum = DBL_MAX;
+		channels[i].maximum = -DBL_MAX;
+		channels[i].sum = 0;
+		channels[i].sumSquares = 0;
+		channels[i].count = 0;
+	}
+	frameTime.init("frame time");
+}
+
+int FlightStats::compute(const char* path) {
+	FlightLog log;
+	if(log.open(path, false)) {	// Don't leave index files behind in a shared log directory
+		failed++;
+		return 1;
+	}
+	compute(log);
+	return 0;
+}
+
+void FlightStats::compute(FlightLog& log) {
+	size_t count = log.size();
+	flights++;
+	records += count;
+	bytes += log.getHeader().headerSize + (uint64_t)count * sizeof(flightRecord);
+	duration += log.getDuration();
+	if(count == 0)
+		return;
+
+	log.adviseSequential(0, count);
+	const flightRecord* previous = NULL;
+	for(size_t i = 0; i < count; i++) {
+		const flightRecord& r = log[i];
+		if(previous) {
+			uint16_t cycles = r.cycle - previous->cycle;
+			if(cycles != 1)
+				dropped += (uint16_t)(cycles - 1);
+		}
+		previous = &r;
+		if(r.frameMicros)
+			frameTime.record((uint64_t)r.frameMicros * 1000);
+
+		if(r.flags & FLIGHT_RECORD_OVERRUN) overruns++;
+		if(r.flags & FLIGHT_RECORD_LOST_SYNC) {
+			lostSyncCycles++;
+			for(int s = 0; s < FLIGHT_STATS_SENSORS; s++)
+				if(r.lostSync & (1 << s)) lostSync[s]++;
+		}
+
+		if(r.flags & FLIGHT_RECORD_ACCEL_NEW) {
+			add(FLIGHT_STATS_ACCEL_X, r.accel[0] * FLIGHT_LOG_ACCEL_LSB);
+			add(FLIGHT_STATS_ACCEL_Y, r.accel[1] * FLIGHT_LOG_ACCEL_LSB);
+			add(FLIGHT_STATS_ACCEL_Z, r.accel[2] * FLIGHT_LOG_ACCEL_LSB);
+		}
+		if(r.flags & FLIGHT_RECORD_GYRO_NEW) {
+			add(FLIGHT_STATS_GYRO_X, r.gyro[0] * FLIGHT_LOG_GYRO_LSB);
+			add(FLIGHT_STATS_GYRO_Y, r.gyro[1] * FLIGHT_LOG_GYRO_LSB);
+			add(FLIGHT_STATS_GYRO_Z, r.gyro[2] * FLIGHT_LOG_GYRO_LSB);
+		}
+		if(r.flags & FLIGHT_RECORD_MAG_NEW) {
+			add(FLIGHT_STATS_MAG_X, r.mag[0] * FLIGHT_LOG_MAG_LSB);
+			add(FLIGHT_STATS_MAG_Y, r.mag[1] * FLIGHT_LOG_MAG_LSB);
+			add(FLIGHT_STATS_MAG_Z, r.mag[2] * FLIGHT_LOG_MAG_LSB);
+		}
+		if(!(r.lostSync & FLIGHT_SYNC_ALTIMETER))
+			add(FLIGHT_STATS_ALTITUDE, r.altitude * FLIGHT_LOG_ALTITUDE_LSB);
+	}
+}
+
+void FlightStats::merge(FlightStats& other) {
+	flights += other.flights;
+	failed += other.failed;
+	duration += other.duration;
+	bytes += other.bytes;
+	records += other.records;
+	dropped += other.dropped;
+	overruns += other.overruns;
+	lostSyncCycles += other.lostSyncCycles;
+	for(int i = 0; i < FLIGHT_STATS_SENSORS; i++)
+		lostSync[i] += other.lostSync[i];
+	for(int i = 0; i < FLIGHT_STATS_CHANNELS; i++) {
+		channelStats& c = channels[i];
+		const channelStats& o = other.channels[i];
+		if(o.minimum < c.minimum) c.minimum = o.minimum;
+		if(o.maximum > c.maximum) c.maximum = o.maximum;
+		c.sum += o.sum;
+		c.sumSquares += o.sumSquares;
+		c.count += o.count;
+	}
+	frameTime.merge(other.frameTime);
+}
+
+void FlightStats::csvHeader(FILE* out) {
+	fprintf(out, "flight,flights,failed,duration_s,records,dropped,overruns,lost_sync_cycles");
+	for(int s = 0; s < FLIGHT_STATS_SENSORS; s++)
+		fprintf(out, ",lost_sync_%s", sensorNames[s]);
+	fprintf(out, ",frame_p50_ms,frame_p90_ms,frame_p99_ms,frame_p999_ms,frame_max_ms");
+	for(int i = 0; i < FLIGHT_STATS_CHANNELS; i++)
+		fprintf(out, ",%s_min,%s_max,%s_rms,%s_sd", channelNames[i], channelNames[i], channelNames[i], channelNames[i]);
+	fprintf(out, "\n");
+}
+
+void FlightStats::csvRow(FILE* out) {
+	fprintf(out, "%s,%d,%d,%.2f,%lu,%lu,%lu,%lu", name.c_str(), flights, failed, duration, records,
+			dropped, overruns, lostSyncCycles);
+	for(int s = 0; s < FLIGHT_STATS_SENSORS; s++)
+		fprintf(out, ",%lu", lostSync[s]);
+	fprintf(out, ",%.3f,%.3f,%.3f,%.3f,%.3f", frameTime.percentile(0.5) / 1e6, frameTime.percentile(0.9) / 1e6,
+			frameTime.percentile(0.99) / 1e6, frameTime.percentile(0.999) / 1e6, frameTime.getMax() / 1e6);
+	for(int i = 0; i < FLIGHT_STATS_CHANNELS; i++) {
+		channelStats& c = channels[i];
+		if(c.count == 0)
+			fprintf(out, ",,,,");
+		else
+			fprintf(out, ",%.4f,%.4f,%.4f,%.4f", c.minimum, c.maximum, c.rms(), c.deviation());
+	}
+	fprintf(out, "\n");
+}
@@ -0,0 +1,97 @@
+/*
+ * flightStats.h
+ *	Per-flight summary of a flight data recorder log for fleet analysis: min, max, RMS and
+ *	standard deviation (vibration, for the accelerometer) of the sensor channels, the
+ *	distribution of frame times, and counts of dropped records, overruns and sensor reads that
+ *	lost sync. Summaries merge, so a batch of flights adds up to a fleet total.
+ *
+ *	Sensor channels only count the cycles that brought a new sample from that sensor, so a
+ *	slow sensor isn't weighted by the loop rate. Frame times are each record's frameMicros, the
+ *	longest rate group frame since the record before, not the time between records; logs
+ *	without it don't add any.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef FLIGHTSTATS_H_
+#define FLIGHTSTATS_H_
+
+#include "flightLogReader.h"
+#include "../realtime/latency.h"
+#include <stdio.h>
+#include <math.h>
+#include <string>
+
+enum FLIGHT_STATS_CHANNEL {
+	FLIGHT_STATS_ACCEL_X = 0,	// g
+	FLIGHT_STATS_ACCEL_Y,
+	FLIGHT_STATS_ACCEL_Z,
+	FLIGHT_STATS_GYRO_X,		// deg/s
+	FLIGHT_STATS_GYRO_Y,
+	FLIGHT_STATS_GYRO_Z,
+	FLIGHT_STATS_MAG_X,			// gauss
+	FLIGHT_STATS_MAG_Y,
+	FLIGHT_STATS_MAG_Z,
+	FLIGHT_STATS_ALTITUDE,		// m
+	FLIGHT_STATS_CHANNELS
+};
+
+#define FLIGHT_STATS_SENSORS	3	// LMS303, L3GD20, LPS331, as FLIGHT_SYNC_* bits 0 to 2
+
+struct channelStats {
+	double minimum;
+	double maximum;
+	double sum;
+	double sumSquares;
+	unsigned long count;
+
+	double rms() { return count ? sqrt(sumSquares / count) : 0; }
+	double mean() { return count ? sum / count : 0; }
+	double deviation() {	// RMS about the mean
+		if(count == 0) return 0;
+		double m = sum / count;
+		double v = sumSquares / count - m * m;
+		return v > 0 ? sqrt(v) : 0;
+	}
+};
+
+class FlightStats {
+
+private:
+
+	void add(FLIGHT_STATS_CHANNEL channel, double value) {
+		channelStats& c = channels[channel];
+		if(value < c.minimum) c.minimum = value;
+		if(value > c.maximum) c.maximum = value;
+		c.sum += value;
+		c.sumSquares += value * value;
+		c.count++;
+	}
+
+public:
+
+	std::string name;
+	int flights;				// 1, or the number merged in
+	int failed;					// Logs that couldn't be opened
+	double duration;			// seconds
+	uint64_t bytes;				// Of log read
+	unsigned long records;
+	unsigned long dropped;		// From gaps in the cycle numbers
+	unsigned long overruns;
+	unsigned long lostSyncCycles;						// Cycles where any sensor lost sync
+	unsigned long lostSync[FLIGHT_STATS_SENSORS];		// Per sensor
+	channelStats channels[FLIGHT_STATS_CHANNELS];
+	LatencyHistogram frameTime;	// ns, per record the longest frame it covers
+
+	FlightStats(const char* name = "");
+
+	int compute(const char* path);	// Summarises one log, returns non-zero if it couldn't be read
+	void compute(FlightLog& log);
+	void merge(FlightStats& other);
+
+	static void csvHeader(FILE* out);
+	void csvRow(FILE* out);
+};
+
+#endif /* FLIGHTSTATS_H_ */
@@ -0,0 +1,159 @@
+/*
+ * imuStream.cpp
+ *	Framing of the compressed IMU stream, see imuStream.h.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "imuStream.h"
+#include "../timing.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+using namespace std;
+
+ImuStreamWriter::ImuStreamWriter() {
+	sinceKey[IMU_STREAM_GYRO] = 0;
+	sinceKey[IMU_STREAM_ACCEL] = 0;
+	samples = 0;
+	frames = 0;
+	bytes = 0;
+}
+
+int ImuStreamWriter::open(const char* path) {
+	timeval wall;
+	gettimeofday(&wall, NULL);
+	imuStreamHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, IMU_STREAM_MAGIC, sizeof(header.magic));
+	header.version = IMU_STREAM_VERSION;
+	header.startMicros = (uint32_t)micros();
+	header.startUnixMicros = (uint64_t)wall.tv_sec * 1000000 + wall.tv_usec;
+
+	for(int s = 0; s < IMU_STREAM_SENSORS; s++) {
+		encoder[s].reset();
+		sinceKey[s] = 0;
+	}
+	samples = 0;
+	frames = 0;
+	bytes = 0;
+	return recorder.open(path, &header, sizeof(header));
+}
+
+bool ImuStreamWriter::write(IMU_STREAM_SENSOR sensor, uint16_t cycle, uint32_t micros,
+		const int16_t samples[][IMU_STREAM_AXES], int count) {
+	if(count <= 0 || !recorder.isOpen())
+		return false;
+	if(count > IMU_STREAM_MAX_SAMPLES) count = IMU_STREAM_MAX_SAMPLES;
+
+	// Header and payload go to the ring in one append, so a frame is either whole or dropped
+	struct {
+		imuStreamFrame header;
+		uint8_t payload[IMU_STREAM_MAX_PAYLOAD];
+	} frame;
+	imuStreamFrame* f = &frame.header;
+	f->sync = IMU_STREAM_SYNC;
+	f->sensor = (uint8_t)sensor;
+	f->count = (uint8_t)count;
+	f->flags = 0;
+	f->micros = micros;
+	f->cycle = cycle;
+
+	ImuSampleEncoder& e = encoder[sensor];
+	if(sinceKey[sensor] == 0) {
+		e.reset();
+		f->flags |= IMU_FRAME_KEY;
+	}
+	int size = e.encode(samples, count, frame.payload);
+	f->size = (uint16_t)size;
+
+	if(!recorder.append(&frame, sizeof(imuStreamFrame) + size)) {
+		sinceKey[sensor] = 0;	// The next frame can't be a delta from one that was never written
+		return false;
+	}
+	if(++sinceKey[sensor] >= IMU_STREAM_KEY_INTERVAL) sinceKey[sensor] = 0;
+	this->samples += count;
+	frames++;
+	bytes += sizeof(imuStreamFrame) + size;
+	return true;
+}
+
+void ImuStreamWriter::report(ostream& out) {
+	recorder.report(out, "IMU stream");
+	char line[160];
+	snprintf(line, sizeof(line), "  %lu samples in %lu frames, %.2f bytes per sample (%.1fx smaller than raw)\n",
+			samples, frames, getBytesPerSample(),
+			samples ? 6.0 / getBytesPerSample() : 0);
+	out << line << flush;
+}
+
+ImuStreamReader::ImuStreamReader() {
+	file = NULL;
+	memset(&header, 0, sizeof(header));
+	synced[IMU_STREAM_GYRO] = false;
+	synced[IMU_STREAM_ACCEL] = false;
+	skipped = 0;
+}
+
+int ImuStreamReader::open(const char* path) {
+	close();
+	file = fopen(path, "rb");
+	if(file == NULL) {
+		printf("Failed to open %s\n", path);
+		return 1;
+	}
+	if(fread(&header, sizeof(header), 1, file) != 1 ||
+			memcmp(header.magic, IMU_STREAM_MAGIC, sizeof(header.magic)) != 0) {
+		printf("%s is not an IMU stream\n", path);
+		close();
+		return 2;
+	}
+	if(header.version != IMU_STREAM_VERSION) {
+		printf("%s is IMU stream version %u, expected %u\n", path, header.version, IMU_STREAM_VERSION);
+		close();
+		return 3;
+	}
+	fseek(file, FLIGHT_LOG_BLOCK, SEEK_SET);
+	for(int s = 0; s < IMU_STREAM_SENSORS; s++) {
+		decoder[s].reset();
+		synced[s] = false;
+	}
+	skipped = 0;
+	return 0;
+}
+
+void ImuStreamReader::close() {
+	if(file) fclose(file);
+	file = NULL;
+}
+
+int ImuStreamReader::next(imuStreamFrame& frame, int16_t samples[][IMU_STREAM_AXES]) {
+	uint8_t payload[IMU_STREAM_MAX_PAYLOAD];
+	while(file) {
+		if(fread(&frame, sizeof(frame), 1, file) != 1 || frame.sync != IMU_STREAM_SYNC)
+			return 1;	// End of the data, or the zeroed preallocation after it
+		if(frame.sensor >= IMU_STREAM_SENSORS || frame.count > IMU_STREAM_MAX_SAMPLES ||
+				frame.size > IMU_STREAM_MAX_PAYLOAD || fread(payload, 1, frame.size, file) != frame.size) {
+			printf("Corrupt IMU stream frame at byte %ld\n", ftell(file));
+			return 1;
+		}
+
+		if(frame.flags & IMU_FRAME_KEY) {
+			decoder[frame.sensor].reset();
+			synced[frame.sensor] = true;
+		}
+		if(!synced[frame.sensor]) {
+			skipped++;
+			continue;
+		}
+		if(decoder[frame.sensor].decode(payload, frame.size, frame.count, samples) != frame.size) {
+			synced[frame.sensor] = false;	// Wait for the next keyframe
+			skipped++;
+			continue;
+		}
+		return 0;
+	}
+	return 1;
+}
@@ -0,0 +1,193 @@
+/*
+ * imuStream.h
+ *	Compressed stream of every raw gyro and accelerometer FIFO sample, written next to the
+ *	flight log (<log>.imu). Each FIFO read becomes one frame: a small header, then per
+ *	sample and per axis the difference from the previous sample on that axis, zigzag
+ *	mapped and written as a varint. Consecutive samples at 100s of Hz differ by a few
+ *	counts, so most axes take one byte instead of two, and any int16 difference still
+ *	round trips exactly (at most three bytes).
+ *
+ *	A keyframe starts from zero instead of the previous frame, so decoding can begin at any
+ *	keyframe. The writer emits one every IMU_STREAM_KEY_INTERVAL frames per sensor, and
+ *	after any frame the recorder dropped, so a lost frame never corrupts the ones after it.
+ *	Encoding and decoding both stream: the only state is the last sample of each sensor.
+ *
+ *	File: one FLIGHT_LOG_BLOCK with an imuStreamHeader, then frames back to back, each an
+ *	imuStreamFrame followed by its payload. Zeroed space (a preallocated file that was never
+ *	closed) has no sync byte, which ends the stream.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef IMUSTREAM_H_
+#define IMUSTREAM_H_
+
+#include "flightRecorder.h"
+#include <stdio.h>
+#include <stdint.h>
+
+#define IMU_STREAM_MAGIC		"IMUSTR1"
+#define IMU_STREAM_VERSION		1
+#define IMU_STREAM_SUFFIX		".imu"
+#define IMU_STREAM_SYNC			0xA5
+#define IMU_STREAM_AXES			3
+#define IMU_STREAM_MAX_SAMPLES	32		// Per frame, the deepest FIFO (L3GD20)
+#define IMU_STREAM_MAX_VARINT	3		// Bytes for a zigzagged int16 difference
+#define IMU_STREAM_MAX_PAYLOAD	(IMU_STREAM_MAX_SAMPLES * IMU_STREAM_AXES * IMU_STREAM_MAX_VARINT)
+#define IMU_STREAM_KEY_INTERVAL	50		// Frames per sensor between keyframes
+
+#define IMU_FRAME_KEY			0x01	// imuStreamFrame flags: deltas start from zero
+
+enum IMU_STREAM_SENSOR {
+	IMU_STREAM_GYRO			= 0,	// L3GD20 OUT_X/Y/Z registers
+	IMU_STREAM_ACCEL		= 1,	// LMS303 OUT_X/Y/Z_A registers
+	IMU_STREAM_SENSORS		= 2
+};
+
+struct imuStreamHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t startMicros;		// micros() when the stream was opened
+	uint64_t startUnixMicros;	// Wall clock at the same moment
+};
+
+struct imuStreamFrame {
+	uint8_t sync;		// IMU_STREAM_SYNC
+	uint8_t sensor;		// IMU_STREAM_SENSOR
+	uint8_t count;		// Samples
+	uint8_t flags;
+	uint32_t micros;	// When the FIFO was read, the newest sample
+	uint16_t cycle;		// The flightRecord cycle it falls in, the next record captured after the read
+	uint16_t size;		// Payload bytes
+};
+
+inline uint32_t imu_stream_zigzag(int32_t value) {
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+inline int32_t imu_stream_unzigzag(uint32_t value) {
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+class ImuSampleEncoder {	// Delta + zigzag + varint for one sensor
+
+private:
+
+	int16_t previous[IMU_STREAM_AXES];
+
+public:
+
+	ImuSampleEncoder() { reset(); }
+	void reset() { previous[0] = previous[1] = previous[2] = 0; }
+
+	// Encodes count samples into out (IMU_STREAM_MAX_PAYLOAD bytes), returns the bytes used
+	int encode(const int16_t samples[][IMU_STREAM_AXES], int count, uint8_t* out) {
+		uint8_t* p = out;
+		for(int i = 0; i < count; i++) {
+			for(int axis = 0; axis < IMU_STREAM_AXES; axis++) {
+				uint32_t v = imu_stream_zigzag((int32_t)samples[i][axis] - previous[axis]);
+				previous[axis] = samples[i][axis];
+				while(v >= 0x80) {
+					*p++ = (uint8_t)(v | 0x80);
+					v >>= 7;
+				}
+				*p++ = (uint8_t)v;
+			}
+		}
+		return p - out;
+	}
+};
+
+class ImuSampleDecoder {
+
+private:
+
+	int16_t previous[IMU_STREAM_AXES];
+
+public:
+
+	ImuSampleDecoder() { reset(); }
+	void reset() { previous[0] = previous[1] = previous[2] = 0; }
+
+	// Returns the payload bytes consumed, or -1 if the payload is malformed
+	int decode(const uint8_t* in, int size, int count, int16_t samples[][IMU_STREAM_AXES]) {
+		const uint8_t* p = in;
+		const uint8_t* end = in + size;
+		for(int i = 0; i < count; i++) {
+			for(int axis = 0; axis < IMU_STREAM_AXES; axis++) {
+				uint32_t v = 0;
+				int shift = 0;
+				for(;;) {
+					if(p == end || shift > 14) return -1;
+					uint8_t byte = *p++;
+					v |= (uint32_t)(byte & 0x7F) << shift;
+					shift += 7;
+					if(!(byte & 0x80)) break;
+				}
+				previous[axis] = (int16_t)(previous[axis] + imu_stream_unzigzag(v));
+				samples[i][axis] = previous[axis];
+			}
+		}
+		return p - in;
+	}
+};
+
+class ImuStreamWriter {	// Control thread side, frames go through a FlightRecorder of their own
+
+private:
+
+	FlightRecorder recorder;
+	ImuSampleEncoder encoder[IMU_STREAM_SENSORS];
+	int sinceKey[IMU_STREAM_SENSORS];
+	unsigned long samples;
+	unsigned long frames;
+	uint64_t bytes;			// Appended, frame headers included
+
+public:
+
+	ImuStreamWriter();
+
+	int open(const char* path);
+	void close() { recorder.close(); }
+	bool isOpen() { return recorder.isOpen(); }
+
+	// One FIFO read. Returns false if the recorder had no room and the frame was dropped.
+	bool write(IMU_STREAM_SENSOR sensor, uint16_t cycle, uint32_t micros,
+			const int16_t samples[][IMU_STREAM_AXES], int count);
+
+	FlightRecorder& getRecorder() { return recorder; }
+	unsigned long getSamples() { return samples; }
+	unsigned long getFrames() { return frames; }
+	double getBytesPerSample() { return samples ? (double)bytes / samples : 0; }	// 6 uncompressed
+
+	void report(std::ostream& out);
+};
+
+class ImuStreamReader {	// Sequential, nothing beyond one frame is buffered
+
+private:
+
+	FILE* file;
+	ImuSampleDecoder decoder[IMU_STREAM_SENSORS];
+	bool synced[IMU_STREAM_SENSORS];	// Decoding from a keyframe on
+	imuStreamHeader header;
+	unsigned long skipped;				// Delta frames with no keyframe before them
+
+public:
+
+	ImuStreamReader();
+
+	int open(const char* path);
+	void close();
+
+	// Next decodable frame into frame and samples. Returns 1 at the end of the stream.
+	int next(imuStreamFrame& frame, int16_t samples[][IMU_STREAM_AXES]);
+
+	const imuStreamHeader& getHeader() { return header; }
+	unsigned long getSkipped() { return skipped; }
+
+	virtual ~ImuStreamReader() { close(); }
+};
+
+#endif /* IMUSTREAM_H_ */
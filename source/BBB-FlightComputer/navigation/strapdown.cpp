@@ -0,0 +1,190 @@
+/*
+ * strapdown.cpp
+ *	Strapdown inertial navigation, see strapdown.h.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "strapdown.h"
+#include "../realtime/latency.h"
+#include <string.h>
+
+static void cross(const float a[3], const float b[3], float out[3]) {
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+StrapdownINS::StrapdownINS() {
+	align(imu::Quaternion(), 0);
+	accelNewest = 0;
+	accelCount = 0;
+}
+
+void StrapdownINS::align(const imu::Quaternion& attitude, unsigned long time) {
+	for(int k = 0; k < 3; k++)
+		nav.velocity[k] = nav.position[k] = nav.specificForce[k] = nav.coning[k] = nav.sculling[k] = 0;
+	nav.samples = nav.batches = 0;
+	nav.interval = 0;
+	nav.attitude = attitude;
+	nav.attitude.normalize();
+	nav.time = time;
+	memset(alpha, 0, sizeof(alpha));
+	memset(beta, 0, sizeof(beta));
+	memset(upsilon, 0, sizeof(upsilon));
+	memset(scull, 0, sizeof(scull));
+	memset(lastTheta, 0, sizeof(lastTheta));
+	memset(lastDv, 0, sizeof(lastDv));
+	batchSeconds = 0;
+}
+
+void StrapdownINS::setAttitude(const imu::Quaternion& attitude) {
+	nav.attitude = attitude;
+	nav.attitude.normalize();
+}
+
+void StrapdownINS::setVelocity(const double velocity[3]) {
+	for(int k = 0; k < 3; k++)
+		nav.velocity[k] = velocity[k];
+}
+
+void StrapdownINS::pushAccel(const accelFIFOBatch& batch) {
+	const float toMetres = (float)INS_GRAVITY;
+	for(int i = 0; i < batch.count; i++) {
+		if(accelCount && (long)(batch.timestamp[i] - accelTime[accelNewest]) <= 0)
+			continue;	// Already have it, or older than what we have
+		accelNewest = (accelNewest + 1) % INS_ACCEL_HISTORY;
+		accel[accelNewest][0] = batch.x[i] * toMetres;
+		accel[accelNewest][1] = batch.y[i] * toMetres;
+		accel[accelNewest][2] = batch.z[i] * toMetres;
+		accelTime[accelNewest] = batch.timestamp[i];
+		if(accelCount < INS_ACCEL_HISTORY)
+			accelCount++;
+	}
+}
+
+// Linear between the samples either side of time, held past either end. cursor counts
+// from the oldest sample, and only moves forward, since gyro samples come oldest first
+static void interpolate(const float (*accel)[3], const unsigned long* accelTime, int oldest, int count,
+		unsigned long time, int& cursor, float force[3]) {
+	while(cursor + 1 < count && (long)(accelTime[(oldest + cursor + 1) % INS_ACCEL_HISTORY] - time) <= 0)
+		cursor++;
+	int a = (oldest + cursor) % INS_ACCEL_HISTORY;
+	long sinceA = (long)(time - accelTime[a]);
+	if(cursor + 1 >= count || sinceA <= 0) {
+		force[0] = accel[a][0];
+		force[1] = accel[a][1];
+		force[2] = accel[a][2];
+		return;
+	}
+	int b = (a + 1) % INS_ACCEL_HISTORY;
+	float t = (float)sinceA / (float)(long)(accelTime[b] - accelTime[a]);
+	for(int k = 0; k < 3; k++)
+		force[k] = accel[a][k] + t * (accel[b][k] - accel[a][k]);
+}
+
+// Savage's recursive coning and sculling terms, with alpha and upsilon the sums before
+// this sample and the previous sample's increments standing in for the rate of change
+void StrapdownINS::addSample(const float rate[3], const float force[3], float dt) {
+	float dTheta[3], dv[3], a[3], u[3], c[3], s[3];
+	for(int k = 0; k < 3; k++) {
+		dTheta[k] = rate[k] * dt;
+		dv[k] = force[k] * dt;
+		a[k] = alpha[k] + lastTheta[k] * (1.0f / 6.0f);
+		u[k] = upsilon[k] + lastDv[k] * (1.0f / 6.0f);
+	}
+
+	cross(a, dTheta, c);
+	for(int k = 0; k < 3; k++)
+		beta[k] += 0.5f * c[k];
+
+	cross(a, dv, c);
+	cross(u, dTheta, s);
+	for(int k = 0; k < 3; k++) {
+		scull[k] += 0.5f * (c[k] + s[k]);
+		alpha[k] += dTheta[k];
+		upsilon[k] += dv[k];
+		lastTheta[k] = dTheta[k];
+		lastDv[k] = dv[k];
+	}
+	batchSeconds += dt;
+	nav.samples++;
+}
+
+void StrapdownINS::endBatch() {
+	if(batchSeconds <= 0)
+		return;
+	double T = batchSeconds;
+
+	// Velocity, with the rotation of the body over the batch and sculling compensated,
+	// resolved with the attitude at the start of the batch
+	float rotation[3];
+	cross(alpha, upsilon, rotation);
+	imu::Vector<3> dvBody(upsilon[0] + 0.5 * rotation[0] + scull[0],
+			upsilon[1] + 0.5 * rotation[1] + scull[1],
+			upsilon[2] + 0.5 * rotation[2] + scull[2]);
+	imu::Vector<3> dvNav = nav.attitude.rotateVector(dvBody);
+
+	double before[3];
+	for(int k = 0; k < 3; k++) {
+		before[k] = nav.velocity[k];
+		nav.velocity[k] += dvNav(k);
+		nav.specificForce[k] = dvNav(k) / T;
+		nav.coning[k] = beta[k];
+		nav.sculling[k] = scull[k];
+	}
+	nav.velocity[2] -= INS_GRAVITY * T;
+	nav.interval = T;
+	for(int k = 0; k < 3; k++)
+		nav.position[k] += 0.5 * (before[k] + nav.velocity[k]) * T;
+
+	// Attitude, by the coning compensated rotation vector
+	imu::Vector<3> phi(alpha[0] + beta[0], alpha[1] + beta[1], alpha[2] + beta[2]);
+	double angle = phi.magnitude();
+	if(angle > 1e-12) {
+		imu::Quaternion step;
+		step.fromAxisAngle(phi / angle, angle);
+		nav.attitude = nav.attitude * step;
+		nav.attitude.normalize();
+	}
+
+	memset(alpha, 0, sizeof(alpha));
+	memset(beta, 0, sizeof(beta));
+	memset(upsilon, 0, sizeof(upsilon));
+	memset(scull, 0, sizeof(scull));
+	batchSeconds = 0;
+	nav.batches++;
+}
+
+void StrapdownINS::integrate(const gyroFIFOBatch& gyro) {
+	LATENCY_SCOPE("ins integration");
+	int n = gyro.count;
+	if(n > GYRO_FIFO_SLOTS)
+		n = GYRO_FIFO_SLOTS;
+	if(n <= 0)
+		return;
+	if(!accelCount) {	// No specific force to pair with yet
+		nav.time = gyro.timestamp[n - 1];
+		return;
+	}
+
+	const float degToRad = (float)M_PI / 180.0f;
+	int oldest = (accelNewest - accelCount + 1 + INS_ACCEL_HISTORY) % INS_ACCEL_HISTORY;
+	int cursor = 0;
+	for(int i = 0; i < n; i++) {
+		long step = (long)(gyro.timestamp[i] - nav.time);
+		if(step <= 0)
+			continue;	// Already integrated
+		nav.time = gyro.timestamp[i];
+		if(step > INS_MAX_STEP_MICROS)
+			continue;	// A stall: skip the gap rather than integrate across it
+
+		// The sample is the mean rate over the interval that ends at its timestamp
+		float rate[3] = { gyro.x[i] * degToRad, gyro.y[i] * degToRad, gyro.z[i] * degToRad };
+		float force[3];
+		interpolate(accel, accelTime, oldest, accelCount, gyro.timestamp[i] - step / 2, cursor, force);
+		addSample(rate, force, step * 1e-6f);
+	}
+	endBatch();
+}
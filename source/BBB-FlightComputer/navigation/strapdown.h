@@ -0,0 +1,100 @@
+/*
+ * strapdown.h
+ *	Strapdown inertial navigation: attitude, velocity and position from every gyro and
+ *	accel FIFO sample. Savage's two speed structure: a cheap float step per gyro sample
+ *	sums the angle and velocity increments and their coning and sculling terms, and
+ *	endBatch(), once per FIFO batch, turns the sums into the attitude, velocity and
+ *	position update in double.
+ *
+ *	The accel FIFO runs at its own rate and is read less often than the gyro's, so its
+ *	samples are kept in a short history and each gyro sample is paired with the specific
+ *	force interpolated to its timestamp. Past the newest accel sample the last one is held.
+ *
+ *	The navigation frame is the AHRS earth frame: z up along the measured gravity, x north
+ *	along the horizontal magnetic field and y west. Earth rate and transport rate are left
+ *	out, both are far below the noise of MEMS gyros over a flight. Unaided, position error
+ *	grows with the cube of time, so the flight loop slaves the attitude to the AHRS, which
+ *	sees the accel and mag corrections, at its output rate. That AHRS levels itself to the
+ *	mean specific force, so in a long turn it takes out the centripetal acceleration and the
+ *	horizontal velocity lags the turn. The vertical channel is unaffected.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ *
+ *  Reference:
+ *  	Savage, Strapdown Inertial Navigation Integration Algorithm Design, Journal of
+ *  	Guidance, Control and Dynamics 21(1) and 21(2), 1998
+ */
+
+#ifndef STRAPDOWN_H_
+#define STRAPDOWN_H_
+
+#include "../AHRS/imumaths.h"
+#include "../sensors/L3GD20Gyro.h"
+#include "../sensors/LMS303.h"
+
+#define INS_ACCEL_HISTORY	64			// Accel samples kept to pair with gyro samples, 40 ms at 1600 Hz
+#define INS_GRAVITY			9.80665		// m/s^2
+#define INS_MAX_STEP_MICROS	100000		// Longer gaps between samples are a stall, not integrated
+
+struct insSolution {
+	imu::Quaternion attitude;	// Body to navigation frame
+	double velocity[3];			// m/s, navigation frame
+	double position[3];			// m from where align() was called, navigation frame
+	double specificForce[3];	// m/s^2, navigation frame, mean over the last batch
+	double coning[3];			// rad, the last batch's coning correction
+	double sculling[3];			// m/s, the last batch's sculling correction
+	double interval;			// s, the last batch's length
+	unsigned long time;			// micros() of the last sample integrated
+	unsigned long samples;		// Gyro samples integrated since align()
+	unsigned long batches;
+};
+
+class StrapdownINS {
+
+private:
+
+	insSolution nav;
+
+	float accel[INS_ACCEL_HISTORY][3];	// m/s^2, body
+	unsigned long accelTime[INS_ACCEL_HISTORY];
+	int accelNewest;		// Slot of the newest sample
+	int accelCount;
+
+	// Sums over the batch so far, body frame at the start of the batch
+	float alpha[3];			// rad, angle increments
+	float beta[3];			// rad, coning
+	float upsilon[3];		// m/s, velocity increments
+	float scull[3];			// m/s, sculling
+	float lastTheta[3];		// The previous sample's increments, carried across batches
+	float lastDv[3];
+	double batchSeconds;
+
+public:
+
+	StrapdownINS();
+
+	// Starts from rest at the origin with the given attitude. Samples older than time are ignored
+	void align(const imu::Quaternion& attitude, unsigned long time);
+
+	// Replaces the attitude with an aided one, keeping velocity and position. Between batches only
+	void setAttitude(const imu::Quaternion& attitude);
+
+	// Replaces the velocity, m/s navigation frame, for a start that isn't from rest
+	void setVelocity(const double velocity[3]);
+
+	void pushAccel(const accelFIFOBatch& batch);
+
+	// One sample: body rates in rad/s and specific force in m/s^2 held over dt seconds
+	void addSample(const float rate[3], const float force[3], float dt);
+
+	// The attitude, velocity and position update over the samples added since the last one
+	void endBatch();
+
+	// Pairs every gyro sample with accel from the history, adds them and ends the batch
+	void integrate(const gyroFIFOBatch& gyro);
+
+	const insSolution& solution() const { return nav; }
+};
+
+#endif /* STRAPDOWN_H_ */
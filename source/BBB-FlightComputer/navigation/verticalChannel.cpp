@@ -0,0 +1,54 @@
+/*
+ * verticalChannel.cpp
+ *	Baro-inertial vertical channel, see verticalChannel.h.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "verticalChannel.h"
+
+VerticalChannel::VerticalChannel() {
+	setTimeConstant(VERTICAL_TIME_CONSTANT);
+	reset(0);
+}
+
+void VerticalChannel::reset(float altitude) {
+	this->altitude = baroAltitude = altitude;
+	climbRate = 0;
+	accelBias = 0;
+	started = false;
+}
+
+// (s + 1/T)^3 = s^3 + k1 s^2 + k2 s + k3
+void VerticalChannel::setTimeConstant(float seconds) {
+	if(seconds <= 0)
+		seconds = VERTICAL_TIME_CONSTANT;
+	float w = 1.0f / seconds;
+	k1 = 3.0f * w;
+	k2 = 3.0f * w * w;
+	k3 = w * w * w;
+}
+
+// The error to the latest baro sample is fed back every step, so the filter sees the baro
+// held between its samples rather than a kick at each one
+void VerticalChannel::predict(float accelUp, float dt) {
+	if(dt <= 0 || dt > VERTICAL_MAX_STEP || !started)
+		return;
+	float error = baroAltitude - altitude;
+	accelBias += k3 * error * dt;
+	if(accelBias > VERTICAL_MAX_BIAS) accelBias = VERTICAL_MAX_BIAS;
+	if(accelBias < -VERTICAL_MAX_BIAS) accelBias = -VERTICAL_MAX_BIAS;
+
+	float climbBefore = climbRate;
+	climbRate += (accelUp + accelBias + k2 * error) * dt;
+	altitude += (0.5f * (climbBefore + climbRate) + k1 * error) * dt;
+}
+
+void VerticalChannel::correct(float baroAltitude) {
+	this->baroAltitude = baroAltitude;
+	if(!started) {
+		altitude = baroAltitude;
+		started = true;
+	}
+}
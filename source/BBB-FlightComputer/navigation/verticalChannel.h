@@ -0,0 +1,56 @@
+/*
+ * verticalChannel.h
+ *	Baro-inertial vertical channel: altitude and climb rate from the earth frame vertical
+ *	acceleration of the INS, at its rate, held to the barometric altitude by a third order
+ *	complementary filter. The accel carries the fast part and the baro the slow part, so the
+ *	output has neither the baro's noise and lag nor the drift of the integrated accel. The
+ *	third state learns the vertical accel bias, so a steady bias leaves no altitude error.
+ *
+ *	The gains are those of a critically damped loop with all three poles at -1/timeConstant.
+ *	Longer smooths more baro noise and leans on the accel for longer.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ *
+ *  Reference:
+ *  	Widnall & Sinha, Optimizing the Gains of the Baro-Inertial Vertical Channel, Journal of
+ *  	Guidance and Control 3(2), 1980
+ */
+
+#ifndef VERTICALCHANNEL_H_
+#define VERTICALCHANNEL_H_
+
+#define VERTICAL_TIME_CONSTANT		2.0f	// s
+#define VERTICAL_MAX_STEP			0.1f	// s, longer steps are a stall and not integrated
+#define VERTICAL_MAX_BIAS			2.0f	// m/s^2, the learned accel bias is held within this
+
+class VerticalChannel {
+
+private:
+
+	float altitude;		// m
+	float climbRate;	// m/s, up
+	float accelBias;	// m/s^2, added to the accel
+	float baroAltitude;	// m, the latest baro sample
+	float k1, k2, k3;	// Altitude, climb rate and bias gains
+	bool started;		// Has had a baro sample
+
+public:
+
+	VerticalChannel();
+
+	void reset(float altitude);	// At rest at the given altitude
+	void setTimeConstant(float seconds);
+
+	// Integrates dt seconds of upward acceleration, gravity removed, in m/s^2
+	void predict(float accelUp, float dt);
+
+	// A new baro altitude. The first one after reset() starts the filter there
+	void correct(float baroAltitude);
+
+	float getAltitude() const { return altitude; }
+	float getClimbRate() const { return climbRate; }
+	float getAccelBias() const { return accelBias; }
+};
+
+#endif /* VERTICALCHANNEL_H_ */
@@ -0,0 +1,247 @@
+/*
+ * allocTrack.cpp
+ *	Allocation tracking test mode, see allocTrack.h. Only built into the program with
+ *	ALLOC_TRACKING; nothing here may allocate on the way through malloc.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "allocTrack.h"
+
+#ifdef ALLOC_TRACKING
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <execinfo.h>
+#include <sys/syscall.h>
+#include <new>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void __libc_free(void* p);
+}
+
+using namespace std;
+
+// Dynamic exception specifications are gone from C++17
+#if __cplusplus < 201103L
+#define THROWS_BAD_ALLOC	throw(bad_alloc)
+#define THROWS_NOTHING		throw()
+#else
+#define THROWS_BAD_ALLOC
+#define THROWS_NOTHING		noexcept
+#endif
+
+struct threadAllocs {
+	long tid;		// 0 in the last slot, which every thread past ALLOC_TRACK_THREADS shares
+	volatile unsigned long allocations;
+	volatile unsigned long frees;
+	volatile unsigned long errors;	// In a scope after alloc_track_start()
+};
+
+struct allocSite {
+	const char* scope;
+	int depth;
+	void* frames[ALLOC_TRACK_DEPTH];
+	unsigned long count;
+};
+
+static threadAllocs threads[ALLOC_TRACK_THREADS + 1];
+static volatile int threadCount = 0;
+static volatile bool started = false;
+static volatile unsigned long errors = 0;
+
+static allocSite sites[ALLOC_TRACK_SITES];
+static int siteCount = 0;
+static unsigned long sitesDropped = 0;
+static volatile int siteLock = 0;
+
+static __thread int slot = -1;
+static __thread const char* scope = NULL;
+static __thread bool inside = false;	// backtrace() can allocate the first time round
+
+static threadAllocs* self() {
+	if(slot < 0) {
+		int s = __sync_fetch_and_add(&threadCount, 1);
+		if(s < ALLOC_TRACK_THREADS) {
+			threads[s].tid = syscall(SYS_gettid);
+			slot = s;
+		}
+		else
+			slot = ALLOC_TRACK_THREADS;
+	}
+	return &threads[slot];
+}
+
+static void record(const char* name, void* const* frames, int depth) {
+	while(__sync_lock_test_and_set(&siteLock, 1)) {}
+	int i = 0;
+	for(; i < siteCount; i++) {
+		allocSite& s = sites[i];
+		if(s.scope == name && s.depth == depth && memcmp(s.frames, frames, depth * sizeof(void*)) == 0)
+			break;
+	}
+	if(i < siteCount)
+		sites[i].count++;
+	else if(siteCount < ALLOC_TRACK_SITES) {
+		allocSite& s = sites[siteCount++];
+		s.scope = name;
+		s.depth = depth;
+		memcpy(s.frames, frames, depth * sizeof(void*));
+		s.count = 1;
+	}
+	else
+		sitesDropped++;
+	__sync_lock_release(&siteLock);
+}
+
+static void __attribute__((noinline)) counted() {
+	threadAllocs* t = self();
+	__sync_fetch_and_add(&t->allocations, 1);
+	if(!scope || !started || inside)
+		return;
+	inside = true;
+	__sync_fetch_and_add(&t->errors, 1);
+	__sync_fetch_and_add(&errors, 1);
+	void* frames[ALLOC_TRACK_DEPTH + 2];
+	int depth = backtrace(frames, ALLOC_TRACK_DEPTH + 2) - 2;	// Less this and the allocator
+	if(depth > 0)
+		record(scope, frames + 2, depth);
+	inside = false;
+}
+
+static void freed() {
+	__sync_fetch_and_add(&self()->frees, 1);
+}
+
+//----------------------------------------------------------------------------------------------
+// The interposed allocator
+
+extern "C" {
+
+void* malloc(size_t size) {
+	counted();
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+	counted();
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) {
+	counted();
+	return __libc_realloc(p, size);
+}
+
+void free(void* p) {
+	if(p) freed();
+	__libc_free(p);
+}
+
+}
+
+static void* allocate(size_t size) {
+	counted();
+	void* p = __libc_malloc(size ? size : 1);
+	if(!p) throw bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size) THROWS_BAD_ALLOC { return allocate(size); }
+void* operator new[](size_t size) THROWS_BAD_ALLOC { return allocate(size); }
+
+void* operator new(size_t size, const nothrow_t&) THROWS_NOTHING {
+	counted();
+	return __libc_malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const nothrow_t&) THROWS_NOTHING {
+	counted();
+	return __libc_malloc(size ? size : 1);
+}
+
+void operator delete(void* p) THROWS_NOTHING { free(p); }
+void operator delete[](void* p) THROWS_NOTHING { free(p); }
+void operator delete(void* p, const nothrow_t&) THROWS_NOTHING { free(p); }
+void operator delete[](void* p, const nothrow_t&) THROWS_NOTHING { free(p); }
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+#endif
+
+//----------------------------------------------------------------------------------------------
+
+AllocTrackScope::AllocTrackScope(const char* name) {
+	previous = scope;
+	scope = name;
+}
+
+AllocTrackScope::~AllocTrackScope() {
+	scope = previous;
+}
+
+void alloc_track_start() {
+	inside = true;	// Loads the unwinder now, outside any scope
+	void* frames[2];
+	backtrace(frames, 2);
+	inside = false;
+	started = true;
+}
+
+unsigned long alloc_track_errors() {
+	return errors;
+}
+
+void alloc_track_report(ostream& out) {
+	char line[160];
+	out << "Allocations by thread:\n";
+	snprintf(line, sizeof(line), "  %8s %12s %12s %12s\n", "tid", "allocations", "frees", "in hot path");
+	out << line;
+	int n = threadCount < ALLOC_TRACK_THREADS ? threadCount : ALLOC_TRACK_THREADS + 1;
+	for(int i = 0; i < n; i++) {
+		threadAllocs& t = threads[i];
+		if(i == ALLOC_TRACK_THREADS)
+			snprintf(line, sizeof(line), "  %8s %12lu %12lu %12lu\n", "others", t.allocations, t.frees, t.errors);
+		else
+			snprintf(line, sizeof(line), "  %8ld %12lu %12lu %12lu\n", t.tid, t.allocations, t.frees, t.errors);
+		out << line;
+	}
+	if(!started)
+		out << "Tracking never started, the warm-up didn't finish\n";
+	else if(!errors)
+		out << "No allocations in the hot path after the warm-up\n";
+	else {
+		snprintf(line, sizeof(line), "%lu allocations in the hot path after the warm-up, from:\n", (unsigned long)errors);
+		out << line;
+	}
+
+	while(__sync_lock_test_and_set(&siteLock, 1)) {}
+	for(int i = 0; i < siteCount; i++) {
+		allocSite& s = sites[i];
+		snprintf(line, sizeof(line), "  %lu in %s\n", s.count, s.scope);
+		out << line;
+		char** symbols = backtrace_symbols(s.frames, s.depth);
+		for(int f = 0; f < s.depth; f++) {
+			if(symbols) out << "      " << symbols[f] << "\n";
+			else {
+				snprintf(line, sizeof(line), "      %p\n", s.frames[f]);
+				out << line;
+			}
+		}
+		if(symbols) __libc_free(symbols);	// Not counted, it isn't the flight code's
+	}
+	if(sitesDropped) {
+		snprintf(line, sizeof(line), "  and %lu from stacks past the first %d\n", sitesDropped, ALLOC_TRACK_SITES);
+		out << line;
+	}
+	__sync_lock_release(&siteLock);
+	out << flush;
+}
+
+#endif
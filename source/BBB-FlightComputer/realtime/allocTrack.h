@@ -0,0 +1,63 @@
+/*
+ * allocTrack.h
+ *	Allocation tracking test mode. Built with ALLOC_TRACKING, allocTrack.cpp interposes
+ *	malloc, calloc, realloc and operator new (glibc: they forward to __libc_malloc and
+ *	friends) and counts every call per thread. ALLOC_TRACK_SCOPE("name") marks a block as
+ *	hot path: the rate group executive wraps each task run in one, so the whole control
+ *	cycle is covered. Once alloc_track_start() is called, after the warm-up, every
+ *	allocation inside a scope is an error; its scope and call stack are kept in a fixed
+ *	table, and alloc_track_report() prints them with the per-thread totals. Link with
+ *	-rdynamic so the stacks have names, or feed the addresses to addr2line.
+ *
+ *	Without ALLOC_TRACKING the scopes compile out, the functions do nothing and
+ *	alloc_track_enabled() is false, so callers need no #ifdefs.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef ALLOCTRACK_H_
+#define ALLOCTRACK_H_
+
+#include <iostream>
+
+#define ALLOC_TRACK_WARMUP_SECONDS	2		// Flight code allocates freely until this far in
+#define ALLOC_TRACK_THREADS			32
+#define ALLOC_TRACK_SITES			64		// Distinct offending stacks kept
+#define ALLOC_TRACK_DEPTH			8		// Frames kept per stack
+
+#ifdef ALLOC_TRACKING
+
+class AllocTrackScope {
+
+private:
+
+	const char* previous;
+
+public:
+
+	AllocTrackScope(const char* name);
+	~AllocTrackScope();
+};
+
+#define ALLOC_TRACK_CONCAT2(a, b)	a##b
+#define ALLOC_TRACK_CONCAT(a, b)	ALLOC_TRACK_CONCAT2(a, b)
+#define ALLOC_TRACK_SCOPE(name)		AllocTrackScope ALLOC_TRACK_CONCAT(allocTrackScope, __LINE__)(name)
+
+inline bool alloc_track_enabled() { return true; }
+void alloc_track_start();				// Allocations in scopes are errors from here on
+unsigned long alloc_track_errors();		// Allocations in scopes since alloc_track_start()
+void alloc_track_report(std::ostream& out);
+
+#else
+
+#define ALLOC_TRACK_SCOPE(name)	((void)0)
+
+inline bool alloc_track_enabled() { return false; }
+inline void alloc_track_start() {}
+inline unsigned long alloc_track_errors() { return 0; }
+inline void alloc_track_report(std::ostream&) {}
+
+#endif
+
+#endif /* ALLOCTRACK_H_ */
@@ -0,0 +1,225 @@
+/*
+ * console.cpp
+ *	Lock-free line queue, status seqlock and the printer thread behind them.
+ *
+ *	The queue is a bounded multi-producer ring in the style of Vyukov's: each slot carries
+ *	a sequence number saying whether it is free for the producer at that position or full
+ *	for the consumer, producers claim positions with a compare and swap, and the single
+ *	consumer (the printer) needs no atomics at all.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "console.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+struct consoleSlot {
+	volatile unsigned long sequence;
+	char text[CONSOLE_LINE_LENGTH];
+};
+
+static consoleSlot queue[CONSOLE_QUEUE_LINES];
+static volatile unsigned long enqueuePosition = 0;
+static unsigned long dequeuePosition = 0;	// Printer only
+static volatile unsigned long dropped = 0;
+
+static char status[CONSOLE_STATUS_SIZE];
+static volatile int statusSize = 0;
+static volatile unsigned long statusSequence = 0;	// Odd while the block is being written
+
+static volatile bool running = false;
+static volatile bool stopping = false;
+static pthread_t printer;
+static float refreshHz = CONSOLE_DEFAULT_HZ;
+static consoleStatusFormatter formatStatus = NULL;
+
+// Printer state
+static unsigned long printedSequence = 0;
+static unsigned long reportedDrops = 0;
+static char lastLine[CONSOLE_LINE_LENGTH];
+static unsigned long repeats = 0;
+
+void console_print(const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+
+	if(!running) {
+		char line[CONSOLE_LINE_LENGTH];
+		vsnprintf(line, sizeof(line), format, args);
+		va_end(args);
+		cout << line << endl;
+		return;
+	}
+
+	consoleSlot* slot;
+	unsigned long position = enqueuePosition;
+	for(;;) {
+		slot = &queue[position & (CONSOLE_QUEUE_LINES - 1)];
+		long difference = (long)(slot->sequence - position);
+		if(difference == 0) {	// Free, try to claim it
+			if(__sync_bool_compare_and_swap(&enqueuePosition, position, position + 1))
+				break;
+			position = enqueuePosition;
+		}
+		else if(difference < 0) {	// Full, the printer hasn't got this far
+			__sync_fetch_and_add(&dropped, 1);
+			va_end(args);
+			return;
+		}
+		else {	// Another producer claimed it first
+			position = enqueuePosition;
+		}
+	}
+
+	vsnprintf(slot->text, CONSOLE_LINE_LENGTH, format, args);
+	va_end(args);
+	__sync_synchronize();	// Text complete before the slot is handed over
+	slot->sequence = position + 1;
+}
+
+void console_publish_status(const void* block, int size) {
+	if(size > CONSOLE_STATUS_SIZE) size = CONSOLE_STATUS_SIZE;
+	statusSequence = statusSequence + 1;
+	__sync_synchronize();
+	memcpy(status, block, size);
+	statusSize = size;
+	__sync_synchronize();
+	statusSequence = statusSequence + 1;
+
+	if(!running && formatStatus) {
+		formatStatus(status, cout);
+		cout << flush;
+	}
+}
+
+unsigned long console_get_dropped() {
+	return dropped;
+}
+
+static bool takeLine(char line[]) {
+	consoleSlot* slot = &queue[dequeuePosition & (CONSOLE_QUEUE_LINES - 1)];
+	if(slot->sequence != dequeuePosition + 1)
+		return false;
+	__sync_synchronize();
+	memcpy(line, slot->text, CONSOLE_LINE_LENGTH);
+	line[CONSOLE_LINE_LENGTH - 1] = 0;
+	__sync_synchronize();	// Copied out before the slot is free again
+	slot->sequence = dequeuePosition + CONSOLE_QUEUE_LINES;
+	dequeuePosition++;
+	return true;
+}
+
+static void printRepeats() {
+	if(repeats)
+		cout << "(last line repeated " << repeats << " times)\n";
+	repeats = 0;
+}
+
+static void printStatus() {
+	char block[CONSOLE_STATUS_SIZE];
+	for(int attempt = 0; attempt < 4; attempt++) {
+		unsigned long before = statusSequence;
+		if(before == printedSequence || (before & 1))
+			return;	// Nothing new, or mid write (it'll be there next time)
+		__sync_synchronize();
+		memcpy(block, status, statusSize);
+		__sync_synchronize();
+		if(statusSequence == before) {
+			printedSequence = before;
+			formatStatus(block, cout);
+			return;
+		}
+	}
+}
+
+static void printPending(bool everything) {
+	if(formatStatus)
+		printStatus();
+
+	char line[CONSOLE_LINE_LENGTH];
+	for(int n = 0; (everything || n < CONSOLE_LINES_PER_WAKE) && takeLine(line); n++) {
+		if(strcmp(line, lastLine) == 0) {
+			repeats++;
+			continue;
+		}
+		printRepeats();
+		cout << line << '\n';
+		memcpy(lastLine, line, CONSOLE_LINE_LENGTH);
+	}
+	printRepeats();
+
+	unsigned long lost = dropped;
+	if(lost != reportedDrops) {
+		cout << "(" << lost - reportedDrops << " console lines dropped)\n";
+		reportedDrops = lost;
+	}
+	cout << flush;
+}
+
+static void* printerThread(void*) {
+	setpriority(PRIO_PROCESS, syscall(SYS_gettid), CONSOLE_NICE);	// Per thread on Linux
+
+	timespec period;
+	period.tv_sec = (time_t)(1.0f / refreshHz);
+	period.tv_nsec = (long)((1.0f / refreshHz - period.tv_sec) * 1e9f);
+	while(!stopping) {
+		printPending(false);
+		nanosleep(&period, NULL);
+	}
+	return NULL;
+}
+
+int console_start(float statusHz, consoleStatusFormatter formatter) {
+	if(running)
+		return 0;
+	refreshHz = statusHz > 0 ? statusHz : CONSOLE_DEFAULT_HZ;
+	formatStatus = formatter;
+
+	for(int i = 0; i < CONSOLE_QUEUE_LINES; i++)
+		queue[i].sequence = i;
+	enqueuePosition = 0;
+	dequeuePosition = 0;
+	lastLine[0] = 0;
+	repeats = 0;
+	printedSequence = statusSequence;
+	stopping = false;
+
+	// Explicitly SCHED_OTHER, the printer must not inherit the flight loop's SCHED_FIFO
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	sched_param p;
+	p.sched_priority = 0;
+	pthread_attr_setschedparam(&attr, &p);
+
+	running = true;
+	__sync_synchronize();
+	if(pthread_create(&printer, &attr, printerThread, NULL) != 0) {
+		running = false;
+		pthread_attr_destroy(&attr);
+		cout << "Failed to start the console printer, printing directly" << endl;
+		return 1;
+	}
+	pthread_attr_destroy(&attr);
+	return 0;
+}
+
+void console_stop() {
+	if(!running)
+		return;
+	stopping = true;
+	pthread_join(printer, NULL);
+	printPending(true);
+	running = false;
+}
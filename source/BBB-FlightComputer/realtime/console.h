@@ -0,0 +1,45 @@
+/*
+ * console.h
+ *	Console output from the flight loop without the flight loop ever touching the terminal.
+ *	Two paths lead to a low priority printer thread:
+ *
+ *	console_print() formats a line straight into a slot of a bounded lock-free queue. Any
+ *	thread may print. When the queue is full the line is dropped and counted rather than
+ *	waited for, so a slow serial console costs lines, never cycle time. The printer shows
+ *	runs of an identical line once with a repeat count.
+ *
+ *	console_publish_status() copies a plain data status block (sensor readings etc.) into
+ *	a seqlock. The printer formats the newest block with the formatter given to
+ *	console_start() at most statusHz times a second, so updates in between coalesce and
+ *	the formatting cost lands on the printer, not the control thread. One thread publishes.
+ *
+ *	Before console_start() and after console_stop() both print directly to cout, so setup
+ *	code, tools and replays keep working unchanged.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef CONSOLE_H_
+#define CONSOLE_H_
+
+#include <iostream>
+
+#define CONSOLE_LINE_LENGTH		128		// Longer lines are truncated
+#define CONSOLE_QUEUE_LINES		64		// Power of two
+#define CONSOLE_STATUS_SIZE		256		// Bytes of status block
+#define CONSOLE_DEFAULT_HZ		5		// Status refreshes per second
+#define CONSOLE_LINES_PER_WAKE	16		// Lines printed per refresh, the rest wait (or drop)
+#define CONSOLE_NICE			19
+
+typedef void (*consoleStatusFormatter)(const void* status, std::ostream& out);
+
+int console_start(float statusHz, consoleStatusFormatter formatter);
+void console_stop();	// Prints what is still queued, then returns to direct output
+
+void console_print(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void console_publish_status(const void* status, int size);
+
+unsigned long console_get_dropped();	// Lines lost to a full queue
+
+#endif /* CONSOLE_H_ */
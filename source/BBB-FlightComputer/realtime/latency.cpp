@@ -0,0 +1,159 @@
+/*
+ * latency.cpp
+ *	Per-stage latency histograms, their registry and the SIGUSR1 report.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "latency.h"
+#include <string.h>
+#include <stdio.h>
+#include <signal.h>
+#include <pthread.h>
+
+using namespace std;
+
+static LatencyHistogram stages[LATENCY_MAX_STAGES];
+static volatile int stageCount = 0;
+static pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+
+void LatencyHistogram::init(const char* n) {
+	strncpy(name, n, LATENCY_NAME_LENGTH - 1);
+	name[LATENCY_NAME_LENGTH - 1] = 0;
+	reset();
+}
+
+void LatencyHistogram::reset() {
+	for(int i = 0; i < LATENCY_BUCKETS; i++)
+		buckets[i] = 0;
+	count = 0;
+	maximum = 0;
+}
+
+void LatencyHistogram::merge(LatencyHistogram& other) {
+	for(int i = 0; i < LATENCY_BUCKETS; i++)
+		buckets[i] = buckets[i] + other.buckets[i];
+	count = count + other.count;
+	if(other.maximum > maximum) maximum = other.maximum;
+}
+
+uint64_t LatencyHistogram::bucketLow(int bucket) {
+	if(bucket < LATENCY_SUB_BUCKETS)
+		return bucket;
+	int group = bucket / LATENCY_SUB_BUCKETS;
+	int sub = bucket % LATENCY_SUB_BUCKETS;
+	return (uint64_t)(LATENCY_SUB_BUCKETS + sub) << (group - 1);
+}
+
+uint64_t LatencyHistogram::bucketHigh(int bucket) {
+	if(bucket < LATENCY_SUB_BUCKETS)
+		return bucket + 1;
+	return bucketLow(bucket) + (1ULL << (bucket / LATENCY_SUB_BUCKETS - 1));
+}
+
+uint64_t LatencyHistogram::percentile(double p) {
+	uint32_t snapshot[LATENCY_BUCKETS];
+	uint64_t total = 0;
+	for(int i = 0; i < LATENCY_BUCKETS; i++) {	// Copy first so the walk sees one consistent total
+		snapshot[i] = buckets[i];
+		total += snapshot[i];
+	}
+	if(total == 0)
+		return 0;
+
+	uint64_t rank = (uint64_t)(p * total + 0.5);
+	if(rank < 1) rank = 1;
+	if(rank > total) rank = total;
+
+	uint64_t seen = 0;
+	for(int i = 0; i < LATENCY_BUCKETS; i++) {
+		seen += snapshot[i];
+		if(seen >= rank) {
+			uint64_t high = bucketHigh(i) - 1;
+			return high < maximum ? high : maximum;	// The max is exact, buckets are not
+		}
+	}
+	return maximum;
+}
+
+LatencyHistogram* latency_stage(const char* name) {
+	pthread_mutex_lock(&registryLock);
+	LatencyHistogram* found = NULL;
+	for(int i = 0; i < stageCount && !found; i++)
+		if(strncmp(stages[i].getName(), name, LATENCY_NAME_LENGTH - 1) == 0)
+			found = &stages[i];
+
+	if(!found) {
+		if(stageCount < LATENCY_MAX_STAGES) {
+			found = &stages[stageCount];
+			found->init(name);
+			__sync_synchronize();	// Initialised before readers can see it
+			stageCount = stageCount + 1;
+		}
+		else {	// Out of slots; everything else shares the last one
+			found = &stages[LATENCY_MAX_STAGES - 1];
+		}
+	}
+	pthread_mutex_unlock(&registryLock);
+	return found;
+}
+
+int latency_stage_count() {
+	return stageCount;
+}
+
+LatencyHistogram* latency_stage_at(int index) {
+	return (index >= 0 && index < stageCount) ? &stages[index] : NULL;
+}
+
+void latency_report(ostream& out) {
+	char line[128];
+	snprintf(line, sizeof(line), "%-28s %10s %10s %10s %10s\n", "stage", "count", "p50 ns", "p99 ns", "max ns");
+	out << line;
+	int n = stageCount;
+	for(int i = 0; i < n; i++) {
+		LatencyHistogram& h = stages[i];
+		snprintf(line, sizeof(line), "%-28.*s %10lu %10llu %10llu %10lu\n", LATENCY_NAME_LENGTH, h.getName(),
+				(unsigned long)h.getCount(), (unsigned long long)h.percentile(0.50),
+				(unsigned long long)h.percentile(0.99), (unsigned long)h.getMax());
+		out << line;
+	}
+	out << flush;
+}
+
+void latency_reset() {
+	int n = stageCount;
+	for(int i = 0; i < n; i++)
+		stages[i].reset();
+}
+
+static void* dumpThread(void* arg) {
+	sigset_t* set = (sigset_t*)arg;
+	for(;;) {
+		int signal;
+		if(sigwait(set, &signal) == 0 && signal == SIGUSR1)
+			latency_report(cout);
+	}
+	return NULL;
+}
+
+int latency_start_dump_thread() {
+	static sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+
+	// Threads started from here on inherit the mask, so only the dump thread takes SIGUSR1
+	if(pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) {
+		cout << "Failed to block SIGUSR1 for the latency report" << endl;
+		return 1;
+	}
+
+	pthread_t thread;
+	if(pthread_create(&thread, NULL, dumpThread, &set) != 0) {
+		cout << "Failed to start the latency report thread" << endl;
+		return 2;
+	}
+	pthread_detach(thread);
+	return 0;
+}
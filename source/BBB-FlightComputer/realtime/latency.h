@@ -0,0 +1,112 @@
+/*
+ * latency.h
+ *	Per-stage latency instrumentation. LATENCY_SCOPE("name") at the top of a block times the
+ *	rest of the block into the histogram registered under that name; call sites sharing a
+ *	name share the histogram. Stages nest, so an outer stage includes the inner ones.
+ *
+ *	Histograms are log-linear: 16 linear sub-buckets per power of two of nanoseconds, so
+ *	every reading is within 1/16 of the truth, from 1 ns to ~4 s, in fixed memory. A stage
+ *	has one writer (the thread that runs it) and any number of readers. Buckets are plain
+ *	aligned words, so recording needs no lock and no atomic read-modify-write, and readers
+ *	may see a sample in the count before it reaches its bucket, never a torn value.
+ *
+ *	latency_start_dump_thread() prints every stage's p50/p99/max whenever the process gets
+ *	SIGUSR1, from a thread of its own so the flight loop never does the printing.
+ *	Build with LATENCY_DISABLED to compile every LATENCY_SCOPE out.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+#include <time.h>
+#include <iostream>
+
+#define LATENCY_SUB_BITS		4
+#define LATENCY_SUB_BUCKETS		(1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_BIT			31		// Samples of 2^32 ns and above land in the last bucket
+#define LATENCY_BUCKETS			((LATENCY_MAX_BIT - LATENCY_SUB_BITS + 2) * LATENCY_SUB_BUCKETS)
+#define LATENCY_MAX_STAGES		32
+#define LATENCY_NAME_LENGTH		32
+
+inline uint64_t latency_now() {	// ns, CLOCK_MONOTONIC (real time even during replay)
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+class LatencyHistogram {
+
+private:
+
+	char name[LATENCY_NAME_LENGTH];
+	volatile uint32_t buckets[LATENCY_BUCKETS];
+	volatile uint32_t count;
+	volatile uint32_t maximum;	// ns
+
+	static int bucketOf(uint32_t ns) {
+		if(ns < LATENCY_SUB_BUCKETS)
+			return ns;
+		int msb = 31 - __builtin_clz(ns);
+		return (msb - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS + ((ns >> (msb - LATENCY_SUB_BITS)) & (LATENCY_SUB_BUCKETS - 1));
+	}
+
+public:
+
+	void init(const char* name);
+	const char* getName() { return name; }
+
+	void record(uint64_t ns) {
+		uint32_t v = ns > 0xFFFFFFFFULL ? 0xFFFFFFFFU : (uint32_t)ns;
+		int b = bucketOf(v);
+		buckets[b] = buckets[b] + 1;	// Single writer, so no read-modify-write race
+		count = count + 1;
+		if(v > maximum) maximum = v;
+	}
+
+	static uint64_t bucketLow(int bucket);
+	static uint64_t bucketHigh(int bucket);	// Exclusive
+
+	uint32_t getCount() { return count; }
+	uint32_t getMax() { return maximum; }
+	uint32_t getBucket(int bucket) { return buckets[bucket]; }
+	uint64_t percentile(double p);	// ns, upper edge of the bucket holding the p-th sample (0-1)
+	void reset();	// Only from the writer thread, or while it is stopped
+	void merge(LatencyHistogram& other);	// Adds other's samples, same threading rule as reset()
+};
+
+class ScopedLatency {
+
+private:
+
+	LatencyHistogram* histogram;
+	uint64_t start;
+
+public:
+
+	ScopedLatency(LatencyHistogram* h) : histogram(h), start(latency_now()) {}
+	~ScopedLatency() { histogram->record(latency_now() - start); }
+};
+
+LatencyHistogram* latency_stage(const char* name);	// Registers on first use
+int latency_stage_count();
+LatencyHistogram* latency_stage_at(int index);
+void latency_report(std::ostream& out);
+void latency_reset();
+int latency_start_dump_thread();	// Blocks SIGUSR1 in the caller; call before starting other threads
+
+#define LATENCY_CONCAT2(a, b)	a##b
+#define LATENCY_CONCAT(a, b)	LATENCY_CONCAT2(a, b)
+
+#ifndef LATENCY_DISABLED
+#define LATENCY_SCOPE(name)																		\
+	static LatencyHistogram* const LATENCY_CONCAT(latencyStage, __LINE__) = latency_stage(name);	\
+	ScopedLatency LATENCY_CONCAT(latencyScope, __LINE__)(LATENCY_CONCAT(latencyStage, __LINE__))
+#else
+#define LATENCY_SCOPE(name)	((void)0)
+#endif
+
+#endif /* LATENCY_H_ */
@@ -0,0 +1,215 @@
+/*
+ * rateGroups.cpp
+ *	Static schedule rate group executive, see rateGroups.h.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "rateGroups.h"
+#include "allocTrack.h"
+#include <stdio.h>
+#include <math.h>
+
+using namespace std;
+
+static int gcd(int a, int b) {
+	while(b) {
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+RateGroupExecutive::RateGroupExecutive(float rateHz) : loop(rateHz) {
+	baseRateHz = rateHz;
+	periodNs = (uint64_t)(1e9 / rateHz);
+	taskCount = 0;
+	frames = 1;
+	frame = 0;
+	longestFrame = 0;
+	built = false;
+	for(int f = 0; f < RATE_GROUP_MAX_FRAMES; f++) {
+		scheduled[f] = 0;
+		frameBudget[f] = 0;
+	}
+}
+
+int RateGroupExecutive::addTask(const char* name, float rateHz, rateTaskFunction run, void* context,
+		float budgetMicroseconds, int flags) {
+	if(taskCount >= RATE_GROUP_MAX_TASKS) {
+		cout << "Failed to add task " << name << ", the executive is full" << endl;
+		return -1;
+	}
+	int divider = rateHz > 0 ? (int)lrintf(baseRateHz / rateHz) : 0;
+	if(divider < 1 || divider > RATE_GROUP_MAX_FRAMES || fabsf(baseRateHz / divider - rateHz) > rateHz * 1e-3f) {
+		cout << "Failed to add task " << name << ": " << rateHz << " Hz doesn't divide the " <<
+				baseRateHz << " Hz base rate" << endl;
+		return -1;
+	}
+
+	rateTask& t = tasks[taskCount];
+	t.name = name;
+	t.run = run;
+	t.context = context;
+	t.rateHz = rateHz;
+	t.divider = divider;
+	t.phase = 0;
+	t.budgetNs = (uint64_t)(budgetMicroseconds * 1000);
+	t.flags = flags;
+	t.runs = 0;
+	t.overBudget = 0;
+	t.shed = 0;
+	t.missed = 0;
+	t.time.init(name);
+	built = false;
+	return taskCount++;
+}
+
+int RateGroupExecutive::build() {
+	built = false;
+	int major = 1;
+	for(int i = 0; i < taskCount; i++) {
+		major = major / gcd(major, tasks[i].divider) * tasks[i].divider;
+		if(major > RATE_GROUP_MAX_FRAMES) {
+			cout << "Task rates need a major frame of more than " << RATE_GROUP_MAX_FRAMES << " frames at " <<
+					baseRateHz << " Hz" << endl;
+			frames = 1;	// An empty schedule, so nothing indexes past the table
+			scheduled[0] = 0;
+			frameBudget[0] = 0;
+			return -1;
+		}
+	}
+	frames = major;
+	for(int f = 0; f < frames; f++) {
+		scheduled[f] = 0;
+		frameBudget[f] = 0;
+	}
+
+	// Fastest first, each at the phase whose busiest frame is least loaded so far
+	bool placed[RATE_GROUP_MAX_TASKS] = { false };
+	for(int n = 0; n < taskCount; n++) {
+		int next = -1;
+		for(int i = 0; i < taskCount; i++)
+			if(!placed[i] && (next < 0 || tasks[i].divider < tasks[next].divider)) next = i;
+		rateTask& t = tasks[next];
+		placed[next] = true;
+
+		uint64_t best = ~0ULL;
+		for(int phase = 0; phase < t.divider; phase++) {
+			uint64_t busiest = 0;
+			for(int f = phase; f < frames; f += t.divider)
+				if(frameBudget[f] > busiest) busiest = frameBudget[f];
+			if(busiest < best) {
+				best = busiest;
+				t.phase = phase;
+			}
+		}
+		for(int f = t.phase; f < frames; f += t.divider)
+			frameBudget[f] += t.budgetNs;
+	}
+
+	// Each frame runs its tasks in the order they were added
+	for(int f = 0; f < frames; f++)
+		for(int i = 0; i < taskCount; i++)
+			if(f % tasks[i].divider == tasks[i].phase)
+				schedule[f][scheduled[f]++] = (unsigned char)i;
+
+	frame = 0;
+	built = true;
+	int overloaded = 0;
+	for(int f = 0; f < frames; f++)
+		if(frameBudget[f] > periodNs) overloaded++;
+	if(overloaded)
+		cout << overloaded << " of " << frames << " frames are budgeted past their " << periodNs / 1000 <<
+				" us period, their last tasks will be shed" << endl;
+	return overloaded;
+}
+
+void RateGroupExecutive::countMissed(unsigned long firstFrame, unsigned long count) {
+	unsigned long whole = count / frames;	// Whole major frames, every task missed frames / divider runs
+	if(whole)
+		for(int i = 0; i < taskCount; i++)
+			tasks[i].missed += whole * (frames / tasks[i].divider);
+	for(unsigned long k = whole * frames; k < count; k++) {
+		int f = (firstFrame + k) % frames;
+		for(int j = 0; j < scheduled[f]; j++)
+			tasks[schedule[f][j]].missed++;
+	}
+}
+
+void RateGroupExecutive::runFrame() {
+	bool first = loop.getCycles() == 0;
+	unsigned long skipped = loop.waitForNextCycle();
+	if(!first) {
+		if(skipped) countMissed(frame + 1, skipped);
+		frame += 1 + skipped;
+	}
+
+	if(!built)	// Nothing to run until build() succeeds
+		return;
+
+	uint64_t woke = latency_now();
+	uint64_t start = loop.now();
+	int f = frame % frames;
+	for(int j = 0; j < scheduled[f]; j++) {
+		rateTask& t = tasks[schedule[f][j]];
+		uint64_t now = loop.now();
+		uint64_t used = now > start ? now - start : 0;	// Replayed reads can set virtual time back
+		if(!(t.flags & RATE_TASK_CRITICAL) && used + t.budgetNs > periodNs) {
+			t.shed++;
+			continue;
+		}
+		uint64_t began = latency_now();
+		{
+			ALLOC_TRACK_SCOPE(t.name);
+			t.run(t.context);
+		}
+		uint64_t took = latency_now() - began;
+		t.time.record(took);
+		t.runs++;
+		if(took > t.budgetNs) t.overBudget++;
+	}
+	uint64_t busy = latency_now() - woke;
+	if(busy > longestFrame) longestFrame = busy;
+}
+
+uint64_t RateGroupExecutive::takeLongestFrame() {
+	uint64_t longest = longestFrame;
+	longestFrame = 0;
+	return longest;
+}
+
+void RateGroupExecutive::printSchedule(ostream& out) {
+	char line[160];
+	uint64_t peak = 0;
+	for(int f = 0; f < frames; f++)
+		if(frameBudget[f] > peak) peak = frameBudget[f];
+	snprintf(line, sizeof(line), "Rate groups: %g Hz base, %d frame major frame, peak frame budget %.0f of %.0f us\n",
+			baseRateHz, frames, peak / 1e3, periodNs / 1e3);
+	out << line;
+	for(int i = 0; i < taskCount; i++) {
+		rateTask& t = tasks[i];
+		snprintf(line, sizeof(line), "  %-20s %7.1f Hz  every %3d frames from %3d  budget %7.0f us%s\n", t.name,
+				t.rateHz, t.divider, t.phase, t.budgetNs / 1e3, t.flags & RATE_TASK_CRITICAL ? "  critical" : "");
+		out << line;
+	}
+	out << flush;
+}
+
+void RateGroupExecutive::report(ostream& out) {
+	loop.report(out);
+	char line[192];
+	snprintf(line, sizeof(line), "%-20s %8s %9s %10s %9s %9s %9s %8s %8s %8s\n", "task", "Hz", "budget us",
+			"runs", "p50 us", "p99 us", "max us", "over", "shed", "missed");
+	out << line;
+	for(int i = 0; i < taskCount; i++) {
+		rateTask& t = tasks[i];
+		snprintf(line, sizeof(line), "%-20s %8.1f %9.0f %10lu %9.1f %9.1f %9.1f %8lu %8lu %8lu\n", t.name, t.rateHz,
+				t.budgetNs / 1e3, t.runs, t.time.percentile(0.5) / 1e3, t.time.percentile(0.99) / 1e3,
+				t.time.getMax() / 1e3, t.overBudget, t.shed, t.missed);
+		out << line;
+	}
+	out << flush;
+}
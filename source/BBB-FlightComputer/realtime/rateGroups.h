@@ -0,0 +1,103 @@
+/*
+ * rateGroups.h
+ *	Rate group executive. Tasks register with a rate that divides the base rate, the RTLoop
+ *	rate the executive's one real-time thread is released at. build() lays them out in a
+ *	static table of minor frames over one major frame (the longest task period): a task of
+ *	divider N runs in every Nth frame from its phase. Phases are chosen fastest task first
+ *	to even out the budgeted load per frame, and within a frame tasks run in the order they
+ *	were added, so add them in priority and data flow order (sensing, estimation, control,
+ *	telemetry).
+ *
+ *	Every task has a time budget. Each run is timed; a run over budget is counted against
+ *	the task. Before a task starts, if the frame has already used so much of its period that
+ *	the task's budget no longer fits, the task is shed for that frame and counted, unless it
+ *	was added RATE_TASK_CRITICAL. That is measured on the loop's clock, so under virtual time
+ *	a run doesn't depend on the host's load: the SITL's bus reads take no time, and a replay's
+ *	take the time they took in flight. A frame that runs past the next release is an RTLoop
+ *	overrun; the frames it skipped don't run at all, and each task due in them counts a
+ *	missed release.
+ *
+ *	Nothing allocates once build() has run, and each task run is an ALLOC_TRACK_SCOPE, so an
+ *	ALLOC_TRACKING build catches any task that does (allocTrack.h).
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef RATEGROUPS_H_
+#define RATEGROUPS_H_
+
+#include "rtLoop.h"
+#include "latency.h"
+#include <iostream>
+
+#define RATE_GROUP_MAX_TASKS	16
+#define RATE_GROUP_MAX_FRAMES	128		// Minor frames per major frame
+
+#define RATE_TASK_CRITICAL		0x01	// Never shed, e.g. the sensor reads the rest depend on
+
+typedef void (*rateTaskFunction)(void* context);
+
+struct rateTask {
+	const char* name;
+	rateTaskFunction run;
+	void* context;
+	float rateHz;
+	int divider;			// Base frames per run
+	int phase;				// First frame it runs in
+	uint64_t budgetNs;
+	int flags;
+
+	unsigned long runs;
+	unsigned long overBudget;	// Runs that took longer than the budget
+	unsigned long shed;			// Frames it was skipped in to protect the deadline
+	unsigned long missed;		// Releases that fell in frames lost to an overrun
+	LatencyHistogram time;		// ns per run
+};
+
+class RateGroupExecutive {
+
+private:
+
+	RTLoop loop;
+	float baseRateHz;
+	uint64_t periodNs;
+	rateTask tasks[RATE_GROUP_MAX_TASKS];
+	int taskCount;
+
+	int frames;		// Per major frame
+	unsigned char schedule[RATE_GROUP_MAX_FRAMES][RATE_GROUP_MAX_TASKS];
+	int scheduled[RATE_GROUP_MAX_FRAMES];	// Tasks in each frame
+	uint64_t frameBudget[RATE_GROUP_MAX_FRAMES];	// ns, sum of the budgets in each frame
+	unsigned long frame;	// Frames released since start, including skipped ones
+	uint64_t longestFrame;	// ns, since the last takeLongestFrame()
+	bool built;
+
+	void countMissed(unsigned long firstFrame, unsigned long count);
+
+public:
+
+	RateGroupExecutive(float baseRateHz);
+
+	// Returns the task's index, or -1 if it doesn't divide the base rate or the table is full
+	int addTask(const char* name, float rateHz, rateTaskFunction run, void* context,
+			float budgetMicroseconds, int flags = 0);
+	// Lays out the schedule. Returns the number of frames whose budgets exceed the period, or -1
+	// if the rates need a major frame longer than RATE_GROUP_MAX_FRAMES, which leaves nothing to run
+	int build();
+
+	int setup(const rtLoopConfig& c) { return loop.setup(c); }
+	void runFrame();	// Waits for the next release, then runs that frame's tasks once built
+
+	RTLoop& getLoop() { return loop; }
+	float getBaseRate() { return baseRateHz; }
+	unsigned long getFrame() { return frame; }
+	uint64_t takeLongestFrame();	// ns from wake to the last task of the longest frame since the last call
+	int getTaskCount() { return taskCount; }
+	const rateTask& getTask(int i) { return tasks[i]; }
+
+	void printSchedule(std::ostream& out);
+	void report(std::ostream& out);
+};
+
+#endif /* RATEGROUPS_H_ */
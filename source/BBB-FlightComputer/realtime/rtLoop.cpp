@@ -0,0 +1,225 @@
+/*
+ * rtLoop.cpp
+ *	Fixed rate real-time executive for the flight loop.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "rtLoop.h"
+#include "../timing.h"
+#include <sched.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+#define NS_PER_SECOND	1000000000ULL
+
+rtHistogram::rtHistogram(const char* n, unsigned long width, const char* u) {
+	name = n;
+	unit = u;
+	binWidth = width > 0 ? width : 1;
+	clear();
+}
+
+void rtHistogram::clear() {
+	memset(bins, 0, sizeof(bins));
+	count = 0;
+	minimum = ~0UL;
+	maximum = 0;
+	sum = 0;
+}
+
+void rtHistogram::record(unsigned long value) {
+	unsigned long bin = value / binWidth;
+	if(bin >= RT_HISTOGRAM_BINS) bin = RT_HISTOGRAM_BINS - 1;
+	bins[bin]++;
+	count++;
+	sum += value;
+	if(value < minimum) minimum = value;
+	if(value > maximum) maximum = value;
+}
+
+void rtHistogram::print(ostream& out) {
+	char line[128];
+	snprintf(line, sizeof(line), "%s: %lu samples, min %lu %s, mean %.1f %s, max %lu %s\n",
+			name, count, count ? minimum : 0, unit, getMean(), unit, maximum, unit);
+	out << line;
+	if(count == 0) return;
+
+	unsigned long tallest = 0;
+	for(int i = 0; i < RT_HISTOGRAM_BINS; i++)
+		if(bins[i] > tallest) tallest = bins[i];
+
+	for(int i = 0; i < RT_HISTOGRAM_BINS; i++) {
+		if(bins[i] == 0) continue;
+		char bar[41];
+		int length = (int)(40.0 * bins[i] / tallest + 0.5);
+		if(length < 1) length = 1;
+		memset(bar, '#', length);
+		bar[length] = 0;
+		if(i == RT_HISTOGRAM_BINS - 1)
+			snprintf(line, sizeof(line), "  %6lu+       %-8s %10lu %s\n", i * binWidth, unit, bins[i], bar);
+		else
+			snprintf(line, sizeof(line), "  %6lu-%-6lu %-8s %10lu %s\n", i * binWidth, (i + 1) * binWidth, unit, bins[i], bar);
+		out << line;
+	}
+}
+
+RTLoop::RTLoop(float rateHz) :
+		cycleTime("Cycle time", 1),
+		wakeLatency("Wake latency", 1),
+		periodJitter("Period jitter", 1),
+		missedPerOverrun("Releases missed per overrun", 1, "releases") {
+	defaultConfig(config, rateHz);
+	period = (uint64_t)(NS_PER_SECOND / rateHz);
+	running = false;
+	nextRelease = lastRelease = lastWake = 0;
+	resetStatistics();
+}
+
+void RTLoop::defaultConfig(rtLoopConfig& c, float rateHz) {
+	c.rateHz = rateHz;
+	c.priority = RT_DEFAULT_PRIORITY;
+	c.cpu = -1;
+	c.lockMemory = true;
+}
+
+static void prefaultStack() {
+	char stack[RT_STACK_PREFAULT];
+	volatile char* page = stack;	// Volatile so the writes aren't optimised away
+	for(int i = 0; i < RT_STACK_PREFAULT; i += 4096)
+		page[i] = 0;
+}
+
+int RTLoop::setup(const rtLoopConfig& c) {
+	config = c;
+	period = (uint64_t)(NS_PER_SECOND / c.rateHz);
+
+	// Histogram bins scale with the period: 50 bins cover 0-2 periods of cycle time and
+	// 0-1/5 of a period of latency and jitter, anything beyond lands in the last bin.
+	unsigned long periodUs = period / 1000;
+	cycleTime = rtHistogram("Cycle time", periodUs / 25);
+	wakeLatency = rtHistogram("Wake latency", periodUs / 250);
+	periodJitter = rtHistogram("Period jitter", periodUs / 250);
+
+	int failed = 0;
+	if(c.lockMemory) {
+		// Keep freed memory in the process and off mmap, so later allocations stay locked
+		mallopt(M_TRIM_THRESHOLD, -1);
+		mallopt(M_MMAP_MAX, 0);
+		if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+			cout << "mlockall failed: " << strerror(errno) << endl;
+			failed++;
+		}
+		prefaultStack();
+	}
+
+	if(c.cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(c.cpu, &set);
+		if(sched_setaffinity(0, sizeof(set), &set) != 0) {
+			cout << "Failed to pin the flight loop to CPU " << c.cpu << ": " << strerror(errno) << endl;
+			failed++;
+		}
+	}
+
+	if(c.priority > 0) {
+		sched_param p;
+		memset(&p, 0, sizeof(p));
+		p.sched_priority = c.priority;
+		if(sched_setscheduler(0, SCHED_FIFO, &p) != 0) {
+			cout << "Failed to set SCHED_FIFO priority " << c.priority << ": " << strerror(errno) << endl;
+			failed++;
+		}
+	}
+
+	running = false;
+	resetStatistics();
+	return failed;
+}
+
+uint64_t RTLoop::now() {
+	if(usingVirtualTime())
+		return (uint64_t)micros() * 1000;
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * NS_PER_SECOND + ts.tv_nsec;
+}
+
+void RTLoop::sleepUntil(uint64_t t) {
+	if(usingVirtualTime()) {
+		if(t / 1000 > micros())
+			setVirtualMicros(t / 1000);
+		return;
+	}
+	timespec ts;
+	ts.tv_sec = t / NS_PER_SECOND;
+	ts.tv_nsec = t % NS_PER_SECOND;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+unsigned long RTLoop::waitForNextCycle() {
+	uint64_t t = now();
+	if(!running) {	// First cycle is released immediately and sets the phase
+		running = true;
+		nextRelease = t;
+		lastWake = t;
+		lastRelease = t;
+		nextRelease += period;
+		cycles++;
+		return 0;
+	}
+
+	cycleTime.record((t - lastWake) / 1000);
+
+	uint64_t missed = 0;
+	if(t > nextRelease) {	// Overran: skip the releases already in the past
+		missed = (t - nextRelease) / period + 1;
+		overruns++;
+		missedReleases += missed;
+		missedPerOverrun.record(missed);
+		nextRelease += missed * period;
+	}
+
+	sleepUntil(nextRelease);
+	uint64_t wake = now();
+
+	wakeLatency.record(wake > nextRelease ? (wake - nextRelease) / 1000 : 0);
+	uint64_t actual = wake - lastWake;
+	uint64_t nominal = nextRelease - lastRelease;
+	periodJitter.record((actual > nominal ? actual - nominal : nominal - actual) / 1000);
+
+	cycles++;
+	lastWake = wake;
+	lastRelease = nextRelease;
+	nextRelease += period;
+	return (unsigned long)missed;
+}
+
+void RTLoop::resetStatistics() {
+	cycles = 0;
+	overruns = 0;
+	missedReleases = 0;
+	cycleTime.clear();
+	wakeLatency.clear();
+	periodJitter.clear();
+	missedPerOverrun.clear();
+}
+
+void RTLoop::report(ostream& out) {
+	char line[160];
+	snprintf(line, sizeof(line), "Flight loop at %.1f Hz: %lu cycles, %lu overruns, %lu missed releases\n",
+			config.rateHz, cycles, overruns, missedReleases);
+	out << line;
+	cycleTime.print(out);
+	wakeLatency.print(out);
+	periodJitter.print(out);
+	if(overruns)
+		missedPerOverrun.print(out);
+}
@@ -0,0 +1,102 @@
+/*
+ * rtLoop.h
+ *	Fixed rate real-time executive for the flight loop. Call setup() once before the loop to
+ *	lock memory, prefault the stack and take SCHED_FIFO priority and a CPU, then
+ *	waitForNextCycle() at the top of every cycle. Cycles are released on an absolute
+ *	CLOCK_MONOTONIC timeline with clock_nanosleep(TIMER_ABSTIME), so a slow cycle never
+ *	pushes the phase of the later ones. A cycle that runs past its deadline is an overrun:
+ *	the missed releases are skipped rather than run back to back, and counted.
+ *
+ *	Under virtual time (replay, simulation) the loop doesn't sleep, it advances micros()
+ *	to each release instead.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef RTLOOP_H_
+#define RTLOOP_H_
+
+#include <time.h>
+#include <stdint.h>
+#include <iostream>
+
+#define RT_DEFAULT_PRIORITY		80		// SCHED_FIFO, above the kernel's I2C and PWM threads
+#define RT_STACK_PREFAULT		(256*1024)	// Bytes of stack touched after mlockall
+#define RT_HISTOGRAM_BINS		50
+
+class rtHistogram {	// Fixed width bins, the last bin collects everything above
+
+private:
+
+	const char* name;
+	const char* unit;
+	unsigned long binWidth;
+	unsigned long bins[RT_HISTOGRAM_BINS];
+	unsigned long count;
+	unsigned long minimum, maximum;
+	double sum;
+
+public:
+
+	rtHistogram(const char* name, unsigned long binWidth, const char* unit = "us");
+
+	void clear();
+	void record(unsigned long value);
+	void print(std::ostream& out);
+
+	unsigned long getCount() { return count; }
+	unsigned long getMax() { return maximum; }
+	double getMean() { return count ? sum / count : 0; }
+};
+
+struct rtLoopConfig {
+	float rateHz;
+	int priority;		// SCHED_FIFO priority, 0 leaves the scheduler alone
+	int cpu;			// CPU to pin to, -1 leaves the affinity alone
+	bool lockMemory;	// mlockall and prefault the stack
+};
+
+class RTLoop {
+
+private:
+
+	rtLoopConfig config;
+	uint64_t period;		// ns
+	uint64_t nextRelease;	// ns on CLOCK_MONOTONIC (or virtual micros() * 1000)
+	uint64_t lastRelease;
+	uint64_t lastWake;
+	bool running;
+
+	unsigned long cycles;
+	unsigned long overruns;		// Cycles that ran past the next release
+	unsigned long missedReleases;	// Releases skipped because of them
+
+	rtHistogram cycleTime;		// Wake to the start of the next wait, the work done per cycle
+	rtHistogram wakeLatency;	// Release to actually running
+	rtHistogram periodJitter;	// |wake to wake - period|
+	rtHistogram missedPerOverrun;
+
+	void sleepUntil(uint64_t t);
+
+public:
+
+	RTLoop(float rateHz);
+
+	static void defaultConfig(rtLoopConfig& c, float rateHz);
+
+	int setup(const rtLoopConfig& c);	// Returns the number of steps that failed (non-root, etc.)
+	unsigned long waitForNextCycle();	// Returns the releases skipped since the last cycle
+	uint64_t now();		// ns, the clock releases are timed on
+
+	float getRate() { return config.rateHz; }
+	float getPeriodSeconds() { return period / 1e9f; }
+	unsigned long getCycles() { return cycles; }
+	unsigned long getOverruns() { return overruns; }
+	unsigned long getMissedReleases() { return missedReleases; }
+
+	void resetStatistics();
+	void report(std::ostream& out);
+};
+
+#endif /* RTLOOP_H_ */
@@ -0,0 +1,113 @@
+/*
+ * replay.cpp
+ *	Runs an I2C recording through the flight tasks with virtual time, see replay.h.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "replay.h"
+#include "../flightControl/flightLoop.h"
+
+using namespace std;
+
+class nullBuffer : public streambuf {	// Swallows the drivers' console chatter
+protected:
+	int overflow(int c) { return c; }
+};
+
+class nullOutput : public PWMOutput {	// The servos aren't there
+public:
+	void setDuty(PWMChannel&, unsigned long) {}
+};
+
+static double nanoseconds() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+void replay_default_settings(replaySettings& s) {
+	s.filter = AHRS_FILTER_MADGWICK;
+	s.beta = FLIGHT_AHRS_BETA;
+	s.kp = 0.5;
+	s.ki = 0.0;
+	s.correctionHz = 100;
+	s.gyroRateHz = FLIGHT_GYRO_RATE_HZ;
+}
+
+unsigned long replay_flight(I2CReplay& replay, const replaySettings& s, replayCallback callback, void* context) {
+	nullBuffer quiet;
+	streambuf* console = cout.rdbuf(&quiet);
+	nullOutput servos;
+	replay.rewind();
+	i2c_set_transport(&replay);
+	pwm_set_output(&servos);
+
+	unsigned long frames = 0;
+	{
+		// Same construction order and tasks as main.cpp, so every read finds its record
+		LMS303 lms303(1, 0x1d);
+		LPS331Altimeter alt(1, 0x5d);
+		L3GD20Gyro gyro(1, 0x6b);
+		gyro.calibrateZeroRate(FLIGHT_GYRO_ZERO_READS);
+
+		// The rest of the setup doesn't touch the bus, but took its time in flight. Carry on
+		// from just before the loop's first read, so the first frame is released where it
+		// was and the AHRS doesn't integrate the gyro samples from the setup
+		if(replay.getNextMicros())
+			setVirtualMicros(replay.getNextMicros() - 1);
+
+		aircraftControls aircraft(FLAP_MIX_ELEVON);
+		aircraft.init();
+
+		uimu_ahrs_set_filter(s.filter);
+		uimu_ahrs_set_beta(s.beta);
+		uimu_ahrs_set_mahony_gains(s.kp, s.ki);
+		uimu_ahrs_set_correction_rate(s.correctionHz);
+		uimu_ahrs_init(lms303.read_acc(), lms303.read_mag());
+
+		AttitudeController controller;
+		FlightRecorder recorder;	// Never opened, the recorder and stream tasks return at once
+		ImuStreamWriter imuStream;
+
+		rtLoopConfig rt;
+		RTLoop::defaultConfig(rt, s.gyroRateHz);
+		rt.priority = 0;	// Offline: no SCHED_FIFO, pinning or locked memory
+		rt.cpu = -1;
+		rt.lockMemory = false;
+
+		RateGroupExecutive executive(s.gyroRateHz);
+		flightTasks tasks;
+		flight_tasks_init(tasks, lms303, alt, gyro, aircraft, controller, recorder, imuStream, executive);
+		if(flight_tasks_add(tasks) == 0 && executive.build() >= 0) {
+			executive.setup(rt);
+			while(!replay.isExhausted()) {
+				size_t gyroReads = replay.getPosition(0x6b), accelReads = replay.getPosition(0x1d);
+				double start = nanoseconds();
+				executive.runFrame();
+				double end = nanoseconds();
+				if(replay.isExhausted())
+					break;
+
+				replayTick tick;
+				tick.micros = (unsigned long long)micros() - replay.getStartMicros();
+				tick.altitude = alt.getAltitude();
+				tick.frameNs = end - start;
+				tick.gyroNew = replay.getPosition(0x6b) != gyroReads && gyro.isGyroNew();
+				tick.accelNew = replay.getPosition(0x1d) != accelReads && lms303.isAccelNew();
+				tick.lms303 = &lms303;
+				tick.gyro = &gyro;
+				tick.alt = &alt;
+				if(callback) callback(tick, context);
+				frames++;
+			}
+		}
+	}
+	replay.finish();
+
+	pwm_set_output(NULL);
+	i2c_set_transport(NULL);
+	cout.rdbuf(console);
+	return frames;
+}
@@ -0,0 +1,54 @@
+/*
+ * replay.h
+ *	Runs an I2C recording through the flight tasks (flightLoop.h) with virtual time. Shared
+ *	by main-replay (one configuration, attitude output) and main-sweep (parameter grids).
+ *
+ *	The tasks run on a rate group executive at the recorded flight's base rate, so each
+ *	device is read in the frames it was read in flight and finds its records in order, and
+ *	micros() follows the recorded times instead of jumping between devices. The servo
+ *	outputs go nowhere.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include "../sensors/i2cTransport.h"
+#include "../AHRS/ahrs.h"
+
+struct replaySettings {
+	UIMU_AHRS_FILTER filter;
+	float beta;			// Madgwick
+	float kp, ki;		// Mahony
+	float correctionHz;	// Accel/mag correction rate of uimu_ahrs_iterate_batch
+	float gyroRateHz;	// Base rate the recording was flown at, BBB-FlightComputer -f
+};
+
+class LMS303;
+class L3GD20Gyro;
+class LPS331Altimeter;
+
+struct replayTick {				// One executive frame
+	unsigned long long micros;	// Since the start of the recording
+	float altitude;				// meters
+	double frameNs;				// The frame's tasks, on the host's clock
+	bool gyroNew;				// The gyro was read this frame and had a new sample
+	bool accelNew;				// Likewise the accelerometer
+	LMS303* lms303;				// The replayed drivers, valid during the callback
+	L3GD20Gyro* gyro;
+	LPS331Altimeter* alt;
+};
+
+// Called after every frame; the attitude is available from the uimu_ahrs_get_* functions
+typedef void (*replayCallback)(const replayTick& tick, void* context);
+
+void replay_default_settings(replaySettings& s);
+
+// Replays from the start of the recording until a device runs out, then counts the records
+// left unread as desyncs. Console output is discarded while it runs. Returns the number of
+// frames, 0 if the tasks don't schedule at s.gyroRateHz.
+unsigned long replay_flight(I2CReplay& replay, const replaySettings& s, replayCallback callback, void* context);
+
+#endif /* REPLAY_H_ */
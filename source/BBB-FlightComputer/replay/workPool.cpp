@@ -0,0 +1,168 @@
+/*
+ * workPool.cpp
+ *	Work stealing pool of forked workers sharing an anonymous mapping.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "workPool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <iostream>
+
+using namespace std;
+
+struct workDeque {	// Jobs [front, back) not yet taken; one cache line each to avoid false sharing
+	volatile int lock;
+	int front;
+	int back;
+	unsigned long steals;
+} __attribute__((aligned(64)));
+
+static void lockDeque(workDeque& d) {
+	while(__sync_lock_test_and_set(&d.lock, 1))
+		sched_yield();
+}
+
+static void unlockDeque(workDeque& d) {
+	__sync_lock_release(&d.lock);
+}
+
+static int takeFront(workDeque& d) {
+	lockDeque(d);
+	int job = -1;
+	if(d.front < d.back)
+		job = d.front++;
+	unlockDeque(d);
+	return job;
+}
+
+// Moves the back half of the fullest other deque into ours. False when nothing is left anywhere.
+static bool steal(workDeque deques[], int workers, int self) {
+	for(;;) {
+		int victim = -1, most = 0;
+		for(int i = 0; i < workers; i++) {
+			int left = deques[i].back - deques[i].front;	// Unlocked peek, rechecked below
+			if(i != self && left > most) {
+				most = left;
+				victim = i;
+			}
+		}
+		if(victim < 0)
+			return false;
+
+		workDeque& v = deques[victim];
+		lockDeque(v);
+		int left = v.back - v.front;
+		if(left <= 0) {	// Someone got there first, look again
+			unlockDeque(v);
+			continue;
+		}
+		int take = (left + 1) / 2;
+		int first = v.back - take;
+		v.back = first;
+		unlockDeque(v);
+
+		workDeque& d = deques[self];
+		lockDeque(d);
+		d.front = first;
+		d.back = first + take;
+		d.steals++;
+		unlockDeque(d);
+		return true;
+	}
+}
+
+static void runWorker(workDeque deques[], int workers, int self, char* results, size_t resultSize,
+		workJob job, void* context) {
+	for(;;) {
+		int j = takeFront(deques[self]);
+		if(j < 0) {
+			if(!steal(deques, workers, self))
+				return;
+			continue;
+		}
+		job(j, results + (size_t)j * resultSize, context);
+	}
+}
+
+int work_pool_default_workers() {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (int)n : 1;
+}
+
+int work_pool_run(int jobs, int workers, size_t resultSize, workJob job, void* context,
+		void* results, workPoolStats* stats) {
+	if(workers < 1) workers = 1;
+	if(workers > jobs) workers = jobs > 0 ? jobs : 1;
+
+	timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	size_t dequeBytes = sizeof(workDeque) * workers;
+	size_t length = dequeBytes + (size_t)jobs * resultSize;
+	void* shared = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(shared == MAP_FAILED) {
+		cout << "Failed to map work pool memory" << endl;
+		return 1;
+	}
+	memset(shared, 0, length);
+	workDeque* deques = (workDeque*)shared;
+	char* shared_results = (char*)shared + dequeBytes;
+
+	for(int i = 0; i < workers; i++) {
+		deques[i].front = (int)((long long)jobs * i / workers);
+		deques[i].back = (int)((long long)jobs * (i + 1) / workers);
+	}
+
+	cout << flush;	// Don't let every child flush a copy of pending output
+	fflush(stdout);
+
+	pid_t* pids = new pid_t[workers];
+	int failed = 0;
+	for(int i = 0; i < workers; i++) {
+		pids[i] = fork();
+		if(pids[i] == 0) {
+			runWorker(deques, workers, i, shared_results, resultSize, job, context);
+			fflush(stdout);
+			_exit(0);
+		}
+		if(pids[i] < 0)	// Out of processes; the others will steal this share
+			cout << "Failed to start work pool worker " << i << endl;
+	}
+
+	int started = 0;
+	for(int i = 0; i < workers; i++) {
+		if(pids[i] <= 0) continue;
+		started++;
+		int status;
+		waitpid(pids[i], &status, 0);
+		if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			failed++;
+	}
+
+	if(started == 0) failed = workers;
+
+	memcpy(results, shared_results, (size_t)jobs * resultSize);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if(stats) {
+		stats->workers = workers;
+		stats->failedWorkers = failed;
+		stats->steals = 0;
+		for(int i = 0; i < workers; i++)
+			stats->steals += deques[i].steals;
+		stats->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	}
+
+	delete[] pids;
+	munmap(shared, length);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+/*
+ * workPool.h
+ *	Work stealing pool for batches of independent offline jobs (replays, log analysis).
+ *	Workers are forked processes rather than threads: the AHRS state, the I2C transport and
+ *	the virtual clock are process wide, so every worker gets its own copy for free.
+ *
+ *	Each worker starts with a contiguous share of the job indices and takes jobs from the
+ *	front of its own deque. A worker that runs dry steals the back half of the fullest deque,
+ *	so consecutive indices (e.g. every parameter set of one recording) mostly stay together.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef WORKPOOL_H_
+#define WORKPOOL_H_
+
+#include <stddef.h>
+
+// Runs in a worker. result points at this job's resultSize bytes of zeroed shared memory.
+typedef void (*workJob)(int job, void* result, void* context);
+
+struct workPoolStats {
+	int workers;
+	int failedWorkers;	// Exited abnormally; their unfinished jobs keep zeroed results
+	unsigned long steals;
+	double seconds;
+};
+
+int work_pool_default_workers();	// Online CPUs
+
+// Runs jobs 0..jobs-1 and copies every result into results (jobs * resultSize bytes).
+// Returns 0 when every worker exited cleanly.
+int work_pool_run(int jobs, int workers, size_t resultSize, workJob job, void* context,
+		void* results, workPoolStats* stats);
+
+#endif /* WORKPOOL_H_ */
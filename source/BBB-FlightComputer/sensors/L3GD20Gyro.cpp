@@ -11,13 +11,26 @@
  */
 
 #include "L3GD20Gyro.h"
+#include "i2cTransport.h"
+#include "../realtime/latency.h"
+#include "../realtime/console.h"
+#include "../timing.h"
 
 using namespace std;
 
+static int16_t saturate16(int value) {
+	return (int16_t)(value > 32767 ? 32767 : (value < -32768 ? -32768 : value));
+}
+
 L3GD20Gyro::L3GD20Gyro(int bus, int address) {
 	I2CBus = bus;
 	I2CAddress = address;
 
+	gyroNewData = false;
+	gyroSequence = 0;
+	syncLost = false;
+	syncLosses = 0;
+
 	reset();	// Reset device to default settings
 	enableGyro();
 	readFullSensorState();
@@ -41,12 +54,15 @@ int L3GD20Gyro::reset() {
 	gyroScale = 0;
 
 	gyroFIFOMode = GYRO_FIFO_BYPASS;
+	sampleInterval = 10000;
+	memset(&fifoBatch, 0, sizeof(fifoBatch));
+	zeroRate[0] = zeroRate[1] = zeroRate[2] = 0;
 
 	gyroX = 0;
 	gyroY = 0;
 	gyroZ = 0;
 
-	sleep(1);
+	delayMicros(1000000);
 	cout << "Done." << endl;
 	return 0;
 }
@@ -78,22 +94,49 @@ int L3GD20Gyro::readFullSensorState() {
 
 		// Read gyro FIFO afterwards to prevent I2C glitch
 		int slotsRead = readGyroFIFO(gyroFIFO);
-		averageGyroFIFO(slotsRead);
+		LATENCY_SCOPE("gyro fifo decode");
+		if(slotsRead > 0)
+			averageGyroFIFO(slotsRead);
+		else
+			fifoBatch.count = 0;	// Nothing new, don't hand the last drain on again
 	}
 	else {	// No accel output averaging
 		readI2CDevice(REG_WHO_AM_I, &dataBuffer[REG_WHO_AM_I], L3GD20_I2C_BUFFER-REG_WHO_AM_I);
 
-		gyroX = convertGyroOutput(REG_OUT_X_H, REG_OUT_X_L);	// Convert to degrees per second
-		gyroY = convertGyroOutput(REG_OUT_Y_H, REG_OUT_Y_L);	// Convert to degrees per second
-		gyroZ = convertGyroOutput(REG_OUT_Z_H, REG_OUT_Z_L);	// Convert to degrees per second
+		gyroX = convertGyroOutput(REG_OUT_X_H, REG_OUT_X_L) - convertGyroOutput(zeroRate[0]);	// Convert to degrees per second
+		gyroY = convertGyroOutput(REG_OUT_Y_H, REG_OUT_Y_L) - convertGyroOutput(zeroRate[1]);	// Convert to degrees per second
+		gyroZ = convertGyroOutput(REG_OUT_Z_H, REG_OUT_Z_L) - convertGyroOutput(zeroRate[2]);	// Convert to degrees per second
+
+		// The one sample read is the batch, so batch callers don't see the last FIFO read
+		const unsigned char* raw = (const unsigned char*)dataBuffer;
+		fifoBatch.count = 1;
+		fifoBatch.x[0] = gyroX;
+		fifoBatch.y[0] = gyroY;
+		fifoBatch.z[0] = gyroZ;
+		fifoBatch.timestamp[0] = micros();
+		fifoBatch.raw[0][0] = saturate16((int16_t)((raw[REG_OUT_X_H] << 8) | raw[REG_OUT_X_L]) - zeroRate[0]);
+		fifoBatch.raw[0][1] = saturate16((int16_t)((raw[REG_OUT_Y_H] << 8) | raw[REG_OUT_Y_L]) - zeroRate[1]);
+		fifoBatch.raw[0][2] = saturate16((int16_t)((raw[REG_OUT_Z_H] << 8) | raw[REG_OUT_Z_L]) - zeroRate[2]);
+		fifoBatch.scale = gyroScale;
 	}
 
 	// Check WHO_AM_I register, to make sure I am reading from the registers I think I am.
-	if (dataBuffer[REG_WHO_AM_I]!=0xD7){
-		cout << "MAJOR FAILURE: DATA WITH LPS331 ALTIMETER HAS LOST SYNC!\t" << endl;
+	if ((unsigned char)dataBuffer[REG_WHO_AM_I]!=0xD7){
+		console_print("MAJOR FAILURE: DATA WITH L3GD20 GYRO HAS LOST SYNC!");
+		gyroNewData = false;
+		fifoBatch.count = 0;
+		syncLost = true;
+		syncLosses++;
 		return (1);
 	}
 
+	syncLost = false;
+
+	// STATUS was read before the outputs, so it describes the data just read. An empty FIFO
+	// means nothing new whatever STATUS says
+	gyroNewData = (dataBuffer[REG_STATUS] & L3GD20_STATUS_ZYXDA) != 0 && fifoBatch.count > 0;
+	if(gyroNewData) gyroSequence++;
+
 	//for(int i=0; i< L3GD20_I2C_BUFFER; i++) cout << std::hex << i << "\t" << (int)dataBuffer[i] << endl;
 	return(0);
 }
@@ -107,10 +150,20 @@ int L3GD20Gyro::setGyroDataRate(L3GD20_DATA_RATE dataRate) {
 		cout << "Failed to set altimeter dataRate!" << endl;
 		return 1;
 	}
+
+	switch(dataRate) {
+	case DR_GYRO_100HZ: sampleInterval = 10000; break;
+	case DR_GYRO_200HZ: sampleInterval = 5000; break;
+	case DR_GYRO_400HZ: sampleInterval = 2500; break;
+	case DR_GYRO_800HZ: sampleInterval = 1250; break;
+	}
 	return 0;
 }
 
 int L3GD20Gyro::writeI2CDeviceByte(char address, char value) {
+	if(i2c_get_transport())
+		return i2c_get_transport()->write(I2CBus, I2CAddress, address, value);
+
 	char namebuf[MAX_BUS];
 	snprintf(namebuf, sizeof(namebuf), "/dev/i2c-%d", I2CBus);
 	int file;
@@ -130,11 +183,16 @@ int L3GD20Gyro::writeI2CDeviceByte(char address, char value) {
 		cout << "Failure to write values to I2C Device address." << endl;
 		return(3);
 	}
+	i2c_record(I2CBus, I2CAddress, address, &value, 1, true);
 	close(file);
 	return 0;
 }
 
 int L3GD20Gyro::readI2CDevice(char address, char data[], int size){
+    LATENCY_SCOPE("i2c read");
+    if(i2c_get_transport())
+    	return i2c_get_transport()->read(I2CBus, I2CAddress, address, data, size);
+
     char namebuf[MAX_BUS];
    	snprintf(namebuf, sizeof(namebuf), "/dev/i2c-%d", 1);
     int file;
@@ -155,13 +213,14 @@ int L3GD20Gyro::readI2CDevice(char address, char data[], int size){
     if(size > 1) temp |= 0b10000000;	// Set MSB to enable burst if reading multiple bytes.
     char buf[1] = { temp };
     if(write(file, buf, 1) !=1){
-    	cout << "Failed to set address to read from in readFullSensorState() " << endl;
+    	console_print("Failed to set address to read from in readFullSensorState()");
     }
 
     if ( read(file, data, size) != size) {
-        cout << "Failure to read value from I2C Device address." << endl;
+        console_print("Failure to read value from I2C Device address.");
     }
 
+    i2c_record(I2CBus, I2CAddress, address, data, size, false);
     close(file);
     return 0;
 }
@@ -178,6 +237,7 @@ int L3GD20Gyro::setGyroScale(L3GD20_GYRO_SCALE scale) {
 		return 1;
 	}
 
+	zeroRate[0] = zeroRate[1] = zeroRate[2] = 0;	// Counts of the old scale
 	switch(scale){
 	case SCALE_GYRO_245dps: {
 		gyroScale = .00875;
@@ -240,8 +300,8 @@ int L3GD20Gyro::setGyroFIFOMode(L3GD20_GYRO_FIFO_MODE mode) {
 }
 
 float L3GD20Gyro::convertGyroOutput(int msb_reg_addr, int lsb_reg_addr){
-	short temp = dataBuffer[msb_reg_addr];
-	temp = (temp<<8) | dataBuffer[lsb_reg_addr];
+	const unsigned char* raw = (const unsigned char*)dataBuffer;
+	short temp = (short)((raw[msb_reg_addr] << 8) | raw[lsb_reg_addr]);
 	return ((float)temp * gyroScale);	// Convert to dps
 }
 
@@ -254,8 +314,8 @@ int L3GD20Gyro::readGyroFIFO(char buffer[]) {
 	readI2CDevice(REG_FIFO_SRC, val, 1);	// Read current FIFO mode
 
 	if(val[0] & 0x20) {
-		cout << "Failed to read gyro FIFO, because FIFO is empty!" << endl;
-		return 1;
+		console_print("Failed to read gyro FIFO, because FIFO is empty!");
+		return 0;
 	}
 	val[0] &= 0x1F;	// Mask all but FIFO slot count bits
 
@@ -264,40 +324,54 @@ int L3GD20Gyro::readGyroFIFO(char buffer[]) {
 	return (int)val[0]+1;	// Return the number of FIFO slots that held new data
 }
 
+void L3GD20Gyro::decodeFIFOSlot(int slot, int& x, int& y, int& z) {
+	// Assemble from unsigned bytes so a low byte >= 0x80 can't sign extend over the high byte
+	const unsigned char* raw = (const unsigned char*)&gyroFIFO[slot*6];
+	short tempX = (short)((raw[1] << 8) | raw[0]);
+	short tempY = (short)((raw[3] << 8) | raw[2]);
+	short tempZ = (short)((raw[5] << 8) | raw[4]);
+
+	// Convert 2's compliment for X, Y & Z
+	x = -(int)tempX;
+	y = -(int)tempY;
+	z = -(int)tempZ;
+}
+
 int L3GD20Gyro::averageGyroFIFO(int slots) {
 	if(slots <= 0) {
-		cout << "Error! Divide by 0 in averageGyroFIFO()!" << endl;
+		console_print("Error! Divide by 0 in averageGyroFIFO()!");
 		return 1;
 	}
+	if(slots > GYRO_FIFO_SLOTS) slots = GYRO_FIFO_SLOTS;
 
 	int sumX = 0;
 	int sumY = 0;
 	int sumZ = 0;
+	unsigned long newest = micros();	// The FIFO was drained just now
 
 	for(int i=0; i<slots; i++) {
-		// Reset temp variables
-		short tempX = 0x0000;
-		short tempY = 0x0000;
-		short tempZ = 0x0000;
-
-		// Convert 2's compliment for X, Y & Z
-		tempX = gyroFIFO[(i*6)+1];
-		tempX = (tempX << 8) | gyroFIFO[i*6];
-		tempX = ~tempX + 1;
-
-		tempY = gyroFIFO[(i*6)+3];
-		tempY = (tempY << 8) | gyroFIFO[(i*6)+2];
-		tempY = ~tempY + 1;
-
-		tempZ = gyroFIFO[(i*6)+5];
-		tempZ = (tempZ << 8) | gyroFIFO[(i*6)+4];
-		tempZ = ~tempZ + 1;
+		int x, y, z;
+		decodeFIFOSlot(i, x, y, z);
+		x -= zeroRate[0];
+		y -= zeroRate[1];
+		z -= zeroRate[2];
+
+		// Keep every sample for callers that integrate the whole batch
+		fifoBatch.x[i] = convertGyroOutput(x);
+		fifoBatch.y[i] = convertGyroOutput(y);
+		fifoBatch.z[i] = convertGyroOutput(z);
+		fifoBatch.timestamp[i] = newest - (slots - 1 - i) * sampleInterval;
+		fifoBatch.raw[i][0] = saturate16(x);	// -(-32768) is one out of range
+		fifoBatch.raw[i][1] = saturate16(y);
+		fifoBatch.raw[i][2] = saturate16(z);
 
 		// Sum X, Y and Z outputs
-		sumX += (int)tempX;
-		sumY += (int)tempY;
-		sumZ += (int)tempZ;
+		sumX += x;
+		sumY += y;
+		sumZ += z;
 	}
+	fifoBatch.count = slots;
+	fifoBatch.scale = gyroScale;
 
 	gyroX = convertGyroOutput(sumX / slots);
 	gyroY = convertGyroOutput(sumY / slots);
@@ -306,6 +380,47 @@ int L3GD20Gyro::averageGyroFIFO(int slots) {
 	return 0;
 }
 
+int L3GD20Gyro::getRawFIFO(int16_t samples[][3]) {
+	if(gyroFIFOMode != GYRO_FIFO_STREAM)
+		return 0;
+	for(int i=0; i<fifoBatch.count; i++) {
+		const unsigned char* raw = (const unsigned char*)&gyroFIFO[i*6];
+		samples[i][0] = (int16_t)((raw[1] << 8) | raw[0]);
+		samples[i][1] = (int16_t)((raw[3] << 8) | raw[2]);
+		samples[i][2] = (int16_t)((raw[5] << 8) | raw[4]);
+	}
+	return fifoBatch.count;
+}
+
+// The zero rate drifts with temperature from part to part, up to a degree per second or so,
+// which the AHRS would otherwise carry as a tilt error. Averaged over whole FIFO drains with
+// the gyro held still, the output is the zero rate. A fixed number of reads, not a time, so a
+// replay makes the same reads the recording did
+int L3GD20Gyro::calibrateZeroRate(int reads) {
+	zeroRate[0] = zeroRate[1] = zeroRate[2] = 0;
+	long sumX = 0, sumY = 0, sumZ = 0;
+	int samples = 0;
+	for(int r = 0; r < reads; r++) {
+		delayMicros(sampleInterval * GYRO_FIFO_SLOTS / 2);	// Half a FIFO between drains
+		if(readFullSensorState() || !gyroNewData)
+			continue;
+		for(int i = 0; i < fifoBatch.count; i++) {
+			sumX += fifoBatch.raw[i][0];
+			sumY += fifoBatch.raw[i][1];
+			sumZ += fifoBatch.raw[i][2];
+		}
+		samples += fifoBatch.count;
+	}
+	if(samples == 0) {
+		cout << "No gyro samples to calibrate the zero rate with!" << endl;
+		return 0;
+	}
+	zeroRate[0] = (int)floor((double)sumX / samples + 0.5);
+	zeroRate[1] = (int)floor((double)sumY / samples + 0.5);
+	zeroRate[2] = (int)floor((double)sumZ / samples + 0.5);
+	return samples;
+}
+
 imu::Vector<3> L3GD20Gyro::read_gyro() {
 	imu::Vector<3> gyro(gyroX,gyroY,gyroZ);
 	return gyro;
@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <iostream>
 #include <math.h>
+#include <stdint.h>
 #include "../AHRS/imumaths.h"
 
 #define L3GD20_I2C_BUFFER	0x40	// There are 0x31 registers on this device
@@ -59,6 +60,8 @@
 #define REG_IG_DURATION				0x38
 #define REG_LOW_ODR					0x39
 
+#define L3GD20_STATUS_ZYXDA			0x08	// STATUS: a new sample is ready on all three axes
+
 enum L3GD20_GYRO_SCALE {
 	SCALE_GYRO_245dps		= 0,
 	SCALE_GYRO_500dps		= 1,
@@ -78,6 +81,16 @@ enum L3GD20_GYRO_FIFO_MODE {
 	GYRO_FIFO_ERROR
 };
 
+struct gyroFIFOBatch {	// Every sample drained from the FIFO in one read, oldest first
+	int count;
+	float x[GYRO_FIFO_SLOTS];	// degrees per second
+	float y[GYRO_FIFO_SLOTS];	// degrees per second
+	float z[GYRO_FIFO_SLOTS];	// degrees per second
+	unsigned long timestamp[GYRO_FIFO_SLOTS];	// micros(), back-dated from the read using the data rate
+	int16_t raw[GYRO_FIFO_SLOTS][3];	// x, y, z before scaling, Q15 of the full scale
+	float scale;	// degrees per second per LSB of raw
+};
+
 class L3GD20Gyro {
 
 private:
@@ -92,10 +105,20 @@ private:
 	float gyroY;
 	float gyroZ;
 
+	unsigned long sampleInterval;	// Microseconds between samples at the current data rate
+	int zeroRate[3];	// Counts read held still, taken off every sample. 0 until calibrated
+
+	bool gyroNewData;	// Last read returned a sample the previous read hadn't seen
+	unsigned long gyroSequence;	// Number of reads that returned a new sample since construction
+	bool syncLost;		// Last read failed the WHO_AM_I check
+	unsigned long syncLosses;
+	gyroFIFOBatch fifoBatch;
+
 	int writeI2CDeviceByte(char address, char value);
 	int readI2CDevice(char address, char data[], int size);
-	int readGyroFIFO(char buffer[]);
+	int readGyroFIFO(char buffer[]);	// Slots drained, 0 if the FIFO was empty
 	int averageGyroFIFO(int slots);
+	void decodeFIFOSlot(int slot, int& x, int& y, int& z);
 	float convertGyroOutput(int msb_reg_addr, int lsb_reg_addr);	// Convert output to degrees per second
 	float convertGyroOutput(int rate);	// Convert output to degrees per second
 
@@ -109,12 +132,21 @@ public:
 	int setGyroScale(L3GD20_GYRO_SCALE scale);
 	int setGyroFIFOMode(L3GD20_GYRO_FIFO_MODE mode);
 	int readFullSensorState();
+	int calibrateZeroRate(int reads);	// Held still, returns the samples averaged
 
 	float getGyroX() { return gyroX; }
 	float getGyroY() { return gyroY; }
 	float getGyroZ() { return gyroZ; }
 
 	imu::Vector<3> read_gyro();
+	const gyroFIFOBatch& getFIFOBatch() { return fifoBatch; }	// One sample in GYRO_FIFO_BYPASS mode, none after a sync loss or from an empty FIFO
+	int getRawFIFO(int16_t samples[][3]);	// The batch as the chip output it, no zero rate taken off, returns the sample count
+
+	// Freshness of the last readFullSensorState(), from the STATUS register
+	bool isGyroNew() { return gyroNewData; }
+	unsigned long getGyroSequence() { return gyroSequence; }
+	bool isSyncLost() { return syncLost; }
+	unsigned long getSyncLosses() { return syncLosses; }
 
 	virtual ~L3GD20Gyro();
 };
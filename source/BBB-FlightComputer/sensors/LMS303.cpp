@@ -12,6 +12,11 @@
  */
 
 #include "LMS303.h"
+#include "i2cTransport.h"
+#include "../realtime/latency.h"
+#include "../realtime/console.h"
+#include "../timing.h"
+#include "../AHRS/fastmath.h"
 
 using namespace std;
 
@@ -26,6 +31,16 @@ LMS303::LMS303(int bus, int address) {
 	pitch = 0;
 	roll = 0;
 
+	magNewData = false;
+	accelNewData = false;
+	magSequence = 0;
+	accelSequence = 0;
+	syncLost = false;
+	syncLosses = 0;
+	accelFIFOSlots = 0;
+	accelSampleInterval = 625;
+	memset(&accelBatch, 0, sizeof(accelBatch));
+
 	reset();	// Reset device to default settings
 	enableMagnetometer();
 	enableAccelerometer();
@@ -51,7 +66,7 @@ int LMS303::reset() {
 	memset(dataBuffer, 0, LMS303_I2C_BUFFER);	// Clear dataBuffer
 	memset(accelFIFO, 0, ACCEL_FIFO_SIZE);	// Clear accelFIFO
 
-	sleep(1);
+	delayMicros(1000000);
 	cout << "Done." << endl;
 	return 0;
 }
@@ -76,9 +91,11 @@ int LMS303::readFullSensorState() {
 
 		// Read accel FIFO afterwards to prevent I2C glitch
 		int slotsRead = readAccelFIFO(accelFIFO);	// Read Accel FIFO
+		LATENCY_SCOPE("accel fifo decode");
 		averageAccelFIFO(slotsRead);
 	}
 	else {	// No accel output averaging
+		readI2CDevice(REG_TEMP_OUT_L, &dataBuffer[REG_TEMP_OUT_L], (REG_OUT_Z_H_M-REG_TEMP_OUT_L)+1);
 		readI2CDevice(REG_WHO_AM_I, &dataBuffer[REG_WHO_AM_I], LMS303_I2C_BUFFER-REG_WHO_AM_I);
 
 		accelX = convertAcceleration(REG_OUT_X_H_A, REG_OUT_X_L_A);
@@ -87,11 +104,23 @@ int LMS303::readFullSensorState() {
 	}
 
 	// Check WHO_AM_I register, to make sure I am reading from the registers I think I am.
-	if (dataBuffer[REG_WHO_AM_I]!=0x49){
-		cout << "MAJOR FAILURE: DATA WITH LMS303 HAS LOST SYNC!\t" << endl;
+	if ((unsigned char)dataBuffer[REG_WHO_AM_I]!=0x49){
+		console_print("MAJOR FAILURE: DATA WITH LMS303 HAS LOST SYNC!");
+		magNewData = false;
+		accelNewData = false;
+		syncLost = true;
+		syncLosses++;
 		return (1);
 	}
 
+	syncLost = false;
+
+	// Status registers were read before the outputs, so these describe the data just read
+	magNewData = (dataBuffer[REG_STATUS_M] & LMS303_STATUS_ZYXDA) != 0;
+	accelNewData = (dataBuffer[REG_STATUS_A] & LMS303_STATUS_ZYXDA) != 0;
+	if(magNewData) magSequence++;
+	if(accelNewData) accelSequence++;
+
 	getTemperature();
 
 	magX = convertMagnetism(REG_OUT_X_H_M, REG_OUT_X_L_M);
@@ -121,8 +150,8 @@ int LMS303::getTemperature() {
 	// Datasheet is not clear, so temp conversion may be inaccurate.
 	// Not verified with negative temperatures;
 
-	short temp = dataBuffer[REG_TEMP_OUT_H];
-	temp = (temp << 8) | (dataBuffer[REG_TEMP_OUT_L]);
+	const unsigned char* raw = (const unsigned char*)dataBuffer;
+	short temp = (short)((raw[REG_TEMP_OUT_H] << 8) | raw[REG_TEMP_OUT_L]);
 
 	// Mask MSBs appropriately to convert 12 bit 2s complement to 16 bit 2s complement
 	if(temp & 0x0800) temp |= 0x8000;
@@ -198,8 +227,8 @@ int LMS303::setMagDataRate(LMS303_MAG_DATA_RATE dataRate) {	// Set magnetometer
 }
 
 float LMS303::convertMagnetism(int msb_reg_addr, int lsb_reg_addr){
-	short temp = dataBuffer[msb_reg_addr];
-	temp = (temp<<8) | dataBuffer[lsb_reg_addr];
+	const unsigned char* raw = (const unsigned char*)dataBuffer;
+	short temp = (short)((raw[msb_reg_addr] << 8) | raw[lsb_reg_addr]);
 	return ((float)temp * magScale);	// Convert to gauss
 }
 
@@ -262,16 +291,18 @@ int LMS303::setAccelScale(LMS303_ACCEL_SCALE scale) {
 }
 
 void LMS303::calculatePitchAndRoll() {
-	double accelXSquared = this->accelX * this->accelX;
-	double accelYSquared = this->accelY * this->accelY;
-	double accelZSquared = this->accelZ * this->accelZ;
-	this->pitch = 180 * atan(accelX/sqrt(accelYSquared + accelZSquared))/M_PI;
-	this->roll = 180 * atan(accelY/sqrt(accelXSquared + accelZSquared))/M_PI;
+	float accelXSquared = this->accelX * this->accelX;
+	float accelYSquared = this->accelY * this->accelY;
+	float accelZSquared = this->accelZ * this->accelZ;
+	const float radToDeg = 180.0f / (float)M_PI;
+	// rsqrt of 0 is large but finite, so a zero denominator still gives +-90 degrees
+	this->pitch = radToDeg * fastmath::atan(accelX * fastmath::rsqrt(accelYSquared + accelZSquared));
+	this->roll = radToDeg * fastmath::atan(accelY * fastmath::rsqrt(accelXSquared + accelZSquared));
 }
 
 float LMS303::convertAcceleration(int msb_reg_addr, int lsb_reg_addr){
-	short temp = dataBuffer[msb_reg_addr];
-	temp = (temp<<8) | dataBuffer[lsb_reg_addr];
+	const unsigned char* raw = (const unsigned char*)dataBuffer;
+	short temp = (short)((raw[msb_reg_addr] << 8) | raw[lsb_reg_addr]);
 	return ((float)temp * accelScale);	// Convert to g's
 }
 
@@ -290,6 +321,20 @@ int LMS303::setAccelDataRate(LMS303_ACCEL_DATA_RATE dataRate){
 		cout << "Failure to update dataRate value!" << endl;
 		return 1;
 	}
+
+	switch(dataRate) {
+	case DR_ACCEL_3p125HZ: accelSampleInterval = 320000; break;
+	case DR_ACCEL_6p25HZ: accelSampleInterval = 160000; break;
+	case DR_ACCEL_12p5HZ: accelSampleInterval = 80000; break;
+	case DR_ACCEL_25HZ: accelSampleInterval = 40000; break;
+	case DR_ACCEL_50HZ: accelSampleInterval = 20000; break;
+	case DR_ACCEL_100HZ: accelSampleInterval = 10000; break;
+	case DR_ACCEL_200HZ: accelSampleInterval = 5000; break;
+	case DR_ACCEL_4OOHZ: accelSampleInterval = 2500; break;
+	case DR_ACCEL_8OOHZ: accelSampleInterval = 1250; break;
+	case DR_ACCEL_16OOHZ: accelSampleInterval = 625; break;
+	default: break;
+	}
 	return 0;
 }
 
@@ -305,6 +350,9 @@ LMS303_ACCEL_DATA_RATE LMS303::getAccelDataRate(){
 }
 
 int LMS303::writeI2CDeviceByte(char address, char value) {
+	if(i2c_get_transport())
+		return i2c_get_transport()->write(I2CBus, I2CAddress, address, value);
+
 	char namebuf[MAX_BUS];
 	snprintf(namebuf, sizeof(namebuf), "/dev/i2c-%d", I2CBus);
 	int file;
@@ -324,11 +372,16 @@ int LMS303::writeI2CDeviceByte(char address, char value) {
 		cout << "Failure to write values to I2C Device address." << endl;
 		return(3);
 	}
+	i2c_record(I2CBus, I2CAddress, address, &value, 1, true);
 	close(file);
 	return 0;
 }
 
 int LMS303::readI2CDevice(char address, char data[], int size){
+    LATENCY_SCOPE("i2c read");
+    if(i2c_get_transport())
+    	return i2c_get_transport()->read(I2CBus, I2CAddress, address, data, size);
+
     char namebuf[MAX_BUS];
    	snprintf(namebuf, sizeof(namebuf), "/dev/i2c-%d", 1);
     int file;
@@ -349,13 +402,14 @@ int LMS303::readI2CDevice(char address, char data[], int size){
     if(size > 1) temp |= 0b10000000;	// Set MSB to enable burst if reading multiple bytes.
     char buf[1] = { temp };
     if(write(file, buf, 1) !=1){
-    	cout << "Failed to set address to read from in readFullSensorState() " << endl;
+    	console_print("Failed to set address to read from in readFullSensorState()");
     }
 
     if ( read(file, data, size) != size) {
-        cout << "Failure to read value from I2C Device address." << endl;
+        console_print("Failure to read value from I2C Device address.");
     }
 
+    i2c_record(I2CBus, I2CAddress, address, data, size, false);
     close(file);
     return 0;
 }
@@ -415,39 +469,42 @@ int LMS303::readAccelFIFO(char buffer[]) {
 
 int LMS303::averageAccelFIFO(int slots){
 	if(slots <= 0) {
-		cout << "Error! Divide by 0 in averageAccelFIFO()!" << endl;
+		console_print("Error! Divide by 0 in averageAccelFIFO()!");
 		return 1;
 	}
 
+	if(slots > ACCEL_BATCH_SLOTS) slots = ACCEL_BATCH_SLOTS;
+	accelFIFOSlots = slots;
+
 	int sumX = 0;
 	int sumY = 0;
 	int sumZ = 0;
+	unsigned long newest = micros();	// The FIFO was drained just now
 
 	for(int i=0; i<slots; i++) {
-		// Reset temp variables
-		short tempX = 0x0000;
-		short tempY = 0x0000;
-		short tempZ = 0x0000;
+		// Assemble from unsigned bytes so a low byte >= 0x80 can't sign extend over the high byte
+		const unsigned char* raw = (const unsigned char*)&this->accelFIFO[i*6];
+		short tempX = (short)((raw[1] << 8) | raw[0]);
+		short tempY = (short)((raw[3] << 8) | raw[2]);
+		short tempZ = (short)((raw[5] << 8) | raw[4]);
 
 		// Convert 2's compliment for X, Y & Z
-		tempX = this->accelFIFO[(i*6)+1];
-		tempX = (tempX << 8) | this->accelFIFO[i*6];
 		tempX = ~tempX + 1;
-
-		tempY = this->accelFIFO[(i*6)+3];
-		tempY = (tempY << 8) | this->accelFIFO[(i*6)+2];
 		tempY = ~tempY + 1;
-
-		tempZ = this->accelFIFO[(i*6)+5];
-		tempZ = (tempZ << 8) | this->accelFIFO[(i*6)+4];
 		tempZ = ~tempZ + 1;
 
+		// Keep every sample for callers that integrate the whole batch
+		accelBatch.x[i] = convertAcceleration(tempX);
+		accelBatch.y[i] = convertAcceleration(tempY);
+		accelBatch.z[i] = convertAcceleration(tempZ);
+		accelBatch.timestamp[i] = newest - (slots - 1 - i) * accelSampleInterval;
 
 		// Sum X, Y and Z outputs
 		sumX += (int)tempX;
 		sumY += (int)tempY;
 		sumZ += (int)tempZ;
 	}
+	accelBatch.count = slots;
 
 	accelX = convertAcceleration(sumX / slots);
 	accelY = convertAcceleration(sumY / slots);
@@ -456,6 +513,18 @@ int LMS303::averageAccelFIFO(int slots){
 	return 0;
 }
 
+int LMS303::getRawFIFO(int16_t samples[][3]) {
+	if(accelFIFOMode != ACCEL_FIFO_STREAM)
+		return 0;
+	for(int i=0; i<accelFIFOSlots; i++) {
+		const unsigned char* raw = (const unsigned char*)&accelFIFO[i*6];
+		samples[i][0] = (int16_t)((raw[1] << 8) | raw[0]);
+		samples[i][1] = (int16_t)((raw[3] << 8) | raw[2]);
+		samples[i][2] = (int16_t)((raw[5] << 8) | raw[4]);
+	}
+	return accelFIFOSlots;
+}
+
 imu::Vector<3> LMS303::read_acc() {
 	imu::Vector<3> acc(accelX, accelY, accelZ);
 	return acc;
@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <iostream>
 #include <math.h>
+#include <stdint.h>
 #include "../AHRS/imumaths.h"
 
 #define LMS303_I2C_BUFFER		0x40	// Only 0x40 registers available according to LMS303 datasheet
@@ -61,6 +62,8 @@
 #define REG_FIFO_SRC			0x2F
 #define REG_IG_CFG1				0x30
 
+#define LMS303_STATUS_ZYXDA		0x08	// STATUS_M/STATUS_A: a new sample is ready on all three axes
+
 enum LMS303_MAG_SCALE {
 	SCALE_MAG_2gauss	= 0,
 	SCALE_MAG_4gauss	= 1,
@@ -106,6 +109,16 @@ enum LMS303_ACCEL_FIFO_MODE {
 	ACCEL_FIFO_ERROR
 };
 
+#define ACCEL_BATCH_SLOTS	(ACCEL_FIFO_SIZE / 6)
+
+struct accelFIFOBatch {	// Every sample of the last FIFO read, oldest first
+	int count;
+	float x[ACCEL_BATCH_SLOTS];	// g
+	float y[ACCEL_BATCH_SLOTS];	// g
+	float z[ACCEL_BATCH_SLOTS];	// g
+	unsigned long timestamp[ACCEL_BATCH_SLOTS];	// micros(), back-dated from the read using the data rate
+};
+
 class LMS303 {
 
 private:
@@ -114,6 +127,9 @@ private:
 	int I2CBus, I2CAddress;
 	char dataBuffer[LMS303_I2C_BUFFER];
 	char accelFIFO[ACCEL_FIFO_SIZE];	// 16 FIFO slots * 6 Accel output registers
+	int accelFIFOSlots;					// Slots the last FIFO read held
+	accelFIFOBatch accelBatch;
+	unsigned long accelSampleInterval;	// Microseconds between samples at the current data rate
 	LMS303_ACCEL_FIFO_MODE accelFIFOMode;
 
 	double magScale;
@@ -129,6 +145,13 @@ private:
 	double pitch;	// in degrees
 	double roll;	// in degrees
 
+	bool magNewData;	// Last read returned a sample the previous read hadn't seen
+	bool accelNewData;
+	unsigned long magSequence;	// Number of reads that returned a new sample since construction
+	unsigned long accelSequence;
+	bool syncLost;		// Last read failed the WHO_AM_I check
+	unsigned long syncLosses;
+
 	int writeI2CDeviceByte(char address, char value);
 	int readI2CDevice(char address, char data[], int size);
 
@@ -169,6 +192,16 @@ public:
 
 	imu::Vector<3> read_acc();
 	imu::Vector<3> read_mag();
+	int getRawFIFO(int16_t samples[][3]);	// Last FIFO read as the chip output it, returns the sample count
+	const accelFIFOBatch& getAccelBatch() { return accelBatch; }	// Only filled in ACCEL_FIFO_STREAM mode
+
+	// Freshness of the last readFullSensorState(), from STATUS_M and STATUS_A
+	bool isMagNew() { return magNewData; }
+	bool isAccelNew() { return accelNewData; }
+	unsigned long getMagSequence() { return magSequence; }
+	unsigned long getAccelSequence() { return accelSequence; }
+	bool isSyncLost() { return syncLost; }
+	unsigned long getSyncLosses() { return syncLosses; }
 
 	float getPitch() { return pitch; }
 	float getRoll() { return roll; }
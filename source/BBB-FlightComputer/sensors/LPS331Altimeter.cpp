@@ -11,6 +11,11 @@
  */
 
 #include "LPS331Altimeter.h"
+#include "i2cTransport.h"
+#include "../realtime/latency.h"
+#include "../realtime/console.h"
+#include "../timing.h"
+#include "../AHRS/fastmath.h"
 using namespace std;
 
 
@@ -36,12 +41,17 @@ using namespace std;
 #define REG_TEMP_OUT_H				0x2C
 #define REG_AMP_CTRL				0x30
 
+#define STATUS_P_DA					0x02	// Pressure data available
+
 LPS331Altimeter::LPS331Altimeter(int bus, int address) {
 	I2CBus = bus;
 	I2CAddress = address;
 
 	pressure = 0;
 	altitude = 0;
+	pressureNew = false;
+	syncLost = false;
+	syncLosses = 0;
 
 	reset();	// Reset device to default settings
 	enableAltimeter();
@@ -59,12 +69,14 @@ int LPS331Altimeter::reset() {
 	pressure = 0;
 	altitude = 0;
 
-	sleep(1);
+	delayMicros(1000000);
 	cout << "Done." << endl;
 	return 0;
 }
 
 int LPS331Altimeter::enableAltimeter() {
+	setResolution(LPS331_FAST_AVG_P, LPS331_FAST_AVG_T);	// Still powered down after the reboot
+
 	char buf[1];
 	readI2CDevice(REG_CTRL_REG1, buf, 1);	// Read current value
 	buf[0] |= 0x80;	// Set power down bit (turn on device)
@@ -73,7 +85,7 @@ int LPS331Altimeter::enableAltimeter() {
 		return 1;
 	}
 
-	setAltDataRate(DR_ALT_7HZ);
+	setAltDataRate(DR_ALT_25HZ);
 	return 0;
 }
 
@@ -84,10 +96,15 @@ int LPS331Altimeter::readFullSensorState() {
 	readI2CDevice(REG_AMP_CTRL, &dataBuffer[REG_AMP_CTRL], 1);
 
 	// Check WHO_AM_I register, to make sure I am reading from the registers I think I am.
-	if (dataBuffer[REG_WHO_AM_I]!=0xBB){
-		cout << "MAJOR FAILURE: DATA WITH LPS331 ALTIMETER HAS LOST SYNC!\t" << endl;
+	if ((unsigned char)dataBuffer[REG_WHO_AM_I]!=0xBB){
+		console_print("MAJOR FAILURE: DATA WITH LPS331 ALTIMETER HAS LOST SYNC!");
+		syncLost = true;
+		syncLosses++;
+		pressureNew = false;
 		return (1);
 	}
+	syncLost = false;
+	pressureNew = (dataBuffer[REG_STATUS_REG] & STATUS_P_DA) != 0;
 
 	pressure = convertPressure(REG_PRESS_OUT_H, REG_PRESS_OUT_L, REG_PRESS_POUT_XL_REH);	// Conver pressure to mbar
 	altitude = convertAltitude(pressure);	// convert mbar to altitude in meters
@@ -108,7 +125,21 @@ int LPS331Altimeter::setAltDataRate(LPS331_ALT_DATA_RATE dataRate) {
 	return 0;
 }
 
+// The datasheet doesn't allow the power on 0x7A (512 pressure, 128 temperature averages) at
+// 25 Hz, and the averaging can only be changed with the device powered down
+int LPS331Altimeter::setResolution(LPS331_PRESSURE_AVERAGE pressureAverage, LPS331_TEMP_AVERAGE tempAverage) {
+	char value = (char)(((int)tempAverage << 4) | (int)pressureAverage);
+	if(writeI2CDeviceByte(REG_RES_CONF, value)) {
+		cout << "Failed to set altimeter resolution!" << endl;
+		return 1;
+	}
+	return 0;
+}
+
 int LPS331Altimeter::writeI2CDeviceByte(char address, char value) {
+	if(i2c_get_transport())
+		return i2c_get_transport()->write(I2CBus, I2CAddress, address, value);
+
 	char namebuf[MAX_BUS];
 	snprintf(namebuf, sizeof(namebuf), "/dev/i2c-%d", I2CBus);
 	int file;
@@ -128,11 +159,16 @@ int LPS331Altimeter::writeI2CDeviceByte(char address, char value) {
 		cout << "Failure to write values to I2C Device address." << endl;
 		return(3);
 	}
+	i2c_record(I2CBus, I2CAddress, address, &value, 1, true);
 	close(file);
 	return 0;
 }
 
 int LPS331Altimeter::readI2CDevice(char address, char data[], int size){
+    LATENCY_SCOPE("i2c read");
+    if(i2c_get_transport())
+    	return i2c_get_transport()->read(I2CBus, I2CAddress, address, data, size);
+
     char namebuf[MAX_BUS];
    	snprintf(namebuf, sizeof(namebuf), "/dev/i2c-%d", 1);
     int file;
@@ -153,27 +189,27 @@ int LPS331Altimeter::readI2CDevice(char address, char data[], int size){
     if(size > 1) temp |= 0b10000000;	// Set MSB to enable burst if reading multiple bytes.
     char buf[1] = { temp };
     if(write(file, buf, 1) !=1){
-    	cout << "Failed to set address to read from in readFullSensorState() " << endl;
+    	console_print("Failed to set address to read from in readFullSensorState()");
     }
 
     if ( read(file, data, size) != size) {
-        cout << "Failure to read value from I2C Device address." << endl;
+        console_print("Failure to read value from I2C Device address.");
     }
 
+    i2c_record(I2CBus, I2CAddress, address, data, size, false);
     close(file);
     return 0;
 }
 
 float LPS331Altimeter::convertPressure(int msb_reg_addr, int lsb_reg_addr, int xlsb_reg_addr) {
-	int temp = dataBuffer[msb_reg_addr];
-	temp = (temp << 8) | dataBuffer[lsb_reg_addr];
-	temp = (temp << 8) | dataBuffer[xlsb_reg_addr];
+	const unsigned char* raw = (const unsigned char*)dataBuffer;
+	int temp = (raw[msb_reg_addr] << 16) | (raw[lsb_reg_addr] << 8) | raw[xlsb_reg_addr];
 
 	return (float)temp / 4096;	// in mBar
 }
 
 float LPS331Altimeter::convertAltitude(float pressure_mbar) {
-	return (1 - pow(pressure_mbar/1013.25, 0.190263)) * 44330.8;
+	return fastmath::baroAltitude(pressure_mbar);	// (1 - (p/1013.25)^0.190263) * 44330.8
 }
 
 LPS331Altimeter::~LPS331Altimeter() {
@@ -0,0 +1,188 @@
+/*
+ * i2cTransport.cpp
+ *	Record and replay of the raw I2C traffic between the sensor drivers and the AltIMU-10.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "i2cTransport.h"
+#include "../timing.h"
+#include "../logging/flightRecorder.h"
+
+using namespace std;
+
+static I2CTransport* transport = NULL;
+static FlightRecorder recording;
+static unsigned long oversized = 0;	// Transactions too long to record
+
+void i2c_set_transport(I2CTransport* t) {
+	transport = t;
+}
+
+I2CTransport* i2c_get_transport() {
+	return transport;
+}
+
+int i2c_record_open(const char* path) {
+	i2c_record_close();
+	i2cLogHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, I2C_LOG_MAGIC, sizeof(header.magic));
+	header.headerSize = FLIGHT_LOG_BLOCK;	// The recorder pads its header to a block
+	oversized = 0;
+	if(recording.open(path, &header, sizeof(header))) {
+		cout << "Failed to open I2C recording " << path << endl;
+		return 1;
+	}
+	return 0;
+}
+
+void i2c_record_close() {
+	recording.close();
+}
+
+// Record and data go to the ring in one append, so a transaction is either whole or dropped
+void i2c_record(int bus, int address, char reg, const char data[], int size, bool isWrite) {
+	if(!recording.isOpen()) return;
+	if(size < 0 || size > I2C_LOG_MAX_DATA) {
+		oversized++;
+		return;
+	}
+
+	struct {
+		i2cLogRecord r;
+		char data[I2C_LOG_MAX_DATA];
+	} t;
+	t.r.micros = (uint32_t)micros();
+	t.r.bus = bus;
+	t.r.address = address;
+	t.r.reg = reg;
+	t.r.flags = isWrite ? I2C_LOG_WRITE : 0;
+	t.r.size = size;
+	memcpy(t.data, data, size);
+	recording.append(&t, sizeof(i2cLogRecord) + size);
+}
+
+void i2c_record_report(ostream& out) {
+	recording.report(out, "I2C recording");
+	if(oversized)
+		out << oversized << " I2C transactions were too long to record" << endl;
+}
+
+I2CReplay::I2CReplay() {
+	exhausted = false;
+	desyncs = 0;
+	firstMicros = 0;
+	lastMicros = 0;
+	memset(cursor, 0, sizeof(cursor));
+}
+
+int I2CReplay::load(const char* path) {
+	FILE* f = fopen(path, "rb");
+	if(f == NULL) {
+		cout << "Failed to open I2C recording " << path << endl;
+		return 1;
+	}
+	fseek(f, 0, SEEK_END);
+	long length = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	log.resize(length > 0 ? length : 0);
+	size_t got = length > 0 ? fread(&log[0], 1, length, f) : 0;
+	fclose(f);
+
+	size_t pos = 0;
+	if(got == log.size() && log.size() >= sizeof(i2cLogHeader) && memcmp(&log[0], I2C_LOG_MAGIC, 8) == 0) {
+		i2cLogHeader header;
+		memcpy(&header, &log[0], sizeof(header));
+		pos = header.headerSize;
+	}
+	if(pos < sizeof(i2cLogHeader) || pos > log.size()) {
+		cout << path << " is not an I2C recording" << endl;
+		return 2;
+	}
+
+	for(int i = 0; i < I2C_MAX_ADDRESS; i++) device[i].clear();
+
+	// Read records only; writes are configuration the replayed drivers repeat themselves
+	unsigned long long wraps = 0;
+	uint32_t previous = 0;
+	bool first = true;
+	while(pos + sizeof(i2cLogRecord) <= log.size()) {
+		i2cLogRecord r;
+		memcpy(&r, &log[pos], sizeof(r));
+		pos += sizeof(r);
+		if(pos + r.size > log.size()) break;	// Recording was cut off mid record
+
+		if(!first && r.micros < previous) wraps += 1ULL << 32;
+		unsigned long long t = wraps + r.micros;
+		if(first) firstMicros = t;
+		lastMicros = t;
+		previous = r.micros;
+		first = false;
+
+		if(!(r.flags & I2C_LOG_WRITE)) {
+			entry e;
+			e.micros = t;
+			e.reg = r.reg;
+			e.size = r.size;
+			e.data = pos;
+			device[r.address & (I2C_MAX_ADDRESS-1)].push_back(e);
+		}
+		pos += r.size;
+	}
+
+	rewind();
+	return 0;
+}
+
+void I2CReplay::rewind() {
+	memset(cursor, 0, sizeof(cursor));
+	exhausted = false;
+	desyncs = 0;
+	setVirtualMicros(firstMicros);
+}
+
+void I2CReplay::finish() {
+	for(int i = 0; i < I2C_MAX_ADDRESS; i++) {
+		desyncs += device[i].size() - cursor[i];
+		cursor[i] = device[i].size();
+	}
+}
+
+unsigned long long I2CReplay::getNextMicros() {
+	unsigned long long next = 0;
+	for(int i = 0; i < I2C_MAX_ADDRESS; i++)
+		if(cursor[i] < device[i].size() && (next == 0 || device[i][cursor[i]].micros < next))
+			next = device[i][cursor[i]].micros;
+	return next;
+}
+
+int I2CReplay::read(int, int address, char reg, char data[], int size) {
+	vector<entry>& records = device[address & (I2C_MAX_ADDRESS-1)];
+	size_t& next = cursor[address & (I2C_MAX_ADDRESS-1)];
+
+	// Normally the very next record matches. If the replayed code reads differently from
+	// the recorded flight, skip ahead to the next read of the same registers.
+	size_t end = next + I2C_REPLAY_LOOKAHEAD;
+	if(end > records.size()) end = records.size();
+	for(size_t i = next; i < end; i++) {
+		const entry& e = records[i];
+		if(e.reg != (uint8_t)reg || e.size != size) continue;
+
+		memcpy(data, &log[e.data], size);
+		desyncs += i - next;
+		next = i + 1;
+		setVirtualMicros(e.micros);
+		return 0;
+	}
+
+	if(next >= records.size()) exhausted = true;
+	else desyncs++;
+	memset(data, 0, size);
+	return 1;
+}
+
+int I2CReplay::write(int, int, char, char) {
+	return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * i2cTransport.h
+ *	Record and replay of the raw I2C traffic between the sensor drivers and the AltIMU-10.
+ *	Every driver read/write goes through its own readI2CDevice()/writeI2CDeviceByte(), which
+ *	talk to /dev/i2c-N unless a transport has been installed, and append each transaction to
+ *	the recording when one is open. Replaying a recording through I2CReplay feeds the same
+ *	driver decode and AHRS code used in flight, with micros() following the recorded times.
+ *
+ *	Recording doesn't touch the disk on the flight thread: each transaction is queued to a
+ *	FlightRecorder ring and written out by its writer thread. A transaction that doesn't fit
+ *	in the ring is dropped and counted, and shows up as desynced reads on replay.
+ *
+ *	Recording format, host byte order:
+ *		i2cLogHeader, zero padded to headerSize
+ *		then per transaction an i2cLogRecord followed by size data bytes
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef I2CTRANSPORT_H_
+#define I2CTRANSPORT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+
+#define I2C_LOG_MAGIC			"I2CLOG2"
+#define I2C_LOG_WRITE			0x01	// i2cLogRecord flags: register write, otherwise a read
+#define I2C_LOG_MAX_DATA		256		// Longest transaction recorded, the drivers' reads are shorter
+#define I2C_MAX_ADDRESS			128		// 7 bit addressing
+#define I2C_REPLAY_LOOKAHEAD	64		// Records searched for a matching read after a desync
+
+struct i2cLogHeader {
+	char magic[8];
+	uint32_t headerSize;	// Bytes before the first record
+};
+
+struct i2cLogRecord {
+	uint32_t micros;	// micros() when the transaction completed
+	uint8_t bus;
+	uint8_t address;
+	uint8_t reg;
+	uint8_t flags;
+	uint16_t size;		// Data bytes following the record
+};
+
+class I2CTransport {	// Stands in for /dev/i2c-N once installed with i2c_set_transport()
+public:
+	virtual int read(int bus, int address, char reg, char data[], int size) = 0;
+	virtual int write(int bus, int address, char reg, char value) = 0;
+	virtual ~I2CTransport() {}
+};
+
+void i2c_set_transport(I2CTransport* transport);	// NULL goes back to the hardware
+I2CTransport* i2c_get_transport();
+
+int i2c_record_open(const char* path);
+void i2c_record_close();
+void i2c_record(int bus, int address, char reg, const char data[], int size, bool isWrite);
+void i2c_record_report(std::ostream& out);	// The writer's statistics and any dropped transactions
+
+class I2CReplay : public I2CTransport {	// Serves driver reads from a recording, in order per device
+
+private:
+
+	struct entry {
+		unsigned long long micros;	// Unwrapped, the flight computer's micros() is 32 bits
+		uint8_t reg;
+		uint16_t size;
+		size_t data;	// Offset into log
+	};
+
+	std::vector<char> log;
+	std::vector<entry> device[I2C_MAX_ADDRESS];
+	size_t cursor[I2C_MAX_ADDRESS];
+
+	bool exhausted;
+	unsigned long desyncs;
+	unsigned long long firstMicros, lastMicros;
+
+public:
+
+	I2CReplay();
+
+	int load(const char* path);
+	void rewind();
+
+	int read(int bus, int address, char reg, char data[], int size);
+	int write(int bus, int address, char reg, char value);
+
+	void finish();	// Counts the records no read asked for as desyncs
+
+	bool isExhausted() { return exhausted; }	// A read ran past the end of its device's records
+	unsigned long getDesyncs() { return desyncs; }	// Recorded reads skipped to find the one asked for
+	size_t getPosition(int address) { return cursor[address & (I2C_MAX_ADDRESS-1)]; }	// Records consumed
+	unsigned long long getNextMicros();	// Time of the earliest unread record, 0 if none are left
+	unsigned long long getStartMicros() { return firstMicros; }
+	double getDuration() { return (lastMicros - firstMicros) / 1e6; }	// seconds
+
+	virtual ~I2CReplay() {}
+};
+
+#endif /* I2CTRANSPORT_H_ */
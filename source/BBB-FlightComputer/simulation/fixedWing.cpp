@@ -0,0 +1,293 @@
+/*
+ * fixedWing.cpp
+ *	6-DOF flying wing model, see fixedWing.h. The equations are the standard ones in body
+ *	axes (Beard & McLain chapters 3 and 4).
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "fixedWing.h"
+#include <string.h>
+
+void fixed_wing_default_parameters(fixedWingParameters& p) {
+	memset(&p, 0, sizeof(p));
+	p.mass = 1.56;
+	p.Jx = 0.1147;
+	p.Jy = 0.0576;
+	p.Jz = 0.1712;
+	p.Jxz = 0.0015;
+	p.S = 0.2589;
+	p.b = 1.4224;
+	p.c = 0.3302;
+	p.rho = 1.2682;
+
+	p.CL0 = 0.28;		// Zagi 0.09, more incidence so the trim pitch is near zero
+	p.CLalpha = 3.5016;
+	p.CLq = 2.8932;
+	p.CLde = 0.2724;
+	p.CDp = 0.0254;
+	p.e = 0.9;
+	p.CDq = 0;
+	p.CDde = 0.3045;
+	p.Cm0 = 0;			// Zagi -0.023, reflexed so the elevons trim near neutral
+	p.Cmalpha = -0.5675;
+	p.Cmq = -1.399;
+	p.Cmde = -0.3254;
+	p.stallAlpha = 0.4712;
+	p.stallBlend = 50;
+
+	p.CYbeta = -0.2;	// Zagi -0.074, likewise
+	p.Clbeta = -0.02854;
+	p.Clp = -0.3209;
+	p.Clr = 0.03066;
+	p.Clda = 0.1682;
+	p.Cnbeta = 0.008;	// Zagi -0.0004, with winglets so it weathercocks
+	p.Cnp = -0.01297;
+	p.Cnr = -0.03;		// Zagi -0.0043, likewise
+	p.Cnda = -0.00328;	// No rudder, the rudder derivatives stay zero
+
+	p.Sprop = 0.0314;
+	p.Cprop = 1;
+	p.kMotor = 30;
+	p.maxDeflection = 15 * M_PI / 180;	// FLAP_DEFLECTION_ANGLE
+	p.servoTau = 0.02;
+	p.cg[0] = p.cg[1] = p.cg[2] = 0;
+
+	p.turbulence = 0.5;
+	p.turbulenceLength = 200;
+}
+
+FixedWing::FixedWing(const fixedWingParameters& parameters, uint64_t seed) : random(seed) {
+	p = parameters;
+	memset(&s, 0, sizeof(s));
+	s.attitude[0] = 1;
+	memset(&demand, 0, sizeof(demand));
+	surfaces = demand;
+	gust[0] = gust[1] = gust[2] = 0;
+	time = 0;
+	crashed = false;
+	specificForce[0] = specificForce[1] = 0;
+	specificForce[2] = -SIM_GRAVITY;
+	airspeed = alpha = beta = 0;
+}
+
+static void rotate(const double q[4], const double v[3], double out[3]) {	// Body to NED
+	double w = q[0], x = q[1], y = q[2], z = q[3];
+	out[0] = (1 - 2 * (y * y + z * z)) * v[0] + 2 * (x * y - w * z) * v[1] + 2 * (x * z + w * y) * v[2];
+	out[1] = 2 * (x * y + w * z) * v[0] + (1 - 2 * (x * x + z * z)) * v[1] + 2 * (y * z - w * x) * v[2];
+	out[2] = 2 * (x * z - w * y) * v[0] + 2 * (y * z + w * x) * v[1] + (1 - 2 * (x * x + y * y)) * v[2];
+}
+
+static void rotateInverse(const double q[4], const double v[3], double out[3]) {	// NED to body
+	double c[4] = { q[0], -q[1], -q[2], -q[3] };
+	rotate(c, v, out);
+}
+
+void FixedWing::bodyFromNED(const double ned[3], double body[3]) {
+	rotateInverse(s.attitude, ned, body);
+}
+
+void FixedWing::getEuler(double& roll, double& pitch, double& yaw) {
+	double w = s.attitude[0], x = s.attitude[1], y = s.attitude[2], z = s.attitude[3];
+	roll = atan2(2 * (w * x + y * z), 1 - 2 * (x * x + y * y));
+	double sp = 2 * (w * y - z * x);
+	pitch = asin(sp > 1 ? 1 : sp < -1 ? -1 : sp);
+	yaw = atan2(2 * (w * z + x * y), 1 - 2 * (y * y + z * z));
+}
+
+void FixedWing::setAttitude(double roll, double pitch, double yaw) {
+	double cr = cos(roll / 2), sr = sin(roll / 2);
+	double cp = cos(pitch / 2), sp = sin(pitch / 2);
+	double cy = cos(yaw / 2), sy = sin(yaw / 2);
+	s.attitude[0] = cr * cp * cy + sr * sp * sy;
+	s.attitude[1] = sr * cp * cy - cr * sp * sy;
+	s.attitude[2] = cr * sp * cy + sr * cp * sy;
+	s.attitude[3] = cr * cp * sy - sr * sp * cy;
+}
+
+void FixedWing::derivatives(const fixedWingState& x, fixedWingState& dx, double force[3]) {
+	const double* q = x.attitude;
+	double u = x.velocity[0], v = x.velocity[1], w = x.velocity[2];
+	double pr = x.rates[0], qr = x.rates[1], rr = x.rates[2];
+
+	// Air relative velocity
+	double windBody[3];
+	rotateInverse(q, p.wind, windBody);
+	double ur = u - windBody[0] - gust[0], vr = v - windBody[1] - gust[1], wr = w - windBody[2] - gust[2];
+	double Va = sqrt(ur * ur + vr * vr + wr * wr);
+	double a = atan2(wr, ur);
+	double b = Va > 0.1 ? asin(vr / Va) : 0;
+	double Vn = Va > 1 ? Va : 1;	// Rate damping terms are per airspeed, keep them finite when stopped
+	double qbar = 0.5 * p.rho * Va * Va;
+
+	// Lift blends to a flat plate past the stall
+	double ep = exp(-p.stallBlend * (a - p.stallAlpha)), em = exp(p.stallBlend * (a + p.stallAlpha));
+	double sigma = (1 + ep + em) / ((1 + ep) * (1 + em));
+	double sa = sin(a), ca = cos(a);
+	double CLlinear = p.CL0 + p.CLalpha * a;
+	double CL = (1 - sigma) * CLlinear + sigma * 2 * (a < 0 ? -1 : 1) * sa * sa * ca;
+	double CD = p.CDp + CLlinear * CLlinear / (M_PI * p.e * p.b * p.b / p.S);
+
+	double de = surfaces.elevator * p.maxDeflection;
+	double da = surfaces.aileron * p.maxDeflection;
+	double dr = surfaces.rudder * p.maxDeflection;
+	double qc = p.c * qr / (2 * Vn), pb = p.b * pr / (2 * Vn), rb = p.b * rr / (2 * Vn);
+
+	// Stability axis lift and drag into body axes
+	double CX = -CD * ca + CL * sa + (-p.CDq * ca + p.CLq * sa) * qc + (-p.CDde * ca + p.CLde * sa) * de;
+	double CZ = -CD * sa - CL * ca + (-p.CDq * sa - p.CLq * ca) * qc + (-p.CDde * sa - p.CLde * ca) * de;
+	double CY = p.CY0 + p.CYbeta * b + p.CYp * pb + p.CYr * rb + p.CYda * da + p.CYdr * dr;
+
+	double prop = p.kMotor * surfaces.throttle;
+	double thrust = 0.5 * p.rho * p.Sprop * p.Cprop * (prop * prop - Va * Va);
+	if(thrust < 0) thrust = 0;
+
+	force[0] = qbar * p.S * CX + thrust;
+	force[1] = qbar * p.S * CY;
+	force[2] = qbar * p.S * CZ;
+
+	double L = qbar * p.S * p.b * (p.Cl0 + p.Clbeta * b + p.Clp * pb + p.Clr * rb + p.Clda * da + p.Cldr * dr);
+	double M = qbar * p.S * p.c * (p.Cm0 + p.Cmalpha * a + p.Cmq * qc + p.Cmde * de);
+	double N = qbar * p.S * p.b * (p.Cn0 + p.Cnbeta * b + p.Cnp * pb + p.Cnr * rb + p.Cnda * da + p.Cndr * dr);
+
+	// Moved off the reference point the forces have an arm: a forward CG pitches the nose down
+	L += p.cg[2] * force[1] - p.cg[1] * force[2];
+	M += p.cg[0] * force[2] - p.cg[2] * force[0];
+	N += p.cg[1] * force[0] - p.cg[0] * force[1];
+
+	// Gravity in body axes: the NED down unit vector is the third row of the rotation
+	double gx = 2 * (q[1] * q[3] - q[0] * q[2]) * SIM_GRAVITY;
+	double gy = 2 * (q[2] * q[3] + q[0] * q[1]) * SIM_GRAVITY;
+	double gz = (1 - 2 * (q[1] * q[1] + q[2] * q[2])) * SIM_GRAVITY;
+
+	dx.velocity[0] = rr * v - qr * w + gx + force[0] / p.mass;
+	dx.velocity[1] = pr * w - rr * u + gy + force[1] / p.mass;
+	dx.velocity[2] = qr * u - pr * v + gz + force[2] / p.mass;
+
+	double G = p.Jx * p.Jz - p.Jxz * p.Jxz;
+	double G1 = p.Jxz * (p.Jx - p.Jy + p.Jz) / G;
+	double G2 = (p.Jz * (p.Jz - p.Jy) + p.Jxz * p.Jxz) / G;
+	double G7 = ((p.Jx - p.Jy) * p.Jx + p.Jxz * p.Jxz) / G;
+	dx.rates[0] = G1 * pr * qr - G2 * qr * rr + (p.Jz * L + p.Jxz * N) / G;
+	dx.rates[1] = (p.Jz - p.Jx) / p.Jy * pr * rr - p.Jxz / p.Jy * (pr * pr - rr * rr) + M / p.Jy;
+	dx.rates[2] = G7 * pr * qr - G1 * qr * rr + (p.Jxz * L + p.Jx * N) / G;
+
+	rotate(q, x.velocity, dx.position);
+
+	dx.attitude[0] = 0.5 * (-q[1] * pr - q[2] * qr - q[3] * rr);
+	dx.attitude[1] = 0.5 * (q[0] * pr + q[2] * rr - q[3] * qr);
+	dx.attitude[2] = 0.5 * (q[0] * qr - q[1] * rr + q[3] * pr);
+	dx.attitude[3] = 0.5 * (q[0] * rr + q[1] * qr - q[2] * pr);
+}
+
+static void addScaled(const fixedWingState& a, const fixedWingState& d, double h, fixedWingState& out) {
+	const double* x = (const double*)&a;
+	const double* dx = (const double*)&d;
+	double* o = (double*)&out;
+	for(unsigned i = 0; i < sizeof(fixedWingState) / sizeof(double); i++)
+		o[i] = x[i] + h * dx[i];
+}
+
+void FixedWing::step(double dt) {
+	if(crashed)
+		return;
+
+	// Surfaces chase their demands
+	double k = 1 - exp(-dt / p.servoTau);
+	surfaces.elevator += k * (demand.elevator - surfaces.elevator);
+	surfaces.aileron += k * (demand.aileron - surfaces.aileron);
+	surfaces.rudder += k * (demand.rudder - surfaces.rudder);
+	surfaces.throttle += k * (demand.throttle - surfaces.throttle);
+
+	// Gusts: first order Gauss-Markov with the correlation length flown through
+	if(p.turbulence > 0) {
+		double decay = exp(-(airspeed > 1 ? airspeed : 1) * dt / p.turbulenceLength);
+		double drive = p.turbulence * sqrt(1 - decay * decay);
+		for(int i = 0; i < 3; i++)
+			gust[i] = decay * gust[i] + random.normal(drive);
+	}
+
+	fixedWingState k1, k2, k3, k4, x;
+	double f1[3], f[3];
+	derivatives(s, k1, f1);
+	addScaled(s, k1, dt / 2, x);
+	derivatives(x, k2, f);
+	addScaled(s, k2, dt / 2, x);
+	derivatives(x, k3, f);
+	addScaled(s, k3, dt, x);
+	derivatives(x, k4, f);
+
+	double* o = (double*)&s;
+	const double *d1 = (const double*)&k1, *d2 = (const double*)&k2, *d3 = (const double*)&k3, *d4 = (const double*)&k4;
+	for(unsigned i = 0; i < sizeof(fixedWingState) / sizeof(double); i++)
+		o[i] += dt / 6 * (d1[i] + 2 * d2[i] + 2 * d3[i] + d4[i]);
+
+	double n = sqrt(s.attitude[0] * s.attitude[0] + s.attitude[1] * s.attitude[1] +
+			s.attitude[2] * s.attitude[2] + s.attitude[3] * s.attitude[3]);
+	for(int i = 0; i < 4; i++)
+		s.attitude[i] /= n;
+	time += dt;
+
+	// What the sensors see at the end of the step
+	derivatives(s, k1, f);
+	for(int i = 0; i < 3; i++)
+		specificForce[i] = f[i] / p.mass;
+	double windBody[3];
+	rotateInverse(s.attitude, p.wind, windBody);
+	double ur = s.velocity[0] - windBody[0] - gust[0], vr = s.velocity[1] - windBody[1] - gust[1];
+	double wr = s.velocity[2] - windBody[2] - gust[2];
+	airspeed = sqrt(ur * ur + vr * vr + wr * wr);
+	alpha = atan2(wr, ur);
+	beta = airspeed > 0.1 ? asin(vr / airspeed) : 0;
+
+	if(s.position[2] >= 0) {
+		crashed = true;
+		memset(s.velocity, 0, sizeof(s.velocity));
+		memset(s.rates, 0, sizeof(s.rates));
+	}
+}
+
+double FixedWing::trim(double Va, double altitude, double headingRadians, fixedWingControls& trimmed) {
+	// Level, unaccelerated, still air, CG on the reference point: solve alpha and elevator together from the lift and
+	// pitching moment (linear range), then thrust equals drag along the body axis
+	double qbar = 0.5 * p.rho * Va * Va;
+	double CLneeded = p.mass * SIM_GRAVITY / (qbar * p.S);
+	// CL0 + CLa a + CLde de = CLneeded, Cm0 + Cma a + Cmde de = 0
+	double det = p.CLalpha * p.Cmde - p.CLde * p.Cmalpha;
+	double a = ((CLneeded - p.CL0) * p.Cmde + p.CLde * p.Cm0) / det;
+	double de = (-p.Cm0 * p.CLalpha - p.Cmalpha * (CLneeded - p.CL0)) / det;
+	if(fabs(a) > p.stallAlpha * 0.8 || fabs(de) > p.maxDeflection)
+		return -1;
+
+	memset(&s, 0, sizeof(s));
+	s.position[2] = -altitude;
+	s.velocity[0] = Va * cos(a);
+	s.velocity[2] = Va * sin(a);
+	setAttitude(0, a, headingRadians);
+	gust[0] = gust[1] = gust[2] = 0;
+	crashed = false;
+
+	// Find the throttle that zeroes the forward acceleration
+	trimmed.elevator = de / p.maxDeflection;
+	trimmed.aileron = 0;
+	trimmed.rudder = 0;
+	double low = 0, high = 1;
+	fixedWingState d;
+	double f[3];
+	for(int i = 0; i < 40; i++) {
+		trimmed.throttle = (low + high) / 2;
+		surfaces = trimmed;
+		derivatives(s, d, f);
+		if(d.velocity[0] < 0) low = trimmed.throttle;
+		else high = trimmed.throttle;
+	}
+	setSurfaces(trimmed);
+	airspeed = Va;
+	alpha = a;
+	beta = 0;
+	derivatives(s, d, f);
+	for(int i = 0; i < 3; i++)
+		specificForce[i] = f[i] / p.mass;
+	return high >= 1 ? -1 : trimmed.throttle;
+}
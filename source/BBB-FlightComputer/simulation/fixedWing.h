@@ -0,0 +1,118 @@
+/*
+ * fixedWing.h
+ *	Rigid body 6-DOF flight dynamics of a small flying wing, for software in the loop
+ *	testing. The state is in the usual aerospace frames: position north-east-down, velocity
+ *	and body rates in body forward-right-down axes, attitude as the body to NED quaternion.
+ *	Aerodynamics are linear stability derivatives with a sigmoid blend to flat plate lift
+ *	past the stall, propulsion a simple prop model, and the surfaces follow their demands
+ *	through a first order servo lag. Wind is a steady NED vector plus first order
+ *	Gauss-Markov gusts in body axes. step() integrates with RK4.
+ *
+ *	The default parameters are loosely those of the Zagi flying wing in Beard & McLain,
+ *	"Small Unmanned Aircraft", with the wing at enough incidence and reflex to fly level near
+ *	zero pitch, which is what the stabiliser holds, and winglets for some weathercock
+ *	stability and yaw damping: the book's airframe has neither and diverges in yaw.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef FIXEDWING_H_
+#define FIXEDWING_H_
+
+#include "simRandom.h"
+
+#define SIM_GRAVITY		9.80665		// m/s^2
+
+struct fixedWingParameters {
+	double mass;					// kg
+	double Jx, Jy, Jz, Jxz;			// kg m^2
+	double S, b, c;					// Wing area m^2, span m, chord m
+	double rho;						// Air density kg/m^3
+
+	double CL0, CLalpha, CLq, CLde;	// Longitudinal, per radian
+	double CDp, e, CDq, CDde;		// Parasitic drag, Oswald efficiency
+	double Cm0, Cmalpha, Cmq, Cmde;
+	double stallAlpha, stallBlend;	// rad, and how sharply lift blends to flat plate there
+
+	double CY0, CYbeta, CYp, CYr, CYda, CYdr;	// Lateral
+	double Cl0, Clbeta, Clp, Clr, Clda, Cldr;
+	double Cn0, Cnbeta, Cnp, Cnr, Cnda, Cndr;
+
+	double Sprop, Cprop, kMotor;	// Thrust = 1/2 rho Sprop Cprop ((kMotor throttle)^2 - Va^2)
+	double maxDeflection;			// rad at full servo travel
+	double servoTau;				// s
+	double cg[3];					// m body, centre of gravity from where the coefficients are taken
+
+	double wind[3];					// m/s NED, steady
+	double turbulence;				// m/s rms per body axis
+	double turbulenceLength;		// m
+};
+
+void fixed_wing_default_parameters(fixedWingParameters& p);
+
+struct fixedWingControls {	// Fractions of full travel
+	double elevator;	// +/-1, positive trailing edge down (nose down)
+	double aileron;		// +/-1, positive rolls right
+	double rudder;		// +/-1, positive yaws right
+	double throttle;	// 0 to 1
+};
+
+struct fixedWingState {
+	double position[3];	// m NED
+	double velocity[3];	// m/s body, relative to the ground
+	double attitude[4];	// w, x, y, z: body to NED
+	double rates[3];	// rad/s body: roll, pitch, yaw
+};
+
+class FixedWing {
+
+private:
+
+	fixedWingParameters p;
+	fixedWingState s;
+	fixedWingControls demand;
+	fixedWingControls surfaces;	// After the servo lag
+	double gust[3];				// m/s body
+	SimRandom random;
+	double time;				// s
+	bool crashed;
+
+	// Outputs of the last step, for the sensors
+	double specificForce[3];	// m/s^2 body, what an accelerometer measures
+	double airspeed, alpha, beta;
+
+	void derivatives(const fixedWingState& x, fixedWingState& dx, double force[3]);
+
+public:
+
+	FixedWing(const fixedWingParameters& parameters, uint64_t seed = 1);
+
+	// Level flight at airspeed: the angle of attack that carries the weight, the elevator
+	// that holds it, the throttle that balances drag. Returns the trim throttle, or a
+	// negative number if the airspeed is out of the model's reach
+	double trim(double airspeed, double altitude, double headingRadians, fixedWingControls& trimmed);
+
+	void setState(const fixedWingState& state) { s = state; }
+	const fixedWingState& getState() { return s; }
+	void setAttitude(double roll, double pitch, double yaw);	// rad, keeps the body velocity
+	void setControls(const fixedWingControls& c) { demand = c; }
+	void setSurfaces(const fixedWingControls& c) { demand = c; surfaces = c; }	// No lag, e.g. at trim
+	const fixedWingControls& getSurfaces() { return surfaces; }
+
+	void step(double dt);
+
+	double getTime() { return time; }
+	bool isCrashed() { return crashed; }	// Hit the ground, the state is frozen
+	double getAltitude() { return -s.position[2]; }
+	double getAirspeed() { return airspeed; }
+	double getAlpha() { return alpha; }
+	double getBeta() { return beta; }
+	const double* getSpecificForce() { return specificForce; }
+	const double* getRates() { return s.rates; }
+	void getEuler(double& roll, double& pitch, double& yaw);	// rad
+	void bodyFromNED(const double ned[3], double body[3]);
+	const fixedWingParameters& getParameters() { return p; }
+};
+
+#endif /* FIXEDWING_H_ */
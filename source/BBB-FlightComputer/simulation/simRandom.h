@@ -0,0 +1,57 @@
+/*
+ * simRandom.h
+ *	Seeded random numbers for the simulator: xorshift64*, with Box-Muller normals. Each
+ *	generator is its own state, so a given seed reproduces a simulated flight exactly.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef SIMRANDOM_H_
+#define SIMRANDOM_H_
+
+#include <stdint.h>
+#include <math.h>
+
+class SimRandom {
+
+private:
+
+	uint64_t state;
+	double spare;
+	bool hasSpare;
+
+public:
+
+	SimRandom(uint64_t seed = 1) { setSeed(seed); }
+
+	void setSeed(uint64_t seed) {
+		state = seed ? seed : 0x9E3779B97F4A7C15ULL;	// Zero would stick at zero
+		hasSpare = false;
+	}
+
+	uint64_t next() {
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 0x2545F4914F6CDD1DULL;
+	}
+
+	double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }	// [0, 1)
+	double uniform(double low, double high) { return low + (high - low) * uniform(); }
+
+	double normal() {	// Zero mean, unit variance
+		if(hasSpare) {
+			hasSpare = false;
+			return spare;
+		}
+		double u = 1 - uniform(), v = uniform();	// u in (0, 1], so the log is finite
+		double r = sqrt(-2 * log(u));
+		spare = r * sin(2 * M_PI * v);
+		hasSpare = true;
+		return r * cos(2 * M_PI * v);
+	}
+	double normal(double sigma) { return sigma * normal(); }
+};
+
+#endif /* SIMRANDOM_H_ */
@@ -0,0 +1,375 @@
+/*
+ * simSensors.cpp
+ *	Register models of the LMS303, L3GD20 and LPS331, see simSensors.h. Register addresses
+ *	and bit fields are from the datasheets, as used by the drivers in ../sensors.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "simSensors.h"
+#include <string.h>
+
+// Shared by the gyro and the LMS303's accelerometer
+#define SIM_WHO_AM_I		0x0F
+#define SIM_STATUS			0x27
+#define SIM_OUT_X_L			0x28
+#define SIM_OUT_Z_H			0x2D
+#define SIM_FIFO_CTRL		0x2E
+#define SIM_FIFO_SRC		0x2F
+#define SIM_ZYXDA			0x08
+#define SIM_ZYXOR			0x80
+#define SIM_FIFO_STREAM		0x02	// FIFO_CTRL mode bits 7:5
+
+// L3GD20
+#define GYRO_CTRL1			0x20
+#define GYRO_CTRL4			0x23
+#define GYRO_CTRL5			0x24
+
+// LMS303
+#define LMS_TEMP_OUT_L		0x05
+#define LMS_STATUS_M		0x07
+#define LMS_OUT_X_L_M		0x08
+#define LMS_OUT_Z_H_M		0x0D
+#define LMS_CTRL0			0x1F
+#define LMS_CTRL1			0x20
+#define LMS_CTRL2			0x21
+#define LMS_CTRL5			0x24
+#define LMS_CTRL6			0x25
+#define LMS_CTRL7			0x26
+
+// LPS331
+#define BARO_RES_CONF		0x10
+#define BARO_CTRL_REG1		0x20
+#define BARO_CTRL_REG2		0x21
+#define BARO_STATUS			0x27
+#define BARO_PRESS_OUT_XL	0x28
+#define BARO_PRESS_OUT_H	0x2A
+#define BARO_TEMP_OUT_L		0x2B
+#define BARO_TEMP_OUT_H		0x2C
+#define BARO_P_DA			0x02
+#define BARO_T_DA			0x01
+
+void sim_sensor_errors(sensorErrors& e, double biasSigma, double scaleSigma, double noise, SimRandom& random) {
+	for(int i = 0; i < 3; i++) {
+		e.bias[i] = random.normal(biasSigma);
+		e.scale[i] = random.normal(scaleSigma);
+	}
+	e.noise = noise;
+}
+
+double sim_pressure_at(double altitude) {
+	return 1013.25 * pow(1 - altitude / 44330.8, 1 / 0.190263);
+}
+
+SimRegisterDevice::SimRegisterDevice(const sensorErrors& e, uint64_t seed) : random(seed) {
+	memset(registers, 0, sizeof(registers));
+	errors = e;
+	nextSample = -1;
+	memset(fifo, 0, sizeof(fifo));
+	memset(latest, 0, sizeof(latest));
+	fifoReset();
+}
+
+double SimRegisterDevice::measure(const sensorErrors& e, const double truth[3], int axis) {
+	return truth[axis] * (1 + e.scale[axis]) + e.bias[axis] + random.normal(e.noise);
+}
+
+short SimRegisterDevice::quantise(double value, double lsb) {
+	double counts = floor(value / lsb + 0.5);
+	if(counts > 32767) return 32767;
+	if(counts < -32768) return -32768;
+	return (short)counts;
+}
+
+void SimRegisterDevice::store(int reg, short value) {
+	registers[reg] = (unsigned char)(value & 0xFF);
+	registers[reg + 1] = (unsigned char)((unsigned short)value >> 8);
+}
+
+void SimRegisterDevice::fifoPush(const short sample[3]) {
+	if(fifoCount == SIM_FIFO_SLOTS) {	// Stream mode drops the oldest
+		fifoHead = (fifoHead + 1) % SIM_FIFO_SLOTS;
+		fifoCount--;
+	}
+	short* slot = fifo[(fifoHead + fifoCount) % SIM_FIFO_SLOTS];
+	slot[0] = sample[0];
+	slot[1] = sample[1];
+	slot[2] = sample[2];
+	fifoCount++;
+}
+
+int SimRegisterDevice::fifoRead(char data[], int size) {
+	short current[3] = { latest[0], latest[1], latest[2] };
+	for(int i = 0; i < size; i++) {
+		if(i % 6 == 0 && fifoCount > 0) {
+			memcpy(current, fifo[fifoHead], sizeof(current));
+			fifoHead = (fifoHead + 1) % SIM_FIFO_SLOTS;
+			fifoCount--;
+		}
+		unsigned short axis = (unsigned short)current[(i % 6) / 2];
+		data[i] = (char)(i % 2 ? axis >> 8 : axis & 0xFF);
+	}
+	return 0;
+}
+
+int SimRegisterDevice::fifoSource() {
+	if(fifoCount == 0)
+		return 0x20;
+	return (fifoCount - 1) | (fifoCount == SIM_FIFO_SLOTS ? 0x40 : 0);
+}
+
+int SimRegisterDevice::read(char reg, char data[], int size) {
+	for(int i = 0; i < size; i++)
+		data[i] = (char)registers[(reg + i) % SIM_REGISTERS];
+	return 0;
+}
+
+int SimRegisterDevice::write(char reg, char value) {
+	registers[reg % SIM_REGISTERS] = (unsigned char)value;
+	return 0;
+}
+
+int SimRegisterDevice::samplesDue(double& next, double rateHz, double timeMicros) {
+	if(rateHz <= 0) {
+		next = -1;
+		return 0;
+	}
+	double interval = 1e6 / rateHz;
+	if(next < 0)	// First sample one period after power up
+		next = timeMicros + interval;
+	int due = 0;
+	while(next <= timeMicros) {
+		next += interval;
+		due++;
+	}
+	return due;
+}
+
+void SimRegisterDevice::update(const simTruth& truth, double timeMicros) {
+	for(int n = samplesDue(nextSample, dataRate(), timeMicros); n > 0; n--)
+		sample(truth);
+}
+
+//----------------------------------------------------------------------------------------------
+// L3GD20
+
+SimL3GD20::SimL3GD20(const sensorErrors& e, uint64_t seed) : SimRegisterDevice(e, seed) {
+	registers[SIM_WHO_AM_I] = 0xD7;
+	registers[GYRO_CTRL1] = 0x07;
+	registers[SIM_FIFO_SRC] = fifoSource();
+}
+
+double SimL3GD20::dataRate() {
+	static const double rates[4] = { 100, 200, 400, 800 };
+	if(!(registers[GYRO_CTRL1] & 0x08))	// Power down
+		return 0;
+	return rates[registers[GYRO_CTRL1] >> 6];
+}
+
+double SimL3GD20::lsb() {
+	switch((registers[GYRO_CTRL4] >> 4) & 0x03) {
+	case 0: return 0.00875;
+	case 1: return 0.0175;
+	default: return 0.07;
+	}
+}
+
+bool SimL3GD20::fifoEnabled() {
+	return (registers[GYRO_CTRL5] & 0x40) && (registers[SIM_FIFO_CTRL] >> 5) == SIM_FIFO_STREAM;
+}
+
+void SimL3GD20::sample(const simTruth& truth) {
+	// The chip's axes are the board's reversed, the driver negates them back
+	for(int i = 0; i < 3; i++) {
+		latest[i] = quantise(-measure(errors, truth.rates, i), lsb());
+		store(SIM_OUT_X_L + 2 * i, latest[i]);
+	}
+	if(fifoEnabled()) {
+		fifoPush(latest);
+		registers[SIM_FIFO_SRC] = fifoSource();
+	}
+	if(registers[SIM_STATUS] & SIM_ZYXDA) registers[SIM_STATUS] |= SIM_ZYXOR;
+	registers[SIM_STATUS] |= SIM_ZYXDA;
+}
+
+int SimL3GD20::read(char reg, char data[], int size) {
+	if(reg == SIM_OUT_X_L && fifoEnabled()) {
+		fifoRead(data, size);
+		registers[SIM_FIFO_SRC] = fifoSource();
+	}
+	else
+		SimRegisterDevice::read(reg, data, size);
+	if(covers(reg, size, SIM_OUT_X_L, SIM_OUT_Z_H))
+		registers[SIM_STATUS] = 0;
+	return 0;
+}
+
+int SimL3GD20::write(char reg, char value) {
+	if(reg == SIM_WHO_AM_I || reg == SIM_FIFO_SRC || (reg >= 0x26 && reg <= SIM_OUT_Z_H) || reg == 0x31)
+		return 0;	// Read only
+	if(reg == GYRO_CTRL5) value &= ~0x80;	// BOOT clears itself
+	SimRegisterDevice::write(reg, value);
+	if(!fifoEnabled()) fifoReset();
+	registers[SIM_FIFO_SRC] = fifoSource();
+	return 0;
+}
+
+//----------------------------------------------------------------------------------------------
+// LMS303
+
+SimLMS303::SimLMS303(const sensorErrors& accel, const sensorErrors& mag, uint64_t seed) :
+		SimRegisterDevice(accel, seed) {
+	magErrors = mag;
+	nextMagSample = -1;
+	registers[SIM_WHO_AM_I] = 0x49;
+	registers[LMS_CTRL1] = 0x07;
+	registers[LMS_CTRL5] = 0x18;
+	registers[LMS_CTRL6] = 0x20;
+	registers[LMS_CTRL7] = 0x02;	// Magnetometer powered down
+	registers[SIM_FIFO_SRC] = fifoSource();
+}
+
+double SimLMS303::dataRate() {
+	int odr = registers[LMS_CTRL1] >> 4;
+	if(odr == 0 || odr > 10)
+		return 0;
+	return 3.125 * (1 << (odr - 1));
+}
+
+double SimLMS303::magDataRate() {
+	if(registers[LMS_CTRL7] & 0x03)	// Single conversion or power down
+		return 0;
+	int odr = (registers[LMS_CTRL5] >> 2) & 0x07;
+	return 3.125 * (1 << (odr > 5 ? 5 : odr));
+}
+
+double SimLMS303::accelLsb() {
+	static const double lsb[5] = { 0.000061, 0.000122, 0.000183, 0.000244, 0.000732 };
+	int fs = (registers[LMS_CTRL2] >> 3) & 0x07;
+	return lsb[fs > 4 ? 4 : fs];
+}
+
+double SimLMS303::magLsb() {
+	static const double lsb[4] = { 0.00008, 0.00016, 0.00032, 0.000479 };
+	return lsb[(registers[LMS_CTRL6] >> 5) & 0x03];
+}
+
+bool SimLMS303::fifoEnabled() {
+	return (registers[LMS_CTRL0] & 0x40) && (registers[SIM_FIFO_CTRL] >> 5) == SIM_FIFO_STREAM;
+}
+
+void SimLMS303::sample(const simTruth& truth) {
+	// Like the gyro, the driver negates the accelerometer axes into the board's
+	for(int i = 0; i < 3; i++) {
+		latest[i] = quantise(-measure(errors, truth.accel, i), accelLsb());
+		store(SIM_OUT_X_L + 2 * i, latest[i]);
+	}
+	if(fifoEnabled()) {
+		fifoPush(latest);
+		registers[SIM_FIFO_SRC] = fifoSource();
+	}
+	if(registers[SIM_STATUS] & SIM_ZYXDA) registers[SIM_STATUS] |= SIM_ZYXOR;
+	registers[SIM_STATUS] |= SIM_ZYXDA;
+}
+
+void SimLMS303::sampleMag(const simTruth& truth) {
+	for(int i = 0; i < 3; i++)
+		store(LMS_OUT_X_L_M + 2 * i, quantise(measure(magErrors, truth.mag, i), magLsb()));
+	store(LMS_TEMP_OUT_L, (short)floor(truth.temperature * 8 + 0.5));	// 8 LSB per degree, 12 bits
+	if(registers[LMS_STATUS_M] & SIM_ZYXDA) registers[LMS_STATUS_M] |= SIM_ZYXOR;
+	registers[LMS_STATUS_M] |= SIM_ZYXDA;
+}
+
+void SimLMS303::update(const simTruth& truth, double timeMicros) {
+	SimRegisterDevice::update(truth, timeMicros);
+	for(int n = samplesDue(nextMagSample, magDataRate(), timeMicros); n > 0; n--)
+		sampleMag(truth);
+}
+
+int SimLMS303::read(char reg, char data[], int size) {
+	if(reg == SIM_OUT_X_L && fifoEnabled()) {
+		fifoRead(data, size);
+		registers[SIM_FIFO_SRC] = fifoSource();
+	}
+	else
+		SimRegisterDevice::read(reg, data, size);
+	if(covers(reg, size, LMS_OUT_X_L_M, LMS_OUT_Z_H_M))
+		registers[LMS_STATUS_M] = 0;
+	if(covers(reg, size, SIM_OUT_X_L, SIM_OUT_Z_H))
+		registers[SIM_STATUS] = 0;
+	return 0;
+}
+
+int SimLMS303::write(char reg, char value) {
+	if((reg >= LMS_TEMP_OUT_L && reg <= LMS_OUT_Z_H_M) || reg == SIM_WHO_AM_I ||
+			(reg >= SIM_STATUS && reg <= SIM_OUT_Z_H) || reg == SIM_FIFO_SRC)
+		return 0;	// Read only
+	if(reg == LMS_CTRL0) value &= ~0x80;	// BOOT clears itself
+	SimRegisterDevice::write(reg, value);
+	if(!fifoEnabled()) fifoReset();
+	registers[SIM_FIFO_SRC] = fifoSource();
+	return 0;
+}
+
+//----------------------------------------------------------------------------------------------
+// LPS331
+
+SimLPS331::SimLPS331(const sensorErrors& e, uint64_t seed) : SimRegisterDevice(e, seed) {
+	oneShot = false;
+	registers[SIM_WHO_AM_I] = 0xBB;
+	registers[BARO_RES_CONF] = 0x7A;
+}
+
+double SimLPS331::dataRate() {
+	static const double rates[8] = { 0, 1, 7, 12.5, 25, 7, 12.5, 25 };	// Pressure, ODR 0 is one shot
+	if(!(registers[BARO_CTRL_REG1] & 0x80))	// Power down
+		return 0;
+	return rates[(registers[BARO_CTRL_REG1] >> 4) & 0x07];
+}
+
+// The configured noise is at the power on 512 pressure averages, and goes up as the root of
+// fewer
+void SimLPS331::sample(const simTruth& truth) {
+	static const double averages[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 256, 384, 512, 512, 512, 512, 512, 512 };
+	double noise = errors.noise * sqrt(512 / averages[registers[BARO_RES_CONF] & 0x0F]);
+	double mbar = truth.pressure * (1 + errors.scale[0]) + errors.bias[0] + random.normal(noise);
+	double counts = floor(mbar * 4096 + 0.5);
+	unsigned long raw = counts < 0 ? 0 : counts > 0xFFFFFF ? 0xFFFFFF : (unsigned long)counts;
+	registers[BARO_PRESS_OUT_XL] = raw & 0xFF;
+	registers[BARO_PRESS_OUT_XL + 1] = (raw >> 8) & 0xFF;
+	registers[BARO_PRESS_OUT_H] = (raw >> 16) & 0xFF;
+	store(BARO_TEMP_OUT_L, quantise(truth.temperature - 42.5, 1 / 480.0));
+
+	if(registers[BARO_STATUS] & BARO_P_DA) registers[BARO_STATUS] |= 0x20;	// P_OR
+	if(registers[BARO_STATUS] & BARO_T_DA) registers[BARO_STATUS] |= 0x10;	// T_OR
+	registers[BARO_STATUS] |= BARO_P_DA | BARO_T_DA;
+}
+
+void SimLPS331::update(const simTruth& truth, double timeMicros) {
+	SimRegisterDevice::update(truth, timeMicros);
+	if(oneShot) {
+		sample(truth);
+		oneShot = false;
+		registers[BARO_CTRL_REG2] &= ~0x01;
+	}
+}
+
+int SimLPS331::read(char reg, char data[], int size) {
+	SimRegisterDevice::read(reg, data, size);
+	if(covers(reg, size, BARO_PRESS_OUT_XL, BARO_PRESS_OUT_H))
+		registers[BARO_STATUS] &= ~(BARO_P_DA | 0x20);
+	if(covers(reg, size, BARO_TEMP_OUT_L, BARO_TEMP_OUT_H))
+		registers[BARO_STATUS] &= ~(BARO_T_DA | 0x10);
+	return 0;
+}
+
+int SimLPS331::write(char reg, char value) {
+	if(reg == SIM_WHO_AM_I || (reg >= BARO_STATUS && reg <= BARO_TEMP_OUT_H))
+		return 0;	// Read only
+	if(reg == BARO_CTRL_REG2) {
+		value &= ~0x84;	// BOOT and SWRESET clear themselves
+		oneShot = (value & 0x01) && (registers[BARO_CTRL_REG1] & 0x80);
+	}
+	return SimRegisterDevice::write(reg, value);
+}
@@ -0,0 +1,126 @@
+/*
+ * simSensors.h
+ *	Register level models of the AltIMU-10's three chips for software in the loop testing.
+ *	Each keeps the chip's register map: writes land in it, reads copy from it, and the
+ *	drivers configure the models exactly as they configure the hardware (data rate, full
+ *	scale, FIFO mode, power down). update() samples the true motion at the configured data
+ *	rate through the sensor's errors, scaled, quantised and clipped to its 16 or 24 bit
+ *	outputs, and sets the status bits the drivers poll. Bursts from the gyro and accel output
+ *	registers drain the FIFO when it's enabled in stream mode, oldest sample first, and
+ *	FIFO_SRC holds the stored sample count the way the chips report it.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef SIMSENSORS_H_
+#define SIMSENSORS_H_
+
+#include "simRandom.h"
+
+#define SIM_REGISTERS		0x40
+#define SIM_FIFO_SLOTS		32
+
+struct simTruth {	// What the sensors sense, in the sensor board's axes: x forward, y left, z up
+	double rates[3];		// deg/s
+	double accel[3];		// g, specific force: +1 on z sitting level
+	double mag[3];			// gauss
+	double pressure;		// mbar
+	double temperature;		// deg C
+};
+
+struct sensorErrors {	// In the sensor's output units
+	double bias[3];
+	double scale[3];	// Fraction, 0.01 reads 1% high
+	double noise;		// rms per sample
+};
+
+// Draws a bias and scale error per axis, for a sensor of the given noise
+void sim_sensor_errors(sensorErrors& e, double biasSigma, double scaleSigma, double noise, SimRandom& random);
+
+class SimRegisterDevice {
+
+protected:
+
+	unsigned char registers[SIM_REGISTERS];
+	sensorErrors errors;
+	SimRandom random;
+	double nextSample;	// us of simulated time, negative while the data rate is off
+
+	// FIFO, for the chips that have one
+	short fifo[SIM_FIFO_SLOTS][3];
+	int fifoHead, fifoCount;
+	short latest[3];	// What a read past the end of the FIFO gets
+
+	double measure(const sensorErrors& e, const double truth[3], int axis);	// Truth through the errors
+	static short quantise(double value, double lsb);	// To the nearest count, clipped
+	void store(int reg, short value);	// Little endian
+	void fifoPush(const short sample[3]);
+	int fifoRead(char data[], int size);	// 6 bytes a sample, the newest repeats once it's empty
+	void fifoReset() { fifoHead = fifoCount = 0; }
+	int fifoSource();	// FIFO_SRC: stored samples less one, 0x40 overrun, 0x20 empty
+	static bool covers(char reg, int size, int first, int last) { return reg <= last && reg + size > first; }
+
+	static int samplesDue(double& next, double rateHz, double timeMicros);	// Advances next past them
+	virtual double dataRate() = 0;	// Hz from the control registers, 0 when powered down
+	virtual void sample(const simTruth& truth) = 0;
+
+public:
+
+	SimRegisterDevice(const sensorErrors& e, uint64_t seed);
+
+	virtual int read(char reg, char data[], int size);
+	virtual int write(char reg, char value);
+	virtual void update(const simTruth& truth, double timeMicros);	// Takes every sample due by timeMicros
+	double getNextSample() { return nextSample; }	// us the next sample is taken at, negative while off
+
+	virtual ~SimRegisterDevice() {}
+};
+
+class SimL3GD20 : public SimRegisterDevice {	// Gyro: dps
+protected:
+	double dataRate();
+	void sample(const simTruth& truth);
+	bool fifoEnabled();
+	double lsb();
+public:
+	SimL3GD20(const sensorErrors& e, uint64_t seed);
+	int read(char reg, char data[], int size);
+	int write(char reg, char value);
+};
+
+class SimLMS303 : public SimRegisterDevice {	// Accel: g, and the magnetometer: gauss
+private:
+	sensorErrors magErrors;
+	double nextMagSample;
+	double magDataRate();
+	void sampleMag(const simTruth& truth);
+	bool fifoEnabled();
+	double accelLsb();
+	double magLsb();
+protected:
+	double dataRate();
+	void sample(const simTruth& truth);
+public:
+	SimLMS303(const sensorErrors& accel, const sensorErrors& mag, uint64_t seed);
+	int read(char reg, char data[], int size);
+	int write(char reg, char value);
+	void update(const simTruth& truth, double timeMicros);
+};
+
+class SimLPS331 : public SimRegisterDevice {	// Baro: mbar, the bias, scale and noise on x
+private:
+	bool oneShot;	// Conversion asked for in CTRL_REG2
+protected:
+	double dataRate();
+	void sample(const simTruth& truth);
+public:
+	SimLPS331(const sensorErrors& e, uint64_t seed);
+	int read(char reg, char data[], int size);
+	int write(char reg, char value);
+	void update(const simTruth& truth, double timeMicros);
+};
+
+double sim_pressure_at(double altitude);	// mbar, the standard atmosphere the driver inverts
+
+#endif /* SIMSENSORS_H_ */
@@ -0,0 +1,175 @@
+/*
+ * sitl.cpp
+ *	Software in the loop harness, see sitl.h.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "sitl.h"
+#include "../timing.h"
+#include <string.h>
+
+using namespace std;
+
+void sitl_default_config(sitlConfig& c) {
+	c.airspeed = 18;
+	c.altitude = 150;
+	c.heading = 0;
+	c.roll = 30;
+	c.pitch = 0;
+	c.seed = 1;
+
+	c.sensorErrors = true;
+	c.gyroNoise = 0.2;
+	c.gyroBias = 0.5;		// Taken out on the launcher by the gyro's zero rate calibration
+	c.gyroScale = 0.01;
+	c.accelNoise = 0.004;
+	c.accelBias = 0.005;	// Left after a six position calibration. 0.02 g uncalibrated tilts the AHRS a degree
+	c.accelScale = 0.01;
+	c.magNoise = 0.005;
+	c.magBias = 0.02;
+	c.magScale = 0.02;
+	c.baroNoise = 0.03;
+	c.baroBias = 1;
+
+	c.magneticField[0] = 0.22;	// The AHRS's reference, about mid latitude north
+	c.magneticField[1] = 0;
+	c.magneticField[2] = 0.42;
+	c.temperature = 25;
+}
+
+static sensorErrors errorsFor(const sitlConfig& c, double noise, double bias, double scale, uint64_t seed) {
+	sensorErrors e;
+	memset(&e, 0, sizeof(e));
+	e.noise = noise;
+	if(c.sensorErrors) {
+		SimRandom random(seed);
+		sim_sensor_errors(e, bias, scale, noise, random);
+	}
+	return e;
+}
+
+// Each sensor's errors and noise have their own streams, so changing one leaves the others alone
+SITL::SITL(const fixedWingParameters& parameters, const sitlConfig& c) :
+		config(c),
+		aircraft(parameters, c.seed),
+		gyro(errorsFor(c, c.gyroNoise, c.gyroBias, c.gyroScale, c.seed * 8 + 1), c.seed * 8 + 5),
+		lms303(errorsFor(c, c.accelNoise, c.accelBias, c.accelScale, c.seed * 8 + 2),
+				errorsFor(c, c.magNoise, c.magBias, c.magScale, c.seed * 8 + 3), c.seed * 8 + 6),
+		lps331(errorsFor(c, c.baroNoise, c.baroBias, 0, c.seed * 8 + 4), c.seed * 8 + 7) {
+	controls = NULL;
+	held = true;
+	lastMicros = micros();
+	simMicros = 0;
+	stepMicros = 0;
+	steps = 0;
+
+	trimThrottle = aircraft.trim(c.airspeed, c.altitude, c.heading * M_PI / 180, demand);
+	if(trimThrottle < 0)
+		cout << "Failed to trim the aircraft at " << c.airspeed << " m/s" << endl;
+	leftElevon = rightElevon = demand.elevator;
+
+	// The upset goes in on the launcher, so the AHRS starts from the attitude it flies off at
+	double roll, pitch, yaw;
+	aircraft.getEuler(roll, pitch, yaw);
+	aircraft.setAttitude(roll + c.roll * M_PI / 180, pitch + c.pitch * M_PI / 180, yaw);
+	sense();
+}
+
+void SITL::sense() {
+	// Body forward-right-down to the board's forward-left-up
+	const double* rates = aircraft.getRates();
+	const double* f = aircraft.getSpecificForce();
+	double held_f[3];
+	if(held) {	// The launcher carries the weight
+		double down[3] = { 0, 0, SIM_GRAVITY };
+		aircraft.bodyFromNED(down, held_f);
+		for(int i = 0; i < 3; i++) held_f[i] = -held_f[i];
+		f = held_f;
+	}
+	double mag[3];
+	aircraft.bodyFromNED(config.magneticField, mag);
+
+	const double sign[3] = { 1, -1, -1 };
+	for(int i = 0; i < 3; i++) {
+		truth.rates[i] = held ? 0 : sign[i] * rates[i] * 180 / M_PI;
+		truth.accel[i] = sign[i] * f[i] / SIM_GRAVITY;
+		truth.mag[i] = sign[i] * mag[i];
+	}
+	truth.pressure = sim_pressure_at(aircraft.getAltitude());
+	truth.temperature = config.temperature;
+}
+
+void SITL::advance() {
+	unsigned long now = micros();
+	simMicros += (unsigned long)(now - lastMicros);	// Wraps with micros() on 32 bit targets
+	lastMicros = now;
+	while(stepMicros + SITL_STEP_MICROS <= simMicros) {
+		stepMicros += SITL_STEP_MICROS;
+		if(!held)
+			aircraft.step(SITL_STEP_MICROS / 1e6);
+		sense();
+		gyro.update(truth, stepMicros);
+		lms303.update(truth, stepMicros);
+		lps331.update(truth, stepMicros);
+		steps++;
+	}
+}
+
+void SITL::release() {
+	advance();
+	held = false;
+	sense();
+}
+
+int SITL::read(int, int address, char reg, char data[], int size) {
+	advance();
+	switch(address) {
+	case SITL_L3GD20_ADDRESS: return gyro.read(reg, data, size);
+	case SITL_LMS303_ADDRESS: return lms303.read(reg, data, size);
+	case SITL_LPS331_ADDRESS: return lps331.read(reg, data, size);
+	default:
+		memset(data, 0, size);	// Nothing answers
+		return 1;
+	}
+}
+
+int SITL::write(int, int address, char reg, char value) {
+	advance();
+	switch(address) {
+	case SITL_L3GD20_ADDRESS: return gyro.write(reg, value);
+	case SITL_LMS303_ADDRESS: return lms303.write(reg, value);
+	case SITL_LPS331_ADDRESS: return lps331.write(reg, value);
+	default: return 1;
+	}
+}
+
+void SITL::setDuty(PWMChannel& channel, unsigned long duty) {
+	advance();
+	if(!controls)
+		return;
+	double span = (double)channel.getServoMax() - channel.getServoMin();
+	double travel = span > 0 ? ((double)duty - channel.getServoMin()) / span : 0;
+	if(travel < 0) travel = 0;	// The servo stops at its end, e.g. for init()'s 10 ms pulses
+	if(travel > 1) travel = 1;
+	double position = 2 * travel - 1;
+
+	// Channels share pins, so they're told apart by which PWMChannel wrote
+	if(&channel == &controls->throttleChannel)
+		demand.throttle = travel;
+	else if(controls->mixMode == FLAP_MIX_ELEVON) {
+		if(&channel == &controls->leftElevonChannel) leftElevon = position;
+		else if(&channel == &controls->rightElevonChannel) rightElevon = position;
+		else return;
+		demand.elevator = (leftElevon + rightElevon) / 2;
+		demand.aileron = (leftElevon - rightElevon) / 2;
+	}
+	else {
+		if(&channel == &controls->elevatorChannel) demand.elevator = position;
+		else if(&channel == &controls->aileronChannel) demand.aileron = position;
+		else if(&channel == &controls->rudderChannel) demand.rudder = position;
+		else return;
+	}
+	aircraft.setControls(demand);
+}
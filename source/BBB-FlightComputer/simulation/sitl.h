@@ -0,0 +1,100 @@
+/*
+ * sitl.h
+ *	Software in the loop: the flight code runs unmodified against a simulated aircraft. SITL
+ *	is installed as both the I2C transport (i2c_set_transport) and the PWM output
+ *	(pwm_set_output), so the real drivers talk to register models of the three chips and the
+ *	mixer's servo duties become surface deflections of a 6-DOF flying wing.
+ *
+ *	Time is lockstep virtual time (timing.h): nothing here sleeps. Whenever the flight code
+ *	touches a sensor or a servo, the aircraft is first integrated up to micros() in fixed
+ *	steps, and the sensors take every sample due on the way. Under setVirtualMicros() the
+ *	RTLoop jumps straight to each release, so a flight runs as fast as the host can compute
+ *	it, and a given seed reproduces it exactly.
+ *
+ *	The aircraft starts held on a launcher at the trim airspeed, so the drivers' reset
+ *	delays and the AHRS initialisation don't fly it; release() lets it go.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef SITL_H_
+#define SITL_H_
+
+#include "fixedWing.h"
+#include "simSensors.h"
+#include "../sensors/i2cTransport.h"
+#include "../flightControl/aircraftControls.h"
+
+#define SITL_STEP_MICROS		625		// 1600 Hz, the fastest sensor data rate
+
+#define SITL_LMS303_ADDRESS		0x1d
+#define SITL_LPS331_ADDRESS		0x5d
+#define SITL_L3GD20_ADDRESS		0x6b
+
+struct sitlConfig {
+	double airspeed;		// m/s, trimmed at the start
+	double altitude;		// m
+	double heading;			// deg
+	double roll, pitch;		// deg, upset from the trimmed attitude at release
+	uint64_t seed;
+
+	bool sensorErrors;		// Draw a bias and scale error for every sensor axis
+	double gyroNoise, gyroBias, gyroScale;		// dps rms, dps, fraction
+	double accelNoise, accelBias, accelScale;	// g
+	double magNoise, magBias, magScale;			// gauss
+	double baroNoise, baroBias;					// mbar
+	double magneticField[3];	// gauss, NED
+	double temperature;			// deg C
+};
+
+void sitl_default_config(sitlConfig& c);
+
+class SITL : public I2CTransport, public PWMOutput {
+
+private:
+
+	sitlConfig config;
+	FixedWing aircraft;
+	SimL3GD20 gyro;
+	SimLMS303 lms303;
+	SimLPS331 lps331;
+	simTruth truth;
+
+	aircraftControls* controls;
+	fixedWingControls demand;
+	double leftElevon, rightElevon;	// Servo positions, +/-1
+	double trimThrottle;
+
+	bool held;
+	unsigned long lastMicros;
+	uint64_t simMicros;		// Unwrapped
+	uint64_t stepMicros;	// Simulated up to here
+	unsigned long steps;
+
+	void advance();
+	void sense();
+
+public:
+
+	SITL(const fixedWingParameters& parameters, const sitlConfig& c);
+
+	int read(int bus, int address, char reg, char data[], int size);
+	int write(int bus, int address, char reg, char value);
+	void setDuty(PWMChannel& channel, unsigned long duty);
+
+	void attach(aircraftControls& aircraft) { controls = &aircraft; }	// Whose channels to listen to
+	void release();		// Off the launcher, with the configured upset
+	bool isHeld() { return held; }
+	void update() { advance(); }	// Catch up with micros()
+
+	FixedWing& getAircraft() { return aircraft; }
+	const simTruth& getTruth() { return truth; }
+	double getTrimThrottle() { return trimThrottle; }	// 0 to 1, negative if the airspeed can't be trimmed
+	double getTime() { return simMicros / 1e6; }		// s since the SITL was made
+	unsigned long getSteps() { return steps; }
+
+	virtual ~SITL() {}
+};
+
+#endif /* SITL_H_ */
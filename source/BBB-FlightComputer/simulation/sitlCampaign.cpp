@@ -0,0 +1,53 @@
+/*
+ * sitlCampaign.cpp
+ *	Monte Carlo dispersions for SITL flights, see sitlCampaign.h.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "sitlCampaign.h"
+
+void sitl_draw_dispersion(uint64_t seed, sitlDispersion& d) {
+	SimRandom random(seed * 8);	// The one stream of the eight the SITL leaves free
+	d.airspeed = random.uniform(CAMPAIGN_AIRSPEED_MIN, CAMPAIGN_AIRSPEED_MAX);
+	d.roll = random.uniform(-CAMPAIGN_ROLL_MAX, CAMPAIGN_ROLL_MAX);
+	d.pitch = random.uniform(-CAMPAIGN_PITCH_MAX, CAMPAIGN_PITCH_MAX);
+	d.windSpeed = random.uniform(0, CAMPAIGN_WIND_MAX);
+	d.windFrom = random.uniform(0, 360);
+	d.gust = random.uniform(0, CAMPAIGN_GUST_MAX);
+	d.cgForward = random.uniform(-CAMPAIGN_CG_FORWARD_MAX, CAMPAIGN_CG_FORWARD_MAX);
+	d.cgRight = random.uniform(-CAMPAIGN_CG_RIGHT_MAX, CAMPAIGN_CG_RIGHT_MAX);
+	d.servoTau = random.uniform(CAMPAIGN_SERVO_TAU_MIN, CAMPAIGN_SERVO_TAU_MAX);
+	d.noiseScale = random.uniform(CAMPAIGN_NOISE_MIN, CAMPAIGN_NOISE_MAX);
+}
+
+void sitl_apply_dispersion(const sitlDispersion& d, uint64_t seed, fixedWingParameters& p, sitlConfig& c) {
+	c.seed = seed;
+	c.altitude = CAMPAIGN_ALTITUDE;
+	c.airspeed = d.airspeed;
+	c.roll = d.roll;
+	c.pitch = d.pitch;
+	c.gyroNoise *= d.noiseScale;
+	c.accelNoise *= d.noiseScale;
+	c.magNoise *= d.noiseScale;
+	c.baroNoise *= d.noiseScale;
+
+	double from = d.windFrom * M_PI / 180;	// Blowing the other way
+	p.wind[0] = -d.windSpeed * cos(from);
+	p.wind[1] = -d.windSpeed * sin(from);
+	p.turbulence = d.gust;
+	p.cg[0] = d.cgForward;
+	p.cg[1] = d.cgRight;
+	p.servoTau = d.servoTau;
+}
+
+const char* sitl_campaign_failure(const sitlFlightResult& r, double duration) {
+	if(r.trimThrottle < 0) return "untrimmed";
+	if(r.crashed) return "crashed";
+	if(r.flown < duration) return "short";
+	if(r.recovered > CAMPAIGN_RECOVERY_SECONDS) return "recovery";
+	if(r.rollRms > CAMPAIGN_ROLL_RMS) return "roll";
+	if(r.pitchRms > CAMPAIGN_PITCH_RMS) return "pitch";
+	return NULL;
+}
@@ -0,0 +1,60 @@
+/*
+ * sitlCampaign.h
+ *	Monte Carlo dispersions for SITL flights. A campaign run is identified by its seed
+ *	alone: the seed draws the launch airspeed and upset, a steady wind and the gust level,
+ *	a CG offset, the servo lag and how noisy the sensors are, and as the SITL seed it also
+ *	draws every sensor's bias and scale errors, the noise and the gusts themselves. So
+ *	main-sitl -m seed flies exactly the run main-sitlCampaign flew.
+ *
+ *	The launcher trims the nominal airframe; CG offsets and wind are the controller's
+ *	problem from the moment it lets go.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef SITLCAMPAIGN_H_
+#define SITLCAMPAIGN_H_
+
+#include "sitlFlight.h"
+
+// There's no altitude hold: the controller holds attitude with the throttle at trim, so with
+// the CG, wind and gusts a run drifts off the trimmed flight path. Launched this high, a
+// run's descent can't reach the ground in the default time and it is judged on attitude
+#define CAMPAIGN_ALTITUDE			500		// m
+
+// Dispersions, drawn uniformly
+#define CAMPAIGN_AIRSPEED_MIN		17		// m/s
+#define CAMPAIGN_AIRSPEED_MAX		20
+#define CAMPAIGN_ROLL_MAX			45		// deg, either way
+#define CAMPAIGN_PITCH_MAX			15
+#define CAMPAIGN_WIND_MAX			5		// m/s, from anywhere
+#define CAMPAIGN_GUST_MAX			1.5		// m/s rms
+#define CAMPAIGN_CG_FORWARD_MAX		0.02	// m either way, about 6% of the chord
+#define CAMPAIGN_CG_RIGHT_MAX		0.005	// m either way
+#define CAMPAIGN_SERVO_TAU_MIN		0.01	// s
+#define CAMPAIGN_SERVO_TAU_MAX		0.06
+#define CAMPAIGN_NOISE_MIN			0.5		// Times the default sensor noise
+#define CAMPAIGN_NOISE_MAX			2
+
+// A run passes if it didn't crash, recovered from the upset in time and held the attitude
+#define CAMPAIGN_RECOVERY_SECONDS	SITL_SETTLE_SECONDS
+#define CAMPAIGN_ROLL_RMS			5		// deg, after SITL_SETTLE_SECONDS
+#define CAMPAIGN_PITCH_RMS			5
+
+struct sitlDispersion {	// One run's draw
+	double airspeed;			// m/s
+	double roll, pitch;			// deg
+	double windSpeed, windFrom;	// m/s, deg true
+	double gust;				// m/s rms
+	double cgForward, cgRight;	// m
+	double servoTau;			// s
+	double noiseScale;
+};
+
+void sitl_draw_dispersion(uint64_t seed, sitlDispersion& d);
+void sitl_apply_dispersion(const sitlDispersion& d, uint64_t seed, fixedWingParameters& p, sitlConfig& c);
+
+const char* sitl_campaign_failure(const sitlFlightResult& r, double duration);	// NULL if it passed
+
+#endif /* SITLCAMPAIGN_H_ */
@@ -0,0 +1,237 @@
+/*
+ * sitlFlight.cpp
+ *	One software in the loop flight, see sitlFlight.h.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#include "sitlFlight.h"
+#include "../flightControl/flightLoop.h"
+#include "../realtime/latency.h"
+#include "../realtime/allocTrack.h"
+#include <string.h>
+
+using namespace std;
+
+static double nanoseconds() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// The truth's ground velocity in the INS frame, north, west, up. The simulated field has no
+// east component, so magnetic north is true north
+static void navVelocity(FixedWing& wing, double velocity[3]) {
+	const fixedWingState& s = wing.getState();
+	double w = s.attitude[0], x = s.attitude[1], y = s.attitude[2], z = s.attitude[3];
+	const double* v = s.velocity;
+	double ned[3] = {
+		(1 - 2 * (y * y + z * z)) * v[0] + 2 * (x * y - w * z) * v[1] + 2 * (x * z + w * y) * v[2],
+		2 * (x * y + w * z) * v[0] + (1 - 2 * (x * x + z * z)) * v[1] + 2 * (y * z - w * x) * v[2],
+		2 * (x * z - w * y) * v[0] + 2 * (y * z + w * x) * v[1] + (1 - 2 * (x * x + y * y)) * v[2] };
+	velocity[0] = ned[0];
+	velocity[1] = -ned[1];
+	velocity[2] = -ned[2];
+}
+
+static double wrap180(double degrees) {
+	while(degrees > 180) degrees -= 360;
+	while(degrees < -180) degrees += 360;
+	return degrees;
+}
+
+static uint64_t fnv1a(uint64_t h, const void* data, size_t size) {
+	const unsigned char* p = (const unsigned char*)data;
+	for(size_t i = 0; i < size; i++) {
+		h ^= p[i];
+		h *= 0x100000001B3ULL;
+	}
+	return h;
+}
+
+int sitl_fly(const fixedWingParameters& parameters, const sitlConfig& config, float gyroRateHz, double duration,
+		sitlFlightResult& result, FILE* truth, const char* flightLog, ostream* report) {
+	memset(&result, 0, sizeof(result));
+	result.altitudeMin = result.airspeedMin = 1e9;
+	result.altitudeMax = result.airspeedMax = -1e9;
+	result.signature = 0xCBF29CE484222325ULL;
+	rtLoopConfig rt;
+	RTLoop::defaultConfig(rt, gyroRateHz);
+	rt.priority = 0;	// A simulation, not a flight: no SCHED_FIFO, pinning or locked memory
+	rt.cpu = -1;
+	rt.lockMemory = false;
+
+	setVirtualMicros(1000000);
+	SITL sitl(parameters, config);
+	result.trimThrottle = sitl.getTrimThrottle();
+	if(sitl.getTrimThrottle() < 0)
+		return 1;
+	i2c_set_transport(&sitl);
+	pwm_set_output(&sitl);
+
+	// From here on as main.cpp
+	LMS303 lms303(1, SITL_LMS303_ADDRESS);
+	LPS331Altimeter alt(1, SITL_LPS331_ADDRESS);
+	L3GD20Gyro gyro(1, SITL_L3GD20_ADDRESS);
+	gyro.calibrateZeroRate(FLIGHT_GYRO_ZERO_READS);	// Still held on the launcher
+
+	aircraftControls aircraft(FLAP_MIX_ELEVON);
+	sitl.attach(aircraft);
+	aircraft.init();
+	aircraft.setThrottle(sitl.getTrimThrottle() * 200 - 100);	// The pilot's stick, -100 to 100 percent
+
+	// On the hardware the setup's I2C traffic takes long enough for the accel FIFO to fill. Bus
+	// transfers take no virtual time, so wait for samples before the AHRS takes its first look
+	delayMicros(100000);
+	lms303.readFullSensorState();
+	uimu_ahrs_init(lms303.read_acc(), lms303.read_mag());
+	uimu_ahrs_set_beta(FLIGHT_AHRS_BETA);
+
+	AttitudeController controller;
+
+	FlightRecorder recorder;
+	if(flightLog && recorder.open(flightLog, FLIGHT_LOOP_HZ))
+		cout << "Flying without a flight log" << endl;
+	ImuStreamWriter imuStream;
+	if(recorder.isOpen() && imuStream.open((string(flightLog) + IMU_STREAM_SUFFIX).c_str()))
+		cout << "Flying without the raw IMU stream" << endl;
+
+	RateGroupExecutive executive(rt.rateHz);
+	flightTasks tasks;
+	flight_tasks_init(tasks, lms303, alt, gyro, aircraft, controller, recorder, imuStream, executive);
+	int overloaded = flight_tasks_add(tasks) ? -1 : executive.build();
+	if(overloaded < 0) {
+		cout << "Can't schedule the flight tasks at " << rt.rateHz << " Hz" << endl;
+		recorder.close();
+		imuStream.close();
+		i2c_set_transport(NULL);
+		pwm_set_output(NULL);
+		return 2;
+	}
+	if(overloaded)
+		cout << "Task budgets don't fit the gyro rate, low priority tasks will be shed" << endl;
+	if(report) executive.printSchedule(*report);
+	executive.setup(rt);
+
+	if(truth)
+		fprintf(truth, "time,roll,pitch,heading,ahrs_roll,ahrs_pitch,ahrs_heading,altitude,airspeed,"
+				"alpha,beta,elevator,aileron,throttle\n");
+
+	FixedWing& wing = sitl.getAircraft();
+	double rollSquares = 0, pitchSquares = 0, rollErrorSquares = 0, pitchErrorSquares = 0;
+	double velocityErrorSquares = 0, climbErrorSquares = 0;
+	double baroErrorSum = 0, baroErrorSquares = 0, verticalErrorSum = 0, verticalErrorSquares = 0;
+	double verticalClimbErrorSquares = 0;
+	int framesPerRecord = (int)(rt.rateHz / FLIGHT_LOOP_HZ);
+
+	sitl.release();
+	double velocity[3];
+	navVelocity(wing, velocity);	// Off the launcher at speed, not from rest
+	tasks.ins.setVelocity(velocity);
+	double startAltitude = wing.getAltitude(), startHeight = tasks.ins.solution().position[2];
+	unsigned long launched = micros();
+	double wallStart = nanoseconds();
+	double flown = 0;
+	bool tracking = false;
+	bool recovered = false;
+	for(unsigned long frame = 0; flown < duration && !wing.isCrashed(); frame++) {
+		executive.runFrame();
+		flown = (unsigned long)(micros() - launched) / 1e6;
+		if(!tracking && flown >= ALLOC_TRACK_WARMUP_SECONDS) {
+			alloc_track_start();
+			tracking = true;
+		}
+		if(frame % framesPerRecord)
+			continue;
+
+		// Aerospace angles: x forward, y right, z down, so pitch up is positive. The AHRS is
+		// x forward, y left, z up: its roll matches, its pitch and heading are mirrored
+		double roll, pitch, yaw;
+		wing.getEuler(roll, pitch, yaw);
+		roll *= 180 / M_PI;
+		pitch *= 180 / M_PI;
+		yaw *= 180 / M_PI;
+		const imu::Vector<3>& euler = uimu_ahrs_get_euler();
+		double rollError = wrap180(euler.z() - roll);
+		double pitchError = -euler.y() - pitch;
+		double altitude = wing.getAltitude(), airspeed = wing.getAirspeed();
+
+		double record[] = { roll, pitch, yaw, euler.x(), euler.y(), euler.z(), altitude, airspeed };
+		result.signature = fnv1a(result.signature, record, sizeof(record));
+
+		if(fabs(roll) > SITL_UPSET_DEGREES || fabs(pitch) > SITL_UPSET_DEGREES) {
+			if(!recovered)
+				result.recovered = flown;
+		}
+		else if(flown - result.recovered >= SITL_RECOVERED_SECONDS)
+			recovered = true;
+		if(flown >= SITL_SETTLE_SECONDS) {
+			result.samples++;
+			rollSquares += roll * roll;
+			pitchSquares += pitch * pitch;
+			if(fabs(roll) > result.rollMax) result.rollMax = fabs(roll);
+			if(fabs(pitch) > result.pitchMax) result.pitchMax = fabs(pitch);
+			rollErrorSquares += rollError * rollError;
+			pitchErrorSquares += pitchError * pitchError;
+
+			const insSolution& ins = tasks.ins.solution();
+			navVelocity(wing, velocity);
+			double error[3];
+			for(int k = 0; k < 3; k++)
+				error[k] = ins.velocity[k] - velocity[k];
+			velocityErrorSquares += error[0] * error[0] + error[1] * error[1] + error[2] * error[2];
+			climbErrorSquares += error[2] * error[2];
+
+			// The baro's bias is a fixed offset, so only the varying part of the error counts
+			double baroError = alt.getAltitude() - altitude, verticalError = tasks.vertical.getAltitude() - altitude;
+			double climbError = tasks.vertical.getClimbRate() - velocity[2];
+			baroErrorSum += baroError;
+			baroErrorSquares += baroError * baroError;
+			verticalErrorSum += verticalError;
+			verticalErrorSquares += verticalError * verticalError;
+			verticalClimbErrorSquares += climbError * climbError;
+		}
+		if(altitude < result.altitudeMin) result.altitudeMin = altitude;
+		if(altitude > result.altitudeMax) result.altitudeMax = altitude;
+		if(airspeed < result.airspeedMin) result.airspeedMin = airspeed;
+		if(airspeed > result.airspeedMax) result.airspeedMax = airspeed;
+
+		if(truth) {
+			const fixedWingControls& s = wing.getSurfaces();
+			fprintf(truth, "%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.2f,%.2f,%.3f,%.3f,%.3f,%.3f,%.3f\n", flown, roll, pitch,
+					yaw, euler.z(), -euler.y(), wrap180(-euler.x()), altitude, airspeed,
+					wing.getAlpha() * 180 / M_PI, wing.getBeta() * 180 / M_PI, s.elevator, s.aileron, s.throttle);
+		}
+	}
+	result.wallSeconds = (nanoseconds() - wallStart) / 1e9;
+	result.flown = flown;
+	result.crashed = wing.isCrashed();
+	result.steps = sitl.getSteps();
+	result.heightError = (tasks.ins.solution().position[2] - startHeight) - (wing.getAltitude() - startAltitude);
+	if(result.samples) {
+		result.rollRms = sqrt(rollSquares / result.samples);
+		result.pitchRms = sqrt(pitchSquares / result.samples);
+		result.rollErrorRms = sqrt(rollErrorSquares / result.samples);
+		result.pitchErrorRms = sqrt(pitchErrorSquares / result.samples);
+		result.velocityErrorRms = sqrt(velocityErrorSquares / result.samples);
+		result.climbErrorRms = sqrt(climbErrorSquares / result.samples);
+		double n = result.samples;
+		result.baroErrorRms = sqrt(fmax(0, baroErrorSquares / n - (baroErrorSum / n) * (baroErrorSum / n)));
+		result.verticalErrorRms = sqrt(fmax(0, verticalErrorSquares / n - (verticalErrorSum / n) * (verticalErrorSum / n)));
+		result.verticalClimbErrorRms = sqrt(verticalClimbErrorSquares / result.samples);
+	}
+	recorder.close();
+	imuStream.close();
+
+	if(report) {
+		executive.report(*report);
+		latency_report(*report);
+		if(flightLog) recorder.report(*report, "Flight log");
+		if(flightLog) imuStream.report(*report);
+		alloc_track_report(*report);
+	}
+	i2c_set_transport(NULL);
+	pwm_set_output(NULL);
+	return 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * sitlFlight.h
+ *	One software in the loop flight: the drivers, AHRS, controller, mixer and rate group
+ *	executive of main.cpp flown against a SITL (sitl.h) from launch until the duration or a
+ *	crash, with how well the attitude was held measured against the truth. main-sitl flies
+ *	one; main-sitlCampaign flies thousands.
+ *
+ *	The flight code keeps its state in globals (virtual time, the AHRS, the I2C and PWM
+ *	hooks), so this flies once per process. In a fresh process a given aircraft, config and
+ *	gyro rate always fly the same trajectory, and its signature says so.
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: John Boyd
+ */
+
+#ifndef SITLFLIGHT_H_
+#define SITLFLIGHT_H_
+
+#include "sitl.h"
+#include <stdio.h>
+#include <iostream>
+
+#define SITL_SETTLE_SECONDS		10		// Upset recovery, left out of the holding statistics
+#define SITL_UPSET_DEGREES		5		// Recovered once roll and pitch stay inside this
+#define SITL_RECOVERED_SECONDS	5		// For this long. Later gust excursions count against holding, not recovery
+
+struct sitlFlightResult {
+	double flown;			// s after release
+	bool crashed;
+	double recovered;		// s after release, start of the first SITL_RECOVERED_SECONDS inside SITL_UPSET_DEGREES
+	unsigned long samples;	// 50 Hz records after SITL_SETTLE_SECONDS
+	double rollRms, rollMax, pitchRms, pitchMax;	// deg, after SITL_SETTLE_SECONDS
+	double rollErrorRms, pitchErrorRms;				// AHRS against the truth
+	double velocityErrorRms, climbErrorRms;			// m/s, INS against the truth
+	double heightError;								// m, INS height gained against the truth at the end
+	double baroErrorRms, verticalErrorRms;			// m, raw baro and vertical channel altitude, less their mean error
+	double verticalClimbErrorRms;					// m/s, vertical channel
+	double altitudeMin, altitudeMax, airspeedMin, airspeedMax;
+	double trimThrottle;	// 0 to 1, negative if it couldn't be launched
+	double wallSeconds;
+	unsigned long steps;	// Of the simulation
+	uint64_t signature;		// Hash of the 50 Hz true and estimated attitude, position and airspeed
+};
+
+// Returns 0 if it flew, 1 if it couldn't trim, 2 if the flight tasks don't schedule at
+// gyroRateHz. truth gets the 50 Hz CSV of main-sitl -o, flightLog the recorder's log; report,
+// if given, gets the schedule before and the executive and latency reports after
+int sitl_fly(const fixedWingParameters& parameters, const sitlConfig& config, float gyroRateHz, double duration,
+		sitlFlightResult& result, FILE* truth = NULL, const char* flightLog = NULL, std::ostream* report = NULL);
+
+#endif /* SITLFLIGHT_H_ */
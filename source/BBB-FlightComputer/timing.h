@@ -0,0 +1,23 @@
+//============================================================================
+// Name        : timing.h
+// Author      : John Boyd
+// Version     :
+// Copyright   : This work is free for you to copy.
+// Description : Time base of the flight computer, defined in
+//				 BBB-FlightComputer.cpp. Drivers include this instead of
+//				 BBB-FlightComputer.h to keep out the other devices' macros.
+//============================================================================
+
+#ifndef TIMING_H_
+#define TIMING_H_
+
+unsigned long micros();
+void delayMicros(unsigned long us);
+
+// Replay and simulation: micros() returns the last value set here and delayMicros() only
+// advances it, until useRealTime() switches back to CLOCK_MONOTONIC.
+void setVirtualMicros(unsigned long us);
+void useRealTime();
+bool usingVirtualTime();
+
+#endif /* TIMING_H_ */
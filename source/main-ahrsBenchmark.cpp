@@ -0,0 +1,528 @@
+//============================================================================
+// Name        : main-ahrsBenchmark.cpp
+// Author      : John Boyd
+// Version     :
+// Copyright   : This work is free for you to copy.
+// Description : Head to head benchmark of the AHRS filters. Reports the cost
+//				 of one filter update and the attitude error on a synthetic
+//				 trajectory, and optionally on a recorded CSV file with rows of
+//				 dt,gx,gy,gz,ax,ay,az,mx,my,mz[,qw,qx,qy,qz]
+//				 (seconds, deg/s, g, gauss, optional reference quaternion).
+//				 Also compares integrating every 800Hz gyro FIFO sample against
+//				 one update per tick with the FIFO average, and running the full
+//				 update every call against skipping stale accel/mag samples, and
+//				 the cost of attitude reads with and without the cached snapshot.
+//				 Last the fixed point Mahony filter is run against the float one,
+//				 on the same samples quantised to Q15 as the sensors output them,
+//				 for the spread of update times and the attitude difference.
+//				 Build with -DAHRS_FIXED_POINT to run every uimu_ahrs_* section
+//				 above on the fixed point filter.
+//				 Usage: main-ahrsBenchmark [recording.csv]
+//============================================================================
+
+#include "BBB-FlightComputer/BBB-FlightComputer.h"
+#include "BBB-FlightComputer/AHRS/fixedAhrs.h"
+#include <vector>
+#include <algorithm>
+
+#define SYNTH_RATE_HZ		200		// Filter update rate of the synthetic run
+#define SYNTH_SECONDS		120
+#define SYNTH_SUBSTEPS		20		// Truth is integrated this much finer than the filter
+#define WARMUP_SECONDS		5.0		// Errors are not scored while the filter settles
+#define FIFO_RATE_HZ		800		// Gyro output data rate for the batch comparison
+#define TICK_RATE_HZ		100		// Flight loop rate for the batch comparison
+#define MAG_RATE_HZ			100		// LMS303 magnetometer data rate
+#define ACCEL_RATE_HZ		400		// Accelerometer data rate for the freshness comparison
+#define READERS_PER_CYCLE	3		// Controller, logger and telemetry
+#define READ_PASSES			5		// Best of, for the attitude read comparison
+#define MAHONY_KP			0.5
+#define MAHONY_KI			0.05
+
+using namespace std;
+
+struct ahrsSample {
+	double dt;
+	double g[3];	// deg/s
+	double a[3];	// g
+	double m[3];	// gauss
+	double ref[4];	// w, x, y, z
+	bool hasRef;
+};
+
+struct ahrsResult {
+	double nsPerUpdate;
+	double rmsErrorDeg;
+	double maxErrorDeg;
+};
+
+static double gaussian(unsigned int* seed) {	// Box-Muller, deterministic per seed
+	double u1 = (rand_r(seed) + 1.0) / (RAND_MAX + 2.0);
+	double u2 = (rand_r(seed) + 1.0) / (RAND_MAX + 2.0);
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static double nanoseconds() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double angleBetween(imu::Quaternion a, imu::Quaternion b) {	// In degrees
+	imu::Quaternion e = a.conjugate() * b;
+	double w = fabs(e.w()) / e.magnitude();
+	if(w > 1.0) w = 1.0;
+	return 2.0 * acos(w) * 180.0 / M_PI;
+}
+
+static void generateSynthetic(vector<ahrsSample>& samples, int rate) {
+	unsigned int seed = 1234;
+	double dt = 1.0 / rate;
+	double h = dt / SYNTH_SUBSTEPS;
+	double gyroBias[3] = { 0.4, -0.3, 0.2 };	// deg/s
+	imu::Vector<3> gravity(0.0, 0.0, 1.0);
+	imu::Vector<3> field(0.22, 0.0, -0.41);	// Roughly mid-latitude, in gauss
+	imu::Quaternion truth;
+	double t = 0;
+
+	for(int i = 0; i < rate * SYNTH_SECONDS; i++) {
+		double w[3];
+		for(int s = 0; s < SYNTH_SUBSTEPS; s++) {	// Exact rotation per substep
+			w[0] = 1.2 * sin(0.7 * t);
+			w[1] = 0.8 * sin(1.3 * t + 0.5);
+			w[2] = 0.5 * cos(0.4 * t);
+			double mag = sqrt(w[0]*w[0] + w[1]*w[1] + w[2]*w[2]);
+			imu::Quaternion step;
+			if(mag > 1e-12) {
+				imu::Vector<3> axis(w[0] / mag, w[1] / mag, w[2] / mag);
+				step.fromAxisAngle(axis, mag * h);
+			}
+			truth = truth * step;
+			t += h;
+		}
+		truth.normalize();
+
+		ahrsSample s;
+		s.dt = dt;
+		imu::Vector<3> a = truth.conjugate().rotateVector(gravity);
+		imu::Vector<3> m = truth.conjugate().rotateVector(field);
+		for(int k = 0; k < 3; k++) {
+			s.g[k] = w[k] * 180.0 / M_PI + gyroBias[k] + 0.3 * gaussian(&seed);
+			s.a[k] = a(k) + 0.01 * gaussian(&seed);
+			s.m[k] = m(k) + 0.005 * gaussian(&seed);
+		}
+		s.ref[0] = truth.w();
+		s.ref[1] = truth.x();
+		s.ref[2] = truth.y();
+		s.ref[3] = truth.z();
+		s.hasRef = true;
+		samples.push_back(s);
+	}
+}
+
+static int loadRecording(const char* path, vector<ahrsSample>& samples) {
+	FILE* in = fopen(path, "r");
+	if(in == NULL) {
+		cout << "Failed to open recording " << path << endl;
+		return 1;
+	}
+
+	char line[512];
+	while(fgets(line, sizeof(line), in) != NULL) {
+		if(line[0] == '#' || line[0] == '\n') continue;
+		ahrsSample s;
+		int n = sscanf(line, "%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf",
+				&s.dt, &s.g[0], &s.g[1], &s.g[2], &s.a[0], &s.a[1], &s.a[2],
+				&s.m[0], &s.m[1], &s.m[2], &s.ref[0], &s.ref[1], &s.ref[2], &s.ref[3]);
+		if(n < 10) continue;	// Header or malformed row
+		s.hasRef = (n == 14);
+		samples.push_back(s);
+	}
+	fclose(in);
+	return 0;
+}
+
+static imu::Quaternion startingAttitude(const vector<ahrsSample>& samples) {
+	const ahrsSample& s = samples[0];
+	if(s.hasRef)
+		return imu::Quaternion(s.ref[0], s.ref[1], s.ref[2], s.ref[3]);
+
+	imu::Vector<3> acc(s.a[0], s.a[1], s.a[2]);
+	imu::Vector<3> mag(s.m[0], s.m[1], s.m[2]);
+	uimu_ahrs_init(acc, mag);
+	return uimu_ahrs_get_imu_quaternion();
+}
+
+// Runs one filter over the samples. When against is not NULL, error is scored against
+// that trajectory instead of the recorded reference.
+static ahrsResult runFilter(UIMU_AHRS_FILTER filter, const vector<ahrsSample>& samples,
+		vector<imu::Quaternion>* trace, const vector<imu::Quaternion>* against) {
+	ahrsResult r = { 0, 0, 0 };
+	uimu_ahrs_set_filter(filter);
+	uimu_ahrs_reset(startingAttitude(samples));
+
+	// Timed pass
+	double start = nanoseconds();
+	for(size_t i = 0; i < samples.size(); i++) {
+		const ahrsSample& s = samples[i];
+		uimu_ahrs_update(imu::Vector<3>(s.g[0], s.g[1], s.g[2]),
+				imu::Vector<3>(s.a[0], s.a[1], s.a[2]),
+				imu::Vector<3>(s.m[0], s.m[1], s.m[2]), s.dt);
+	}
+	r.nsPerUpdate = (nanoseconds() - start) / samples.size();
+
+	// Scored pass
+	uimu_ahrs_reset(startingAttitude(samples));
+	double t = 0, sumSq = 0;
+	int scored = 0;
+	for(size_t i = 0; i < samples.size(); i++) {
+		const ahrsSample& s = samples[i];
+		uimu_ahrs_update(imu::Vector<3>(s.g[0], s.g[1], s.g[2]),
+				imu::Vector<3>(s.a[0], s.a[1], s.a[2]),
+				imu::Vector<3>(s.m[0], s.m[1], s.m[2]), s.dt);
+		t += s.dt;
+
+		imu::Quaternion est = uimu_ahrs_get_imu_quaternion();
+		if(trace != NULL) trace->push_back(est);
+		if(t < WARMUP_SECONDS) continue;
+
+		double err;
+		if(against != NULL) err = angleBetween((*against)[i], est);
+		else if(s.hasRef) err = angleBetween(imu::Quaternion(s.ref[0], s.ref[1], s.ref[2], s.ref[3]), est);
+		else continue;
+
+		sumSq += err * err;
+		if(err > r.maxErrorDeg) r.maxErrorDeg = err;
+		scored++;
+	}
+	r.rmsErrorDeg = scored ? sqrt(sumSq / scored) : 0;
+	return r;
+}
+
+static void report(const char* name, ahrsResult r) {
+	printf("  %-10s %8.1f ns/update   rms %7.3f deg   max %7.3f deg\n",
+			name, r.nsPerUpdate, r.rmsErrorDeg, r.maxErrorDeg);
+}
+
+static void compare(const char* title, const vector<ahrsSample>& samples) {
+	bool hasRef = samples[0].hasRef;
+	printf("%s (%lu samples%s)\n", title, (unsigned long)samples.size(),
+			hasRef ? "" : ", no reference: error is Mahony vs Madgwick");
+
+	vector<imu::Quaternion> madgwickTrace;
+	ahrsResult madgwick = runFilter(AHRS_FILTER_MADGWICK, samples, &madgwickTrace, NULL);
+	ahrsResult mahony = runFilter(AHRS_FILTER_MAHONY, samples, NULL, hasRef ? NULL : &madgwickTrace);
+
+	report("Madgwick", madgwick);
+	report("Mahony", mahony);
+}
+
+// Feeds 800Hz samples in ticks of FIFO_RATE_HZ/TICK_RATE_HZ, either averaged into one
+// update per tick or integrated sample by sample with the correction at the tick rate.
+static void compareBatch(const vector<ahrsSample>& samples) {
+	const int perTick = FIFO_RATE_HZ / TICK_RATE_HZ;
+	const unsigned long interval = 1000000 / FIFO_RATE_HZ;
+	printf("Gyro FIFO at %d Hz, %d samples per %d Hz tick (%s)\n", FIFO_RATE_HZ, perTick, TICK_RATE_HZ,
+			uimu_ahrs_get_filter() == AHRS_FILTER_MAHONY ? "Mahony" : "Madgwick");
+	uimu_ahrs_set_correction_rate(TICK_RATE_HZ);
+
+	for(int mode = 0; mode < 2; mode++) {
+		uimu_ahrs_reset(startingAttitude(samples));
+		unsigned long base = micros();
+		double spent = 0, sumSq = 0, worst = 0;
+		int scored = 0;
+
+		for(size_t start = 0; start + perTick <= samples.size(); start += perTick) {
+			const ahrsSample& last = samples[start + perTick - 1];
+			imu::Vector<3> acc(last.a[0], last.a[1], last.a[2]);
+			imu::Vector<3> mag(last.m[0], last.m[1], last.m[2]);
+
+			double t0;
+			if(mode == 0) {
+				double g[3] = { 0, 0, 0 };
+				for(int i = 0; i < perTick; i++)
+					for(int k = 0; k < 3; k++)
+						g[k] += samples[start + i].g[k] / perTick;
+				t0 = nanoseconds();
+				uimu_ahrs_update(imu::Vector<3>(g[0], g[1], g[2]), acc, mag, perTick / (double)FIFO_RATE_HZ);
+			}
+			else {
+				gyroFIFOBatch batch;
+				batch.count = perTick;
+				batch.scale = FIXED_AHRS_GYRO_FULL_SCALE / 32768.0f;
+				for(int i = 0; i < perTick; i++) {
+					batch.x[i] = samples[start + i].g[0];
+					batch.y[i] = samples[start + i].g[1];
+					batch.z[i] = samples[start + i].g[2];
+					for(int k = 0; k < 3; k++)
+						batch.raw[i][k] = fixedpoint::toQ15(samples[start + i].g[k], FIXED_AHRS_GYRO_FULL_SCALE);
+					batch.timestamp[i] = base + (start + i + 1) * interval;
+				}
+				t0 = nanoseconds();
+				uimu_ahrs_iterate_batch(batch, acc, mag);
+			}
+			spent += nanoseconds() - t0;
+
+			if((start + perTick) / (double)FIFO_RATE_HZ < WARMUP_SECONDS) continue;
+			double err = angleBetween(imu::Quaternion(last.ref[0], last.ref[1], last.ref[2], last.ref[3]),
+					uimu_ahrs_get_imu_quaternion());
+			sumSq += err * err;
+			if(err > worst) worst = err;
+			scored++;
+		}
+
+		printf("  %-10s %8.1f ns/gyro sample  rms %7.3f deg   max %7.3f deg\n",
+				mode == 0 ? "averaged" : "per sample", spent / samples.size(),
+				scored ? sqrt(sumSq / scored) : 0, worst);
+	}
+}
+
+// Runs the filter at the gyro rate with accel and mag arriving at their own slower
+// rates, once treating every call as fresh and once passing the real freshness.
+static void compareFreshness(const vector<ahrsSample>& samples) {
+	const int magEvery = FIFO_RATE_HZ / MAG_RATE_HZ;
+	const int accEvery = FIFO_RATE_HZ / ACCEL_RATE_HZ;
+	printf("Filter at %d Hz, accel at %d Hz, mag at %d Hz (%s)\n", FIFO_RATE_HZ, ACCEL_RATE_HZ, MAG_RATE_HZ,
+			uimu_ahrs_get_filter() == AHRS_FILTER_MAHONY ? "Mahony" : "Madgwick");
+
+	for(int mode = 0; mode < 2; mode++) {
+		uimu_ahrs_reset(startingAttitude(samples));
+		double spent = 0, sumSq = 0, worst = 0;
+		int scored = 0;
+		size_t accIndex = 0, magIndex = 0;	// Latest sample each sensor has produced
+
+		for(size_t i = 0; i < samples.size(); i++) {
+			bool accFresh = (i % accEvery) == 0;
+			bool magFresh = (i % magEvery) == 0;
+			if(accFresh) accIndex = i;
+			if(magFresh) magIndex = i;
+			const ahrsSample& s = samples[i];
+			const ahrsSample& sa = samples[accIndex];
+			const ahrsSample& sm = samples[magIndex];
+
+			imu::Vector<3> g(s.g[0], s.g[1], s.g[2]);
+			imu::Vector<3> a(sa.a[0], sa.a[1], sa.a[2]);
+			imu::Vector<3> m(sm.m[0], sm.m[1], sm.m[2]);
+			double t0 = nanoseconds();
+			if(mode == 0) uimu_ahrs_update(g, a, m, s.dt);
+			else uimu_ahrs_update(g, a, m, s.dt, accFresh, magFresh);
+			spent += nanoseconds() - t0;
+
+			if(i / (double)FIFO_RATE_HZ < WARMUP_SECONDS) continue;
+			double err = angleBetween(imu::Quaternion(s.ref[0], s.ref[1], s.ref[2], s.ref[3]),
+					uimu_ahrs_get_imu_quaternion());
+			sumSq += err * err;
+			if(err > worst) worst = err;
+			scored++;
+		}
+
+		printf("  %-10s %8.1f ns/update   rms %7.3f deg   max %7.3f deg\n",
+				mode == 0 ? "always" : "fresh only", spent / samples.size(),
+				scored ? sqrt(sumSq / scored) : 0, worst);
+	}
+}
+
+// Mode 0 is the float Mahony filter on the float samples, 1 the float filter on the samples
+// quantised to Q15 as the sensors would output them, and 2 the fixed point filter on those.
+// Each update is timed on its own, so the spread shows as well as the mean
+static void runMahony(int mode, const vector<ahrsSample>& samples, vector<double>& ns, vector<imu::Quaternion>& trace) {
+	const float gyroLsb = FIXED_AHRS_GYRO_FULL_SCALE / 32768.0f;
+	const float accLsb = FIXED_AHRS_ACC_FULL_SCALE / 32768.0f;
+	const float magLsb = FIXED_AHRS_MAG_FULL_SCALE / 32768.0f;
+	imu::Quaternion start = startingAttitude(samples);
+	FixedAhrs fixedFilter;
+	fixedFilter.setGains(MAHONY_KP, MAHONY_KI);
+	fixedFilter.setGyroScale(gyroLsb);
+	fixedFilter.reset(start);
+	uimu_ahrs_set_filter(AHRS_FILTER_MAHONY);
+	uimu_ahrs_reset(start);
+
+	for(size_t i = 0; i < samples.size(); i++) {
+		const ahrsSample& s = samples[i];
+		int16_t g[3], a[3], m[3];
+		for(int k = 0; k < 3; k++) {
+			g[k] = fixedpoint::toQ15(s.g[k], FIXED_AHRS_GYRO_FULL_SCALE);
+			a[k] = fixedpoint::toQ15(s.a[k], FIXED_AHRS_ACC_FULL_SCALE);
+			m[k] = fixedpoint::toQ15(s.m[k], FIXED_AHRS_MAG_FULL_SCALE);
+		}
+
+		double t0;
+		if(mode == 2) {
+			uint32_t micros = (uint32_t)(s.dt * 1e6 + 0.5);
+			t0 = nanoseconds();
+			fixedFilter.update(g, a, m, micros);
+			fixedFilter.normalize();
+			trace.push_back(fixedFilter.quaternion());
+		}
+		else {
+			imu::Vector<3> gv(s.g[0], s.g[1], s.g[2]), av(s.a[0], s.a[1], s.a[2]), mv(s.m[0], s.m[1], s.m[2]);
+			if(mode == 1) {
+				gv = imu::Vector<3>(g[0] * gyroLsb, g[1] * gyroLsb, g[2] * gyroLsb);
+				av = imu::Vector<3>(a[0] * accLsb, a[1] * accLsb, a[2] * accLsb);
+				mv = imu::Vector<3>(m[0] * magLsb, m[1] * magLsb, m[2] * magLsb);
+			}
+			t0 = nanoseconds();
+			uimu_ahrs_update(gv, av, mv, s.dt);
+			trace.push_back(uimu_ahrs_get_imu_quaternion());
+		}
+		ns.push_back(nanoseconds() - t0);
+	}
+}
+
+static double percentile(vector<double> v, double p) {
+	sort(v.begin(), v.end());
+	return v[(size_t)(p * (v.size() - 1))];
+}
+
+// RMS and worst angle between two traces after the warm-up. against NULL scores the reference
+static void traceError(const vector<ahrsSample>& samples, const vector<imu::Quaternion>& trace,
+		const vector<imu::Quaternion>* against, double& rms, double& worst) {
+	double t = 0, sumSq = 0;
+	int scored = 0;
+	worst = 0;
+	for(size_t i = 0; i < samples.size(); i++) {
+		const ahrsSample& s = samples[i];
+		t += s.dt;
+		if(t < WARMUP_SECONDS || (against == NULL && !s.hasRef)) continue;
+		double err = angleBetween(against ? (*against)[i] : imu::Quaternion(s.ref[0], s.ref[1], s.ref[2], s.ref[3]),
+				trace[i]);
+		sumSq += err * err;
+		if(err > worst) worst = err;
+		scored++;
+	}
+	rms = scored ? sqrt(sumSq / scored) : 0;
+}
+
+static void compareFixedPoint(const char* title, const vector<ahrsSample>& samples) {
+	static const char* names[] = { "float", "float Q15", "fixed" };
+	bool hasRef = samples[0].hasRef;
+	printf("Fixed point Mahony, %s (Q15 of %g dps, %g g, %g gauss)\n", title,
+			FIXED_AHRS_GYRO_FULL_SCALE, FIXED_AHRS_ACC_FULL_SCALE, FIXED_AHRS_MAG_FULL_SCALE);
+#ifdef AHRS_FIXED_POINT
+	printf("  Built with AHRS_FIXED_POINT: the float rows run the fixed filter too\n");
+#endif
+	uimu_ahrs_set_mahony_gains(MAHONY_KP, MAHONY_KI);
+
+	vector<imu::Quaternion> traces[3];
+	for(int mode = 0; mode < 3; mode++) {
+		vector<double> ns;
+		runMahony(mode, samples, ns, traces[mode]);
+		double mean = 0;
+		for(size_t i = 0; i < ns.size(); i++)
+			mean += ns[i] / ns.size();
+		double rms = 0, worst = 0;
+		if(hasRef)
+			traceError(samples, traces[mode], NULL, rms, worst);
+		printf("  %-10s %7.1f ns mean %7.1f p50 %7.1f p99 %8.1f max", names[mode], mean,
+				percentile(ns, 0.5), percentile(ns, 0.99), percentile(ns, 1.0));
+		if(hasRef)
+			printf("   rms %6.3f deg   max %6.3f deg", rms, worst);
+		printf("\n");
+	}
+
+	// Fixed against float on the same Q15 inputs is the arithmetic alone, float Q15 against
+	// float the input quantisation alone
+	double rms, worst;
+	traceError(samples, traces[2], &traces[1], rms, worst);
+	printf("  fixed against float Q15: rms %8.5f deg   max %8.5f deg\n", rms, worst);
+	traceError(samples, traces[1], &traces[0], rms, worst);
+	printf("  float Q15 against float: rms %8.5f deg   max %8.5f deg\n", rms, worst);
+}
+
+volatile double sink;	// Keeps read results alive so they aren't optimised away
+
+// Uses every angle and element, the way the readers do, so no part of a conversion is dead
+static double consume(const imu::Vector<3>& euler, const imu::Matrix<3>& m) {
+	double sum = euler.x() + euler.y() + euler.z();
+	for(int i = 0; i < 3; i++)
+		for(int j = 0; j < 3; j++)
+			sum += m(i, j);
+	return sum;
+}
+
+// Each cycle several readers want euler angles and the rotation matrix. Compares
+// converting from the quaternion for every reader with the cached snapshot. A read is
+// far shorter than the clock, so each mode times the whole sample loop, best of
+// READ_PASSES, and the reads are what it adds over updating alone.
+static void compareReads(const vector<ahrsSample>& samples) {
+	static const char* names[] = { "update", "recompute", "snapshot" };
+	printf("Attitude reads, %d readers of euler + matrix per update\n", READERS_PER_CYCLE);
+	imu::Quaternion offset;
+
+	double best[3];
+	for(int mode = 0; mode < 3; mode++) {
+		best[mode] = 0;
+		for(int pass = 0; pass < READ_PASSES; pass++) {
+			uimu_ahrs_reset(startingAttitude(samples));
+			double start = nanoseconds();
+			for(size_t i = 0; i < samples.size(); i++) {
+				const ahrsSample& s = samples[i];
+				uimu_ahrs_update(imu::Vector<3>(s.g[0], s.g[1], s.g[2]),
+						imu::Vector<3>(s.a[0], s.a[1], s.a[2]),
+						imu::Vector<3>(s.m[0], s.m[1], s.m[2]), s.dt);
+
+				for(int r = 0; mode > 0 && r < READERS_PER_CYCLE; r++) {
+					if(mode == 1) {
+						imu::Quaternion body = imu::Quaternion(uimu_ahrs_get_imu_quaternion()) * offset.conjugate();
+						imu::Vector<3> euler = body.toEuler();
+						euler.toDegrees();
+						sink = consume(euler, body.toMatrix());
+					}
+					else {
+						sink = consume(uimu_ahrs_get_euler(), uimu_ahrs_get_matrix());
+					}
+				}
+			}
+			double spent = (nanoseconds() - start) / samples.size();
+			if(pass == 0 || spent < best[mode]) best[mode] = spent;
+		}
+		printf("  %-10s %8.1f ns per update", names[mode], best[mode]);
+		if(mode > 0)
+			printf(", %8.1f ns of reads", best[mode] - best[0]);
+		printf("\n");
+	}
+
+	double recompute = best[1] - best[0], snapshot = best[2] - best[0];
+	if(snapshot < recompute)
+		printf("  snapshot saves %.1f ns per update, %.0f%% of the reads\n", recompute - snapshot,
+				recompute > 0 ? 100 * (recompute - snapshot) / recompute : 0);
+	else
+		printf("  snapshot costs %.1f ns per update more than recomputing\n", snapshot - recompute);
+}
+
+int main(int argc, char* argv[]) {
+	uimu_ahrs_set_beta(0.1);
+	uimu_ahrs_set_mahony_gains(0.5, 0.05);
+
+	vector<ahrsSample> synthetic;
+	generateSynthetic(synthetic, SYNTH_RATE_HZ);
+	compare("Synthetic trajectory", synthetic);
+
+	vector<ahrsSample> fifo;
+	generateSynthetic(fifo, FIFO_RATE_HZ);
+	uimu_ahrs_set_filter(AHRS_FILTER_MADGWICK);
+	compareBatch(fifo);
+	uimu_ahrs_set_filter(AHRS_FILTER_MAHONY);
+	compareBatch(fifo);
+
+	uimu_ahrs_set_filter(AHRS_FILTER_MADGWICK);
+	compareFreshness(fifo);
+	uimu_ahrs_set_filter(AHRS_FILTER_MAHONY);
+	compareFreshness(fifo);
+
+	compareReads(synthetic);
+
+	compareFixedPoint("synthetic trajectory", synthetic);
+	compareFixedPoint("800 Hz synthetic trajectory", fifo);
+
+	if(argc > 1) {
+		vector<ahrsSample> recorded;
+		if(loadRecording(argv[1], recorded) || recorded.empty()) {
+			cout << "No usable samples in " << argv[1] << endl;
+			return 1;
+		}
+		compare(argv[1], recorded);
+		compareFixedPoint(argv[1], recorded);
+	}
+
+	return 0;
+}
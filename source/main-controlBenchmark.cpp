@@ -0,0 +1,244 @@
+//============================================================================
+// Name        : main-controlBenchmark.cpp
+// Author      : John Boyd
+// Version     :
+// Copyright   : This work is free for you to copy.
+// Description : Benchmark of the cascaded attitude controller. Times a rate
+//				 loop update per gyro sample, a whole 32 sample FIFO batch and
+//				 the quaternion attitude loop (next to the Euler conversion it
+//				 replaced), checks the worst cycle against a budget, and
+//				 counts heap allocations while they run (there must be none).
+//				 Checks the attitude error stays finite and points the right
+//				 way through +/-90 degrees of pitch, where Euler angles
+//				 break down. Then flies a step to 30 degrees of bank, and a step
+//				 with too little aileron authority to reach the commanded
+//				 roll rate, through a simple roll model at gyro rate, to
+//				 check settling and that anti-windup keeps the overshoot down.
+//				 Usage: main-controlBenchmark [-b budgetMicroseconds]
+//				 Exits non-zero if the p99 cycle misses the budget or the
+//				 controller allocated.
+//============================================================================
+
+#include "BBB-FlightComputer/BBB-FlightComputer.h"
+#include "BBB-FlightComputer/realtime/latency.h"
+#include <new>
+
+#define GYRO_RATE_HZ		760		// L3GD20 data rate
+#define LOOP_RATE_HZ		50		// Flight loop, the attitude loop rate
+#define BATCHES				200000
+#define DEFAULT_BUDGET_US	20		// Control's share of a cycle
+#define ROLL_AUTHORITY		3.0f	// Model: steady roll rate per percent of aileron, deg/s
+#define ROLL_LAG			0.15f	// Model: roll rate time constant, s
+#define STEP_SECONDS		6
+
+using namespace std;
+
+// Dynamic exception specifications are gone from C++17
+#if __cplusplus < 201103L
+#define THROWS_BAD_ALLOC	throw(std::bad_alloc)
+#define THROWS_NOTHING		throw()
+#else
+#define THROWS_BAD_ALLOC
+#define THROWS_NOTHING		noexcept
+#endif
+
+static volatile unsigned long allocations = 0;
+
+void* operator new(size_t size) THROWS_BAD_ALLOC {
+	__sync_fetch_and_add(&allocations, 1);
+	void* p = malloc(size ? size : 1);
+	if(p == NULL) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size) THROWS_BAD_ALLOC {
+	return operator new(size);
+}
+
+void operator delete(void* p) THROWS_NOTHING { free(p); }
+void operator delete[](void* p) THROWS_NOTHING { free(p); }
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+#endif
+
+struct stepResult {
+	float riseSeconds;		// To 90% of the step
+	float overshootDegrees;
+	float settleSeconds;	// Last time outside +/-2 degrees of the setpoint
+	float peakIntegral;		// Largest roll rate integral, percent
+};
+
+// Flies the roll axis of the controller through a first order roll rate model with
+// the FIFO delivering LOOP_RATE_HZ batches of GYRO_RATE_HZ samples
+static stepResult flyStep(float target, float authority) {
+	AttitudeController controller;
+	controller.setAttitude(target, 0);
+	stepResult r = { -1, 0, 0, 0 };
+	float roll = 0, rate = 0;
+	float dt = 1.0f / GYRO_RATE_HZ;
+	unsigned long micros = 1000000;
+	int perBatch = GYRO_RATE_HZ / LOOP_RATE_HZ;
+	for(int cycle = 0; cycle < STEP_SECONDS * LOOP_RATE_HZ; cycle++) {
+		float half = roll * (float)M_PI / 360.0f;
+		controller.updateAttitude(imu::Quaternion(cosf(half), sinf(half), 0, 0), micros);
+		for(int i = 0; i < perBatch; i++) {	// The samples that arrived during the last cycle
+			float aileron = controller.getRoll();
+			rate += (authority * aileron - rate) / ROLL_LAG * dt;
+			roll += rate * dt;
+			micros += 1000000 / GYRO_RATE_HZ;
+			controller.updateRates(rate, 0, 0, micros);
+
+			float t = (cycle * perBatch + i) * dt;
+			if(r.riseSeconds < 0 && roll >= 0.9f * target) r.riseSeconds = t;
+			if(roll - target > r.overshootDegrees) r.overshootDegrees = roll - target;
+			if(fabsf(roll - target) > 2) r.settleSeconds = t;
+			float integral = fabsf(controller.getRateLoop(CONTROL_ROLL).getIntegral());
+			if(integral > r.peakIntegral) r.peakIntegral = integral;
+		}
+	}
+	return r;
+}
+
+// Pitch then roll, as the AHRS euler angles are, in degrees
+static imu::Quaternion attitudeOf(float roll, float pitch, float heading) {
+	imu::Quaternion h(cos(heading * M_PI / 360), 0, 0, sin(heading * M_PI / 360));
+	imu::Quaternion p(cos(pitch * M_PI / 360), 0, sin(pitch * M_PI / 360), 0);
+	imu::Quaternion r(cos(roll * M_PI / 360), sin(roll * M_PI / 360), 0, 0);
+	return h * p * r;
+}
+
+// Through +/-90 degrees of pitch the error must stay finite and command the pitch back
+// down, whatever the roll and heading
+static int checkVerticalPitch() {
+	AttitudeController controller;
+	int failed = 0;
+	for(int pitch = 80; pitch <= 100; pitch += 2) {
+		for(int sign = -1; sign <= 1; sign += 2) {
+			for(int heading = 0; heading < 360; heading += 45) {
+				controller.updateAttitude(attitudeOf(heading == 0 ? 0 : 10, sign * pitch, heading), 0);
+				float e = controller.getAttitudeError(CONTROL_PITCH);
+				if(e != e || fabsf(e) > 180 || e * sign > -60) {	// NaN, or not pitching back towards level
+					printf("FAIL: pitch %d heading %d gives a pitch error of %.1f°\n", sign * pitch, heading, e);
+					failed = 1;
+				}
+			}
+		}
+	}
+	return failed;
+}
+
+static void fillBatch(gyroFIFOBatch& batch, unsigned long& micros, int n, unsigned int* seed) {
+	batch.count = n;
+	for(int i = 0; i < n; i++) {
+		micros += 1000000 / GYRO_RATE_HZ;
+		batch.x[i] = (rand_r(seed) % 2001 - 1000) * 0.05f;
+		batch.y[i] = (rand_r(seed) % 2001 - 1000) * 0.05f;
+		batch.z[i] = (rand_r(seed) % 2001 - 1000) * 0.05f;
+		batch.timestamp[i] = micros;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	double budgetUs = DEFAULT_BUDGET_US;
+	int c;
+	while((c = getopt(argc, argv, "b:")) != -1) {
+		switch(c) {
+		case 'b': budgetUs = atof(optarg); break;
+		default: return 1;
+		}
+	}
+
+	// Worst case batches: a full FIFO every cycle, noisy rates so nothing settles
+	static gyroFIFOBatch batches[64];
+	unsigned long micros = 1000000;
+	unsigned int seed = 1;
+	for(int i = 0; i < 64; i++)
+		fillBatch(batches[i], micros, GYRO_FIFO_SLOTS, &seed);
+
+	static imu::Quaternion attitudes[64];
+	for(int i = 0; i < 64; i++)
+		attitudes[i] = attitudeOf(batches[i].x[0], batches[i].y[0] * 1.5f, batches[i].z[0] * 3);
+
+	AttitudeController controller;
+	LatencyHistogram sample, batch, attitude, cycle, attitudeBlock, euler;
+	sample.init("rate loop sample");
+	batch.init("rate loop batch");
+	attitude.init("attitude loop");
+	cycle.init("control per cycle");
+	attitudeBlock.init("attitude update");
+	euler.init("euler conversion");
+
+	unsigned long allocationsBefore = allocations;
+	unsigned long t = 1000000;
+	for(int b = 0; b < BATCHES; b++) {
+		gyroFIFOBatch& fifo = batches[b & 63];
+		for(int i = 0; i < fifo.count; i++) fifo.timestamp[i] = t + i * (1000000 / GYRO_RATE_HZ);
+		t += GYRO_FIFO_SLOTS * (1000000 / GYRO_RATE_HZ);
+
+		uint64_t start = latency_now();
+		controller.updateAttitude(attitudes[b & 63], t);
+		uint64_t outer = latency_now();
+		controller.updateRates(fifo);
+		uint64_t end = latency_now();
+		attitude.record(outer - start);
+		batch.record(end - outer);
+		cycle.record(end - start);
+	}
+
+	// One sample at a time, timed in blocks so the clock doesn't dominate
+	for(int b = 0; b < BATCHES / 10; b++) {
+		gyroFIFOBatch& fifo = batches[b & 63];
+		uint64_t start = latency_now();
+		for(int i = 0; i < fifo.count; i++)
+			controller.updateRates(fifo.x[i], fifo.y[i], fifo.z[i], t += 1000000 / GYRO_RATE_HZ);
+		sample.record((latency_now() - start) / fifo.count);
+	}
+
+	// Per update, in blocks so the clock doesn't dominate: the quaternion attitude loop
+	// against what the Euler angle loop paid for its angles before it could start
+	volatile double sink = 0;
+	for(int b = 0; b < BATCHES / 10; b++) {
+		uint64_t start = latency_now();
+		for(int i = 0; i < 64; i++)
+			controller.updateAttitude(attitudes[i], t += 1000000 / LOOP_RATE_HZ);
+		uint64_t middle = latency_now();
+		for(int i = 0; i < 64; i++) {
+			imu::Vector<3> angles = attitudes[i].toEuler();
+			sink = sink + angles.z();
+		}
+		attitudeBlock.record((middle - start) / 64);
+		euler.record((latency_now() - middle) / 64);
+	}
+	unsigned long allocated = allocations - allocationsBefore;
+
+	LatencyHistogram* all[] = { &sample, &batch, &attitude, &cycle, &attitudeBlock, &euler };
+	printf("%-22s %10s %10s %10s\n", "", "p50 ns", "p99 ns", "max ns");
+	for(int i = 0; i < 6; i++)
+		printf("%-22s %10llu %10llu %10u\n", all[i]->getName(), (unsigned long long)all[i]->percentile(0.5),
+				(unsigned long long)all[i]->percentile(0.99), all[i]->getMax());
+	double p99Us = cycle.percentile(0.99) / 1e3;
+	printf("%lu rate updates, %lu attitude updates, %lu heap allocations\n", controller.getRateUpdates(),
+			controller.getAngleUpdates(), allocated);
+	printf("p99 cycle %.2f us of a %.0f us budget (%.3f%% of a %d Hz cycle)\n", p99Us, budgetUs,
+			p99Us * LOOP_RATE_HZ / 1e4, LOOP_RATE_HZ);
+
+	stepResult normal = flyStep(30, ROLL_AUTHORITY);
+	stepResult saturated = flyStep(60, ROLL_AUTHORITY / 4);	// The rate setpoint is out of reach, the integral winds up
+	printf("\n%-26s %8s %10s %8s %10s\n", "roll step", "rise s", "overshoot", "settle s", "peak I %");
+	printf("%-26s %8.2f %9.1f° %8.2f %10.1f\n", "30°, full authority", normal.riseSeconds,
+			normal.overshootDegrees, normal.settleSeconds, normal.peakIntegral);
+	printf("%-26s %8.2f %9.1f° %8.2f %10.1f\n", "60°, quarter authority", saturated.riseSeconds,
+			saturated.overshootDegrees, saturated.settleSeconds, saturated.peakIntegral);
+
+	int failed = checkVerticalPitch();
+	if(allocated) {
+		printf("FAIL: the controller allocated\n");
+		failed = 1;
+	}
+	if(p99Us > budgetUs) {
+		printf("FAIL: p99 cycle over budget\n");
+		failed = 1;
+	}
+	return failed;
+}
@@ -0,0 +1,156 @@
+//============================================================================
+// Name        : main-fastmathBenchmark.cpp
+// Author      : John Boyd
+// Version     :
+// Copyright   : This work is free for you to copy.
+// Description : Sweeps every fastmath approximation over its input range and
+//				 reports the worst error against double precision libm, then
+//				 the cost per call of the approximation and of the float libm
+//				 call it replaces. Exits non-zero if any error exceeds the
+//				 bound documented in fastmath.h, so run it after changing a
+//				 coefficient or building for a new target.
+//============================================================================
+
+#include "BBB-FlightComputer/BBB-FlightComputer.h"
+
+#define SWEEP_POINTS	2000001		// Samples per input range
+#define TIMING_CALLS	4000000
+#define TIMING_INPUTS	1024		// Inputs cycled through by the timing loops
+
+using namespace std;
+
+static double nanoseconds() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+volatile float sink;	// Keeps results alive so the work isn't optimised away
+
+static int failures = 0;
+
+static void report(const char* name, double worst, double at, double bound, const char* unit) {
+	bool ok = worst <= bound;
+	printf("%-10s max error %10.3e %-8s at %12.6g  (bound %.1e) %s\n",
+			name, worst, unit, at, bound, ok ? "ok" : "EXCEEDED");
+	if(!ok)
+		failures++;
+}
+
+static void checkAtan() {
+	double worst = 0, at = 0;
+	for(int i = 0; i < SWEEP_POINTS; i++) {	// Dense near zero, out to +-1e4
+		double t = -1.0 + 2.0 * i / (SWEEP_POINTS - 1);
+		float x = (float)(t * t * t * 1e4);
+		double err = fabs(fastmath::atan(x) - atan((double)x));
+		if(err > worst) { worst = err; at = x; }
+	}
+	report("atan", worst, at, FASTMATH_ATAN_MAX_ERROR, "rad");
+}
+
+static void checkAtan2() {
+	double worst = 0, at = 0;
+	for(int i = 0; i < SWEEP_POINTS; i++) {	// Once around the unit circle, scaled
+		double a = -M_PI + 2.0 * M_PI * i / (SWEEP_POINTS - 1);
+		double r = 1e-3 + (i % 7) * 10.0;
+		float y = (float)(r * sin(a)), x = (float)(r * cos(a));
+		double err = fabs(fastmath::atan2(y, x) - atan2((double)y, (double)x));
+		if(err > M_PI) err = 2 * M_PI - err;	// +-pi are the same angle
+		if(err > worst) { worst = err; at = a; }
+	}
+	report("atan2", worst, at, FASTMATH_ATAN_MAX_ERROR, "rad");
+}
+
+static void checkAsin() {
+	double worst = 0, at = 0;
+	for(int i = 0; i < SWEEP_POINTS; i++) {
+		float x = (float)(-1.0 + 2.0 * i / (SWEEP_POINTS - 1));
+		double err = fabs(fastmath::asin(x) - asin((double)x));
+		if(err > worst) { worst = err; at = x; }
+	}
+	report("asin", worst, at, FASTMATH_ASIN_MAX_ERROR, "rad");
+}
+
+static void checkRsqrt() {
+	double worst = 0, at = 0;
+	for(int i = 0; i < SWEEP_POINTS; i++) {	// Logarithmic from 1e-6 to 1e6
+		float x = (float)pow(10.0, -6.0 + 12.0 * i / (SWEEP_POINTS - 1));
+		double exact = 1.0 / sqrt((double)x);
+		double err = fabs(fastmath::rsqrt(x) - exact) / exact;
+		if(err > worst) { worst = err; at = x; }
+	}
+	report("rsqrt", worst, at, FASTMATH_RSQRT_MAX_ERROR, "relative");
+}
+
+static void checkTilt() {	// LMS303::calculatePitchAndRoll, in degrees
+	double worst = 0, at = 0;
+	for(int i = 0; i < SWEEP_POINTS; i++) {
+		double a = -M_PI / 2 + M_PI * i / (SWEEP_POINTS - 1);
+		float x = (float)sin(a), yz = (float)cos(a);
+		float fast = 180.0f / (float)M_PI * fastmath::atan(x * fastmath::rsqrt(yz * yz));
+		double err = fabs(fast - 180.0 * atan((double)x / fabs((double)yz)) / M_PI);
+		if(err > worst) { worst = err; at = a * 180.0 / M_PI; }
+	}
+	// atan'(x)*x <= 1/2, so the rsqrt error adds at most half its relative error
+	report("tilt", worst, at, (FASTMATH_ATAN_MAX_ERROR + FASTMATH_RSQRT_MAX_ERROR / 2) * 180.0 / M_PI, "deg");
+}
+
+static void checkBaro() {
+	double worst = 0, at = 0;
+	for(int i = 0; i < SWEEP_POINTS; i++) {
+		float p = FASTMATH_BARO_MIN_MBAR + (FASTMATH_BARO_MAX_MBAR - FASTMATH_BARO_MIN_MBAR) * (double)i / (SWEEP_POINTS - 1);
+		double exact = (1 - pow(p / 1013.25, 0.190263)) * 44330.8;
+		double err = fabs(fastmath::baroAltitude(p) - exact);
+		if(err > worst) { worst = err; at = p; }
+	}
+	report("baro", worst, at, FASTMATH_BARO_MAX_ERROR, "m");
+}
+
+static float inputs[TIMING_INPUTS];
+
+#define TIME_CALL(label, expr)															\
+	do {																				\
+		double start = nanoseconds();													\
+		for(int n = 0; n < TIMING_CALLS; n++) {											\
+			float x = inputs[n & (TIMING_INPUTS - 1)];									\
+			sink = (expr);																\
+		}																				\
+		printf("  %-24s %6.2f ns\n", label, (nanoseconds() - start) / TIMING_CALLS);	\
+	} while(0)
+
+static void timeCalls() {
+	unsigned int seed = 1;
+	for(int i = 0; i < TIMING_INPUTS; i++)
+		inputs[i] = rand_r(&seed) / (float)RAND_MAX * 2.0f - 1.0f;
+
+	printf("\nCost per call\n");
+	TIME_CALL("fastmath::atan", fastmath::atan(x * 3.0f));
+	TIME_CALL("atanf", atanf(x * 3.0f));
+	TIME_CALL("fastmath::atan2", fastmath::atan2(x, 0.5f - x));
+	TIME_CALL("atan2f", atan2f(x, 0.5f - x));
+	TIME_CALL("fastmath::asin", fastmath::asin(x));
+	TIME_CALL("asinf", asinf(x));
+	TIME_CALL("fastmath::rsqrt", fastmath::rsqrt(x + 1.5f));
+	TIME_CALL("1/sqrtf", 1.0f / sqrtf(x + 1.5f));
+	TIME_CALL("fastmath::baroAltitude", fastmath::baroAltitude(760.0f + 400.0f * x));
+	TIME_CALL("powf altitude", (1 - powf((760.0f + 400.0f * x) / 1013.25f, 0.190263f)) * 44330.8f);
+}
+
+int main() {
+#ifdef FASTMATH_PRECISE
+	printf("Built with FASTMATH_PRECISE, fastmath is libm\n");
+#endif
+	checkAtan();
+	checkAtan2();
+	checkAsin();
+	checkRsqrt();
+	checkTilt();
+	checkBaro();
+	timeCalls();
+
+	if(failures) {
+		printf("\n%d approximation(s) outside their documented bound\n", failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,148 @@
+//============================================================================
+// Name        : main-flightLog.cpp
+// Author      : John Boyd
+// Version     :
+// Copyright   : This work is free for you to copy.
+// Description : Inspects and exports flight data recorder logs (BBB-FlightComputer
+//				 -l, main-replay -l). Without -c prints a summary of the log and
+//				 how long it took to open; with -c streams the chosen channels
+//				 as CSV to -o (or stdout).
+//				 Usage: main-flightLog [-s startSeconds] [-e endSeconds]
+//				        [-c channels] [-f flags] [-o out.csv] [-g] [-n] flight.log
+//				 channels: time,accel,mag,gyro,attitude,euler,baro,demand,pwm,all
+//				 flags: accel,mag,gyro,overrun,lostsync - only rows with all of them,
+//				 e.g. -f mag exports only the cycles with a new mag sample.
+//				 -g scans the whole log for dropped records, overruns and
+//				 sensor reads that lost sync.
+//				 -n ignores (and doesn't write) the sidecar index.
+//============================================================================
+
+#include "BBB-FlightComputer/logging/flightLogReader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <iostream>
+#include <string>
+
+#define EXPORT_BUFFER	(1024*1024)
+
+using namespace std;
+
+static double nanoseconds() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int parseFlags(const char* list, uint8_t& flags) {
+	flags = 0;
+	string text = list;
+	size_t pos = 0;
+	while(pos <= text.size()) {
+		size_t comma = text.find(',', pos);
+		if(comma == string::npos) comma = text.size();
+		string name = text.substr(pos, comma - pos);
+		if(name == "accel") flags |= FLIGHT_RECORD_ACCEL_NEW;
+		else if(name == "mag") flags |= FLIGHT_RECORD_MAG_NEW;
+		else if(name == "gyro") flags |= FLIGHT_RECORD_GYRO_NEW;
+		else if(name == "overrun") flags |= FLIGHT_RECORD_OVERRUN;
+		else if(name == "lostsync") flags |= FLIGHT_RECORD_LOST_SYNC;
+		else return 1;
+		pos = comma + 1;
+	}
+	return 0;
+}
+
+static void scanGaps(FlightLog& log) {
+	unsigned long dropped = 0, overruns = 0, lostSync = 0;
+	uint64_t longestGap = 0;
+	log.adviseSequential(0, log.size());
+	for(size_t i = 1; i < log.size(); i++) {
+		dropped += (uint16_t)(log[i].cycle - log[i-1].cycle - 1);
+		if(log[i].flags & FLIGHT_RECORD_OVERRUN) overruns++;
+		if(log[i].flags & FLIGHT_RECORD_LOST_SYNC) lostSync++;
+		uint64_t gap = log.timeOf(i) - log.timeOf(i-1);
+		if(gap > longestGap) longestGap = gap;
+	}
+	printf("  %lu dropped records, %lu overruns, %lu cycles lost sync, longest gap %.1f ms\n", dropped, overruns,
+			lostSync, longestGap / 1e3);
+}
+
+int main(int argc, char* argv[]) {
+	double startSeconds = 0, endSeconds = -1;
+	unsigned channels = 0;
+	uint8_t flags = 0;
+	const char* outputPath = NULL;
+	bool gaps = false, sidecar = true;
+
+	int c;
+	while((c = getopt(argc, argv, "s:e:c:f:o:gn")) != -1) {
+		switch(c) {
+		case 's': startSeconds = atof(optarg); break;
+		case 'e': endSeconds = atof(optarg); break;
+		case 'c':
+			if(flight_log_parse_channels(optarg, channels))
+				return 1;
+			break;
+		case 'f':
+			if(parseFlags(optarg, flags)) {
+				printf("Bad flags %s, expected accel,mag,gyro,overrun,lostsync\n", optarg);
+				return 1;
+			}
+			break;
+		case 'o': outputPath = optarg; break;
+		case 'g': gaps = true; break;
+		case 'n': sidecar = false; break;
+		default: return 1;
+		}
+	}
+	if(optind != argc - 1) {
+		printf("Usage: %s [-s startSeconds] [-e endSeconds] [-c channels] [-f flags] [-o out.csv] [-g] [-n] flight.log\n", argv[0]);
+		return 1;
+	}
+
+	FlightLog log;
+	double start = nanoseconds();
+	if(log.open(argv[optind], sidecar))
+		return 1;
+	double opened = nanoseconds();
+
+	size_t from = startSeconds > 0 ? log.seek((uint64_t)(startSeconds * 1e6)) : 0;
+	size_t to = endSeconds >= 0 ? log.seek((uint64_t)(endSeconds * 1e6)) : log.size();
+	if(from == FLIGHT_LOG_END) from = log.size();
+	if(to == FLIGHT_LOG_END) to = log.size();
+	double sought = nanoseconds();
+
+	if(channels == 0) {
+		const flightLogHeader& h = log.getHeader();
+		time_t wall = (time_t)(h.startUnixMicros / 1000000);
+		char started[64];
+		strftime(started, sizeof(started), "%Y-%m-%d %H:%M:%S", localtime(&wall));
+		printf("%s: %lu records, %.1f s of flight from %s", argv[optind], (unsigned long)log.size(),
+				log.getDuration(), started);
+		if(h.rateHz > 0) printf(" at %g Hz", h.rateHz);
+		printf("\n  opened in %.3f ms (index %s), seeks took %.1f us\n", (opened - start) / 1e6,
+				log.isIndexLoaded() ? "loaded" : "built", (sought - opened) / 1e3);
+		if(startSeconds > 0 || endSeconds >= 0)
+			printf("  records %lu to %lu are in the time range\n", (unsigned long)from, (unsigned long)to);
+		if(gaps) scanGaps(log);
+		return 0;
+	}
+
+	FILE* out = stdout;
+	if(outputPath) {
+		out = fopen(outputPath, "w");
+		if(out == NULL) {
+			printf("Failed to create %s\n", outputPath);
+			return 1;
+		}
+	}
+	setvbuf(out, NULL, _IOFBF, EXPORT_BUFFER);
+	unsigned long rows = flight_log_export_csv(log, from, to, channels, flags, out);
+	if(outputPath) {
+		fclose(out);
+		printf("%lu rows written to %s in %.2f s\n", rows, outputPath, (nanoseconds() - sought) / 1e9);
+	}
+	return 0;
+}
@@ -0,0 +1,211 @@
+//============================================================================
+// Name        : main-flightStats.cpp
+// Author      : John Boyd
+// Version     :
+// Copyright   : This work is free for you to copy.
+// Description : Fleet analysis of flight data recorder logs. Summarises every
+//				 log given, or every *.log in the directories given, on one
+//				 worker thread per core: sensor channel min/max/RMS and
+//				 vibration, frame time percentiles (ms), dropped records, overruns
+//				 and sensor reads that lost sync. Prints one table row per
+//				 flight, a fleet total and the fleet frame time histogram.
+//				 Usage: main-flightStats [-j threads] [-o stats.csv] [-q]
+//				        logDirectory|flight.log...
+//				 -o also writes every flight and the fleet total, with all
+//				 channels, as CSV. -q skips the per-flight rows on stdout.
+//============================================================================
+
+#include "BBB-FlightComputer/logging/flightStats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define MAX_THREADS		256
+#define HISTOGRAM_BAR	50
+
+using namespace std;
+
+struct batch {
+	vector<string> paths;
+	vector<FlightStats*> results;	// One allocation per flight, so workers never share a cache line
+	volatile unsigned long next;	// Next path to claim
+};
+
+static double nanoseconds() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static bool endsWith(const string& text, const char* suffix) {
+	size_t n = strlen(suffix);
+	return text.size() >= n && text.compare(text.size() - n, n, suffix) == 0;
+}
+
+static int addPaths(const char* path, vector<string>& paths) {
+	struct stat st;
+	if(stat(path, &st) != 0) {
+		printf("Failed to find %s\n", path);
+		return 1;
+	}
+	if(!S_ISDIR(st.st_mode)) {
+		paths.push_back(path);
+		return 0;
+	}
+	DIR* dir = opendir(path);
+	if(dir == NULL) {
+		printf("Failed to read directory %s\n", path);
+		return 1;
+	}
+	vector<string> found;
+	dirent* entry;
+	while((entry = readdir(dir)) != NULL) {
+		string name = entry->d_name;
+		if(endsWith(name, ".log"))
+			found.push_back(string(path) + "/" + name);
+	}
+	closedir(dir);
+	sort(found.begin(), found.end());
+	paths.insert(paths.end(), found.begin(), found.end());
+	return 0;
+}
+
+static void* worker(void* context) {
+	batch* b = (batch*)context;
+	for(;;) {
+		unsigned long i = __sync_fetch_and_add(&b->next, 1);
+		if(i >= b->paths.size())
+			break;
+		b->results[i]->compute(b->paths[i].c_str());
+	}
+	return NULL;
+}
+
+static void printRow(FlightStats& s) {
+	double vibration = 0, rate = 0;	// Vector sums of the three axes
+	for(int axis = 0; axis < 3; axis++) {
+		vibration += pow(s.channels[FLIGHT_STATS_ACCEL_X + axis].deviation(), 2);
+		rate += pow(s.channels[FLIGHT_STATS_GYRO_X + axis].rms(), 2);
+	}
+	vibration = sqrt(vibration);
+	rate = sqrt(rate);
+	string name = s.name;
+	if(name.size() > 28) name = "..." + name.substr(name.size() - 25);
+	printf("%-28s %8.1f %9lu %7lu %7lu %6lu %7.2f %7.2f %7.2f %7.3f %7.1f\n", name.c_str(), s.duration,
+			s.records, s.dropped, s.overruns, s.lostSyncCycles, s.frameTime.percentile(0.5) / 1e6,
+			s.frameTime.percentile(0.99) / 1e6, s.frameTime.getMax() / 1e6, vibration, rate);
+}
+
+static void printHistogram(LatencyHistogram& h) {
+	uint32_t largest = 0;
+	for(int i = 0; i < LATENCY_BUCKETS; i++)
+		if(h.getBucket(i) > largest) largest = h.getBucket(i);
+	if(largest == 0)
+		return;
+	printf("\nFleet frame time       count\n");
+	for(int i = 0; i < LATENCY_BUCKETS; i++) {
+		uint32_t n = h.getBucket(i);
+		if(n == 0) continue;
+		char bar[HISTOGRAM_BAR + 1];
+		int length = (int)((uint64_t)n * HISTOGRAM_BAR / largest);
+		if(length == 0) length = 1;
+		memset(bar, '#', length);
+		bar[length] = 0;
+		printf("%8.3f - %8.3f ms %10u %s\n", LatencyHistogram::bucketLow(i) / 1e6,
+				LatencyHistogram::bucketHigh(i) / 1e6, n, bar);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	const char* csvPath = NULL;
+	bool quiet = false;
+
+	int c;
+	while((c = getopt(argc, argv, "j:o:q")) != -1) {
+		switch(c) {
+		case 'j': threads = atol(optarg); break;
+		case 'o': csvPath = optarg; break;
+		case 'q': quiet = true; break;
+		default: return 1;
+		}
+	}
+	if(optind >= argc || threads < 1) {
+		printf("Usage: %s [-j threads] [-o stats.csv] [-q] logDirectory|flight.log...\n", argv[0]);
+		return 1;
+	}
+	if(threads > MAX_THREADS) threads = MAX_THREADS;
+
+	batch b;
+	for(int i = optind; i < argc; i++)
+		if(addPaths(argv[i], b.paths))
+			return 1;
+	if(b.paths.empty()) {
+		printf("No flight logs found\n");
+		return 1;
+	}
+	for(size_t i = 0; i < b.paths.size(); i++)
+		b.results.push_back(new FlightStats(b.paths[i].c_str()));
+	b.next = 0;
+	if((size_t)threads > b.paths.size()) threads = b.paths.size();
+
+	double start = nanoseconds();
+	pthread_t workers[MAX_THREADS];
+	int started = 0;
+	for(int i = 0; i < threads; i++) {
+		if(pthread_create(&workers[i], NULL, worker, &b) != 0) {
+			printf("Failed to start worker %d, continuing with %d\n", i, started);
+			break;
+		}
+		started++;
+	}
+	if(started == 0)
+		worker(&b);
+	for(int i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+	double elapsed = (nanoseconds() - start) / 1e9;
+
+	// Merged in path order, so the output doesn't depend on which worker finished first
+	FlightStats fleet("fleet");
+	for(size_t i = 0; i < b.results.size(); i++)
+		fleet.merge(*b.results[i]);
+
+	printf("%-28s %8s %9s %7s %7s %6s %7s %7s %7s %7s %7s\n", "flight", "seconds", "records", "dropped",
+			"overrun", "nosync", "frm p50", "frm p99", "frm max", "vib g", "dps rms");
+	if(!quiet) {
+		for(size_t i = 0; i < b.results.size(); i++)
+			if(b.results[i]->flights) printRow(*b.results[i]);
+	}
+	printRow(fleet);
+	if(fleet.lostSyncCycles)
+		printf("Lost sync: %lu LMS303, %lu L3GD20, %lu LPS331 reads\n", fleet.lostSync[0], fleet.lostSync[1],
+				fleet.lostSync[2]);
+	printHistogram(fleet.frameTime);
+
+	if(csvPath) {
+		FILE* out = fopen(csvPath, "w");
+		if(out == NULL) {
+			printf("Failed to create %s\n", csvPath);
+			return 1;
+		}
+		FlightStats::csvHeader(out);
+		for(size_t i = 0; i < b.results.size(); i++)
+			b.results[i]->csvRow(out);
+		fleet.csvRow(out);
+		fclose(out);
+	}
+
+	printf("\n%d flights (%d unreadable), %.1f MiB in %.2f s on %d threads (%.0f MiB/s)\n", fleet.flights,
+			fleet.failed, fleet.bytes / 1048576.0, elapsed, started ? started : 1,
+			fleet.bytes / 1048576.0 / elapsed);
+	for(size_t i = 0; i < b.results.size(); i++)
+		delete b.results[i];
+	return fleet.failed ? 2 : 0;
+}
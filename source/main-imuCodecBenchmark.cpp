@@ -0,0 +1,163 @@
+//============================================================================
+// Name        : main-imuCodecBenchmark.cpp
+// Author      : John Boyd
+// Version     :
+// Copyright   : This work is free for you to copy.
+// Description : Measures the compressed IMU stream codec (logging/imuStream.h).
+//				 Collects every raw gyro and accel FIFO sample from I2C
+//				 recordings (BBB-FlightComputer -r) by replaying them through
+//				 the drivers, then encodes and decodes them frame by frame as
+//				 the flight loop would, checks the round trip is exact, and
+//				 prints the encode and decode cost per sample and the size
+//				 against the 6 bytes per sample the chip outputs. Also runs a
+//				 worst case of uniformly random samples.
+//				 Usage: main-imuCodecBenchmark [-r repeats] [-g gyroRateHz]
+//				        recording.i2c...
+//				 -g is the gyro rate the recordings were flown at
+//				 (BBB-FlightComputer -f, 100 by default).
+//============================================================================
+
+#include "BBB-FlightComputer/BBB-FlightComputer.h"
+#include "BBB-FlightComputer/replay/replay.h"
+#include "BBB-FlightComputer/logging/imuStream.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <vector>
+
+#define DEFAULT_REPEATS	20
+
+using namespace std;
+
+struct imuFrames {	// One sensor's FIFO reads, back to back
+	vector<int16_t> samples;	// x, y, z per sample
+	vector<int> counts;			// Samples per FIFO read
+};
+
+static double nanoseconds() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void addFrame(imuFrames& frames, const int16_t samples[][IMU_STREAM_AXES], int count) {
+	if(count <= 0) return;
+	frames.samples.insert(frames.samples.end(), &samples[0][0], &samples[0][0] + count * IMU_STREAM_AXES);
+	frames.counts.push_back(count);
+}
+
+static void collectTick(const replayTick& tick, void* context) {
+	imuFrames* frames = (imuFrames*)context;
+	int16_t samples[IMU_STREAM_MAX_SAMPLES][IMU_STREAM_AXES];
+	if(tick.gyroNew)
+		addFrame(frames[IMU_STREAM_GYRO], samples, tick.gyro->getRawFIFO(samples));
+	if(tick.accelNew)
+		addFrame(frames[IMU_STREAM_ACCEL], samples, tick.lms303->getRawFIFO(samples));
+}
+
+// Encodes then decodes every frame repeats times, keyframes as the writer places them
+static int measure(const char* name, const imuFrames& frames, int repeats) {
+	size_t sampleCount = frames.samples.size() / IMU_STREAM_AXES;
+	if(sampleCount == 0) {
+		printf("%-14s no samples\n", name);
+		return 0;
+	}
+	vector<uint8_t> encoded(frames.counts.size() * IMU_STREAM_MAX_PAYLOAD);
+	vector<int> sizes(frames.counts.size());
+	vector<int16_t> decoded(frames.samples.size());
+	const int16_t (*in)[IMU_STREAM_AXES] = (const int16_t (*)[IMU_STREAM_AXES])&frames.samples[0];
+	int16_t (*out)[IMU_STREAM_AXES] = (int16_t (*)[IMU_STREAM_AXES])&decoded[0];
+
+	double encodeNs = 1e30, decodeNs = 1e30;	// Best of the repeats, the least disturbed run
+	size_t bytes = 0;
+	for(int r = 0; r < repeats; r++) {
+		ImuSampleEncoder encoder;
+		double start = nanoseconds();
+		size_t sample = 0;
+		bytes = 0;
+		for(size_t f = 0; f < frames.counts.size(); f++) {
+			if(f % IMU_STREAM_KEY_INTERVAL == 0) encoder.reset();
+			sizes[f] = encoder.encode(in + sample, frames.counts[f], &encoded[bytes]);
+			bytes += sizes[f];
+			sample += frames.counts[f];
+		}
+		double encodedAt = nanoseconds();
+
+		ImuSampleDecoder decoder;
+		sample = 0;
+		size_t offset = 0;
+		for(size_t f = 0; f < frames.counts.size(); f++) {
+			if(f % IMU_STREAM_KEY_INTERVAL == 0) decoder.reset();
+			if(decoder.decode(&encoded[offset], sizes[f], frames.counts[f], out + sample) != sizes[f]) {
+				printf("%-14s frame %lu failed to decode\n", name, (unsigned long)f);
+				return 1;
+			}
+			offset += sizes[f];
+			sample += frames.counts[f];
+		}
+		double decodedAt = nanoseconds();
+		if(encodedAt - start < encodeNs) encodeNs = encodedAt - start;
+		if(decodedAt - encodedAt < decodeNs) decodeNs = decodedAt - encodedAt;
+	}
+
+	if(memcmp(&decoded[0], &frames.samples[0], frames.samples.size() * sizeof(int16_t)) != 0) {
+		printf("%-14s round trip is NOT exact\n", name);
+		return 1;
+	}
+	double framed = bytes + frames.counts.size() * sizeof(imuStreamFrame);
+	printf("%-14s %8lu samples %7lu frames  encode %5.1f ns/sample  decode %5.1f ns/sample\n",
+			name, (unsigned long)sampleCount, (unsigned long)frames.counts.size(),
+			encodeNs / sampleCount, decodeNs / sampleCount);
+	printf("%-14s payload %.2f B/sample (%.2fx), framed %.2f B/sample (%.2fx), exact\n", "",
+			(double)bytes / sampleCount, 6.0 * sampleCount / bytes,
+			framed / sampleCount, 6.0 * sampleCount / framed);
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	int repeats = DEFAULT_REPEATS;
+	replaySettings settings;
+	replay_default_settings(settings);
+	int c;
+	while((c = getopt(argc, argv, "r:g:")) != -1) {
+		switch(c) {
+		case 'r': repeats = atoi(optarg); break;
+		case 'g': settings.gyroRateHz = atof(optarg); break;
+		default: return 1;
+		}
+	}
+	if(optind >= argc || repeats <= 0 || settings.gyroRateHz <= 0) {
+		printf("Usage: %s [-r repeats] [-g gyroRateHz] recording.i2c...\n", argv[0]);
+		return 1;
+	}
+
+	imuFrames frames[IMU_STREAM_SENSORS];
+	for(int i = optind; i < argc; i++) {
+		I2CReplay replay;
+		if(replay.load(argv[i]))
+			return 1;
+		if(replay_flight(replay, settings, collectTick, frames) == 0) {
+			printf("%s: nothing replayed, no loop reads recorded or the flight tasks don't schedule at %g Hz\n",
+					argv[i], settings.gyroRateHz);
+			return 1;
+		}
+	}
+
+	// Worst case: no correlation between samples, as many frames as the gyro had
+	imuFrames noise;
+	srand(1);
+	for(size_t f = 0; f < frames[IMU_STREAM_GYRO].counts.size() || f < 1000; f++) {
+		int16_t samples[IMU_STREAM_MAX_SAMPLES][IMU_STREAM_AXES];
+		for(int i = 0; i < IMU_STREAM_MAX_SAMPLES; i++)
+			for(int axis = 0; axis < IMU_STREAM_AXES; axis++)
+				samples[i][axis] = (int16_t)(rand() & 0xFFFF);
+		addFrame(noise, samples, IMU_STREAM_MAX_SAMPLES);
+	}
+
+	int failed = 0;
+	failed |= measure("gyro", frames[IMU_STREAM_GYRO], repeats);
+	failed |= measure("accel", frames[IMU_STREAM_ACCEL], repeats);
+	failed |= measure("random", noise, repeats);
+	return failed;
+}
@@ -0,0 +1,120 @@
+//============================================================================
+// Name        : main-latencyBenchmark.cpp
+// Author      : John Boyd
+// Version     :
+// Copyright   : This work is free for you to copy.
+// Description : Cost of the per-stage latency instrumentation: the clock read,
+//				 a histogram record and a complete LATENCY_SCOPE around an empty
+//				 block. Also checks that percentiles land within the 1/16
+//				 bucket resolution of known distributions, and that a reader
+//				 thread can take percentiles while the writer records.
+//				 Exits non-zero if a percentile is out of bounds.
+//============================================================================
+
+#include "BBB-FlightComputer/BBB-FlightComputer.h"
+#include "BBB-FlightComputer/realtime/latency.h"
+#include <pthread.h>
+
+#define TIMING_CALLS	2000000
+#define READER_PASSES	2000
+
+using namespace std;
+
+static double nanoseconds() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+volatile uint64_t sink;	// Keeps results alive so the work isn't optimised away
+
+static int failures = 0;
+
+static void timeOverhead() {
+	LatencyHistogram* h = latency_stage("benchmark record");
+
+	double start = nanoseconds();
+	for(int i = 0; i < TIMING_CALLS; i++)
+		sink = latency_now();
+	printf("latency_now()           %6.1f ns\n", (nanoseconds() - start) / TIMING_CALLS);
+
+	start = nanoseconds();
+	for(int i = 0; i < TIMING_CALLS; i++)
+		h->record(i & 0xFFFF);
+	printf("record()                %6.1f ns\n", (nanoseconds() - start) / TIMING_CALLS);
+
+	start = nanoseconds();
+	for(int i = 0; i < TIMING_CALLS; i++) {
+		LATENCY_SCOPE("benchmark scope");
+		sink = i;
+	}
+	printf("LATENCY_SCOPE (empty)   %6.1f ns\n", (nanoseconds() - start) / TIMING_CALLS);
+}
+
+static void checkPercentile(LatencyHistogram* h, double p, double expected) {
+	double got = h->percentile(p);
+	double error = fabs(got - expected) / expected;
+	bool ok = error <= 1.0 / LATENCY_SUB_BUCKETS;
+	printf("  %-22s p%-4g expected %10.0f got %10.0f %s\n", h->getName(), p * 100, expected, got, ok ? "ok" : "OUT OF BOUNDS");
+	if(!ok) failures++;
+}
+
+static void checkAccuracy() {
+	printf("\nPercentiles of known distributions\n");
+
+	LatencyHistogram* uniform = latency_stage("uniform 1-100000");
+	for(uint64_t v = 1; v <= 100000; v++)
+		uniform->record(v);
+	checkPercentile(uniform, 0.50, 50000);
+	checkPercentile(uniform, 0.99, 99000);
+	checkPercentile(uniform, 1.00, 100000);
+
+	LatencyHistogram* tail = latency_stage("bimodal 2us/5ms");	// 1% of cycles hit a slow I2C read
+	for(int i = 0; i < 99000; i++) tail->record(2000);
+	for(int i = 0; i < 1000; i++) tail->record(5000000);
+	checkPercentile(tail, 0.50, 2000);
+	checkPercentile(tail, 0.999, 5000000);
+}
+
+static LatencyHistogram* shared;
+static volatile bool writing = true;
+
+static void* reader(void* arg) {
+	uint64_t previous = 0;
+	long* regressions = (long*)arg;
+	for(int i = 0; i < READER_PASSES && writing; i++) {
+		uint32_t count = shared->getCount();
+		if(count < previous) (*regressions)++;
+		previous = count;
+		sink = shared->percentile(0.99);
+	}
+	return NULL;
+}
+
+static void checkConcurrentRead() {
+	shared = latency_stage("concurrent");
+	long regressions = 0;
+	pthread_t thread;
+	pthread_create(&thread, NULL, reader, &regressions);
+	for(int i = 0; i < TIMING_CALLS * 5; i++)
+		shared->record(i & 0xFFF);
+	writing = false;
+	pthread_join(thread, NULL);
+	printf("\nConcurrent reader: %lu samples recorded, %ld count regressions seen\n",
+			(unsigned long)shared->getCount(), regressions);
+	if(regressions) failures++;
+}
+
+int main() {
+	timeOverhead();
+	checkAccuracy();
+	checkConcurrentRead();
+	printf("\n");
+	latency_report(cout);
+
+	if(failures) {
+		printf("\n%d check(s) failed\n", failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,176 @@
+//============================================================================
+// Name        : main-matrixBenchmark.cpp
+// Author      : John Boyd
+// Version     :
+// Copyright   : This work is free for you to copy.
+// Description : Benchmarks imu::Matrix determinant, inverse and solves for
+//				 N = 3..15 against the previous heap allocating cofactor
+//				 expansion. The old code is factorial in N, so it is only
+//				 timed while it finishes in reasonable time.
+//============================================================================
+
+#include "BBB-FlightComputer/BBB-FlightComputer.h"
+
+#define LEGACY_DET_MAX_N	9	// 9! minors per determinant is already ~0.1s
+#define LEGACY_INV_MAX_N	8	// N*N determinants of size N-1
+#define TARGET_NS			20000000.0	// Time each measurement for about 20ms
+
+using namespace std;
+
+// The previous imu::Matrix: malloc'd storage and recursive cofactor expansion with a
+// freshly allocated minor at every level. Kept here only as the benchmark baseline.
+template <uint8_t N> class LegacyMatrix
+{
+public:
+	LegacyMatrix() {
+		_cell = (double*)malloc(sizeof(double)*N*N);
+		memset(_cell, 0, sizeof(double)*N*N);
+	}
+	LegacyMatrix(const LegacyMatrix& m) {
+		_cell = (double*)malloc(sizeof(double)*N*N);
+		memcpy(_cell, m._cell, sizeof(double)*N*N);
+	}
+	~LegacyMatrix() { free(_cell); }
+
+	double& operator ()(int x, int y) { return _cell[x*N+y]; }
+
+	LegacyMatrix<N-1> minor_matrix(int row, int col) {
+		int rowCount = 0;
+		LegacyMatrix<N-1> ret;
+		for(int i = 0; i < N; i++) {
+			if(i == row) continue;
+			int colCount = 0;
+			for(int j = 0; j < N; j++) {
+				if(j == col) continue;
+				ret(rowCount, colCount++) = (*this)(i, j);
+			}
+			rowCount++;
+		}
+		return ret;
+	}
+
+private:
+	LegacyMatrix& operator = (const LegacyMatrix&);
+	double* _cell;
+};
+
+template <uint8_t N> struct LegacyDeterminant {
+	static double of(LegacyMatrix<N>& m) {
+		double det = 0.0;
+		for(int i = 0; i < N; i++) {
+			LegacyMatrix<N-1> minor = m.minor_matrix(0, i);
+			det += (i%2==1?-1.0:1.0) * m(0, i) * LegacyDeterminant<N-1>::of(minor);
+		}
+		return det;
+	}
+};
+
+template <> struct LegacyDeterminant<1> {
+	static double of(LegacyMatrix<1>& m) { return m(0, 0); }
+};
+
+template <uint8_t N> void legacyInvert(LegacyMatrix<N>& m, LegacyMatrix<N>& ret) {
+	double det = LegacyDeterminant<N>::of(m);
+	for(int x = 0; x < N; x++) {
+		for(int y = 0; y < N; y++) {
+			LegacyMatrix<N-1> minor = m.minor_matrix(y, x);
+			ret(x, y) = LegacyDeterminant<N-1>::of(minor) / det;
+			if((x+y)%2 == 1) ret(x, y) = -ret(x, y);
+		}
+	}
+}
+
+static double nanoseconds() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+volatile double sink;	// Keeps results alive so the work isn't optimised away
+
+template <uint8_t N> imu::Matrix<N> makeSPD(unsigned int seed) {	// B*B^T + N*I
+	imu::Matrix<N> b;
+	for(int x = 0; x < N; x++)
+		for(int y = 0; y < N; y++)
+			b(x, y) = rand_r(&seed) / (double)RAND_MAX - 0.5;
+	imu::Matrix<N> a = imu::Matrix<N>::identity() * N;
+	a.symmetric_update(b);
+	return a;
+}
+
+template <uint8_t N> double identityError(const imu::Matrix<N>& a, const imu::Matrix<N>& inv) {
+	imu::Matrix<N> e = a * inv - imu::Matrix<N>::identity();
+	double worst = 0;
+	for(int i = 0; i < N*N; i++)
+		if(fabs(e.data()[i]) > worst) worst = fabs(e.data()[i]);
+	return worst;
+}
+
+// Each op is timed by doubling the repeat count until the run takes long enough.
+#define TIME_OP(result, expr)										\
+	do {															\
+		long reps = 1;												\
+		for(;;) {													\
+			double start = nanoseconds();							\
+			for(long r = 0; r < reps; r++) { expr; }				\
+			double elapsed = nanoseconds() - start;					\
+			if(elapsed > TARGET_NS || reps > (1L << 26)) {			\
+				result = elapsed / reps;							\
+				break;												\
+			}														\
+			reps *= 2;												\
+		}															\
+	} while(0)
+
+template <uint8_t N> void bench() {
+	imu::Matrix<N> a = makeSPD<N>(N * 7919);
+	imu::Matrix<N, 1> b;
+	for(int i = 0; i < N; i++) b(i, 0) = i + 1;
+
+	double det, inv, lu, chol;
+	TIME_OP(det, sink = a.determinant());
+	TIME_OP(inv, sink = a.invert()(0, 0));
+	TIME_OP(lu, sink = imu::LU<N>(a).solve(b)(0, 0));
+	TIME_OP(chol, sink = imu::Cholesky<N>(a).solve(b)(0, 0));
+	double err = identityError(a, a.invert());
+
+	char legacyDet[32] = "skipped";
+	char legacyInv[32] = "skipped";
+	if(N <= LEGACY_DET_MAX_N) {
+		LegacyMatrix<N> old;
+		for(int x = 0; x < N; x++)
+			for(int y = 0; y < N; y++)
+				old(x, y) = a(x, y);
+		double t;
+		TIME_OP(t, sink = LegacyDeterminant<N>::of(old));
+		snprintf(legacyDet, sizeof(legacyDet), "%.0f", t);
+		if(N <= LEGACY_INV_MAX_N) {
+			LegacyMatrix<N> oldInv;
+			TIME_OP(t, legacyInvert<N>(old, oldInv); sink = oldInv(0, 0));
+			snprintf(legacyInv, sizeof(legacyInv), "%.0f", t);
+		}
+	}
+
+	printf("%3d %12.0f %12s %12.0f %12s %12.0f %12.0f %10.1e\n",
+			N, det, legacyDet, inv, legacyInv, lu, chol, err);
+}
+
+int main() {
+	printf("All times in ns per call\n");
+	printf("%3s %12s %12s %12s %12s %12s %12s %10s\n",
+			"N", "det(LU)", "det(old)", "inv(LU)", "inv(old)", "LU solve", "chol solve", "|A*inv-I|");
+	bench<3>();
+	bench<4>();
+	bench<5>();
+	bench<6>();
+	bench<7>();
+	bench<8>();
+	bench<9>();
+	bench<10>();
+	bench<11>();
+	bench<12>();
+	bench<13>();
+	bench<14>();
+	bench<15>();
+	return 0;
+}
@@ -0,0 +1,241 @@
+//============================================================================
+// Name        : main-replay.cpp
+// Author      : John Boyd
+// Version     :
+// Copyright   : This work is free for you to copy.
+// Description : Replays I2C recordings made with BBB-FlightComputer -r through
+//				 the flight tasks, on the same rate group schedule, as fast as
+//				 the CPU allows. Time is virtual: micros() follows the recorded
+//				 timestamps, so the AHRS sees exactly the dt it saw in flight.
+//				 Writes the attitude and the cost of every frame to
+//				 <recording>.csv (or into the -o directory) and prints a
+//				 per-flight and total summary.
+//				 Usage: main-replay [-f madgwick|mahony] [-b beta] [-p kp]
+//				        [-i ki] [-c correctionHz] [-g gyroRateHz] [-o dir]
+//				        [-n] [-l] recording.i2c...
+//				 -g is the gyro rate the recording was flown at
+//				 (BBB-FlightComputer -f, 100 by default). -n skips the CSV
+//				 output. -l also writes a flight data recorder log of every
+//				 frame to <recording>.log, and the raw IMU FIFO samples to
+//				 <recording>.log.imu. The per-stage latency report of the
+//				 instrumented driver, AHRS and task code is printed at the end.
+//============================================================================
+
+#include "BBB-FlightComputer/BBB-FlightComputer.h"
+#include "BBB-FlightComputer/replay/replay.h"
+#include "BBB-FlightComputer/realtime/latency.h"
+#include "BBB-FlightComputer/logging/flightRecorder.h"
+#include "BBB-FlightComputer/logging/imuStream.h"
+#include <string>
+
+#define STAGE_FRAME		0	// The frame's flight tasks, fed from the recording
+#define STAGE_OUTPUT	1
+#define STAGE_COUNT		2
+
+using namespace std;
+
+static const char* stageNames[STAGE_COUNT] = { "frame", "output" };
+
+struct stageStats {
+	double totalNs;
+	double maxNs;
+	unsigned long count;
+};
+
+struct replayOptions {
+	replaySettings settings;
+	const char* outputDir;
+	bool writeCSV;
+	bool writeLog;
+};
+
+struct flightOutput {
+	FILE* csv;
+	FlightRecorder* recorder;
+	ImuStreamWriter* imuStream;
+	unsigned long frames;
+	stageStats stats[STAGE_COUNT];
+};
+
+static double nanoseconds() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void addSample(stageStats& s, double ns) {
+	s.totalNs += ns;
+	if(ns > s.maxNs) s.maxNs = ns;
+	s.count++;
+}
+
+static void printStages(const stageStats stats[]) {
+	for(int i = 0; i < STAGE_COUNT; i++) {
+		if(stats[i].count == 0) continue;
+		printf("  %-8s mean %8.0f ns   max %8.0f ns\n",
+				stageNames[i], stats[i].totalNs / stats[i].count, stats[i].maxNs);
+	}
+}
+
+static string outputPath(const char* recording, const replayOptions& opt, const char* suffix) {
+	string path = recording;
+	if(opt.outputDir) {
+		size_t slash = path.find_last_of('/');
+		if(slash != string::npos) path = path.substr(slash + 1);
+		path = string(opt.outputDir) + "/" + path;
+	}
+	return path + suffix;
+}
+
+static void writeTick(const replayTick& tick, void* context) {
+	flightOutput* out = (flightOutput*)context;
+	double start = nanoseconds();
+	if(out->csv) {
+		const imu::Quaternion& q = uimu_ahrs_get_quaternion();
+		const imu::Vector<3>& e = uimu_ahrs_get_euler();
+		fprintf(out->csv, "%llu,%.6f,%.6f,%.6f,%.6f,%.3f,%.3f,%.3f,%.2f,%.0f\n",
+				tick.micros, q.w(), q.x(), q.y(), q.z(), e.x(), e.y(), e.z(), tick.altitude, tick.frameNs);
+		addSample(out->stats[STAGE_OUTPUT], nanoseconds() - start);
+	}
+	if(out->recorder) {
+		flightRecord r;
+		flight_log_capture(r, (uint16_t)out->frames, *tick.lms303, *tick.gyro, *tick.alt, NULL);
+		r.frameMicros = tick.frameNs / 1e3 < 0xFFFF ? (uint16_t)(tick.frameNs / 1e3) : 0xFFFF;
+		while(!out->recorder->hasRoom(sizeof(r)))	// Offline, so wait for the writer rather than drop
+			usleep(1000);
+		out->recorder->record(r);
+	}
+	if(out->imuStream) {
+		int16_t samples[IMU_STREAM_MAX_SAMPLES][IMU_STREAM_AXES];
+		size_t room = sizeof(imuStreamFrame) + IMU_STREAM_MAX_PAYLOAD;
+		if(tick.gyroNew) {
+			while(!out->imuStream->getRecorder().hasRoom(room))
+				usleep(1000);
+			out->imuStream->write(IMU_STREAM_GYRO, (uint16_t)out->frames, (uint32_t)tick.micros, samples,
+					tick.gyro->getRawFIFO(samples));
+		}
+		if(tick.accelNew) {
+			while(!out->imuStream->getRecorder().hasRoom(room))
+				usleep(1000);
+			out->imuStream->write(IMU_STREAM_ACCEL, (uint16_t)out->frames, (uint32_t)tick.micros, samples,
+					tick.lms303->getRawFIFO(samples));
+		}
+	}
+	out->frames++;
+	addSample(out->stats[STAGE_FRAME], tick.frameNs);
+}
+
+// Returns the recorded flight time in seconds, or a negative number if the file is unusable
+static double replayFlight(const char* recording, const replayOptions& opt, stageStats totals[]) {
+	I2CReplay replay;
+	if(replay.load(recording))
+		return -1;
+
+	flightOutput out;
+	memset(&out, 0, sizeof(out));
+	if(opt.writeCSV) {
+		string path = outputPath(recording, opt, ".csv");
+		out.csv = fopen(path.c_str(), "w");
+		if(out.csv == NULL) {
+			printf("Failed to create %s\n", path.c_str());
+			return -1;
+		}
+		fprintf(out.csv, "micros,qw,qx,qy,qz,heading,pitch,roll,altitude,frame_ns\n");
+	}
+
+	FlightRecorder recorder;
+	ImuStreamWriter imuStream;
+	if(opt.writeLog) {
+		string path = outputPath(recording, opt, ".log");
+		if(recorder.open(path.c_str(), 0) || imuStream.open((path + IMU_STREAM_SUFFIX).c_str())) {
+			if(out.csv) fclose(out.csv);
+			return -1;
+		}
+		out.recorder = &recorder;
+		out.imuStream = &imuStream;
+	}
+
+	unsigned long frames = replay_flight(replay, opt.settings, writeTick, &out);
+	if(out.csv) fclose(out.csv);
+	recorder.close();
+	imuStream.close();
+	if(frames == 0) {
+		printf("%s: nothing replayed, no loop reads recorded or the flight tasks don't schedule at %g Hz\n",
+				recording, opt.settings.gyroRateHz);
+		return -1;
+	}
+
+	printf("%s: %lu frames, %.1f s of flight, %lu desynced reads\n",
+			recording, frames, replay.getDuration(), replay.getDesyncs());
+	printStages(out.stats);
+	if(out.imuStream) imuStream.report(cout);
+
+	for(int i = 0; i < STAGE_COUNT; i++) {
+		totals[i].totalNs += out.stats[i].totalNs;
+		totals[i].count += out.stats[i].count;
+		if(out.stats[i].maxNs > totals[i].maxNs) totals[i].maxNs = out.stats[i].maxNs;
+	}
+	return replay.getDuration();
+}
+
+static int parseFilter(const char* name, UIMU_AHRS_FILTER& filter) {
+	if(strcmp(name, "madgwick") == 0) filter = AHRS_FILTER_MADGWICK;
+	else if(strcmp(name, "mahony") == 0) filter = AHRS_FILTER_MAHONY;
+	else return 1;
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	replayOptions opt;
+	replay_default_settings(opt.settings);
+	opt.outputDir = NULL;
+	opt.writeCSV = true;
+	opt.writeLog = false;
+
+	int c;
+	while((c = getopt(argc, argv, "f:b:p:i:c:g:o:nl")) != -1) {
+		switch(c) {
+		case 'f':
+			if(parseFilter(optarg, opt.settings.filter)) {
+				printf("Unknown filter %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'b': opt.settings.beta = atof(optarg); break;
+		case 'p': opt.settings.kp = atof(optarg); break;
+		case 'i': opt.settings.ki = atof(optarg); break;
+		case 'c': opt.settings.correctionHz = atof(optarg); break;
+		case 'g': opt.settings.gyroRateHz = atof(optarg); break;
+		case 'o': opt.outputDir = optarg; break;
+		case 'n': opt.writeCSV = false; break;
+		case 'l': opt.writeLog = true; break;
+		default: return 1;
+		}
+	}
+	if(optind >= argc || opt.settings.gyroRateHz <= 0) {
+		printf("Usage: %s [-f madgwick|mahony] [-b beta] [-p kp] [-i ki] [-c correctionHz] "
+				"[-g gyroRateHz] [-o dir] [-n] [-l] recording.i2c...\n", argv[0]);
+		return 1;
+	}
+
+	stageStats totals[STAGE_COUNT];
+	memset(totals, 0, sizeof(totals));
+	double flightSeconds = 0;
+	int failed = 0;
+
+	double start = nanoseconds();
+	for(int i = optind; i < argc; i++) {
+		double seconds = replayFlight(argv[i], opt, totals);
+		if(seconds < 0) failed++;
+		else flightSeconds += seconds;
+	}
+	double wallSeconds = (nanoseconds() - start) / 1e9;
+
+	printf("\n%d recordings, %.1f s of flight replayed in %.2f s (%.0fx real time)\n",
+			argc - optind - failed, flightSeconds, wallSeconds,
+			wallSeconds > 0 ? flightSeconds / wallSeconds : 0);
+	printStages(totals);
+	printf("\n");
+	latency_report(cout);	// Breakdown of the stages above
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+//============================================================================
+// Name        : main-sitl.cpp
+// Author      : John Boyd
+// Version     :
+// Copyright   : This work is free for you to copy.
+// Description : Software in the loop: flies the flight computer's drivers,
+//				 AHRS, controller, mixer and rate group schedule, unmodified,
+//				 against a simulated flying wing (simulation/sitl.h). The
+//				 sensors are register models fed from the 6-DOF state, with
+//				 noise, bias and scale errors; the servo duties move the
+//				 surfaces. Time is virtual and lockstep, so a ten minute
+//				 flight takes seconds.
+//				 Usage: main-sitl [-t seconds] [-s seed] [-v airspeed]
+//				        [-a altitude] [-r roll] [-p pitch] [-w north,east]
+//				        [-g gust] [-f gyroRateHz] [-n] [-m seed] [-o truth.csv]
+//				        [-l flight.log]
+//				 The aircraft is launched trimmed at -v m/s (18) and -a m
+//				 (150), upset by -r and -p degrees (30, 0), with the
+//				 throttle left at trim. -w is a steady wind in m/s, -g the
+//				 rms gust (0.5 m/s). -n flies perfect sensors, only noise.
+//				 -m flies main-sitlCampaign's run of that seed: its draw
+//				 replaces -s -v -a -r -p -w -g, and the trajectory signature
+//				 matches the campaign's.
+//				 -o writes the true and estimated attitude at 50 Hz, -l the
+//				 flight log as BBB-FlightComputer -l does.
+//				 Prints how well the attitude was held, the AHRS, INS and
+//				 altitude errors against the truth, and the executive and
+//				 latency reports with the host's real task times. Exits 1 if it crashed.
+//				 Built with ALLOC_TRACKING (realtime/allocTrack.h), it also
+//				 reports every allocation the flight tasks made after the
+//				 warm-up, and exits 1 if there were any.
+//============================================================================
+
+#include "BBB-FlightComputer/flightControl/flightLoop.h"
+#include "BBB-FlightComputer/simulation/sitlCampaign.h"
+#include "BBB-FlightComputer/realtime/allocTrack.h"
+#include <stdlib.h>
+#include <sstream>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	sitlConfig config;
+	sitl_default_config(config);
+	fixedWingParameters parameters;
+	fixed_wing_default_parameters(parameters);
+	double duration = 600;
+	const char* truthPath = NULL;
+	const char* flightLog = NULL;
+	float gyroRateHz = FLIGHT_GYRO_RATE_HZ;
+	bool campaign = false;
+	uint64_t campaignSeed = 0;
+
+	int c;
+	while((c = getopt(argc, argv, "t:s:v:a:r:p:w:g:f:nm:o:l:")) != -1) {
+		switch(c) {
+		case 't': duration = atof(optarg); break;
+		case 's': config.seed = strtoull(optarg, NULL, 0); break;
+		case 'v': config.airspeed = atof(optarg); break;
+		case 'a': config.altitude = atof(optarg); break;
+		case 'r': config.roll = atof(optarg); break;
+		case 'p': config.pitch = atof(optarg); break;
+		case 'w':
+			if(sscanf(optarg, "%lf,%lf", &parameters.wind[0], &parameters.wind[1]) != 2) {
+				cout << "Wind is north,east in m/s" << endl;
+				return 1;
+			}
+			break;
+		case 'g': parameters.turbulence = atof(optarg); break;
+		case 'f': gyroRateHz = atof(optarg); break;
+		case 'n': config.sensorErrors = false; break;
+		case 'm':
+			campaign = true;
+			campaignSeed = strtoull(optarg, NULL, 0);
+			break;
+		case 'o': truthPath = optarg; break;
+		case 'l': flightLog = optarg; break;
+		default: return 1;
+		}
+	}
+	if(gyroRateHz < FLIGHT_LOOP_HZ || fmodf(gyroRateHz, FLIGHT_LOOP_HZ) != 0) {
+		cout << "Gyro rate must be a multiple of " << FLIGHT_LOOP_HZ << " Hz" << endl;
+		return 1;
+	}
+	if(campaign) {
+		sitlDispersion d;
+		sitl_draw_dispersion(campaignSeed, d);
+		sitl_apply_dispersion(d, campaignSeed, parameters, config);
+		printf("Campaign run %llu: wind %.1f m/s from %.0f deg, gust %.2f m/s, CG %+.1f mm forward %+.1f mm right, "
+				"servo lag %.0f ms, noise x%.2f\n", (unsigned long long)campaignSeed, d.windSpeed, d.windFrom, d.gust,
+				d.cgForward * 1e3, d.cgRight * 1e3, d.servoTau * 1e3, d.noiseScale);
+	}
+
+	FILE* truth = NULL;
+	if(truthPath) {
+		truth = fopen(truthPath, "w");
+		if(!truth) {
+			cout << "Failed to open " << truthPath << endl;
+			return 1;
+		}
+	}
+
+	printf("Launching at %.1f m/s, %.0f m, upset %.0f deg roll %.0f deg pitch, seed %llu\n\n", config.airspeed,
+			config.altitude, config.roll, config.pitch, (unsigned long long)config.seed);
+	sitlFlightResult r;
+	ostringstream report;
+	int failed = sitl_fly(parameters, config, gyroRateHz, duration, r, truth, flightLog, &report);
+	if(truth) fclose(truth);
+	if(failed) {
+		if(failed == 1) cout << "Failed to trim the aircraft for launch" << endl;
+		return 1;
+	}
+
+	printf("\nThrottle %.0f%%, %.1f s flown in %.2f s (%.0fx real time), %lu simulation steps\n",
+			r.trimThrottle * 100, r.flown, r.wallSeconds, r.wallSeconds > 0 ? r.flown / r.wallSeconds : 0, r.steps);
+	if(r.crashed)
+		printf("CRASHED after %.1f s\n", r.flown);
+	if(r.samples) {
+		printf("Recovered from the upset in %.1f s\n", r.recovered);
+		printf("Attitude held after %d s:  roll rms %.2f max %.2f deg, pitch rms %.2f max %.2f deg\n",
+				SITL_SETTLE_SECONDS, r.rollRms, r.rollMax, r.pitchRms, r.pitchMax);
+		printf("AHRS error:  roll rms %.2f deg, pitch rms %.2f deg\n", r.rollErrorRms, r.pitchErrorRms);
+		printf("INS error:   velocity rms %.2f m/s, climb rms %.2f m/s, height %.1f m at the end\n",
+				r.velocityErrorRms, r.climbErrorRms, r.heightError);
+		printf("Altitude error:  baro rms %.2f m, vertical channel rms %.2f m and climb rms %.2f m/s\n",
+				r.baroErrorRms, r.verticalErrorRms, r.verticalClimbErrorRms);
+	}
+	printf("Altitude %.1f to %.1f m, airspeed %.1f to %.1f m/s\n", r.altitudeMin, r.altitudeMax, r.airspeedMin,
+			r.airspeedMax);
+	printf("Trajectory signature %016llx\n\n", (unsigned long long)r.signature);
+	cout << report.str();
+	return r.crashed || alloc_track_errors() ? 1 : 0;
+}
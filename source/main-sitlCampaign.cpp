@@ -0,0 +1,396 @@
+//============================================================================
+// Name        : main-sitlCampaign.cpp
+// Author      : John Boyd
+// Version     :
+// Copyright   : This work is free for you to copy.
+// Description : Monte Carlo SITL campaign, to check the controller's robustness
+//				 before a release. Flies -c runs (1000) of -t seconds (120)
+//				 from seed -s (1) on, each dispersed by its seed
+//				 (simulation/sitlCampaign.h): launch speed and upset, wind
+//				 and gusts, CG offset, servo lag, sensor noise and errors.
+//				 The flight code keeps its state in globals, so every run
+//				 is its own forked process, -j at a time (one per core);
+//				 each starts from the same clean state, so a seed flies the
+//				 same trajectory wherever and whenever it runs.
+//				 Usage: main-sitlCampaign [-c runs] [-s firstSeed]
+//				        [-t seconds] [-j processes] [-R reruns]
+//				        [-o runs.csv] [-b baseline.csv]
+//				 Prints the pass rate, the failing seeds by cause, the spread of
+//				 recovery time, attitude holding and AHRS error, and the
+//				 throughput in simulated flight hours per wall clock
+//				 minute. The first -R (5) failing seeds are flown again and
+//				 their trajectory signatures compared, to show they
+//				 reproduce bit for bit; main-sitl -m seed -t seconds flies
+//				 one with the full reports and -o truth. -o writes every
+//				 run's draw and metrics. -b reads an earlier campaign's -o,
+//				 a known passing one such as the last release's, and
+//				 counts every cause there too and marks the seeds that
+//				 passed there, so a regression stands out from a seed that
+//				 always failed. Exits 1 if any run failed.
+//============================================================================
+
+#include "BBB-FlightComputer/flightControl/flightLoop.h"
+#include "BBB-FlightComputer/simulation/sitlCampaign.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <string>
+
+#define MAX_PROCESSES		256
+#define MAX_LISTED			20		// Failing seeds printed
+
+using namespace std;
+
+struct campaignRun {	// Written whole down the pipe by each run's process
+	uint64_t seed;
+	int status;			// sitl_fly's, -1 if the process died
+	sitlFlightResult result;
+};
+
+static double nanoseconds() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void fly(uint64_t seed, double duration, int fd) {
+	// The drivers' chatter from thousands of runs isn't worth reading
+	int null = open("/dev/null", O_WRONLY);
+	if(null >= 0) dup2(null, STDOUT_FILENO);
+
+	fixedWingParameters parameters;
+	fixed_wing_default_parameters(parameters);
+	sitlConfig config;
+	sitl_default_config(config);
+	sitlDispersion d;
+	sitl_draw_dispersion(seed, d);
+	sitl_apply_dispersion(d, seed, parameters, config);
+
+	campaignRun run;
+	memset(&run, 0, sizeof(run));
+	run.seed = seed;
+	run.status = sitl_fly(parameters, config, FLIGHT_GYRO_RATE_HZ, duration, run.result);
+	if(write(fd, &run, sizeof(run)) != sizeof(run))	// Under PIPE_BUF, so it arrives whole
+		_exit(1);
+	_exit(0);
+}
+
+// Forks a process per seed, processes at a time, and collects what they write
+static void runAll(const vector<uint64_t>& seeds, double duration, long processes, vector<campaignRun>& runs) {
+	runs.clear();
+	int fds[2];
+	if(pipe(fds) != 0) {
+		printf("Failed to create the result pipe\n");
+		return;
+	}
+	vector<pair<pid_t, uint64_t> > active;
+	size_t next = 0, report = seeds.size() / 10;
+	while(next < seeds.size() || !active.empty()) {
+		if(next < seeds.size() && (long)active.size() < processes) {
+			fflush(stdout);
+			cout << flush;
+			pid_t pid = fork();
+			if(pid == 0) {
+				close(fds[0]);
+				fly(seeds[next], duration, fds[1]);
+			}
+			if(pid < 0) {
+				if(active.empty()) {
+					printf("Failed to start a run\n");
+					break;
+				}
+			}
+			else {
+				active.push_back(make_pair(pid, seeds[next]));
+				next++;
+				continue;
+			}
+		}
+
+		int status;
+		pid_t pid = wait(&status);
+		if(pid < 0)
+			break;
+		uint64_t seed = 0;
+		for(size_t i = 0; i < active.size(); i++)
+			if(active[i].first == pid) {
+				seed = active[i].second;
+				active.erase(active.begin() + i);
+				break;
+			}
+		campaignRun run;
+		if(WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+			// One whole record per clean exit, though not necessarily this process's
+			if(read(fds[0], &run, sizeof(run)) != sizeof(run)) {
+				printf("Failed to read a run's result\n");
+				break;
+			}
+		}
+		else {
+			memset(&run, 0, sizeof(run));
+			run.seed = seed;
+			run.status = -1;
+		}
+		runs.push_back(run);
+		if(report && runs.size() % report == 0 && seeds.size() > 1) {
+			printf("%lu of %lu runs\n", (unsigned long)runs.size(), (unsigned long)seeds.size());
+			fflush(stdout);
+		}
+	}
+	close(fds[0]);
+	close(fds[1]);
+}
+
+static bool bySeed(const campaignRun& a, const campaignRun& b) {
+	return a.seed < b.seed;
+}
+
+static const char* failure(const campaignRun& run, double duration) {
+	return run.status < 0 ? "aborted" : sitl_campaign_failure(run.result, duration);
+}
+
+// An earlier campaign's -o: each seed's result, "pass" or the cause
+static bool loadBaseline(const char* path, map<uint64_t, string>& results) {
+	FILE* in = fopen(path, "r");
+	if(in == NULL)
+		return false;
+	char line[512];
+	while(fgets(line, sizeof(line), in)) {
+		unsigned long long seed;
+		char result[32];
+		if(sscanf(line, "%llu,%31[^,]", &seed, result) == 2)	// Not the header, it doesn't start with a number
+			results[seed] = result;
+	}
+	fclose(in);
+	return true;
+}
+
+static void printSpread(const char* name, vector<double>& values, const char* unit) {
+	if(values.empty())
+		return;
+	sort(values.begin(), values.end());
+	double sum = 0;
+	for(size_t i = 0; i < values.size(); i++)
+		sum += values[i];
+	printf("  %-22s mean %7.2f  p50 %7.2f  p95 %7.2f  max %7.2f %s\n", name, sum / values.size(),
+			values[values.size() / 2], values[(size_t)(values.size() * 0.95)], values.back(), unit);
+}
+
+int main(int argc, char* argv[]) {
+	long processes = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned long count = 1000;
+	uint64_t first = 1;
+	double duration = 120;
+	unsigned long reruns = 5;
+	const char* csvPath = NULL;
+	const char* baselinePath = NULL;
+
+	int c;
+	while((c = getopt(argc, argv, "c:s:t:j:R:o:b:")) != -1) {
+		switch(c) {
+		case 'c': count = strtoul(optarg, NULL, 0); break;
+		case 's': first = strtoull(optarg, NULL, 0); break;
+		case 't': duration = atof(optarg); break;
+		case 'j': processes = atol(optarg); break;
+		case 'R': reruns = strtoul(optarg, NULL, 0); break;
+		case 'o': csvPath = optarg; break;
+		case 'b': baselinePath = optarg; break;
+		default: return 1;
+		}
+	}
+	if(count < 1 || processes < 1 || duration <= 0) {
+		printf("Usage: %s [-c runs] [-s firstSeed] [-t seconds] [-j processes] [-R reruns] [-o runs.csv] "
+				"[-b baseline.csv]\n", argv[0]);
+		return 1;
+	}
+	if(processes > MAX_PROCESSES) processes = MAX_PROCESSES;
+	map<uint64_t, string> baseline;
+	if(baselinePath && !loadBaseline(baselinePath, baseline)) {
+		printf("Failed to read %s\n", baselinePath);
+		return 1;
+	}
+
+	vector<uint64_t> seeds;
+	for(unsigned long i = 0; i < count; i++)
+		seeds.push_back(first + i);
+	printf("Flying %lu runs of %.0f s, seeds %llu to %llu, %ld at a time\n", count, duration,
+			(unsigned long long)first, (unsigned long long)(first + count - 1), processes);
+
+	double start = nanoseconds();
+	vector<campaignRun> runs;
+	runAll(seeds, duration, processes, runs);
+	double elapsed = (nanoseconds() - start) / 1e9;
+	sort(runs.begin(), runs.end(), bySeed);	// So the output doesn't depend on which run finished first
+
+	double flown = 0, busy = 0;
+	unsigned long passed = 0;
+	vector<const char*> causes;
+	vector<unsigned long> causeCounts;
+	vector<vector<uint64_t> > causeSeeds;
+	vector<double> recovery, rollRms, pitchRms, rollError, pitchError, altitudeLost;
+	for(size_t i = 0; i < runs.size(); i++) {
+		const campaignRun& run = runs[i];
+		const sitlFlightResult& r = run.result;
+		flown += r.flown;
+		busy += r.wallSeconds;
+		const char* cause = failure(run, duration);
+		if(!cause)
+			passed++;
+		else {
+			size_t k = 0;
+			while(k < causes.size() && strcmp(causes[k], cause) != 0) k++;
+			if(k == causes.size()) {
+				causes.push_back(cause);
+				causeCounts.push_back(0);
+				causeSeeds.push_back(vector<uint64_t>());
+			}
+			causeCounts[k]++;
+			causeSeeds[k].push_back(run.seed);
+		}
+		if(run.status != 0)
+			continue;
+		recovery.push_back(r.recovered);
+		if(r.samples) {
+			rollRms.push_back(r.rollRms);
+			pitchRms.push_back(r.pitchRms);
+			rollError.push_back(r.rollErrorRms);
+			pitchError.push_back(r.pitchErrorRms);
+		}
+		altitudeLost.push_back(CAMPAIGN_ALTITUDE - r.altitudeMin);
+	}
+
+	printf("\n%lu of %lu runs passed (%.1f%%)\n", passed, (unsigned long)runs.size(),
+			runs.empty() ? 0 : 100.0 * passed / runs.size());
+	if(baselinePath) {	// Causes only the baseline had belong in the table too, with no runs now
+		for(size_t i = 0; i < runs.size(); i++) {
+			map<uint64_t, string>::const_iterator b = baseline.find(runs[i].seed);
+			if(b == baseline.end() || b->second == "pass")
+				continue;
+			size_t k = 0;
+			while(k < causes.size() && b->second != causes[k]) k++;
+			if(k == causes.size()) {
+				causes.push_back(b->second.c_str());
+				causeCounts.push_back(0);
+				causeSeeds.push_back(vector<uint64_t>());
+			}
+		}
+	}
+	if(!causes.empty()) {
+		printf("  %-10s %6s", "cause", "runs");
+		if(baselinePath) printf(" %9s", "baseline");
+		printf("  seeds%s\n", baselinePath ? ", * passed in the baseline" : "");
+	}
+	unsigned long regressed = 0, fixed = 0, unknown = 0;
+	for(size_t k = 0; k < causes.size(); k++) {
+		printf("  %-10s %6lu", causes[k], causeCounts[k]);
+		if(baselinePath) {
+			unsigned long before = 0;
+			for(size_t i = 0; i < runs.size(); i++) {
+				map<uint64_t, string>::const_iterator b = baseline.find(runs[i].seed);
+				if(b != baseline.end() && b->second == causes[k]) before++;
+			}
+			printf(" %9lu", before);
+		}
+		if(!causeSeeds[k].empty())
+			printf(" ");
+		for(size_t j = 0; j < causeSeeds[k].size() && j < MAX_LISTED; j++) {
+			map<uint64_t, string>::const_iterator b = baseline.find(causeSeeds[k][j]);
+			printf(" %llu%s", (unsigned long long)causeSeeds[k][j], b != baseline.end() && b->second == "pass" ? "*" : "");
+		}
+		if(causeSeeds[k].size() > MAX_LISTED)
+			printf(" and %lu more", (unsigned long)(causeSeeds[k].size() - MAX_LISTED));
+		printf("\n");
+	}
+	if(baselinePath) {
+		for(size_t i = 0; i < runs.size(); i++) {
+			map<uint64_t, string>::const_iterator b = baseline.find(runs[i].seed);
+			bool failed = failure(runs[i], duration) != NULL;
+			if(b == baseline.end())
+				unknown++;
+			else if(failed && b->second == "pass")
+				regressed++;
+			else if(!failed && b->second != "pass")
+				fixed++;
+		}
+		printf("Against %s: %lu seeds that passed there failed, %lu that failed there passed", baselinePath,
+				regressed, fixed);
+		if(unknown)
+			printf(", %lu weren't flown there", unknown);
+		printf("\n");
+	}
+	printf("Across the runs that flew:\n");
+	printSpread("recovery s", recovery, "s");
+	printSpread("roll rms", rollRms, "deg");
+	printSpread("pitch rms", pitchRms, "deg");
+	printSpread("AHRS roll error rms", rollError, "deg");
+	printSpread("AHRS pitch error rms", pitchError, "deg");
+	printSpread("altitude lost", altitudeLost, "m");
+	printf("\n%.1f flight hours in %.1f s: %.2f flight hours per wall clock minute, %.0fx real time per process\n",
+			flown / 3600, elapsed, elapsed > 0 ? flown / 3600 / (elapsed / 60) : 0, busy > 0 ? flown / busy : 0);
+
+	vector<uint64_t> failed;
+	for(size_t i = 0; i < runs.size(); i++) {
+		const char* cause = failure(runs[i], duration);
+		if(!cause)
+			continue;
+		if(failed.empty())
+			printf("\nFailed:\n");
+		if(failed.size() < MAX_LISTED)
+			printf("  seed %llu: %s, flew %.1f s, recovered %.1f s, roll rms %.1f, pitch rms %.1f deg\n",
+					(unsigned long long)runs[i].seed, cause, runs[i].result.flown, runs[i].result.recovered,
+					runs[i].result.rollRms, runs[i].result.pitchRms);
+		failed.push_back(runs[i].seed);
+	}
+	if(failed.size() > MAX_LISTED)
+		printf("  and %lu more\n", (unsigned long)(failed.size() - MAX_LISTED));
+
+	if(reruns && !failed.empty()) {
+		vector<uint64_t> again(failed.begin(), failed.begin() + min((size_t)reruns, failed.size()));
+		vector<campaignRun> second;
+		runAll(again, duration, processes, second);
+		sort(second.begin(), second.end(), bySeed);
+		printf("\nFlown again:\n");
+		for(size_t i = 0; i < second.size(); i++) {
+			const campaignRun* original = NULL;
+			for(size_t j = 0; j < runs.size() && !original; j++)
+				if(runs[j].seed == second[i].seed) original = &runs[j];
+			bool same = original && original->status == second[i].status &&
+					original->result.signature == second[i].result.signature;
+			printf("  seed %llu: signature %016llx, %s  (main-sitl -m %llu -t %g)\n",
+					(unsigned long long)second[i].seed, (unsigned long long)second[i].result.signature,
+					same ? "reproduced" : "DIFFERENT", (unsigned long long)second[i].seed, duration);
+		}
+	}
+
+	if(csvPath) {
+		FILE* out = fopen(csvPath, "w");
+		if(out == NULL) {
+			printf("Failed to create %s\n", csvPath);
+			return 1;
+		}
+		fprintf(out, "seed,result,airspeed,roll,pitch,wind,wind_from,gust,cg_forward,cg_right,servo_tau,noise,"
+				"flown,recovered,roll_rms,roll_max,pitch_rms,pitch_max,roll_error_rms,pitch_error_rms,"
+				"altitude_min,altitude_max,airspeed_min,airspeed_max,signature\n");
+		for(size_t i = 0; i < runs.size(); i++) {
+			const campaignRun& run = runs[i];
+			const sitlFlightResult& r = run.result;
+			sitlDispersion d;
+			sitl_draw_dispersion(run.seed, d);
+			const char* cause = failure(run, duration);
+			fprintf(out, "%llu,%s,%.2f,%.1f,%.1f,%.2f,%.0f,%.2f,%.4f,%.4f,%.3f,%.2f,"
+					"%.1f,%.1f,%.3f,%.2f,%.3f,%.2f,%.3f,%.3f,%.1f,%.1f,%.1f,%.1f,%016llx\n",
+					(unsigned long long)run.seed, cause ? cause : "pass", d.airspeed, d.roll, d.pitch, d.windSpeed,
+					d.windFrom, d.gust, d.cgForward, d.cgRight, d.servoTau, d.noiseScale, r.flown, r.recovered,
+					r.rollRms, r.rollMax, r.pitchRms, r.pitchMax, r.rollErrorRms, r.pitchErrorRms, r.altitudeMin,
+					r.altitudeMax, r.airspeedMin, r.airspeedMax, (unsigned long long)r.signature);
+		}
+		fclose(out);
+	}
+	return failed.empty() ? 0 : 1;
+}
@@ -0,0 +1,423 @@
+//============================================================================
+// Name        : main-stepLatency.cpp
+// Author      : John Boyd
+// Version     :
+// Copyright   : This work is free for you to copy.
+// Description : End to end latency, sensor to servo: from a rotation reaching
+//				 the gyro FIFO to the corrected duty landing in the PWM sysfs
+//				 file. The flight tasks run in real time, as on the aircraft,
+//				 against the simulated sensors (simulation/simSensors.h) and
+//				 a fake sysfs tree laid out like the BeagleBone's, so the
+//				 duties go through the real open/write/close path.
+//				 At rest and level, a roll rate step goes in at a random
+//				 point of the loop period; its latency runs from the first
+//				 gyro sample that has it to the first elevon duty write that
+//				 moves. The steps alternate in sign, with the AHRS and the
+//				 controller reset in between.
+//				 Usage: main-stepLatency [-n steps] [-r stepDps]
+//				        [-k configuration] [-b baseline] [-w baseline]
+//				        [-x percent] [-d directory] [-p priority] [-c cpu]
+//				        [-v]
+//				 Runs -n (100) steps of -r dps (100) in each acquisition,
+//				 AHRS and control configuration, or only those whose name
+//				 contains -k, and prints the latency distribution of each.
+//				 -w saves every p99 as a baseline; -b checks against one
+//				 and fails if a p99 grew more than -x percent (20). -d is
+//				 where the sysfs tree goes (/tmp), e.g. the SD card to
+//				 count its writes. -p and -c as for BBB-FlightComputer.
+//				 -v also prints the per-stage latencies of each.
+//				 Exits 1 if a step got no response or a p99 regressed.
+//============================================================================
+
+#include "BBB-FlightComputer/BBB-FlightComputer.h"
+#include "BBB-FlightComputer/flightControl/flightLoop.h"
+#include "BBB-FlightComputer/simulation/simSensors.h"
+#include "BBB-FlightComputer/realtime/latency.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <map>
+#include <vector>
+
+#define STEP_WARMUP_SECONDS		0.5
+#define STEP_SETTLE_SECONDS		0.1		// At rest before each step
+#define STEP_TIMEOUT_SECONDS	0.5		// No response by then is a miss
+#define STEP_DUTY_NS			2000	// A duty this far from where it was has responded, 0.2% of travel
+
+using namespace std;
+
+struct latencyConfig {
+	const char* name;
+	float loopHz;						// Base rate: gyro, AHRS, rate loop and mixer
+	L3GD20_DATA_RATE gyroRate;
+	L3GD20_GYRO_FIFO_MODE fifo;
+	UIMU_AHRS_FILTER filter;
+};
+
+static const latencyConfig configs[] = {
+	{ "100 Hz stream madgwick",	100, DR_GYRO_800HZ, GYRO_FIFO_STREAM, AHRS_FILTER_MADGWICK },	// As flown
+	{ "100 Hz stream mahony",	100, DR_GYRO_800HZ, GYRO_FIFO_STREAM, AHRS_FILTER_MAHONY },
+	{ "100 Hz bypass madgwick",	100, DR_GYRO_800HZ, GYRO_FIFO_BYPASS, AHRS_FILTER_MADGWICK },
+	{ "100 Hz odr100 madgwick",	100, DR_GYRO_100HZ, GYRO_FIFO_STREAM, AHRS_FILTER_MADGWICK },
+	{ "200 Hz stream madgwick",	200, DR_GYRO_800HZ, GYRO_FIFO_STREAM, AHRS_FILTER_MADGWICK },
+	{ "400 Hz stream madgwick",	400, DR_GYRO_800HZ, GYRO_FIFO_STREAM, AHRS_FILTER_MADGWICK },
+};
+#define CONFIGS		(int)(sizeof(configs) / sizeof(configs[0]))
+
+// The three chips at rest and level, on the real clock. A step is applied between the
+// samples either side of its time however late the next bus access comes
+class StepBench : public I2CTransport {
+
+private:
+
+	SimL3GD20 gyro;
+	SimLMS303 lms303;
+	SimLPS331 lps331;
+	simTruth truth;
+	double stepRate;	// dps about x
+	double stepAt;		// us, negative when no step is pending
+	double stepSample;	// us, the first gyro sample with the last step in it
+
+	static sensorErrors perfect() {
+		sensorErrors e;
+		memset(&e, 0, sizeof(e));
+		return e;
+	}
+
+	void updateTo(double us) {
+		gyro.update(truth, us);
+		lms303.update(truth, us);
+		lps331.update(truth, us);
+	}
+
+	void advance() {
+		double now = latency_now() / 1e3;
+		if(stepAt >= 0 && now >= stepAt) {
+			updateTo(stepAt);
+			truth.rates[0] = stepRate;
+			stepSample = gyro.getNextSample();
+			stepAt = -1;
+		}
+		updateTo(now);
+	}
+
+public:
+
+	StepBench() : gyro(perfect(), 1), lms303(perfect(), perfect(), 2), lps331(perfect(), 3) {
+		memset(&truth, 0, sizeof(truth));
+		truth.accel[2] = 1;
+		truth.mag[0] = 0.22;	// The AHRS's reference field, in the board's forward-left-up axes
+		truth.mag[2] = -0.42;
+		truth.pressure = sim_pressure_at(150);
+		truth.temperature = 25;
+		stepRate = 0;
+		stepAt = -1;
+		stepSample = -1;
+	}
+
+	int read(int, int address, char reg, char data[], int size) {
+		advance();
+		switch(address) {
+		case 0x6b: return gyro.read(reg, data, size);
+		case 0x1d: return lms303.read(reg, data, size);
+		case 0x5d: return lps331.read(reg, data, size);
+		default:
+			memset(data, 0, size);
+			return 1;
+		}
+	}
+
+	int write(int, int address, char reg, char value) {
+		advance();
+		switch(address) {
+		case 0x6b: return gyro.write(reg, value);
+		case 0x1d: return lms303.write(reg, value);
+		case 0x5d: return lps331.write(reg, value);
+		default: return 1;
+		}
+	}
+
+	void step(double rate, uint64_t atNs) {
+		stepRate = rate;
+		stepAt = atNs / 1e3;
+		stepSample = -1;
+	}
+	bool stepTaken() { return stepAt < 0 && stepSample >= 0; }
+	uint64_t getStepSampleNs() { return (uint64_t)(stepSample * 1e3); }
+};
+
+struct bench {
+	StepBench* sensors;
+	LMS303* lms303;
+	LPS331Altimeter* alt;
+	L3GD20Gyro* gyro;
+	aircraftControls* aircraft;
+	rtLoopConfig rt;
+	bool realTimeWarned;
+};
+
+//----------------------------------------------------------------------------------------------
+// A sysfs tree with the PWM overlays already loaded
+
+static int makeFile(const string& path, const char* contents) {
+	FILE* f = fopen(path.c_str(), "w");
+	if(!f) {
+		printf("Failed to create %s\n", path.c_str());
+		return 1;
+	}
+	fputs(contents, f);
+	fclose(f);
+	return 0;
+}
+
+static int makeSysfs(const string& root) {
+	static const int pins[] = { THROTTLE_PIN, ELEVATOR_PIN, AILERON_PIN, LEFT_ELEVON_PIN, RIGHT_ELEVON_PIN, RUDDER_PIN };
+	string capemgr = root + "/bone_capemgr.9";
+	string ocp = root + "/ocp.3";
+	if(mkdir(capemgr.c_str(), 0755) || mkdir(ocp.c_str(), 0755)) {
+		printf("Failed to create the sysfs tree in %s\n", root.c_str());
+		return 1;
+	}
+	string slots = " 0: 54:PF--- \n 7: ff:P-O-L Override Board Name,00A0,Override Manuf,am33xx_pwm\n";
+	for(int i = 0; i < (int)(sizeof(pins) / sizeof(pins[0])); i++) {
+		char line[128], dir[64];
+		snprintf(dir, sizeof(dir), "/pwm_test_P9_%d.12", pins[i]);
+		string pwm = ocp + dir;
+		if(mkdir(pwm.c_str(), 0755)) {
+			if(errno == EEXIST)	// Channels share pins
+				continue;
+			printf("Failed to create %s\n", pwm.c_str());
+			return 1;
+		}
+		snprintf(line, sizeof(line), " %d: ff:P-O-L Override Board Name,00A0,Override Manuf,bone_pwm_P9_%d\n", 8 + i,
+				pins[i]);
+		slots += line;
+		if(makeFile(pwm + "/period", "0") || makeFile(pwm + "/duty", "0") || makeFile(pwm + "/polarity", "0") ||
+				makeFile(pwm + "/run", "0"))
+			return 1;
+	}
+	return makeFile(capemgr + "/slots", slots.c_str());
+}
+
+static int removeEntry(const char* path, const struct stat*, int, struct FTW*) {
+	return remove(path);
+}
+
+//----------------------------------------------------------------------------------------------
+
+static void runFor(RateGroupExecutive& executive, double seconds) {
+	uint64_t end = latency_now() + (uint64_t)(seconds * 1e9);
+	while(latency_now() < end)
+		executive.runFrame();
+}
+
+static bool responded(PWMChannel& channel, unsigned long before, uint64_t since) {
+	long moved = (long)channel.getDuty() - (long)before;
+	return channel.getDutyWritten() >= since && (moved > STEP_DUTY_NS || moved < -STEP_DUTY_NS);
+}
+
+// Steps the roll rate trials times, alternating in sign. Returns the number with no response
+static unsigned long measure(const latencyConfig& c, bench& b, int trials, double stepDps, LatencyHistogram& h,
+		bool verbose) {
+	b.gyro->setGyroDataRate(c.gyroRate);
+	b.gyro->setGyroFIFOMode(c.fifo);
+	uimu_ahrs_set_filter(c.filter);
+	latency_reset();
+
+	AttitudeController controller;
+	FlightRecorder recorder;	// Never opened, the recorder and stream tasks return at once
+	ImuStreamWriter imuStream;
+	RateGroupExecutive executive(c.loopHz);
+	flightTasks tasks;
+	flight_tasks_init(tasks, *b.lms303, *b.alt, *b.gyro, *b.aircraft, controller, recorder, imuStream, executive);
+	int overloaded = flight_tasks_add(tasks) ? -1 : executive.build();
+	if(overloaded < 0) {
+		printf("%s: can't schedule the flight tasks, every step counts as missed\n", c.name);
+		return trials;
+	}
+	if(overloaded)
+		printf("%s: task budgets don't fit, low priority tasks will be shed\n", c.name);
+	b.rt.rateHz = c.loopHz;
+	if(executive.setup(b.rt) && !b.realTimeWarned) {
+		printf("Measuring without full real-time guarantees\n");
+		b.realTimeWarned = true;
+	}
+
+	runFor(executive, STEP_WARMUP_SECONDS);
+	SimRandom random(1);
+	PWMChannel& left = b.aircraft->leftElevonChannel;
+	PWMChannel& right = b.aircraft->rightElevonChannel;
+	uint64_t period = (uint64_t)(1e9 / c.loopHz);
+	unsigned long missed = 0;
+	for(int i = 0; i < trials; i++) {
+		b.lms303->readFullSensorState();
+		uimu_ahrs_init(b.lms303->read_acc(), b.lms303->read_mag());
+		controller.reset();
+		runFor(executive, STEP_SETTLE_SECONDS);
+
+		unsigned long leftBefore = left.getDuty(), rightBefore = right.getDuty();
+		uint64_t at = latency_now() + (uint64_t)random.uniform(0, period);
+		b.sensors->step(i % 2 ? -stepDps : stepDps, at);
+		uint64_t deadline = at + (uint64_t)(STEP_TIMEOUT_SECONDS * 1e9);
+		bool done = false;
+		while(!done && latency_now() < deadline) {
+			executive.runFrame();
+			if(!b.sensors->stepTaken())
+				continue;
+			uint64_t sampled = b.sensors->getStepSampleNs();
+			uint64_t landed = 0;
+			if(responded(left, leftBefore, sampled)) landed = left.getDutyWritten();
+			if(responded(right, rightBefore, sampled) && (!landed || right.getDutyWritten() < landed))
+				landed = right.getDutyWritten();
+			if(landed) {
+				h.record(landed - sampled);
+				done = true;
+			}
+		}
+		if(!done) missed++;
+		b.sensors->step(0, latency_now());
+	}
+	if(verbose) {
+		printf("\n%s\n", c.name);
+		latency_report(cout);
+	}
+	return missed;
+}
+
+//----------------------------------------------------------------------------------------------
+
+static int readBaseline(const char* path, map<string, double>& p99) {
+	FILE* f = fopen(path, "r");
+	if(!f) {
+		printf("Failed to open %s\n", path);
+		return 1;
+	}
+	char line[256];
+	while(fgets(line, sizeof(line), f)) {
+		char* tab = strchr(line, '\t');
+		if(line[0] == '#' || !tab)
+			continue;
+		*tab = 0;
+		p99[line] = atof(tab + 1);
+	}
+	fclose(f);
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	int trials = 100;
+	double stepDps = 100;
+	const char* only = NULL;
+	const char* baselinePath = NULL;
+	const char* savePath = NULL;
+	double tolerance = 20;
+	const char* directory = "/tmp";
+	bool verbose = false;
+	bench b;
+	RTLoop::defaultConfig(b.rt, FLIGHT_GYRO_RATE_HZ);
+	b.realTimeWarned = false;
+
+	int c;
+	while((c = getopt(argc, argv, "n:r:k:b:w:x:d:p:c:v")) != -1) {
+		switch(c) {
+		case 'n': trials = atoi(optarg); break;
+		case 'r': stepDps = atof(optarg); break;
+		case 'k': only = optarg; break;
+		case 'b': baselinePath = optarg; break;
+		case 'w': savePath = optarg; break;
+		case 'x': tolerance = atof(optarg); break;
+		case 'd': directory = optarg; break;
+		case 'p': b.rt.priority = atoi(optarg); break;
+		case 'c': b.rt.cpu = atoi(optarg); break;
+		case 'v': verbose = true; break;
+		default: return 1;
+		}
+	}
+	if(trials < 1) {
+		printf("Usage: %s [-n steps] [-r stepDps] [-k configuration] [-b baseline] [-w baseline] [-x percent] "
+				"[-d directory] [-p priority] [-c cpu] [-v]\n", argv[0]);
+		return 1;
+	}
+	map<string, double> baseline;
+	if(baselinePath && readBaseline(baselinePath, baseline))
+		return 1;
+
+	string root = string(directory) + "/pwmsysfsXXXXXX";
+	vector<char> rootPath(root.begin(), root.end());
+	rootPath.push_back(0);
+	if(!mkdtemp(&rootPath[0])) {
+		printf("Failed to create a sysfs tree in %s\n", directory);
+		return 1;
+	}
+	root = &rootPath[0];
+	if(makeSysfs(root)) {
+		nftw(root.c_str(), removeEntry, 8, FTW_DEPTH | FTW_PHYS);
+		return 1;
+	}
+	pwm_set_sysfs_root(root);
+
+	StepBench sensors;
+	i2c_set_transport(&sensors);
+	LMS303 lms303(1, 0x1d);
+	LPS331Altimeter alt(1, 0x5d);
+	L3GD20Gyro gyro(1, 0x6b);
+	aircraftControls aircraft(FLAP_MIX_ELEVON);
+	aircraft.init();	// The overlays are already loaded, but it still waits for them
+	uimu_ahrs_set_beta(0.1);	// As main.cpp
+
+	b.sensors = &sensors;
+	b.lms303 = &lms303;
+	b.alt = &alt;
+	b.gyro = &gyro;
+	b.aircraft = &aircraft;
+
+	LatencyHistogram results[CONFIGS];
+	unsigned long missed[CONFIGS];
+	bool ran[CONFIGS];
+	for(int i = 0; i < CONFIGS; i++) {
+		results[i].init(configs[i].name);
+		missed[i] = 0;
+		ran[i] = !only || strstr(configs[i].name, only);
+		if(ran[i])
+			missed[i] = measure(configs[i], b, trials, stepDps, results[i], verbose);
+	}
+	i2c_set_transport(NULL);
+	nftw(root.c_str(), removeEntry, 8, FTW_DEPTH | FTW_PHYS);
+
+	int failed = 0;
+	printf("\n%.0f dps roll steps, gyro sample to elevon duty written, us\n", stepDps);
+	printf("%-24s %6s %6s %8s %8s %8s %8s %9s\n", "configuration", "steps", "missed", "p50", "p90", "p99", "max",
+			"baseline");
+	for(int i = 0; i < CONFIGS; i++) {
+		if(!ran[i])
+			continue;
+		LatencyHistogram& h = results[i];
+		double p99 = h.percentile(0.99) / 1e3;
+		printf("%-24s %6u %6lu %8.0f %8.0f %8.0f %8.0f", configs[i].name, h.getCount(), missed[i],
+				h.percentile(0.5) / 1e3, h.percentile(0.9) / 1e3, p99, h.getMax() / 1e3);
+		map<string, double>::iterator base = baseline.find(configs[i].name);
+		if(base != baseline.end()) {
+			bool regressed = p99 > base->second * (1 + tolerance / 100);
+			printf(" %9.0f%s", base->second, regressed ? "  REGRESSED" : "");
+			if(regressed) failed = 1;
+		}
+		printf("\n");
+		if(missed[i]) failed = 1;
+	}
+
+	if(savePath) {
+		FILE* f = fopen(savePath, "w");
+		if(!f) {
+			printf("Failed to create %s\n", savePath);
+			return 1;
+		}
+		fprintf(f, "# main-stepLatency p99 us, %.0f dps steps\n", stepDps);
+		for(int i = 0; i < CONFIGS; i++)
+			if(ran[i]) fprintf(f, "%s\t%.0f\n", configs[i].name, results[i].percentile(0.99) / 1e3);
+		fclose(f);
+	}
+	return failed;
+}
@@ -0,0 +1,315 @@
+//============================================================================
+// Name        : main-sweep.cpp
+// Author      : John Boyd
+// Version     :
+// Copyright   : This work is free for you to copy.
+// Description : Sweeps AHRS gains over I2C recordings on every core. Each
+//				 (recording, parameter set) pair is an independent replay job
+//				 on the work stealing pool, scored against a reference
+//				 attitude for that recording: <recording>.ref.csv with rows of
+//				 micros,qw,qx,qy,qz (micros since the start of the recording,
+//				 further columns ignored). A main-replay CSV of a trusted
+//				 configuration is a valid reference. Prints the parameter sets
+//				 ranked by RMS attitude error over all recordings.
+//				 Usage: main-sweep [-j workers] [-f madgwick,mahony] [-b betas]
+//				        [-p kps] [-i kis] [-c correctionHzs] [-w warmupSeconds]
+//				        [-t top] [-g gyroRateHz] [-o results.csv] recording.i2c...
+//				 Lists are a,b,c or start:stop:step. Beta only applies to
+//				 Madgwick and kp/ki only to Mahony, so each filter gets its
+//				 own grid. -g is the gyro rate the recordings were flown at
+//				 (BBB-FlightComputer -f, 100 by default).
+//============================================================================
+
+#include "BBB-FlightComputer/BBB-FlightComputer.h"
+#include "BBB-FlightComputer/replay/replay.h"
+#include "BBB-FlightComputer/replay/workPool.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#define REFERENCE_SUFFIX		".ref.csv"
+#define REFERENCE_TOLERANCE_US	20000	// Ticks further than this from a reference row aren't scored
+#define DEFAULT_WARMUP_SECONDS	5.0
+#define DEFAULT_TOP				20
+
+using namespace std;
+
+struct refSample {
+	unsigned long long micros;
+	imu::Quaternion q;
+};
+
+struct sweepResult {	// Lives in the pool's shared memory, so plain data only
+	int ok;
+	unsigned long ticks;
+	unsigned long samples;	// Ticks scored against the reference
+	double sumSquares;		// deg^2
+	double maxError;		// deg
+};
+
+struct sweepJobs {
+	vector<string> recordings;
+	vector<replaySettings> settings;
+	unsigned long long warmupMicros;
+};
+
+struct scoreContext {
+	const vector<refSample>* reference;
+	size_t cursor;
+	unsigned long long warmupMicros;
+	sweepResult* result;
+};
+
+struct rankedSettings {
+	int index;
+	double rms;
+	double maxError;
+	unsigned long samples;
+	bool operator < (const rankedSettings& other) const { return rms < other.rms; }
+};
+
+static int loadReference(const string& path, vector<refSample>& reference) {
+	FILE* f = fopen(path.c_str(), "r");
+	if(f == NULL)
+		return 1;
+
+	reference.clear();
+	char line[512];
+	while(fgets(line, sizeof(line), f)) {
+		unsigned long long t;
+		double w, x, y, z;
+		if(sscanf(line, "%llu,%lf,%lf,%lf,%lf", &t, &w, &x, &y, &z) != 5)
+			continue;	// Header
+		refSample s;
+		s.micros = t;
+		s.q = imu::Quaternion(w, x, y, z);
+		reference.push_back(s);
+	}
+	fclose(f);
+	return reference.empty() ? 2 : 0;
+}
+
+static void scoreTick(const replayTick& tick, void* context) {
+	scoreContext* c = (scoreContext*)context;
+	c->result->ticks++;
+	const vector<refSample>& ref = *c->reference;
+
+	while(c->cursor + 1 < ref.size() && ref[c->cursor + 1].micros <= tick.micros)
+		c->cursor++;
+	size_t nearest = c->cursor;
+	if(nearest + 1 < ref.size() &&
+			ref[nearest + 1].micros - tick.micros < tick.micros - ref[nearest].micros)
+		nearest++;
+
+	unsigned long long gap = ref[nearest].micros > tick.micros ?
+			ref[nearest].micros - tick.micros : tick.micros - ref[nearest].micros;
+	if(tick.micros < c->warmupMicros || gap > REFERENCE_TOLERANCE_US)
+		return;
+
+	const imu::Quaternion& q = uimu_ahrs_get_quaternion();
+	const imu::Quaternion& r = ref[nearest].q;
+	double dot = fabs(q.w()*r.w() + q.x()*r.x() + q.y()*r.y() + q.z()*r.z());
+	if(dot > 1.0) dot = 1.0;
+	double error = 2.0 * acos(dot) * 180.0 / M_PI;
+
+	c->result->sumSquares += error * error;
+	if(error > c->result->maxError) c->result->maxError = error;
+	c->result->samples++;
+}
+
+// Worker side. Jobs are ordered recording first, so a worker keeps one recording loaded
+// for as long as it is working through that recording's parameter sets.
+static void runJob(int job, void* result, void* context) {
+	static I2CReplay* replay = NULL;
+	static vector<refSample> reference;
+	static int loaded = -1;
+
+	sweepJobs* jobs = (sweepJobs*)context;
+	int recording = job / jobs->settings.size();
+	const replaySettings& settings = jobs->settings[job % jobs->settings.size()];
+	sweepResult* r = (sweepResult*)result;
+
+	if(recording != loaded) {
+		delete replay;
+		replay = new I2CReplay();
+		loaded = recording;
+		const string& path = jobs->recordings[recording];
+		if(replay->load(path.c_str()) || loadReference(path + REFERENCE_SUFFIX, reference)) {
+			delete replay;
+			replay = NULL;
+		}
+	}
+	if(replay == NULL)
+		return;
+
+	scoreContext c;
+	c.reference = &reference;
+	c.cursor = 0;
+	c.warmupMicros = jobs->warmupMicros;
+	c.result = r;
+	r->ok = replay_flight(*replay, settings, scoreTick, &c) > 0;
+}
+
+static int parseList(const char* text, vector<float>& values) {
+	values.clear();
+	float start, stop, step;
+	if(sscanf(text, "%f:%f:%f", &start, &stop, &step) == 3) {
+		if(step <= 0 || stop < start)
+			return 1;
+		for(int i = 0; start + i * step <= stop + step * 1e-3f; i++)
+			values.push_back(start + i * step);
+		return 0;
+	}
+
+	string list = text;
+	size_t pos = 0;
+	while(pos <= list.size()) {
+		size_t comma = list.find(',', pos);
+		if(comma == string::npos) comma = list.size();
+		values.push_back(atof(list.substr(pos, comma - pos).c_str()));
+		pos = comma + 1;
+	}
+	return values.empty();
+}
+
+static void printSettings(const replaySettings& s) {
+	if(s.filter == AHRS_FILTER_MADGWICK)
+		printf("madgwick beta=%g", s.beta);
+	else
+		printf("mahony kp=%g ki=%g", s.kp, s.ki);
+	printf(" correction=%gHz", s.correctionHz);
+}
+
+int main(int argc, char* argv[]) {
+	int workers = work_pool_default_workers();
+	bool madgwick = true, mahony = true;
+	vector<float> betas(1, 0.1f), kps(1, 0.5f), kis(1, 0.0f), rates(1, 100.0f);
+	double warmup = DEFAULT_WARMUP_SECONDS;
+	int top = DEFAULT_TOP;
+	const char* resultsPath = NULL;
+	replaySettings s;
+	replay_default_settings(s);
+
+	int c;
+	while((c = getopt(argc, argv, "j:f:b:p:i:c:w:t:g:o:")) != -1) {
+		int bad = 0;
+		switch(c) {
+		case 'j': workers = atoi(optarg); break;
+		case 'f':
+			madgwick = strstr(optarg, "madgwick") != NULL;
+			mahony = strstr(optarg, "mahony") != NULL;
+			bad = !madgwick && !mahony;
+			break;
+		case 'b': bad = parseList(optarg, betas); break;
+		case 'p': bad = parseList(optarg, kps); break;
+		case 'i': bad = parseList(optarg, kis); break;
+		case 'c': bad = parseList(optarg, rates); break;
+		case 'w': warmup = atof(optarg); break;
+		case 't': top = atoi(optarg); break;
+		case 'g':
+			s.gyroRateHz = atof(optarg);
+			bad = s.gyroRateHz <= 0;
+			break;
+		case 'o': resultsPath = optarg; break;
+		default: return 1;
+		}
+		if(bad) {
+			printf("Bad value for -%c: %s\n", c, optarg);
+			return 1;
+		}
+	}
+
+	sweepJobs jobs;
+	jobs.warmupMicros = (unsigned long long)(warmup * 1e6);
+	for(int i = optind; i < argc; i++) {
+		string ref = string(argv[i]) + REFERENCE_SUFFIX;
+		if(access(ref.c_str(), R_OK) != 0) {
+			printf("Skipping %s, no %s\n", argv[i], ref.c_str());
+			continue;
+		}
+		jobs.recordings.push_back(argv[i]);
+	}
+	if(jobs.recordings.empty()) {
+		printf("Usage: %s [-j workers] [-f madgwick,mahony] [-b betas] [-p kps] [-i kis] "
+				"[-c correctionHzs] [-w warmupSeconds] [-t top] [-g gyroRateHz] [-o results.csv] "
+				"recording.i2c...\n", argv[0]);
+		return 1;
+	}
+
+	for(size_t r = 0; r < rates.size(); r++) {
+		s.correctionHz = rates[r];
+		s.filter = AHRS_FILTER_MADGWICK;
+		for(size_t b = 0; madgwick && b < betas.size(); b++) {
+			s.beta = betas[b];
+			jobs.settings.push_back(s);
+		}
+		s.filter = AHRS_FILTER_MAHONY;
+		for(size_t p = 0; mahony && p < kps.size(); p++) {
+			for(size_t i = 0; i < kis.size(); i++) {
+				s.kp = kps[p];
+				s.ki = kis[i];
+				jobs.settings.push_back(s);
+			}
+		}
+	}
+
+	int jobCount = jobs.recordings.size() * jobs.settings.size();
+	printf("%d recordings x %d parameter sets = %d replays on %d workers\n",
+			(int)jobs.recordings.size(), (int)jobs.settings.size(), jobCount, workers);
+
+	vector<sweepResult> results(jobCount);
+	workPoolStats pool;
+	if(work_pool_run(jobCount, workers, sizeof(sweepResult), runJob, &jobs, &results[0], &pool))
+		printf("%d worker(s) failed, their unfinished jobs are missing from the ranking\n", pool.failedWorkers);
+
+	// Combine each parameter set's runs over every recording
+	vector<rankedSettings> ranking;
+	int failedJobs = 0;
+	for(size_t p = 0; p < jobs.settings.size(); p++) {
+		rankedSettings rank;
+		rank.index = p;
+		rank.maxError = 0;
+		rank.samples = 0;
+		double sumSquares = 0;
+		for(size_t r = 0; r < jobs.recordings.size(); r++) {
+			const sweepResult& result = results[r * jobs.settings.size() + p];
+			if(!result.ok) {
+				failedJobs++;
+				continue;
+			}
+			sumSquares += result.sumSquares;
+			rank.samples += result.samples;
+			if(result.maxError > rank.maxError) rank.maxError = result.maxError;
+		}
+		if(rank.samples == 0) continue;
+		rank.rms = sqrt(sumSquares / rank.samples);
+		ranking.push_back(rank);
+	}
+	sort(ranking.begin(), ranking.end());
+
+	printf("Done in %.2f s, %lu steals, %d failed replays\n\n", pool.seconds, pool.steals, failedJobs);
+	printf("%4s %10s %10s %10s  %s\n", "rank", "rms deg", "max deg", "samples", "settings");
+	for(int i = 0; i < (int)ranking.size() && i < top; i++) {
+		printf("%4d %10.3f %10.3f %10lu  ", i + 1, ranking[i].rms, ranking[i].maxError, ranking[i].samples);
+		printSettings(jobs.settings[ranking[i].index]);
+		printf("\n");
+	}
+
+	if(resultsPath) {
+		FILE* out = fopen(resultsPath, "w");
+		if(out == NULL) {
+			printf("Failed to create %s\n", resultsPath);
+			return 1;
+		}
+		fprintf(out, "rank,rms_deg,max_deg,samples,filter,beta,kp,ki,correction_hz\n");
+		for(size_t i = 0; i < ranking.size(); i++) {
+			const replaySettings& rs = jobs.settings[ranking[i].index];
+			fprintf(out, "%d,%.4f,%.4f,%lu,%s,%g,%g,%g,%g\n", (int)i + 1, ranking[i].rms,
+					ranking[i].maxError, ranking[i].samples,
+					rs.filter == AHRS_FILTER_MADGWICK ? "madgwick" : "mahony",
+					rs.beta, rs.kp, rs.ki, rs.correctionHz);
+		}
+		fclose(out);
+	}
+	return ranking.empty() ? 1 : 0;
+}
@@ -4,15 +4,49 @@
 // Version     :
 // Copyright   : This work is free for you to copy.
 // Description : Main function for Beaglebone Black flight computer.
+//				 Usage: BBB-FlightComputer [-r recording.i2c] [-l flight.log]
+//				        [-f gyroRateHz] [-p priority] [-c cpu]
+//				 -r records all sensor I2C traffic for main-replay.
+//				 -l runs the flight data recorder: one binary record of
+//				 sensors, attitude, demands and PWM outputs at 50 Hz,
+//				 plus every raw gyro and accel FIFO sample, compressed,
+//				 in flight.log.imu.
+//				 Tasks run in rate groups from one real-time thread: gyro,
+//				 AHRS, rate loop and mixer at the gyro rate, accel/mag and
+//				 the attitude loop at 50 Hz, baro at 25 Hz and telemetry at
+//				 10 Hz. The rate loop runs on every gyro FIFO sample, the
+//				 attitude loop on the AHRS quaternion, holding wings level;
+//				 Euler angles are only worked out for the status display.
+//				 -f, -p and -c set the gyro rate (a multiple of 50 Hz, 100
+//				 by default), the loop's SCHED_FIFO priority (0 to stay
+//				 SCHED_OTHER) and the CPU it is pinned to.
+//				 Ctrl-C stops the loop and prints its timing and per-task
+//				 budget, shed and missed counts.
+//				 SIGUSR1 prints the per-stage latencies at any time.
+//				 Built with ALLOC_TRACKING it also reports any allocation the
+//				 flight tasks made after the first seconds, see
+//				 realtime/allocTrack.h.
+//				 Status is printed by a low priority thread a few times a
+//				 second; the flight loop only publishes a snapshot.
 // Resources   : PRU - https://github.com/beagleboard/am335x_pru_package
 //============================================================================
 
 #include "BBB-FlightComputer/BBB-FlightComputer.h"
+#include "BBB-FlightComputer/flightControl/flightLoop.h"
+#include "BBB-FlightComputer/realtime/latency.h"
+#include "BBB-FlightComputer/realtime/console.h"
+#include "BBB-FlightComputer/realtime/allocTrack.h"
+#include <signal.h>
 
 unsigned long delta_t;
+volatile sig_atomic_t stopRequested = 0;
 
 using namespace std;
 
+static void requestStop(int) {
+	stopRequested = 1;
+}
+
 int main(int argc, char* argv[]) {
 	/* Experimental Quaternion based AHRS
 	LMS303 lms303(1, 0x1d);
@@ -94,55 +128,88 @@ int main(int argc, char* argv[]) {
 
 	}*/
 
+	rtLoopConfig rt;
+	RTLoop::defaultConfig(rt, FLIGHT_GYRO_RATE_HZ);
+	const char* recording = NULL;
+	const char* flightLog = NULL;
+
+	int c;
+	while((c = getopt(argc, argv, "r:l:f:p:c:")) != -1) {
+		switch(c) {
+		case 'r': recording = optarg; break;
+		case 'l': flightLog = optarg; break;
+		case 'f': rt.rateHz = atof(optarg); break;
+		case 'p': rt.priority = atoi(optarg); break;
+		case 'c': rt.cpu = atoi(optarg); break;
+		default: return 1;
+		}
+	}
+	if(rt.rateHz < FLIGHT_LOOP_HZ || fmodf(rt.rateHz, FLIGHT_LOOP_HZ) != 0) {
+		cout << "Gyro rate must be a multiple of " << FLIGHT_LOOP_HZ << " Hz" << endl;
+		return 1;
+	}
+
+	if(recording && i2c_record_open(recording))	// Before the sensors so their setup is recorded too
+		return 1;
+
 	LMS303 lms303(1, 0x1d);
 	LPS331Altimeter alt(1, 0x5d);
 	L3GD20Gyro gyro(1, 0x6b);
+	cout << "Hold still, calibrating the gyro..." << endl;
+	gyro.calibrateZeroRate(FLIGHT_GYRO_ZERO_READS);
 
 	// Aircraft
 	aircraftControls aircraft(FLAP_MIX_ELEVON);
 	aircraft.init();
 
-	float pitchReading = 0;
-	float rollReading = 0;
-
-	while(1) {
-		lms303.readFullSensorState();
-		gyro.readFullSensorState();
-		alt.readFullSensorState();
-
-		cout << "##################################\n";
-
-		cout << "Magnetism X:\t" << lms303.getMagX() << " gauss" << endl;
-		cout << "Magnetism Y:\t" << lms303.getMagY() << " gauss" << endl;
-		cout << "Magnetism Z:\t" << lms303.getMagZ() << " gauss" << endl << endl;
-
-		cout << "Accel X:\t" << lms303.getAccelX() << " g" << endl;
-		cout << "Accel Y:\t" << lms303.getAccelY() << " g" << endl;
-		cout << "Accel Z:\t" << lms303.getAccelZ() << " g" << endl << endl;
-
+	uimu_ahrs_init(lms303.read_acc(), lms303.read_mag());
+	uimu_ahrs_set_beta(FLIGHT_AHRS_BETA);
 
-		pitchReading = lms303.getPitch();
-		rollReading = lms303.getRoll();
-		cout << "Pitch:\t" << pitchReading << "\u00b0" << endl;
-		cout << "Roll:\t" << rollReading << "\u00b0" << endl << endl;
+	AttitudeController controller;	// Holds wings level: zero attitude setpoints
 
-		aircraft.setPitch(-1*pitchReading*100/90);
-		aircraft.setRoll(-1*rollReading*100/90);
-		cout << aircraft.getPitch() << endl;
-		cout << aircraft.getRoll() << endl;
+	latency_start_dump_thread();
+	console_start(CONSOLE_DEFAULT_HZ, flight_print_status);
 
-		cout << "Core temperature:\t" << lms303.getTemperature() << "\u00b0C" << endl << endl;
+	FlightRecorder recorder;	// Before the loop setup, so its buffers are locked and its writer isn't SCHED_FIFO
+	if(flightLog && recorder.open(flightLog, FLIGHT_LOOP_HZ))
+		cout << "Flying without a flight log" << endl;
+	ImuStreamWriter imuStream;
+	if(recorder.isOpen() && imuStream.open((string(flightLog) + IMU_STREAM_SUFFIX).c_str()))
+		cout << "Flying without the raw IMU stream" << endl;
 
-		cout << "Pressure:\t" << alt.getPressure() << " mBar" << endl;
-		cout << "Altitude:\t" << alt.getAltitude() << " m" << endl << endl;
-
-		cout << "Roll X:\t" << gyro.getGyroX() << " \u00b0/s" << endl;
-		cout << "Roll Y:\t" << gyro.getGyroY() << " \u00b0/s" << endl;
-		cout << "Roll Z:\t" << gyro.getGyroZ() << " \u00b0/s" << endl;
-
-		//usleep(10000);
-
-	} // \Hardware test
+	RateGroupExecutive executive(rt.rateHz);
+	flightTasks tasks;
+	flight_tasks_init(tasks, lms303, alt, gyro, aircraft, controller, recorder, imuStream, executive);
+	int overloaded = flight_tasks_add(tasks) ? -1 : executive.build();
+	if(overloaded < 0) {
+		cout << "Can't schedule the flight tasks at " << rt.rateHz << " Hz, not flying" << endl;
+		return 1;
+	}
+	if(overloaded)
+		cout << "Task budgets don't fit the gyro rate, low priority tasks will be shed" << endl;
+	executive.printSchedule(cout);
+
+	if(executive.setup(rt))
+		cout << "Flight loop running without full real-time guarantees" << endl;
+	signal(SIGINT, requestStop);
+	signal(SIGTERM, requestStop);
+
+	unsigned long warmup = (unsigned long)(ALLOC_TRACK_WARMUP_SECONDS * rt.rateHz);
+	for(unsigned long frame = 0; !stopRequested; frame++) {
+		executive.runFrame();
+		if(frame == warmup)
+			alloc_track_start();
+	}
 
-	return 0;
+	recorder.close();
+	imuStream.close();
+	console_stop();
+	executive.report(cout);
+	latency_report(cout);
+	if(flightLog) recorder.report(cout, "Flight log");
+	if(flightLog) imuStream.report(cout);
+	alloc_track_report(cout);
+	i2c_record_close();
+	if(recording) i2c_record_report(cout);
+	return alloc_track_errors() ? 1 : 0;
 }